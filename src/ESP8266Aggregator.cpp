@@ -0,0 +1,192 @@
+#include "ESP8266Aggregator.h"
+#include "ESP8266Parameters.h"
+
+ESP8266Aggregator aggregator;
+
+static const uint32_t kRollupPeriodMs[ROLLUP_LEVELS] = {60000UL, 900000UL, 3600000UL};
+
+void RunningStats::merge(const RunningStats &other)
+{
+    if (other.count == 0)
+        return;
+    if (count == 0)
+    {
+        *this = other;
+        return;
+    }
+    uint32_t total = count + other.count;
+    float delta = other.mean - mean;
+    mean += delta * other.count / total;
+    m2 += other.m2 + delta * delta * ((float)count * other.count / total);
+    if (other.minV < minV)
+        minV = other.minV;
+    if (other.maxV > maxV)
+        maxV = other.maxV;
+    count = total;
+}
+
+void Rollup::reset(uint32_t start)
+{
+    start_ms = start;
+    end_ms = start;
+    present_mask = 0;
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        stats[i].reset();
+    }
+}
+
+void Rollup::add(const Sample &sample)
+{
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        ParameterType param = static_cast<ParameterType>(i);
+        if (!sample.hasValue(param))
+            continue;
+        stats[i].add(ESP8266Aggregator::uploadValue(sample, param));
+    }
+    present_mask |= sample.present_mask;
+    end_ms = sample.timestamp;
+}
+
+void Rollup::merge(const Rollup &other)
+{
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        stats[i].merge(other.stats[i]);
+    }
+    present_mask |= other.present_mask;
+    if (other.start_ms < start_ms)
+        start_ms = other.start_ms;
+    if (other.end_ms > end_ms)
+        end_ms = other.end_ms;
+}
+
+ESP8266Aggregator::ESP8266Aggregator()
+{
+    reset();
+}
+
+void ESP8266Aggregator::reset()
+{
+    for (uint8_t level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        open_[level].reset(0);
+        closed_[level].reset(0);
+        started_[level] = false;
+    }
+    pendingCount_ = 0;
+    compactions_ = 0;
+}
+
+uint32_t ESP8266Aggregator::periodMs(uint8_t level)
+{
+    return level < ROLLUP_LEVELS ? kRollupPeriodMs[level] : 0;
+}
+
+int32_t ESP8266Aggregator::uploadValue(const Sample &sample, ParameterType param)
+{
+    // Upload scale from the parameter table: AC measurements go up as milli-units
+    return (int32_t)roundf(sample.getValue(param) * param_upload_scale(param));
+}
+
+void ESP8266Aggregator::add(const Sample &sample)
+{
+    if (sample.present_mask == 0)
+        return;
+
+    for (uint8_t level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        Rollup &bucket = open_[level];
+        if (!started_[level])
+        {
+            bucket.reset(sample.timestamp);
+            started_[level] = true;
+        }
+        else if (sample.timestamp - bucket.start_ms >= kRollupPeriodMs[level])
+        {
+            closed_[level] = bucket;
+            if (level == 0)
+                enqueue(bucket);
+            bucket.reset(sample.timestamp);
+        }
+        bucket.add(sample);
+    }
+}
+
+void ESP8266Aggregator::enqueue(const Rollup &rollup)
+{
+    if (pendingCount_ == ROLLUP_QUEUE_SIZE)
+    {
+        // Merge the adjacent pair covering the least time
+        size_t best = 0;
+        uint32_t bestSpan = UINT32_MAX;
+        for (size_t i = 0; i + 1 < pendingCount_; i++)
+        {
+            uint32_t span = pending_[i + 1].end_ms - pending_[i].start_ms;
+            if (span < bestSpan)
+            {
+                bestSpan = span;
+                best = i;
+            }
+        }
+        pending_[best].merge(pending_[best + 1]);
+        for (size_t i = best + 1; i + 1 < pendingCount_; i++)
+        {
+            pending_[i] = pending_[i + 1];
+        }
+        pendingCount_--;
+        compactions_++;
+    }
+    pending_[pendingCount_++] = rollup;
+}
+
+void ESP8266Aggregator::dropThrough(uint32_t end_ms)
+{
+    size_t dropped = 0;
+    while (dropped < pendingCount_ && pending_[dropped].end_ms <= end_ms)
+    {
+        dropped++;
+    }
+    for (size_t i = dropped; i < pendingCount_; i++)
+    {
+        pending_[i - dropped] = pending_[i];
+    }
+    pendingCount_ -= dropped;
+}
+
+void ESP8266Aggregator::printStatus() const
+{
+    static const char *kLevelNames[ROLLUP_LEVELS] = {"1m", "15m", "1h"};
+    for (uint8_t level = 0; level < ROLLUP_LEVELS; level++)
+    {
+        const Rollup &r = closed_[level].empty() ? open_[level] : closed_[level];
+        Serial.print("Rollup ");
+        Serial.print(kLevelNames[level]);
+        Serial.print(closed_[level].empty() ? " (open): " : ": ");
+        bool first = true;
+        for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+        {
+            if (!(r.present_mask & (1u << i)))
+                continue;
+            const RunningStats &s = r.stats[i];
+            if (!first)
+                Serial.print(", ");
+            first = false;
+            Serial.print(FPSTR(param_key(static_cast<ParameterType>(i))));
+            Serial.print(" n=");
+            Serial.print(s.count);
+            Serial.print(" mean=");
+            Serial.print(s.mean, 1);
+            Serial.print(" sd=");
+            Serial.print(sqrtf(s.variance()), 1);
+        }
+        Serial.println(first ? "no samples" : "");
+    }
+    Serial.print("Rollup queue: ");
+    Serial.print(pendingCount_);
+    Serial.print("/");
+    Serial.print(ROLLUP_QUEUE_SIZE);
+    Serial.print(", compactions ");
+    Serial.println(compactions_);
+}
@@ -0,0 +1,101 @@
+#ifndef ESP8266_AGGREGATOR_H
+#define ESP8266_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "ESP8266DataTypes.h"
+
+#define ROLLUP_LEVELS 3
+#define ROLLUP_QUEUE_SIZE 8         // Closed 1-minute rollups kept for catch-up uploads
+#define ROLLUP_BACKLOG_SAMPLES 200  // Spilled samples before uploads switch to rollups
+
+// Running min/max/mean/variance (Welford), mergeable (Chan et al.)
+struct RunningStats
+{
+    uint32_t count;
+    float mean;
+    float m2; // Sum of squared differences from the mean
+    int32_t minV;
+    int32_t maxV;
+
+    void reset()
+    {
+        count = 0;
+        mean = 0.0f;
+        m2 = 0.0f;
+        minV = 0;
+        maxV = 0;
+    }
+
+    void add(int32_t x)
+    {
+        if (count == 0 || x < minV)
+            minV = x;
+        if (count == 0 || x > maxV)
+            maxV = x;
+        count++;
+        float delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    void merge(const RunningStats &other);
+    float variance() const { return count > 1 ? m2 / (count - 1) : 0.0f; }
+};
+
+// One window of statistics for every parameter seen in it
+struct Rollup
+{
+    uint32_t start_ms;
+    uint32_t end_ms;       // Timestamp of the last sample included
+    uint16_t present_mask; // Parameters with at least one value
+    RunningStats stats[PARAMETER_TYPE_COUNT];
+
+    void reset(uint32_t start);
+    void add(const Sample &sample);
+    void merge(const Rollup &other);
+    bool empty() const { return present_mask == 0; }
+    const RunningStats &get(ParameterType param) const { return stats[static_cast<uint8_t>(param)]; }
+};
+
+// Incremental per-parameter statistics fed from every poll, over 1-minute,
+// 15-minute and 1-hour windows at once. Closed 1-minute rollups also enter a
+// short queue that catch-up uploads send instead of the raw backlog; when the
+// queue is full the adjacent pair spanning the least time is merged, so older
+// history is kept at coarser resolution instead of being dropped.
+class ESP8266Aggregator
+{
+public:
+    ESP8266Aggregator();
+
+    void add(const Sample &sample);
+    void reset();
+
+    const Rollup &open(uint8_t level) const { return open_[level]; }
+    const Rollup &closed(uint8_t level) const { return closed_[level]; }
+    static uint32_t periodMs(uint8_t level);
+
+    // Catch-up queue, oldest first
+    size_t pendingCount() const { return pendingCount_; }
+    const Rollup &pending(size_t i) const { return pending_[i]; }
+    // Drop queued rollups that end at or before end_ms (acknowledged upload)
+    void dropThrough(uint32_t end_ms);
+
+    void printStatus() const;
+
+    // A parameter's value as the uploader scales it into integer series
+    static int32_t uploadValue(const Sample &sample, ParameterType param);
+
+private:
+    Rollup open_[ROLLUP_LEVELS];
+    Rollup closed_[ROLLUP_LEVELS];
+    bool started_[ROLLUP_LEVELS];
+    Rollup pending_[ROLLUP_QUEUE_SIZE];
+    size_t pendingCount_;
+    uint32_t compactions_;
+
+    void enqueue(const Rollup &rollup);
+};
+
+extern ESP8266Aggregator aggregator;
+
+#endif // ESP8266_AGGREGATOR_H
@@ -0,0 +1,646 @@
+#include "ESP8266AsyncHttp.h"
+#include "ESP8266Log.h"
+
+ESP8266AsyncHttp *ESP8266AsyncHttp::channels_ = nullptr;
+
+// Print adapter that frames everything written to it as HTTP/1.1 chunks
+class ChunkedPrint : public Print
+{
+public:
+    explicit ChunkedPrint(WiFiClient &client) : client_(client), used_(0), total_(0), socketUs_(0), failed_(false) {}
+
+    size_t write(uint8_t byte) override
+    {
+        buffer_[used_++] = byte;
+        total_++;
+        if (used_ == CHUNK_BUFFER_SIZE)
+            flushChunk();
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t length) override
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            write(data[i]);
+        }
+        return length;
+    }
+    using Print::write;
+
+    // Send the last partial chunk and the terminating zero-length chunk
+    bool finish()
+    {
+        flushChunk();
+        if (!failed_ && client_.write((const uint8_t *)"0\r\n\r\n", 5) != 5)
+            failed_ = true;
+        return !failed_;
+    }
+
+    size_t total() const { return total_; }
+    // Time spent in socket writes, so the writer's own time can be told apart
+    uint32_t socketMicros() const { return socketUs_; }
+
+private:
+    WiFiClient &client_;
+    uint8_t buffer_[CHUNK_BUFFER_SIZE];
+    size_t used_;
+    size_t total_;
+    uint32_t socketUs_;
+    bool failed_;
+
+    void flushChunk()
+    {
+        if (used_ == 0 || failed_)
+        {
+            used_ = 0;
+            return;
+        }
+        char head[8];
+        int n = snprintf(head, sizeof(head), "%x\r\n", (unsigned)used_);
+        uint32_t started = micros();
+        if (client_.write((const uint8_t *)head, n) != (size_t)n ||
+            client_.write(buffer_, used_) != used_ ||
+            client_.write((const uint8_t *)"\r\n", 2) != 2)
+        {
+            failed_ = true;
+        }
+        socketUs_ += micros() - started;
+        used_ = 0;
+    }
+};
+
+ESP8266AsyncHttp::ESP8266AsyncHttp(const char *name)
+    : name_(name), state_(HttpState::Idle), get_(false), port_(80), contentType_(nullptr), data_(nullptr), length_(0),
+      timeoutMs_(5000), code_(0), reused_(false), keepAlive_(true), chunked_(false), gotBytes_(false),
+      contentLength_(-1), chunkRemaining_(0), contentRangeStart_(-1), rawSink_(false), rawBuffer_(nullptr),
+      rawData_(nullptr), rawCapacity_(0), rawLength_(0), rawOverflow_(false), sinkFailed_(false), sentAt_(0), sentAtUs_(0), deadline_(0), lastUsed_(0), bytesSent_(0), next_(channels_)
+{
+    memset(&stats_, 0, sizeof(stats_));
+    memset(&timing_, 0, sizeof(timing_));
+    channels_ = this;
+}
+
+void ESP8266AsyncHttp::setResponseBuffer(uint8_t *buffer, size_t capacity)
+{
+    rawBuffer_ = buffer;
+    rawCapacity_ = capacity;
+}
+
+bool ESP8266AsyncHttp::begin(const String &url, const char *contentType, uint16_t timeout_ms,
+                             const char *bearerToken, HttpCompletion onDone)
+{
+    if (busy())
+    {
+        LOG_W("HTTP", "%s channel busy", name_);
+        return false;
+    }
+
+    // "http://host:port/path" -> "host:port", "/path"
+    int start = url.indexOf("://");
+    start = (start < 0) ? 0 : start + 3;
+    int end = url.indexOf('/', start);
+    String key = (end < 0) ? url.substring(start) : url.substring(start, end);
+    path_ = (end < 0) ? String("/") : url.substring(end);
+
+    // A kept-alive socket is only reused for the same host and while fresh
+    if (client_.connected() && (key != hostKey_ || millis() - lastUsed_ > ASYNC_HTTP_IDLE_TIMEOUT_MS))
+    {
+        client_.stop();
+    }
+    if (key != hostKey_)
+    {
+        hostKey_ = key;
+        int colon = key.indexOf(':');
+        host_ = (colon < 0) ? key : key.substring(0, colon);
+        port_ = (colon < 0) ? 80 : (uint16_t)key.substring(colon + 1).toInt();
+    }
+
+    contentType_ = contentType;
+    bearer_ = bearerToken ? bearerToken : "";
+    timeoutMs_ = timeout_ms;
+    onDone_ = onDone;
+    code_ = 0;
+    response_ = String();
+    rawSink_ = rawBuffer_ != nullptr;
+    rawData_ = rawBuffer_;
+    rawLength_ = 0;
+    rawOverflow_ = false;
+    sinkFailed_ = false;
+    bytesSent_ = 0;
+    memset(&timing_, 0, sizeof(timing_));
+    reused_ = client_.connected();
+    state_ = HttpState::Connecting;
+    return true;
+}
+
+bool ESP8266AsyncHttp::start(const String &url, const char *contentType, const BodyWriter &writer,
+                             uint16_t timeout_ms, const char *bearerToken, HttpCompletion onDone)
+{
+    if (!begin(url, contentType, timeout_ms, bearerToken, onDone))
+        return false;
+    get_ = false;
+    extraHeaders_ = String();
+    writer_ = writer;
+    data_ = nullptr;
+    length_ = 0;
+    return true;
+}
+
+bool ESP8266AsyncHttp::start(const String &url, const char *contentType, const uint8_t *body, size_t length,
+                             uint16_t timeout_ms, const char *bearerToken, HttpCompletion onDone)
+{
+    if (!begin(url, contentType, timeout_ms, bearerToken, onDone))
+        return false;
+    get_ = false;
+    extraHeaders_ = String();
+    writer_ = nullptr;
+    data_ = body;
+    length_ = length;
+    return true;
+}
+
+bool ESP8266AsyncHttp::startGet(const String &url, const String &extraHeaders, uint16_t timeout_ms,
+                                const char *bearerToken, HttpCompletion onDone)
+{
+    if (!begin(url, nullptr, timeout_ms, bearerToken, onDone))
+        return false;
+    get_ = true;
+    extraHeaders_ = extraHeaders;
+    writer_ = nullptr;
+    data_ = nullptr;
+    length_ = 0;
+    return true;
+}
+
+bool ESP8266AsyncHttp::sendRequest()
+{
+    String head;
+    head.reserve(192 + path_.length() + hostKey_.length() + bearer_.length() + extraHeaders_.length());
+    head = get_ ? "GET " : "POST ";
+    head += path_;
+    head += " HTTP/1.1\r\nHost: ";
+    head += hostKey_;
+    head += "\r\nConnection: keep-alive";
+    if (!get_)
+    {
+        head += "\r\nContent-Type: ";
+        head += contentType_;
+        if (writer_)
+        {
+            head += "\r\nTransfer-Encoding: chunked";
+        }
+        else
+        {
+            head += "\r\nContent-Length: ";
+            head += (unsigned long)length_;
+        }
+    }
+    if (bearer_.length() > 0)
+    {
+        head += "\r\nAuthorization: Bearer ";
+        head += bearer_;
+    }
+    head += "\r\n";
+    head += extraHeaders_;
+    head += "\r\n";
+    if (client_.write((const uint8_t *)head.c_str(), head.length()) != head.length())
+        return false;
+
+    if (writer_)
+    {
+        ChunkedPrint out(client_);
+        uint32_t started = micros();
+        writer_(out);
+        timing_.body_us = micros() - started - out.socketMicros();
+        bool sent = out.finish();
+        bytesSent_ = out.total();
+        return sent;
+    }
+    bytesSent_ = length_;
+    return length_ == 0 || client_.write(data_, length_) == length_;
+}
+
+bool ESP8266AsyncHttp::poll()
+{
+    switch (state_)
+    {
+    case HttpState::Idle:
+    case HttpState::Done:
+        return false;
+
+    case HttpState::Connecting:
+        // Skipped entirely on a kept-alive socket; a fresh connect is the one
+        // step that waits, bounded by the request timeout
+        if (!client_.connected())
+        {
+            client_.setTimeout(timeoutMs_);
+            uint32_t started = micros();
+            bool connected = client_.connect(host_.c_str(), port_);
+            timing_.connect_us = micros() - started;
+            if (!connected)
+            {
+                complete(HTTPC_ERROR_CONNECTION_REFUSED);
+                return false;
+            }
+        }
+        state_ = HttpState::Sending;
+        return true;
+
+    case HttpState::Sending:
+    {
+        uint32_t started = micros();
+        bool sent = sendRequest();
+        timing_.send_us = micros() - started;
+        if (!sent)
+        {
+            complete(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+            return false;
+        }
+        sentAtUs_ = micros();
+        sentAt_ = millis();
+        deadline_ = sentAt_ + timeoutMs_;
+        keepAlive_ = true;
+        chunked_ = false;
+        gotBytes_ = false;
+        contentLength_ = -1;
+        contentRangeStart_ = -1;
+        etag_ = String();
+        line_ = String();
+        state_ = HttpState::StatusLine;
+        return true;
+    }
+
+    default:
+        break;
+    }
+
+    // Parse whatever has arrived, within a budget so one large response
+    // cannot hold the loop
+    uint8_t buf[128];
+    size_t budget = ASYNC_HTTP_READ_BUDGET;
+    int avail;
+    while (busy() && budget > 0 && (avail = client_.available()) > 0)
+    {
+        size_t want = (size_t)avail;
+        if (want > sizeof(buf))
+            want = sizeof(buf);
+        if (want > budget)
+            want = budget;
+        size_t got = client_.read(buf, want);
+        if (got == 0)
+            break;
+        gotBytes_ = true;
+        budget -= got;
+        consume(buf, got);
+    }
+    if (!busy())
+        return false;
+
+    if (!client_.connected() && client_.available() == 0)
+    {
+        if (state_ == HttpState::Body && contentLength_ < 0)
+        {
+            // No length: the body ends when the server closes the connection
+            keepAlive_ = false;
+            complete(code_);
+        }
+        else if (reused_ && !gotBytes_)
+        {
+            // The kept-alive socket went stale; resend once on a fresh connection
+            LOG_W("HTTP", "Stale connection to %s, reconnecting", hostKey_.c_str());
+            stats_.reconnects++;
+            client_.stop();
+            reused_ = false;
+            state_ = HttpState::Connecting;
+            return true;
+        }
+        else
+        {
+            complete(HTTPC_ERROR_CONNECTION_LOST);
+        }
+        return false;
+    }
+
+    if ((long)(millis() - deadline_) >= 0)
+    {
+        complete(HTTPC_ERROR_READ_TIMEOUT);
+        return false;
+    }
+    return true;
+}
+
+int ESP8266AsyncHttp::wait()
+{
+    while (poll())
+    {
+        yield();
+    }
+    return code_;
+}
+
+bool ESP8266AsyncHttp::takeLine(uint8_t byte)
+{
+    if (byte == '\n')
+        return true;
+    if (byte != '\r' && line_.length() < ASYNC_HTTP_MAX_LINE)
+        line_ += (char)byte;
+    return false;
+}
+
+void ESP8266AsyncHttp::headerLine()
+{
+    line_.trim();
+    if (line_.length() == 0)
+    {
+        // End of headers; 204 and 304 never carry a body, whatever the headers say
+        if (code_ == HTTP_CODE_NO_CONTENT || code_ == HTTP_CODE_NOT_MODIFIED)
+            complete(code_);
+        else if (chunked_)
+            state_ = HttpState::ChunkSize;
+        else if (contentLength_ == 0)
+            complete(code_);
+        else
+            state_ = HttpState::Body;
+        return;
+    }
+    // ETag values are case-sensitive, so take them before lowercasing
+    if (line_.length() > 5 && line_.substring(0, 5).equalsIgnoreCase("etag:"))
+    {
+        etag_ = line_.substring(5);
+        etag_.trim();
+        return;
+    }
+    line_.toLowerCase();
+    if (line_.startsWith("content-length:"))
+        contentLength_ = line_.substring(15).toInt();
+    else if (line_.startsWith("transfer-encoding:") && line_.indexOf("chunked") > 0)
+        chunked_ = true;
+    else if (line_.startsWith("connection:") && line_.indexOf("close") > 0)
+        keepAlive_ = false;
+    else if (line_.startsWith("content-range:"))
+    {
+        // "content-range: bytes 4096-8191/401232"
+        int bytes = line_.indexOf("bytes");
+        if (bytes > 0)
+            contentRangeStart_ = atol(line_.c_str() + bytes + 5);
+    }
+}
+
+void ESP8266AsyncHttp::consume(const uint8_t *data, size_t length)
+{
+    size_t i = 0;
+    while (i < length && busy())
+    {
+        if (sinkFailed_)
+        {
+            complete(HTTPC_ERROR_STREAM_WRITE);
+            return;
+        }
+        switch (state_)
+        {
+        case HttpState::StatusLine:
+            if (takeLine(data[i++]))
+            {
+                // "HTTP/1.1 200 OK"
+                int space = line_.indexOf(' ');
+                int code = (space < 0) ? 0 : line_.substring(space + 1).toInt();
+                if (code <= 0)
+                {
+                    complete(HTTPC_ERROR_CONNECTION_LOST);
+                    return;
+                }
+                code_ = code;
+                keepAlive_ = !line_.startsWith("HTTP/1.0");
+                line_ = String();
+                state_ = HttpState::Headers;
+            }
+            break;
+
+        case HttpState::Headers:
+            if (takeLine(data[i++]))
+            {
+                headerLine();
+                line_ = String();
+            }
+            break;
+
+        case HttpState::Body:
+        {
+            size_t n = length - i;
+            if (contentLength_ >= 0 && (long)n > contentLength_)
+                n = contentLength_;
+            appendBody(data + i, n);
+            i += n;
+            if (contentLength_ >= 0)
+            {
+                contentLength_ -= n;
+                if (contentLength_ == 0)
+                    complete(code_);
+            }
+            break;
+        }
+
+        case HttpState::ChunkSize:
+            if (takeLine(data[i++]))
+            {
+                chunkRemaining_ = strtol(line_.c_str(), nullptr, 16);
+                line_ = String();
+                state_ = chunkRemaining_ > 0 ? HttpState::ChunkData : HttpState::Trailer;
+            }
+            break;
+
+        case HttpState::ChunkData:
+        {
+            size_t n = length - i;
+            if ((long)n > chunkRemaining_)
+                n = chunkRemaining_;
+            appendBody(data + i, n);
+            i += n;
+            chunkRemaining_ -= n;
+            if (chunkRemaining_ == 0)
+                state_ = HttpState::ChunkEnd;
+            break;
+        }
+
+        case HttpState::ChunkEnd:
+            if (takeLine(data[i++]))
+            {
+                line_ = String();
+                state_ = HttpState::ChunkSize;
+            }
+            break;
+
+        case HttpState::Trailer:
+            if (takeLine(data[i++]))
+            {
+                bool last = line_.length() == 0;
+                line_ = String();
+                if (last)
+                    complete(code_);
+            }
+            break;
+
+        default:
+            return;
+        }
+    }
+}
+
+void ESP8266AsyncHttp::appendBody(const uint8_t *data, size_t length)
+{
+    if (sink_)
+    {
+        if (!sinkFailed_ && length > 0 && !sink_(data, length))
+            sinkFailed_ = true;
+        return;
+    }
+    if (rawSink_)
+    {
+        size_t room = rawCapacity_ - rawLength_;
+        if (length > room)
+        {
+            rawOverflow_ = true;
+            length = room;
+        }
+        memcpy(rawBuffer_ + rawLength_, data, length);
+        rawLength_ += length;
+        return;
+    }
+    response_.concat((const char *)data, length);
+}
+
+void ESP8266AsyncHttp::complete(int code)
+{
+    if (code > 0 && rawOverflow_)
+    {
+        LOG_E("HTTP", "Raw response does not fit buffer of %u", (unsigned)rawCapacity_);
+        code = HTTPC_ERROR_TOO_LESS_RAM;
+    }
+    if (code > 0 && sinkFailed_)
+        code = HTTPC_ERROR_STREAM_WRITE;
+    code_ = code;
+
+    // A failed or partially read response would desynchronise the next
+    // request on this socket, so drop it
+    if (code <= 0 || !keepAlive_)
+        client_.stop();
+
+    uint32_t waited = (code > 0) ? millis() - sentAt_ : 0;
+    timing_.wait_us = (code > 0) ? micros() - sentAtUs_ : 0;
+    lastUsed_ = millis();
+    stats_.requests++;
+    if (code <= 0)
+    {
+        stats_.errors++;
+    }
+    else
+    {
+        if (reused_)
+            stats_.reused++;
+        if (timing_.connect_us > 0)
+        {
+            uint32_t connectMs = timing_.connect_us / 1000;
+            stats_.connects++;
+            stats_.connect_ms_total += connectMs;
+            if (connectMs > stats_.connect_ms_max)
+                stats_.connect_ms_max = connectMs;
+        }
+        stats_.wait_ms_total += waited;
+        if (waited > stats_.wait_ms_max)
+            stats_.wait_ms_max = waited;
+    }
+
+    if (code > 0)
+    {
+        LOG_D("HTTP", "%s %s %s connection, %u ms connecting, %u ms waiting for the reply", name_,
+              hostKey_.c_str(), reused_ ? "reused" : "new", (unsigned)(timing_.connect_us / 1000), (unsigned)waited);
+    }
+    else
+    {
+        LOG_W("HTTP", "%s %s %s connection, %s", name_, hostKey_.c_str(), reused_ ? "reused" : "new",
+              HTTPClient::errorToString(code).c_str());
+    }
+
+    state_ = HttpState::Done;
+    rawBuffer_ = nullptr; // The buffer was for this request only
+    rawCapacity_ = 0;
+    writer_ = nullptr;
+    sink_ = nullptr;
+    if (onDone_)
+    {
+        HttpCompletion done = onDone_;
+        onDone_ = nullptr;
+        done(code);
+    }
+}
+
+void ESP8266AsyncHttp::close()
+{
+    client_.stop();
+    state_ = HttpState::Idle;
+}
+
+void ESP8266AsyncHttp::closeIfIdle()
+{
+    if (!busy() && client_.connected() && millis() - lastUsed_ > ASYNC_HTTP_IDLE_TIMEOUT_MS)
+    {
+        LOG_D("HTTP", "Closing idle connection to %s", hostKey_.c_str());
+        client_.stop();
+    }
+}
+
+void ESP8266AsyncHttp::closeIdleAll()
+{
+    for (ESP8266AsyncHttp *ch = channels_; ch; ch = ch->next_)
+    {
+        ch->closeIfIdle();
+    }
+}
+
+void ESP8266AsyncHttp::closeAll()
+{
+    for (ESP8266AsyncHttp *ch = channels_; ch; ch = ch->next_)
+    {
+        if (!ch->busy())
+            ch->client_.stop();
+    }
+}
+
+void ESP8266AsyncHttp::printStats() const
+{
+    Serial.print("HTTP ");
+    Serial.print(name_);
+    if (hostKey_.length() > 0)
+    {
+        Serial.print(" (");
+        Serial.print(hostKey_);
+        Serial.print(")");
+    }
+    Serial.print(": ");
+    Serial.print(stats_.requests);
+    Serial.print(" req, ");
+    Serial.print(stats_.reused);
+    Serial.print(" reused, ");
+    Serial.print(stats_.reconnects);
+    Serial.print(" reconnects, ");
+    Serial.print(stats_.errors);
+    Serial.print(" errors, avg connect ");
+    Serial.print(stats_.connects ? stats_.connect_ms_total / stats_.connects : 0);
+    Serial.print(" ms, max connect ");
+    Serial.print(stats_.connect_ms_max);
+    Serial.print(" ms, avg wait ");
+    uint32_t ok = stats_.requests - stats_.errors;
+    Serial.print(ok ? stats_.wait_ms_total / ok : 0);
+    Serial.print(" ms, max wait ");
+    Serial.print(stats_.wait_ms_max);
+    Serial.println(busy() ? " ms (in flight)" : " ms");
+}
+
+void ESP8266AsyncHttp::printAllStats()
+{
+    for (const ESP8266AsyncHttp *ch = channels_; ch; ch = ch->next_)
+    {
+        ch->printStats();
+    }
+}
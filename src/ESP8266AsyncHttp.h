@@ -0,0 +1,196 @@
+#ifndef ESP8266_ASYNC_HTTP_H
+#define ESP8266_ASYNC_HTTP_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266HTTPClient.h>
+#include <WiFiClient.h>
+#include <functional>
+
+#define CHUNK_BUFFER_SIZE 512          // Bytes collected before a chunk goes on the wire
+#define ASYNC_HTTP_POLL_MS 5           // How often a job re-checks an in-flight request
+#define ASYNC_HTTP_READ_BUDGET 512     // Response bytes parsed per poll() call
+#define ASYNC_HTTP_MAX_LINE 256        // Longest status/header line kept
+#define ASYNC_HTTP_IDLE_TIMEOUT_MS 30000
+
+// Writes a request body to the given Print; called once per attempt, so it
+// must produce the same bytes every time
+typedef std::function<void(Print &)> BodyWriter;
+
+// Receives response body bytes as they arrive; return false to abort
+typedef std::function<bool(const uint8_t *data, size_t length)> BodySink;
+
+// Called once when a request finishes, with the HTTP status code or a
+// negative HTTPClient error code
+typedef std::function<void(int code)> HttpCompletion;
+
+enum class HttpState : uint8_t
+{
+    Idle,
+    Connecting,
+    Sending,
+    StatusLine,
+    Headers,
+    Body,      // Content-Length body, or body until the server closes
+    ChunkSize,
+    ChunkData,
+    ChunkEnd,  // CRLF after chunk data
+    Trailer,
+    Done
+};
+
+// Per-channel request statistics. "reused" requests went out on a kept-alive
+// socket; connect is the TCP connect of the others; wait is the time from
+// request sent to response complete.
+struct HttpChannelStats
+{
+    uint32_t requests;
+    uint32_t reused;
+    uint32_t reconnects; // stale keep-alive socket replaced before any reply
+    uint32_t errors;
+    uint32_t connects;   // Successful requests that opened a fresh socket
+    uint32_t connect_ms_total;
+    uint32_t connect_ms_max;
+    uint32_t wait_ms_total;
+    uint32_t wait_ms_max;
+};
+
+// Phase timings of the last request, in microseconds. body is the time spent
+// inside the body writer with its socket writes taken out; wait runs from the
+// request being sent to the response being complete.
+struct HttpTiming
+{
+    uint32_t connect_us; // 0 on a kept-alive socket
+    uint32_t send_us;
+    uint32_t body_us;
+    uint32_t wait_us;
+};
+
+// One HTTP/1.1 request at a time on its own kept-alive WiFiClient. A request
+// is advanced by poll(): connect, write, then an incremental response parser
+// that consumes whatever bytes have arrived and returns, so the caller's job
+// can yield to other work while the server is still thinking. When the
+// response is complete (or fails, or times out) the completion callback runs
+// once and the channel goes back to idle. Each subsystem owns its channel, so
+// an upload waiting on the cloud never holds the socket a Modbus read needs.
+class ESP8266AsyncHttp
+{
+public:
+    explicit ESP8266AsyncHttp(const char *name);
+
+    // Start a POST. A streamed body is sent with chunked transfer encoding and
+    // never buffered in full; a fixed body must stay valid until completion.
+    // Returns false when the channel is still busy.
+    bool start(const String &url, const char *contentType, const BodyWriter &writer, uint16_t timeout_ms,
+               const char *bearerToken = nullptr, HttpCompletion onDone = nullptr);
+    bool start(const String &url, const char *contentType, const uint8_t *body, size_t length, uint16_t timeout_ms,
+               const char *bearerToken = nullptr, HttpCompletion onDone = nullptr);
+    // Start a GET; extraHeaders are raw "Name: value\r\n" lines (e.g. Range)
+    bool startGet(const String &url, const String &extraHeaders, uint16_t timeout_ms,
+                  const char *bearerToken = nullptr, HttpCompletion onDone = nullptr);
+
+    // Advance the request; true while it is still in flight
+    bool poll();
+    // Drive the request to completion, for callers that need the reply now
+    int wait();
+
+    bool busy() const { return state_ != HttpState::Idle && state_ != HttpState::Done; }
+    HttpState state() const { return state_; }
+
+    // Result of the last completed request
+    int code() const { return code_; }
+    const String &response() const { return response_; }
+    size_t responseLength() const { return rawSink_ ? rawLength_ : response_.length(); }
+    // Body of the last completed request: the fixed buffer it was read
+    // into, else response()
+    const uint8_t *responseData() const
+    {
+        return rawSink_ ? rawData_ : (const uint8_t *)response_.c_str();
+    }
+    size_t bytesSent() const { return bytesSent_; }
+    const HttpTiming &timing() const { return timing_; }
+
+    // First byte offset of a 206 reply's Content-Range, or -1
+    long contentRangeStart() const { return contentRangeStart_; }
+    // ETag header of the last response, quotes included, or empty
+    const String &etag() const { return etag_; }
+
+    // Send the next response body into a fixed buffer instead of response().
+    // Applies to one request only: set it again before every start()
+    void setResponseBuffer(uint8_t *buffer, size_t capacity);
+    // Hand the next response body to a sink as it arrives, never buffering it
+    void setBodySink(const BodySink &sink) { sink_ = sink; }
+
+    void close();
+    void closeIfIdle();
+    void printStats() const;
+
+    // Every channel, for periodic housekeeping and the status report
+    static void closeIdleAll();
+    // Close every socket not in use now, e.g. before the radio is turned off
+    static void closeAll();
+    static void printAllStats();
+
+private:
+    const char *name_;
+    WiFiClient client_;
+    HttpState state_;
+
+    // Request
+    bool get_;
+    String extraHeaders_;
+    String hostKey_; // "host:port"
+    String host_;
+    uint16_t port_;
+    String path_;
+    const char *contentType_;
+    BodyWriter writer_;
+    const uint8_t *data_;
+    size_t length_;
+    String bearer_;
+    uint16_t timeoutMs_;
+    HttpCompletion onDone_;
+
+    // Response parser
+    int code_;
+    bool reused_;
+    bool keepAlive_;
+    bool chunked_;
+    bool gotBytes_;
+    long contentLength_;
+    long chunkRemaining_;
+    long contentRangeStart_;
+    String etag_;
+    String line_;
+    String response_;
+    bool rawSink_; // Current/last body went to rawBuffer_
+    uint8_t *rawBuffer_;
+    const uint8_t *rawData_; // Buffer the current/last body went to
+    size_t rawCapacity_;
+    size_t rawLength_;
+    bool rawOverflow_;
+    BodySink sink_;
+    bool sinkFailed_;
+
+    unsigned long sentAt_;
+    uint32_t sentAtUs_;
+    unsigned long deadline_;
+    unsigned long lastUsed_;
+    size_t bytesSent_;
+    HttpChannelStats stats_;
+    HttpTiming timing_;
+
+    ESP8266AsyncHttp *next_;
+    static ESP8266AsyncHttp *channels_;
+
+    bool begin(const String &url, const char *contentType, uint16_t timeout_ms, const char *bearerToken,
+               HttpCompletion onDone);
+    bool sendRequest();
+    void consume(const uint8_t *data, size_t length);
+    bool takeLine(uint8_t byte);
+    void headerLine();
+    void appendBody(const uint8_t *data, size_t length);
+    void complete(int code);
+};
+
+#endif // ESP8266_ASYNC_HTTP_H
@@ -0,0 +1,133 @@
+#include "ESP8266CodecBench.h"
+#include "ESP8266Compression.h"
+#include "ESP8266ModbusHandler.h"
+
+void ESP8266CodecBench::buildSyntheticTraces(std::vector<BenchTrace> &traces, size_t length)
+{
+    // Shapes seen on inverter registers, in the same scaled units as uploads
+    BenchTrace flat{"flat", {}};
+    BenchTrace ramp{"ramp", {}};
+    BenchTrace noisy{"noisy", {}};
+    BenchTrace step{"step", {}};
+    flat.samples.reserve(length);
+    ramp.samples.reserve(length);
+    noisy.samples.reserve(length);
+    step.samples.reserve(length);
+
+    uint32_t lcg = 12345; // Deterministic noise so runs are comparable
+    for (size_t i = 0; i < length; i++)
+    {
+        lcg = lcg * 1103515245u + 12345u;
+        long jitter = (long)((lcg >> 16) % 101) - 50;
+
+        flat.samples.push_back(230000);
+        ramp.samples.push_back(1200 + (long)i * 7);
+        noisy.samples.push_back(230000 + jitter);
+        step.samples.push_back(((i / 32) % 2) ? 2500 : 500);
+    }
+
+    traces.push_back(flat);
+    traces.push_back(ramp);
+    traces.push_back(noisy);
+    traces.push_back(step);
+}
+
+void ESP8266CodecBench::report(Print &out, const String &trace, const char *op, size_t samples, uint32_t cycles,
+                               size_t bytes)
+{
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    float nsPerSample = samples ? (cycles * 1000.0f / mhz) / (BENCH_ITERATIONS * (float)samples) : 0.0f;
+    float bytesPerSample = samples ? (float)bytes / samples : 0.0f;
+    float ratio = samples ? (float)bytes / (4.0f * samples) : 0.0f;
+
+    out.print("BENCH,");
+    out.print(trace);
+    out.print(",");
+    out.print(op);
+    out.print(",");
+    out.print((unsigned long)samples);
+    out.print(",");
+    out.print(nsPerSample, 1);
+    out.print(",");
+    out.print(bytesPerSample, 3);
+    out.print(",");
+    out.println(ratio, 3);
+}
+
+void ESP8266CodecBench::runTrace(Print &out, const BenchTrace &trace)
+{
+    const std::vector<long> &series = trace.samples;
+    size_t n = series.size();
+    if (n == 0)
+        return;
+
+    std::vector<int32_t> deltas;
+    std::vector<uint8_t> bytes;
+    std::vector<int32_t> decoded;
+    uint32_t start;
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        Compression::delta_compress(series, deltas);
+    report(out, trace.name, "delta_compress", n, ESP.getCycleCount() - start, 0);
+    yield();
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        Compression::encode_deltas_varint(deltas, bytes);
+    report(out, trace.name, "encode_deltas_varint", n, ESP.getCycleCount() - start, bytes.size());
+    yield();
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        Compression::decode_deltas_varint(bytes, decoded);
+    report(out, trace.name, "decode_deltas_varint", n, ESP.getCycleCount() - start, 0);
+    yield();
+
+    size_t hexLen = 0;
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        hexLen = Compression::hex_encode(bytes).length();
+    report(out, trace.name, "hex_encode", n, ESP.getCycleCount() - start, hexLen);
+    yield();
+
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        ESP8266ModbusHandler::calculateCRC(bytes.data(), bytes.size());
+    report(out, trace.name, "crc16", n, ESP.getCycleCount() - start, 0);
+    yield();
+
+    // Every field codec, encode then decode
+    std::vector<long> roundTrip;
+    for (uint8_t c = 0; c < Compression::CODEC_COUNT; c++)
+    {
+        Compression::Codec codec = static_cast<Compression::Codec>(c);
+        String op = String("encode_") + Compression::codec_name(codec);
+        start = ESP.getCycleCount();
+        for (int i = 0; i < BENCH_ITERATIONS; i++)
+            Compression::encode_series(codec, series, bytes);
+        report(out, trace.name, op.c_str(), n, ESP.getCycleCount() - start, bytes.size());
+        yield();
+
+        op = String("decode_") + Compression::codec_name(codec);
+        start = ESP.getCycleCount();
+        for (int i = 0; i < BENCH_ITERATIONS; i++)
+            Compression::decode_series(codec, bytes.data(), bytes.size(), n, roundTrip);
+        report(out, trace.name, op.c_str(), n, ESP.getCycleCount() - start, 0);
+        yield();
+    }
+}
+
+void ESP8266CodecBench::run(Print &out, const std::vector<BenchTrace> &traces)
+{
+    out.print("BENCH_BEGIN,cpu_mhz=");
+    out.print(ESP.getCpuFreqMHz());
+    out.print(",iterations=");
+    out.println(BENCH_ITERATIONS);
+    out.println("BENCH,trace,op,samples,ns_per_sample,bytes_per_sample,ratio");
+    for (const BenchTrace &trace : traces)
+    {
+        runTrace(out, trace);
+    }
+    out.println("BENCH_END");
+}
@@ -0,0 +1,37 @@
+#ifndef ESP8266_CODEC_BENCH_H
+#define ESP8266_CODEC_BENCH_H
+
+#include <Arduino.h>
+#include <vector>
+
+#define BENCH_TRACE_LENGTH 256 // Samples per synthetic trace
+#define BENCH_ITERATIONS 16    // Repetitions per measurement
+
+// One named series of scaled integer samples to benchmark
+struct BenchTrace
+{
+    String name;
+    std::vector<long> samples;
+};
+
+// On-device codec micro-benchmark. Times each compression routine with the
+// CPU cycle counter over synthetic traces (flat, ramp, noisy, step) plus
+// any recorded traces passed in, and prints one CSV line per measurement:
+//
+//   BENCH,<trace>,<op>,<samples>,<ns_per_sample>,<bytes_per_sample>,<ratio>
+//
+// ratio is encoded bytes / (4 bytes per raw sample); 0 for ops that do not
+// produce an encoding. Output is stable so runs can be diffed in review.
+class ESP8266CodecBench
+{
+public:
+    static void buildSyntheticTraces(std::vector<BenchTrace> &traces, size_t length = BENCH_TRACE_LENGTH);
+    static void run(Print &out, const std::vector<BenchTrace> &traces);
+
+private:
+    static void runTrace(Print &out, const BenchTrace &trace);
+    static void report(Print &out, const String &trace, const char *op, size_t samples, uint32_t cycles,
+                       size_t bytes);
+};
+
+#endif // ESP8266_CODEC_BENCH_H
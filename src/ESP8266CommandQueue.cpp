@@ -0,0 +1,31 @@
+#include "ESP8266CommandQueue.h"
+
+ESP8266CommandQueue commandQueue;
+
+ESP8266CommandQueue::ESP8266CommandQueue() : head_(0), count_(0)
+{
+}
+
+bool ESP8266CommandQueue::push(const PendingCommand &command)
+{
+    if (full())
+        return false;
+    commands_[(head_ + count_) % COMMAND_QUEUE_SIZE] = command;
+    count_++;
+    return true;
+}
+
+size_t ESP8266CommandQueue::takeAll(PendingCommand *out, size_t capacity)
+{
+    size_t n = 0;
+    while (count_ > 0 && n < capacity)
+    {
+        PendingCommand &command = commands_[head_];
+        out[n++] = command;
+        command.action = String(); // Free the strings now, not on the next lap
+        command.target_register = String();
+        head_ = (head_ + 1) % COMMAND_QUEUE_SIZE;
+        count_--;
+    }
+    return n;
+}
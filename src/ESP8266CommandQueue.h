@@ -0,0 +1,55 @@
+#ifndef ESP8266_COMMAND_QUEUE_H
+#define ESP8266_COMMAND_QUEUE_H
+
+#include <Arduino.h>
+
+#define COMMAND_QUEUE_SIZE 8 // Commands waiting for the command job
+#define COMMAND_RESULTS_MAX 16 // Results held for the next upload; covers the largest batch a config reply fits
+
+// A cloud command waiting for the command job
+struct PendingCommand
+{
+    String action;
+    String target_register;
+    int value;
+    unsigned long received_at;
+    bool valid;
+};
+
+// Outcome of one command, reported in the next upload
+struct CommandResult
+{
+    String status; // "success", "failure" or "superseded"
+    String executed_at;
+    String error_message;
+    bool has_result;
+    String target_register;
+    int value;
+};
+
+// Bounded FIFO of pending commands. The command job drains it as a whole,
+// so commands that arrive together are executed together.
+class ESP8266CommandQueue
+{
+public:
+    ESP8266CommandQueue();
+
+    // False when the queue is full; the command is dropped
+    bool push(const PendingCommand &command);
+    // Move every queued command into out (oldest first); returns the count
+    size_t takeAll(PendingCommand *out, size_t capacity);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == COMMAND_QUEUE_SIZE; }
+    const PendingCommand &at(size_t i) const { return commands_[(head_ + i) % COMMAND_QUEUE_SIZE]; }
+
+private:
+    PendingCommand commands_[COMMAND_QUEUE_SIZE];
+    size_t head_;
+    size_t count_;
+};
+
+extern ESP8266CommandQueue commandQueue;
+
+#endif // ESP8266_COMMAND_QUEUE_H
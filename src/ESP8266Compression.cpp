@@ -89,6 +89,271 @@ namespace Compression
         return true;
     }
 
+    const char *codec_name(Codec codec)
+    {
+        switch (codec)
+        {
+        case Codec::DeltaVarint:
+            return "Delta";
+        case Codec::DeltaOfDelta:
+            return "DeltaOfDelta";
+        case Codec::ForBitpack:
+            return "FOR";
+        case Codec::Rle:
+            return "RLE";
+        default:
+            return "Unknown";
+        }
+    }
+
+    static void put_signed(int32_t v, std::vector<uint8_t> &out)
+    {
+        varint_encode(zigzag_encode(v), out);
+    }
+
+    static bool get_signed(const uint8_t *data, size_t len, size_t &offset, int32_t &v)
+    {
+        uint32_t raw;
+        if (!varint_decode(data, len, offset, raw))
+            return false;
+        v = zigzag_decode(raw);
+        return true;
+    }
+
+    static uint8_t bit_width(uint32_t v)
+    {
+        uint8_t bits = 0;
+        while (v)
+        {
+            bits++;
+            v >>= 1;
+        }
+        return bits;
+    }
+
+    static void encode_delta_of_delta(const std::vector<long> &series, std::vector<uint8_t> &out)
+    {
+        long prev = 0;
+        long prevDelta = 0;
+        for (size_t i = 0; i < series.size(); ++i)
+        {
+            if (i == 0)
+                put_signed((int32_t)series[0], out);
+            else if (i == 1)
+                put_signed((int32_t)(series[1] - series[0]), out);
+            else
+                put_signed((int32_t)((series[i] - prev) - prevDelta), out);
+            if (i > 0)
+                prevDelta = series[i] - prev;
+            prev = series[i];
+        }
+    }
+
+    static bool decode_delta_of_delta(const uint8_t *data, size_t len, size_t count, std::vector<long> &out)
+    {
+        size_t off = 0;
+        long value = 0;
+        long delta = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            int32_t v;
+            if (!get_signed(data, len, off, v))
+                return false;
+            if (i == 0)
+                value = v;
+            else if (i == 1)
+            {
+                delta = v;
+                value += delta;
+            }
+            else
+            {
+                delta += v;
+                value += delta;
+            }
+            out.push_back(value);
+        }
+        return off == len;
+    }
+
+    static void encode_for_bitpack(const std::vector<long> &series, std::vector<uint8_t> &out)
+    {
+        for (size_t start = 0; start < series.size(); start += FOR_BLOCK_SIZE)
+        {
+            size_t end = start + FOR_BLOCK_SIZE < series.size() ? start + FOR_BLOCK_SIZE : series.size();
+            long minV = series[start];
+            long maxV = series[start];
+            for (size_t i = start; i < end; ++i)
+            {
+                if (series[i] < minV)
+                    minV = series[i];
+                if (series[i] > maxV)
+                    maxV = series[i];
+            }
+            uint8_t width = bit_width((uint32_t)(maxV - minV));
+            put_signed((int32_t)minV, out);
+            out.push_back(width);
+
+            // Offsets from the block minimum, LSB first
+            uint32_t acc = 0;
+            uint8_t accBits = 0;
+            for (size_t i = start; i < end && width > 0; ++i)
+            {
+                uint32_t offset = (uint32_t)(series[i] - minV);
+                for (uint8_t b = 0; b < width; ++b)
+                {
+                    acc |= ((offset >> b) & 1u) << accBits;
+                    if (++accBits == 8)
+                    {
+                        out.push_back((uint8_t)acc);
+                        acc = 0;
+                        accBits = 0;
+                    }
+                }
+            }
+            if (accBits > 0)
+                out.push_back((uint8_t)acc);
+        }
+    }
+
+    static bool decode_for_bitpack(const uint8_t *data, size_t len, size_t count, std::vector<long> &out)
+    {
+        size_t off = 0;
+        for (size_t start = 0; start < count; start += FOR_BLOCK_SIZE)
+        {
+            size_t n = start + FOR_BLOCK_SIZE < count ? FOR_BLOCK_SIZE : count - start;
+            int32_t minV;
+            if (!get_signed(data, len, off, minV) || off >= len)
+                return false;
+            uint8_t width = data[off++];
+            if (width > 32)
+                return false;
+
+            size_t bytes = (n * width + 7) / 8;
+            if (off + bytes > len)
+                return false;
+            size_t bitPos = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t offset = 0;
+                for (uint8_t b = 0; b < width; ++b, ++bitPos)
+                {
+                    offset |= (uint32_t)((data[off + bitPos / 8] >> (bitPos % 8)) & 1u) << b;
+                }
+                out.push_back((long)minV + (long)offset);
+            }
+            off += bytes;
+        }
+        return off == len;
+    }
+
+    static void encode_rle(const std::vector<long> &series, std::vector<uint8_t> &out)
+    {
+        long prevRun = 0;
+        size_t i = 0;
+        while (i < series.size())
+        {
+            size_t run = 1;
+            while (i + run < series.size() && series[i + run] == series[i])
+                run++;
+            put_signed((int32_t)(series[i] - prevRun), out);
+            varint_encode((uint32_t)run, out);
+            prevRun = series[i];
+            i += run;
+        }
+    }
+
+    static bool decode_rle(const uint8_t *data, size_t len, size_t count, std::vector<long> &out)
+    {
+        size_t off = 0;
+        long value = 0;
+        while (out.size() < count)
+        {
+            int32_t change;
+            uint32_t run;
+            if (!get_signed(data, len, off, change) || !varint_decode(data, len, off, run) || run == 0)
+                return false;
+            if (out.size() + run > count)
+                return false;
+            value += change;
+            out.insert(out.end(), run, value);
+        }
+        return off == len;
+    }
+
+    void encode_series(Codec codec, const std::vector<long> &series, std::vector<uint8_t> &out)
+    {
+        out.clear();
+        if (series.empty())
+            return;
+
+        switch (codec)
+        {
+        case Codec::DeltaOfDelta:
+            encode_delta_of_delta(series, out);
+            break;
+        case Codec::ForBitpack:
+            encode_for_bitpack(series, out);
+            break;
+        case Codec::Rle:
+            encode_rle(series, out);
+            break;
+        case Codec::DeltaVarint:
+        default:
+        {
+            std::vector<int32_t> deltas;
+            delta_compress(series, deltas);
+            encode_deltas_varint(deltas, out);
+            break;
+        }
+        }
+    }
+
+    bool decode_series(Codec codec, const uint8_t *data, size_t len, size_t count, std::vector<long> &out)
+    {
+        out.clear();
+        out.reserve(count);
+
+        switch (codec)
+        {
+        case Codec::DeltaOfDelta:
+            return decode_delta_of_delta(data, len, count, out);
+        case Codec::ForBitpack:
+            return decode_for_bitpack(data, len, count, out);
+        case Codec::Rle:
+            return decode_rle(data, len, count, out);
+        case Codec::DeltaVarint:
+        {
+            std::vector<int32_t> deltas;
+            if (!decode_deltas_varint(std::vector<uint8_t>(data, data + len), deltas) || deltas.size() != count)
+                return false;
+            delta_decompress(deltas, out);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    Codec encode_best(const std::vector<long> &series, std::vector<uint8_t> &out)
+    {
+        Codec best = Codec::DeltaVarint;
+        encode_series(best, series, out);
+
+        std::vector<uint8_t> candidate;
+        for (uint8_t c = 1; c < CODEC_COUNT; ++c)
+        {
+            Codec codec = static_cast<Codec>(c);
+            encode_series(codec, series, candidate);
+            if (candidate.size() < out.size())
+            {
+                out.swap(candidate);
+                best = codec;
+            }
+        }
+        return best;
+    }
+
     String hex_encode(const std::vector<uint8_t> &bytes)
     {
         String hex;
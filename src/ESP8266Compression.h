@@ -31,6 +31,25 @@ namespace Compression
     void encode_deltas_varint(const std::vector<int32_t> &deltas, std::vector<uint8_t> &bytesOut);
     bool decode_deltas_varint(const std::vector<uint8_t> &bytes, std::vector<int32_t> &deltasOut);
 
+    // Per-field codecs. Every codec encodes a series of scaled integers into a
+    // byte stream and decodes it back given the sample count, so uploads can
+    // pick the smallest encoding per field and still verify it.
+    enum class Codec : uint8_t
+    {
+        DeltaVarint = 0,  // zigzag varint of first value and deltas
+        DeltaOfDelta = 1, // zigzag varint of first value, first delta, then delta changes
+        ForBitpack = 2,   // per block: zigzag varint minimum, bit width, packed offsets
+        Rle = 3,          // runs: zigzag varint value change, varint run length
+    };
+    static const uint8_t CODEC_COUNT = 4;
+    static const size_t FOR_BLOCK_SIZE = 64;
+
+    const char *codec_name(Codec codec);
+    void encode_series(Codec codec, const std::vector<long> &series, std::vector<uint8_t> &out);
+    bool decode_series(Codec codec, const uint8_t *data, size_t len, size_t count, std::vector<long> &out);
+    // Try every codec and keep the smallest output (DeltaVarint wins ties)
+    Codec encode_best(const std::vector<long> &series, std::vector<uint8_t> &out);
+
     // Hex helpers for optional transport/debug
     String hex_encode(const std::vector<uint8_t> &bytes);
     std::vector<uint8_t> hex_decode(const String &hex);
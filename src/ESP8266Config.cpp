@@ -1,8 +1,49 @@
 #include "ESP8266Config.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266Log.h"
+#include <LittleFS.h>
 
 ConfigManager configManager;
 
-ConfigManager::ConfigManager()
+namespace
+{
+    // Version 1 EEPROM image, written before the layout was versioned. Its
+    // magic was the last field, so it moved with every field added above it.
+    struct LegacyAPIConfig
+    {
+        char api_key[128];
+        char read_url[128];
+        char write_url[128];
+        char upload_url[128];
+        char config_url[128];
+        uint16_t timeout_ms;
+    };
+
+    struct LegacyDeviceConfig
+    {
+        uint8_t slave_address;
+        uint16_t poll_interval_ms;
+        uint16_t upload_interval_ms;
+        uint8_t buffer_size;
+        ParameterType enabled_params[MAX_POLLING_PARAMS];
+        uint8_t num_enabled_params;
+    };
+
+    struct LegacyConfig
+    {
+        WiFiConfig wifi;
+        LegacyAPIConfig api;
+        LegacyDeviceConfig device;
+        SecurityConfig security;
+        BootStatusConfig boot_status;
+        char firmware_version[16];
+        uint32_t magic;
+    };
+}
+
+static_assert(sizeof(LegacyConfig) <= sizeof(ESP8266Config), "EEPROM_SIZE must cover a version 1 image");
+
+ConfigManager::ConfigManager() : nonce_(0), nonceReserved_(0), hotStateOnFlash_(false)
 {
     loadDefaults();
 }
@@ -10,37 +51,149 @@ ConfigManager::ConfigManager()
 bool ConfigManager::begin()
 {
     EEPROM.begin(EEPROM_SIZE);
-    return loadConfig();
+    bool loaded = loadConfig();
+
+    hotStateOnFlash_ = LittleFS.begin();
+    if (!hotStateOnFlash_ || !loadHotState())
+    {
+        // No hot state file yet: start from the copy in the EEPROM config
+        nonceReserved_ = config_.security.nonce;
+        if (hotStateOnFlash_)
+        {
+            LOG_I("CONFIG", "Moving nonce and boot status to hot state file");
+            saveHotState();
+        }
+    }
+
+    // Skip every nonce that may have been handed out before the reboot
+    nonce_ = nonceReserved_;
+    return loaded;
+}
+
+bool ConfigManager::loadHotState()
+{
+    File f = LittleFS.open(HOT_STATE_PATH, "r");
+    if (!f)
+        return false;
+
+    HotState state;
+    bool ok = f.read(reinterpret_cast<uint8_t *>(&state), sizeof(state)) == sizeof(state) && state.magic == HOT_STATE_MAGIC;
+    f.close();
+    if (!ok)
+    {
+        LOG_W("CONFIG", "Invalid hot state file, ignoring");
+        return false;
+    }
+
+    // Never go below a mark that made it into EEPROM
+    nonceReserved_ = state.nonce_reserved > config_.security.nonce ? state.nonce_reserved : config_.security.nonce;
+    config_.boot_status = state.boot_status;
+    return true;
+}
+
+bool ConfigManager::saveHotState()
+{
+    if (!hotStateOnFlash_)
+    {
+        // Fallback: full EEPROM commit, but only once per reserved block
+        return saveConfig();
+    }
+
+    HotState state;
+    state.magic = HOT_STATE_MAGIC;
+    state.nonce_reserved = nonceReserved_;
+    state.boot_status = config_.boot_status;
+
+    // Write a temp file and rename it so a power cut never leaves a torn state
+    File f = LittleFS.open(HOT_STATE_TMP_PATH, "w");
+    if (!f)
+    {
+        LOG_E("CONFIG", "Failed to save hot state");
+        return false;
+    }
+    bool ok = f.write(reinterpret_cast<const uint8_t *>(&state), sizeof(state)) == sizeof(state);
+    f.close();
+    if (!ok || !LittleFS.rename(HOT_STATE_TMP_PATH, HOT_STATE_PATH))
+    {
+        LOG_E("CONFIG", "Failed to save hot state");
+        return false;
+    }
+    return true;
 }
 
 bool ConfigManager::loadConfig()
 {
     EEPROM.get(0, config_);
 
+    if (config_.magic != CONFIG_MAGIC && migrateLegacyConfig())
+        return true;
     if (!isConfigValid())
     {
-        Serial.println("[CONFIG] Invalid config in EEPROM, loading defaults");
+        LOG_W("CONFIG", "Invalid config in EEPROM, loading defaults");
         loadDefaults();
         return false;
     }
 
-    Serial.println("[CONFIG] Configuration loaded successfully");
+    LOG_I("CONFIG", "Configuration loaded successfully");
+    return true;
+}
+
+bool ConfigManager::migrateLegacyConfig()
+{
+    LegacyConfig legacy;
+    EEPROM.get(0, legacy);
+    if (legacy.magic != LEGACY_CONFIG_MAGIC || strlen(legacy.wifi.ssid) == 0 || strlen(legacy.api.api_key) == 0)
+        return false;
+
+    LOG_I("CONFIG", "Migrating version 1 configuration");
+    // Fields the old layout did not have: a single inverter, fixed-rate
+    // polling, always-on radio and the other defaults
+    loadDefaults();
+    config_.wifi = legacy.wifi;
+    memcpy(config_.api.api_key, legacy.api.api_key, sizeof(legacy.api.api_key));
+    memcpy(config_.api.read_url, legacy.api.read_url, sizeof(legacy.api.read_url));
+    memcpy(config_.api.write_url, legacy.api.write_url, sizeof(legacy.api.write_url));
+    memcpy(config_.api.upload_url, legacy.api.upload_url, sizeof(legacy.api.upload_url));
+    memcpy(config_.api.config_url, legacy.api.config_url, sizeof(legacy.api.config_url));
+    config_.api.timeout_ms = legacy.api.timeout_ms;
+
+    DeviceConfig &device = config_.device;
+    device.slave_address = legacy.device.slave_address;
+    device.poll_interval_ms = legacy.device.poll_interval_ms;
+    device.upload_interval_ms = legacy.device.upload_interval_ms;
+    device.buffer_size = legacy.device.buffer_size;
+    device.num_enabled_params = min(legacy.device.num_enabled_params, (uint8_t)MAX_POLLING_PARAMS);
+    memcpy(device.enabled_params, legacy.device.enabled_params, sizeof(device.enabled_params));
+
+    config_.security = legacy.security;
+    config_.boot_status = legacy.boot_status;
+    memcpy(config_.firmware_version, legacy.firmware_version, sizeof(config_.firmware_version));
+    config_.firmware_version[sizeof(config_.firmware_version) - 1] = '\0';
+
+    // saveConfig() persists the reserved mark, so raise it to the old
+    // counter first; anti-replay must never restart from 0
+    nonceReserved_ = config_.security.nonce;
+    saveConfig();
     return true;
 }
 
 bool ConfigManager::saveConfig()
 {
+    MetricTimer timer(MetricStage::SAVE_CONFIG);
     config_.magic = CONFIG_MAGIC;
+    config_.version = CONFIG_VERSION;
+    config_.size = sizeof(config_);
+    config_.security.nonce = nonceReserved_; // Persisted mark, never the live counter
     EEPROM.put(0, config_);
     bool success = EEPROM.commit();
 
     if (success)
     {
-        Serial.println("[CONFIG] Configuration saved successfully");
+        LOG_I("CONFIG", "Configuration saved successfully");
     }
     else
     {
-        Serial.println("[CONFIG] Failed to save configuration");
+        LOG_E("CONFIG", "Failed to save configuration");
     }
 
     return success;
@@ -60,6 +213,9 @@ void ConfigManager::loadDefaults()
     strcpy(config_.api.upload_url, "http://10.238.139.181:5001/upload");
     strcpy(config_.api.config_url, "http://10.238.139.181:5001/config");
     config_.api.timeout_ms = 5000;
+    config_.api.modbus_transport = MODBUS_TRANSPORT_JSON_HEX;
+    config_.api.upload_format = UPLOAD_FORMAT_JSON;
+    config_.api.config_long_poll_s = 0;
 
     // Security defaults
     strcpy(config_.security.psk, "E5A3C8B2F0D9E8A1C5B3A2D8F0E9C4B2A1D8E5C3B0A9F8E2D1C0B7A6F5E4D3C2");
@@ -78,7 +234,7 @@ void ConfigManager::loadDefaults()
     config_.device.slave_address = 0x11;
     config_.device.poll_interval_ms = 5000;
     config_.device.upload_interval_ms = 15000;
-    config_.device.buffer_size = 10;
+    config_.device.buffer_size = MAX_BUFFER_SAMPLES;
 
     // Initialize default polling parameters
     config_.device.num_enabled_params = 5;
@@ -88,7 +244,23 @@ void ConfigManager::loadDefaults()
     config_.device.enabled_params[3] = ParameterType::TEMPERATURE;
     config_.device.enabled_params[4] = ParameterType::OUTPUT_POWER;
 
+    // Block read planner defaults
+    config_.device.block_gap_tolerance = 2;
+    config_.device.block_max_regs = 32;
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; ++i)
+    {
+        config_.device.deadband[i] = 0; // Report every sample until the cloud sets a deadband
+        config_.device.max_silence_s[i] = 0;
+    }
+    config_.device.num_extra_slaves = 0; // Single inverter until the cloud lists more
+    config_.device.adaptive_poll = false;
+    config_.device.poll_min_ms = 1000;
+    config_.device.poll_max_ms = 60000;
+    config_.device.power_mode = 0; // Always on
+
     config_.magic = CONFIG_MAGIC;
+    config_.version = CONFIG_VERSION;
+    config_.size = sizeof(config_);
 }
 
 void ConfigManager::setWiFiConfig(const char *ssid, const char *password, const char *hostname)
@@ -138,9 +310,26 @@ void ConfigManager::setFirmwareVersion(const char *version)
     config_.firmware_version[sizeof(config_.firmware_version) - 1] = '\0';
 }
 
+void ConfigManager::setModbusTransport(uint8_t transport)
+{
+    config_.api.modbus_transport = (transport == MODBUS_TRANSPORT_BINARY) ? MODBUS_TRANSPORT_BINARY : MODBUS_TRANSPORT_JSON_HEX;
+}
+
+void ConfigManager::setUploadFormat(uint8_t format)
+{
+    config_.api.upload_format = (format == UPLOAD_FORMAT_BINARY) ? UPLOAD_FORMAT_BINARY : UPLOAD_FORMAT_JSON;
+}
+
+void ConfigManager::setConfigLongPoll(uint8_t seconds)
+{
+    config_.api.config_long_poll_s = seconds > CONFIG_LONG_POLL_MAX_S ? CONFIG_LONG_POLL_MAX_S : seconds;
+}
+
 bool ConfigManager::isConfigValid() const
 {
     return config_.magic == CONFIG_MAGIC &&
+           config_.version == CONFIG_VERSION &&
+           config_.size == sizeof(config_) &&
            strlen(config_.wifi.ssid) > 0 &&
            strlen(config_.api.api_key) > 0;
 }
@@ -155,16 +344,56 @@ void ConfigManager::updatePollingConfig(uint16_t new_interval, const std::vector
     }
 }
 
+void ConfigManager::setBlockReadConfig(uint8_t gap_tolerance, uint8_t max_regs)
+{
+    config_.device.block_gap_tolerance = gap_tolerance;
+    config_.device.block_max_regs = max_regs;
+}
+
+void ConfigManager::setExtraSlaves(const SlaveConfig *slaves, uint8_t count)
+{
+    if (count > MAX_SLAVES - 1)
+        count = MAX_SLAVES - 1;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        config_.device.extra_slaves[i] = slaves[i];
+    }
+    config_.device.num_extra_slaves = count;
+}
+
+void ConfigManager::setAdaptivePolling(bool enabled, uint16_t min_ms, uint16_t max_ms)
+{
+    config_.device.adaptive_poll = enabled;
+    config_.device.poll_min_ms = min_ms;
+    config_.device.poll_max_ms = max_ms;
+}
+
+void ConfigManager::setPowerMode(uint8_t mode)
+{
+    config_.device.power_mode = mode;
+}
+
+void ConfigManager::setReportingConfig(const uint16_t *deadband, const uint16_t *max_silence_s)
+{
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; ++i)
+    {
+        config_.device.deadband[i] = deadband[i];
+        config_.device.max_silence_s[i] = max_silence_s[i];
+    }
+}
+
 uint32_t ConfigManager::getNextNonce()
 {
-    // Increment the nonce value in the configuration object
-    config_.security.nonce++;
+    nonce_++;
 
-    // Immediately save the entire configuration to EEPROM to persist the new nonce
-    saveConfig();
+    if (nonce_ > nonceReserved_)
+    {
+        // Block exhausted: persist the next high-water mark before using it
+        nonceReserved_ = nonce_ + NONCE_RESERVE_BLOCK - 1;
+        saveHotState();
+    }
 
-    // Return the new nonce that should be used for the current message
-    return config_.security.nonce;
+    return nonce_;
 }
 
 // Boot status management methods
@@ -177,7 +406,7 @@ void ConfigManager::setOTARebootFlag(bool pending)
         strcpy(config_.boot_status.last_boot_status, "rebooting");
         strcpy(config_.boot_status.boot_error_message, "");
     }
-    saveConfig();
+    saveHotState();
 }
 
 void ConfigManager::setBootStatus(const char *status, const char *error_message)
@@ -196,14 +425,14 @@ void ConfigManager::setBootStatus(const char *status, const char *error_message)
     }
     
     config_.boot_status.boot_success_reported = false;
-    saveConfig();
+    saveHotState();
 }
 
 void ConfigManager::markBootSuccessReported()
 {
     config_.boot_status.boot_success_reported = true;
     config_.boot_status.ota_reboot_pending = false;
-    saveConfig();
+    saveHotState();
 }
 
 bool ConfigManager::needsBootStatusReport() const
@@ -7,6 +7,25 @@
 #include "ESP8266DataTypes.h"
 
 #define MAX_POLLING_PARAMS 10
+#define MAX_SLAVES 6 // Inverters polled behind one gateway, primary included
+#define MAX_BUFFER_SAMPLES 200 // Compact samples are 28 bytes, ~5.6 KB of RAM
+#define UPLOAD_BATCH_MAX_SAMPLES 150 // Payload budget: backlog windows merged into one request
+
+// Hot state lives in a small LittleFS file so nonce and boot status updates
+// do not rewrite (and erase) the whole EEPROM config sector
+#define HOT_STATE_PATH "/hot_state.bin"
+#define HOT_STATE_TMP_PATH "/hot_state.tmp"
+#define NONCE_RESERVE_BLOCK 1000 // Nonces reserved per persisted high-water mark
+
+// How Modbus RTU frames travel to the gateway
+#define MODBUS_TRANSPORT_JSON_HEX 0 // {"frame":"<HEX>"} JSON bodies (legacy gateway API)
+#define MODBUS_TRANSPORT_BINARY 1   // raw RTU frame as application/octet-stream
+
+// Upload body format
+#define UPLOAD_FORMAT_JSON 0   // JSON payload inside the base64 secure wrapper
+#define UPLOAD_FORMAT_BINARY 1 // ESP8266UploadEnvelope records with an HMAC trailer
+
+#define CONFIG_LONG_POLL_MAX_S 55 // A held config check must finish inside the 16-bit ms timeout
 
 struct WiFiConfig
 {
@@ -23,6 +42,17 @@ struct APIConfig
     char upload_url[128];
     char config_url[128];
     uint16_t timeout_ms;
+    uint8_t modbus_transport; // MODBUS_TRANSPORT_*
+    uint8_t upload_format;    // UPLOAD_FORMAT_*
+    uint8_t config_long_poll_s; // Seconds the server may hold a config check; 0 = short polls
+};
+
+// A further inverter behind the same gateway. The primary inverter is
+// DeviceConfig.slave_address polling enabled_params.
+struct SlaveConfig
+{
+    uint8_t address;
+    uint16_t param_mask; // Bit per ParameterType polled on this inverter
 };
 
 struct DeviceConfig
@@ -33,6 +63,16 @@ struct DeviceConfig
     uint8_t buffer_size;
     ParameterType enabled_params[MAX_POLLING_PARAMS];
     uint8_t num_enabled_params;
+    uint8_t block_gap_tolerance; // Unused registers allowed inside one block read
+    uint8_t block_max_regs;      // Maximum registers per block read
+    uint16_t deadband[PARAMETER_TYPE_COUNT];      // Raw units a value must move to be stored; 0 = every sample
+    uint16_t max_silence_s[PARAMETER_TYPE_COUNT]; // Store anyway after this long; 0 = REPORT_DEFAULT_MAX_SILENCE_S
+    SlaveConfig extra_slaves[MAX_SLAVES - 1];
+    uint8_t num_extra_slaves;
+    bool adaptive_poll;   // Let signal dynamics and PV output move the poll interval
+    uint16_t poll_min_ms; // Adaptive bounds; poll_interval_ms is the daytime baseline
+    uint16_t poll_max_ms;
+    uint8_t power_mode; // POWER_MODE_ALWAYS_ON or POWER_MODE_SAVE (ESP8266PowerManager.h)
 };
 
 struct SecurityConfig
@@ -49,15 +89,28 @@ struct BootStatusConfig
     char boot_error_message[64]; // Error details if any
 };
 
+// Frequently written state, persisted separately from the cold config
+struct HotState
+{
+    uint32_t magic;
+    uint32_t nonce_reserved; // Every nonce up to this mark may already be in use
+    BootStatusConfig boot_status;
+};
+
+// EEPROM image. The header comes first so it stays put whatever the layout
+// below it: any change to the fields bumps CONFIG_VERSION and adds a step to
+// ConfigManager::loadConfig() that carries the older image over.
 struct ESP8266Config
 {
+    uint32_t magic;   // For EEPROM validation
+    uint16_t version; // CONFIG_VERSION of the layout below
+    uint16_t size;    // sizeof(ESP8266Config) when written
     WiFiConfig wifi;
     APIConfig api;
     DeviceConfig device;
     SecurityConfig security;
     BootStatusConfig boot_status;
     char firmware_version[16]; // Firmware version string (e.g., "1.0.0")
-    uint32_t magic; // For EEPROM validation
 };
 
 class ConfigManager
@@ -83,7 +136,15 @@ public:
     void setAPIConfig(const char *api_key, const char *read_url, const char *write_url, const char *upload_url = NULL, const char *config_url = NULL, uint16_t timeout_ms = 5000);
     void setDeviceConfig(uint8_t slave_addr, uint16_t poll_interval, uint16_t upload_interval, uint8_t buffer_size);
     void setFirmwareVersion(const char *version);
+    void setModbusTransport(uint8_t transport);
+    void setUploadFormat(uint8_t format);
+    void setConfigLongPoll(uint8_t seconds);
     void updatePollingConfig(uint16_t new_interval, const std::vector<ParameterType> &new_params);
+    void setBlockReadConfig(uint8_t gap_tolerance, uint8_t max_regs);
+    void setReportingConfig(const uint16_t *deadband, const uint16_t *max_silence_s);
+    void setExtraSlaves(const SlaveConfig *slaves, uint8_t count);
+    void setAdaptivePolling(bool enabled, uint16_t min_ms, uint16_t max_ms);
+    void setPowerMode(uint8_t mode);
 
     // Boot status management
     void setOTARebootFlag(bool pending);
@@ -91,14 +152,26 @@ public:
     void markBootSuccessReported();
     bool needsBootStatusReport() const;
 
-    uint32_t getNextNonce(); // Increments the nonce, saves it, and returns the new value
+    // Returns the next nonce from the reserved block in RAM; only persists a
+    // new high-water mark once every NONCE_RESERVE_BLOCK messages
+    uint32_t getNextNonce();
 
 private:
     ESP8266Config config_;
-    static const uint32_t CONFIG_MAGIC = 0xBEEFCAFE;
+    uint32_t nonce_;          // Last nonce handed out
+    uint32_t nonceReserved_;  // Persisted high-water mark
+    bool hotStateOnFlash_;    // false: LittleFS unavailable, hot state falls back to EEPROM
+    static const uint32_t CONFIG_MAGIC = 0xEC0CF16A;
+    static const uint16_t CONFIG_VERSION = 2;             // 1 is the unversioned layout
+    static const uint32_t LEGACY_CONFIG_MAGIC = 0xBEEFCAFE; // Trailer of the version 1 image
+    static const uint32_t HOT_STATE_MAGIC = 0x484F5431; // "HOT1"
     static const int EEPROM_SIZE = sizeof(ESP8266Config);
 
     bool isConfigValid() const;
+    // Carry a version 1 image over, settings and nonce included
+    bool migrateLegacyConfig();
+    bool loadHotState();
+    bool saveHotState();
 };
 
 extern ConfigManager configManager;
@@ -1,92 +1,92 @@
 #include "ESP8266DataTypes.h"
 #include "ESP8266Inverter.h"
+#include "ESP8266Parameters.h"
 
-ESP8266DataBuffer::ESP8266DataBuffer(size_t capacity) : capacity_(capacity)
+void Sample::setValue(ParameterType param, float value)
 {
-    buffer_.reserve(capacity);
+    float scaled = roundf(value * param_scale(param));
+    if (scaled < 0.0f)
+        scaled = 0.0f;
+    else if (scaled > 65535.0f)
+        scaled = 65535.0f;
+    setRaw(param, static_cast<uint16_t>(scaled));
 }
 
-void ESP8266DataBuffer::append(const Sample &sample)
+float Sample::getValue(ParameterType param) const
 {
-    if (buffer_.size() >= capacity_)
-    {
-        // Remove oldest sample if buffer is full
-        buffer_.erase(buffer_.begin());
-    }
-    buffer_.push_back(sample);
+    if (!hasValue(param))
+        return 0.0f;
+    return raw[static_cast<uint8_t>(param)] / param_scale(param);
 }
 
-std::vector<Sample> ESP8266DataBuffer::flush()
+ESP8266DataBuffer::ESP8266DataBuffer(size_t capacity)
+    : storage_(capacity ? capacity : 1), capacity_(capacity ? capacity : 1), head_(0), count_(0), reserved_(0)
 {
-    std::vector<Sample> result = buffer_;
-    buffer_.clear();
-    return result;
 }
 
-String parameterTypeToString(ParameterType param)
+bool ESP8266DataBuffer::makeRoom()
 {
-    switch (param)
-    {
-    case ParameterType::AC_VOLTAGE:
-        return "AC_VOLTAGE";
-    case ParameterType::AC_CURRENT:
-        return "AC_CURRENT";
-    case ParameterType::AC_FREQUENCY:
-        return "AC_FREQUENCY";
-    case ParameterType::PV1_VOLTAGE:
-        return "PV1_VOLTAGE";
-    case ParameterType::PV2_VOLTAGE:
-        return "PV2_VOLTAGE";
-    case ParameterType::PV1_CURRENT:
-        return "PV1_CURRENT";
-    case ParameterType::PV2_CURRENT:
-        return "PV2_CURRENT";
-    case ParameterType::TEMPERATURE:
-        return "TEMPERATURE";
-    case ParameterType::EXPORT_POWER_PERCENT:
-        return "EXPORT_POWER_PERCENT";
-    case ParameterType::OUTPUT_POWER:
-        return "OUTPUT_POWER";
-    default:
-        return "UNKNOWN";
-    }
+    if (count_ < capacity_)
+        return true;
+    if (reserved_ > 0)
+        return false; // Oldest samples are being uploaded; do not overwrite them
+
+    // Drop the oldest sample
+    head_ = (head_ + 1) % capacity_;
+    count_--;
+    return true;
+}
+
+bool ESP8266DataBuffer::append(const Sample &sample)
+{
+    Sample *slot = reserveSlot();
+    if (!slot)
+        return false;
+    *slot = sample;
+    commitSlot();
+    return true;
+}
+
+Sample *ESP8266DataBuffer::reserveSlot()
+{
+    if (!makeRoom())
+        return nullptr;
+    return &storage_[(head_ + count_) % capacity_];
+}
+
+void ESP8266DataBuffer::commitSlot()
+{
+    if (count_ < capacity_)
+        count_++;
 }
 
-ParameterType stringToParameterType(const String &str)
+SampleWindow ESP8266DataBuffer::reserveWindow(size_t maxSamples)
 {
-    if (str == "AC_VOLTAGE")
-        return ParameterType::AC_VOLTAGE;
-    if (str == "AC_CURRENT")
-        return ParameterType::AC_CURRENT;
-    if (str == "AC_FREQUENCY")
-        return ParameterType::AC_FREQUENCY;
-    if (str == "PV1_VOLTAGE")
-        return ParameterType::PV1_VOLTAGE;
-    if (str == "PV2_VOLTAGE")
-        return ParameterType::PV2_VOLTAGE;
-    if (str == "PV1_CURRENT")
-        return ParameterType::PV1_CURRENT;
-    if (str == "PV2_CURRENT")
-        return ParameterType::PV2_CURRENT;
-    if (str == "TEMPERATURE")
-        return ParameterType::TEMPERATURE;
-    if (str == "EXPORT_POWER_PERCENT")
-        return ParameterType::EXPORT_POWER_PERCENT;
-    if (str == "OUTPUT_POWER")
-        return ParameterType::OUTPUT_POWER;
-    return ParameterType::AC_VOLTAGE; // Default
+    reserved_ = count_ < maxSamples ? count_ : maxSamples;
+    return SampleWindow(storage_.data(), capacity_, head_, reserved_);
 }
 
-bool isValidParameterString(const String &str)
+SampleWindow ESP8266DataBuffer::peekWindow(size_t maxSamples) const
 {
-    return (str == "AC_VOLTAGE" ||
-            str == "AC_CURRENT" ||
-            str == "AC_FREQUENCY" ||
-            str == "PV1_VOLTAGE" ||
-            str == "PV2_VOLTAGE" ||
-            str == "PV1_CURRENT" ||
-            str == "PV2_CURRENT" ||
-            str == "TEMPERATURE" ||
-            str == "EXPORT_POWER_PERCENT" ||
-            str == "OUTPUT_POWER");
-}
\ No newline at end of file
+    size_t count = count_ < maxSamples ? count_ : maxSamples;
+    return SampleWindow(storage_.data(), capacity_, head_, count);
+}
+
+void ESP8266DataBuffer::releaseWindow()
+{
+    head_ = (head_ + reserved_) % capacity_;
+    count_ -= reserved_;
+    reserved_ = 0;
+}
+
+void ESP8266DataBuffer::cancelWindow()
+{
+    reserved_ = 0;
+}
+
+void ESP8266DataBuffer::clear()
+{
+    head_ = 0;
+    count_ = 0;
+    reserved_ = 0;
+}
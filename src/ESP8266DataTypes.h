@@ -3,19 +3,14 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "ESP8266ParamTable.h"
 
+// Generated from ECOWATT_PARAMS; the value is the kParams index
 enum class ParameterType : uint8_t
 {
-    AC_VOLTAGE = 0,
-    AC_CURRENT = 1,
-    AC_FREQUENCY = 2,
-    PV1_VOLTAGE = 3,
-    PV2_VOLTAGE = 4,
-    PV1_CURRENT = 5,
-    PV2_CURRENT = 6,
-    TEMPERATURE = 7,
-    EXPORT_POWER_PERCENT = 8,
-    OUTPUT_POWER = 9
+#define PARAM_ENUM_(id, ...) id,
+    ECOWATT_PARAMS(PARAM_ENUM_)
+#undef PARAM_ENUM_
 };
 
 struct ParameterConfig
@@ -24,66 +19,132 @@ struct ParameterConfig
     String unit;
 };
 
+#define PARAM_COUNT_ONE_(...) +1
+#define PARAMETER_TYPE_COUNT (0 ECOWATT_PARAMS(PARAM_COUNT_ONE_))
+
+static_assert(PARAMETER_TYPE_COUNT <= 16, "present_mask and poll span masks are 16-bit");
+
+// Fixed-layout sample: one raw register value per ParameterType plus a
+// presence bitmask. Scaling to engineering units is applied lazily through
+// the kParams descriptor table, so a sample is plain data with no heap use.
 struct Sample
 {
-    unsigned long timestamp;
-    std::vector<std::pair<ParameterType, float>> values;
+    uint32_t timestamp;
+    uint16_t present_mask;
+    uint16_t raw[PARAMETER_TYPE_COUNT];
+    uint8_t slave; // Index in the configured slave list; 0 = primary inverter
+
+    Sample() : timestamp(0), present_mask(0), slave(0) {}
+
+    void clear() { present_mask = 0; }
 
-    void setValue(ParameterType param, float value)
+    void setRaw(ParameterType param, uint16_t value)
     {
-        for (auto &pair : values)
-        {
-            if (pair.first == param)
-            {
-                pair.second = value;
-                return;
-            }
-        }
-        values.push_back(std::make_pair(param, value));
+        uint8_t index = static_cast<uint8_t>(param);
+        raw[index] = value;
+        present_mask |= (uint16_t)(1u << index);
+    }
+
+    uint16_t getRaw(ParameterType param) const
+    {
+        return hasValue(param) ? raw[static_cast<uint8_t>(param)] : 0;
     }
 
     bool hasValue(ParameterType param) const
     {
-        for (const auto &pair : values)
-        {
-            if (pair.first == param)
-                return true;
-        }
-        return false;
+        return (present_mask & (1u << static_cast<uint8_t>(param))) != 0;
     }
 
-    float getValue(ParameterType param) const
+    // Scaled accessors (raw / kParams scale)
+    void setValue(ParameterType param, float value);
+    float getValue(ParameterType param) const;
+};
+
+static_assert(sizeof(Sample) <= 28, "Sample should stay a compact POD");
+
+// Read-only view over a window of oldest samples in the ring buffer. The view
+// does not copy samples; it stays valid until the window is released or
+// cancelled.
+class SampleWindow
+{
+public:
+    class const_iterator
     {
-        for (const auto &pair : values)
+    public:
+        const_iterator(const SampleWindow *window, size_t index) : window_(window), index_(index) {}
+        const Sample &operator*() const { return (*window_)[index_]; }
+        const_iterator &operator++()
         {
-            if (pair.first == param)
-                return pair.second;
+            index_++;
+            return *this;
         }
-        return 0.0f;
-    }
+        bool operator!=(const const_iterator &other) const { return index_ != other.index_; }
+
+    private:
+        const SampleWindow *window_;
+        size_t index_;
+    };
+
+    SampleWindow() : storage_(nullptr), capacity_(0), start_(0), count_(0) {}
+    SampleWindow(const Sample *storage, size_t capacity, size_t start, size_t count)
+        : storage_(storage), capacity_(capacity), start_(start), count_(count) {}
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    const Sample &operator[](size_t i) const { return storage_[(start_ + i) % capacity_]; }
+    const Sample &front() const { return (*this)[0]; }
+    const Sample &back() const { return (*this)[count_ - 1]; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count_); }
+
+private:
+    const Sample *storage_;
+    size_t capacity_;
+    size_t start_;
+    size_t count_;
 };
 
+// Fixed-capacity circular sample buffer. Storage is allocated once; append
+// and release are O(1). The uploader reserves a window of the oldest samples,
+// reads it in place and releases it only after the server ACKs, while polling
+// keeps appending behind it.
 class ESP8266DataBuffer
 {
 public:
     explicit ESP8266DataBuffer(size_t capacity);
 
-    bool hasSpace() const { return buffer_.size() < capacity_; }
-    void append(const Sample &sample);
-    std::vector<Sample> flush();
-    // New: non-destructive snapshot; caller can clear() on success
-    std::vector<Sample> snapshot() const { return buffer_; }
-    void clear() { buffer_.clear(); }
-    size_t size() const { return buffer_.size(); }
-    bool empty() const { return buffer_.empty(); }
+    bool hasSpace() const { return count_ < capacity_; }
+    // Append a copy; drops the oldest unreserved sample when full. Returns
+    // false if the buffer is full and the oldest samples are reserved.
+    bool append(const Sample &sample);
+
+    // Producer side: fill the next slot in place, then commit it. Returns
+    // nullptr when no slot can be reclaimed.
+    Sample *reserveSlot();
+    void commitSlot();
+
+    // Consumer side: view of up to maxSamples oldest samples
+    SampleWindow reserveWindow(size_t maxSamples);
+    void releaseWindow(); // ACK received: drop the reserved samples
+    void cancelWindow();  // Upload failed: keep the samples for the next try
+    size_t reserved() const { return reserved_; }
+    // Read-only view of up to maxSamples oldest samples; leaves any
+    // reserved upload window untouched
+    SampleWindow peekWindow(size_t maxSamples) const;
+
+    void clear();
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
 
 private:
-    std::vector<Sample> buffer_;
+    std::vector<Sample> storage_;
     size_t capacity_;
-};
+    size_t head_;     // Index of the oldest sample
+    size_t count_;    // Samples currently stored
+    size_t reserved_; // Oldest samples held by an upload window
 
-String parameterTypeToString(ParameterType param);
-ParameterType stringToParameterType(const String &str);
-bool isValidParameterString(const String &str);
+    bool makeRoom();
+};
 
 #endif // ESP8266_DATA_TYPES_H
\ No newline at end of file
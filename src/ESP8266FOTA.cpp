@@ -1,19 +1,22 @@
 #include "ESP8266FOTA.h"
 #include "ESP8266Config.h"
 #include "ESP8266Security.h"
+#include "ESP8266Scheduler.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266Log.h"
 #include <SHA256.h>
 
-ESP8266FOTA::ESP8266FOTA()
+ESP8266FOTA::ESP8266FOTA() : http_("firmware")
 {
     reset();
 }
 
 void ESP8266FOTA::begin()
 {
-    Serial.println("[FOTA] Initializing FOTA system...");
+    LOG_I("FOTA", "Initializing FOTA system...");
     cleanupPreviousFOTA();
     reset();
-    Serial.println("[FOTA] FOTA system initialized");
+    LOG_I("FOTA", "FOTA system initialized");
 }
 
 void ESP8266FOTA::reset()
@@ -26,9 +29,13 @@ void ESP8266FOTA::reset()
     manifest_ack_sent_ = false;
     manifest_received_ = false;
     total_chunks_received_ = 0;
-    memset(chunks_received_bitmap_, 0, sizeof(chunks_received_bitmap_));
+    chunks_received_bitmap_.clear();
     update_session_initialized_ = false;
+    bytes_received_ = 0;
     bytes_written_ = 0;
+    range_offset_ = 0;
+    download_failures_ = 0;
+    http_.close();
     hash_type_ = HashType::NONE;
     hash_initialized_ = false;
     streaming_sha256_.reset();
@@ -51,7 +58,7 @@ bool ESP8266FOTA::isComplete() const
 
 unsigned long ESP8266FOTA::getRecommendedPollingInterval() const
 {
-    if (update_in_progress_ && !isComplete())
+    if (needsFastPolling())
     {
         // Use aggressive polling during FOTA updates
         // Start with 500ms, increase slightly as we get more chunks to reduce server load
@@ -83,11 +90,14 @@ bool ESP8266FOTA::processSecureFOTAResponse(const String &secureResponse)
     
     if (error)
     {
-        Serial.print("[FOTA] Error parsing secure response: ");
-        Serial.println(error.c_str());
+        LOG_E("FOTA", "Error parsing secure response: %s", error.c_str());
         return false;
     }
-    
+    return processSecureFOTAResponse(secureDoc);
+}
+
+bool ESP8266FOTA::processSecureFOTAResponse(JsonDocument &secureDoc)
+{
     // Check if this is a secure wrapper with nonce, payload, and mac
     if (!secureDoc.containsKey("nonce") || !secureDoc.containsKey("payload") || !secureDoc.containsKey("mac"))
     {
@@ -96,7 +106,7 @@ bool ESP8266FOTA::processSecureFOTAResponse(const String &secureResponse)
         {
             return processPlainFOTAResponse(secureDoc["fota"]);
         }
-        Serial.println("[FOTA] No secure wrapper or FOTA data found");
+        LOG_I("FOTA", "No secure wrapper or FOTA data found");
         return false;
     }
     
@@ -111,7 +121,7 @@ bool ESP8266FOTA::processSecureFOTAResponse(const String &secureResponse)
     
     if (calculatedMac != receivedMac)
     {
-        Serial.println("[FOTA] Error: MAC verification failed for secure FOTA response");
+        LOG_E("FOTA", "Error: MAC verification failed for secure FOTA response");
         return false;
     }
     
@@ -127,12 +137,11 @@ bool ESP8266FOTA::processSecureFOTAResponse(const String &secureResponse)
     
     // Parse the decoded payload
     StaticJsonDocument<2048> payloadDoc;
-    error = deserializeJson(payloadDoc, decodedPayload);
+    DeserializationError error = deserializeJson(payloadDoc, decodedPayload);
     
     if (error)
     {
-        Serial.print("[FOTA] Error parsing decoded payload: ");
-        Serial.println(error.c_str());
+        LOG_E("FOTA", "Error parsing decoded payload: %s", error.c_str());
         return false;
     }
     
@@ -148,21 +157,23 @@ bool ESP8266FOTA::processSecureFOTAResponse(const String &secureResponse)
 
 bool ESP8266FOTA::processPlainFOTAResponse(const JsonObject &fotaObj)
 {
-    Serial.print("[FOTA] Processing FOTA message: ");
-    serializeJson(fotaObj, Serial);
-    Serial.println();
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_VERBOSE
+    char preview[LOG_LINE_MAX];
+    serializeJson(fotaObj, preview, sizeof(preview));
+    LOG_V("FOTA", "Processing FOTA message: %s", preview);
+#endif
 
     // Check if this is a manifest (first FOTA message)
     if (fotaObj.containsKey("manifest"))
     {
         if (processManifest(fotaObj))
         {
-            Serial.println("[FOTA] Manifest processed successfully");
+            LOG_I("FOTA", "Manifest processed successfully");
             return true;
         }
         else
         {
-            Serial.println("[FOTA] Failed to process manifest");
+            LOG_E("FOTA", "Failed to process manifest");
             return false;
         }
     }
@@ -171,21 +182,18 @@ bool ESP8266FOTA::processPlainFOTAResponse(const JsonObject &fotaObj)
     {
         if (processChunk(fotaObj))
         {
-            Serial.print("[FOTA] Chunk ");
-            Serial.print(fotaObj["chunk_number"].as<int>());
-            Serial.println(" processed successfully");
+            LOG_D("FOTA", "Chunk %d processed successfully", fotaObj["chunk_number"].as<int>());
             return true;
         }
         else
         {
-            Serial.print("[FOTA] Failed to process chunk ");
-            Serial.println(fotaObj["chunk_number"].as<int>());
+            LOG_E("FOTA", "Failed to process chunk %d", fotaObj["chunk_number"].as<int>());
             return false;
         }
     }
     else
     {
-        Serial.println("[FOTA] Unknown FOTA message format");
+        LOG_I("FOTA", "Unknown FOTA message format");
         return false;
     }
 }
@@ -194,7 +202,7 @@ bool ESP8266FOTA::processManifest(const JsonObject &fota)
 {
     if (!fota.containsKey("manifest"))
     {
-        Serial.println("[FOTA] Error: No manifest in FOTA message");
+        LOG_E("FOTA", "Error: No manifest in FOTA message");
         return false;
     }
 
@@ -206,6 +214,10 @@ bool ESP8266FOTA::processManifest(const JsonObject &fota)
     String hash = manifest["hash"] | "";
     uint16_t chunk_size = manifest["chunk_size"] | 0;
     uint16_t total_chunks = manifest["total_chunks"] | 0;
+    String url = manifest["url"] | "";
+    uint32_t transfer_size = manifest["transfer_size"] | size;
+    String compression = manifest["compression"] | "none";
+    String base_version = manifest["base_version"] | "";
 
     // Create temporary manifest for validation
     FOTAManifest tempManifest;
@@ -214,19 +226,35 @@ bool ESP8266FOTA::processManifest(const JsonObject &fota)
     tempManifest.hash = hash;
     tempManifest.chunk_size = chunk_size;
     tempManifest.total_chunks = total_chunks;
+    tempManifest.url = resolveDownloadUrl(url);
+    tempManifest.transfer_size = transfer_size;
+    tempManifest.base_version = base_version;
     tempManifest.valid = true;
+
+    if (!ESP8266FirmwareDecoder::parseCompression(compression, tempManifest.compression))
+    {
+        LOG_E("FOTA", "Error: Unsupported compression: %s", compression.c_str());
+        return false;
+    }
     
     // Validate manifest
     if (!validateManifest(tempManifest))
     {
-        Serial.println("[FOTA] Error: Manifest validation failed");
+        LOG_E("FOTA", "Error: Manifest validation failed");
         return false;
     }
 
     // Check if this is a different version than current
     if (version.equals(configManager.getFirmwareVersion()))
     {
-        Serial.println("[FOTA] Warning: Manifest version same as current firmware");
+        LOG_W("FOTA", "Warning: Manifest version same as current firmware");
+        return false;
+    }
+
+    // A delta only reconstructs the image from the exact build it was made against
+    if (tempManifest.delta() && !base_version.equals(configManager.getFirmwareVersion()))
+    {
+        LOG_E("FOTA", "Error: Delta base version %s does not match running firmware", base_version.c_str());
         return false;
     }
 
@@ -235,17 +263,16 @@ bool ESP8266FOTA::processManifest(const JsonObject &fota)
     if (hashLength == 32)
     {
         hash_type_ = HashType::MD5;
-        Serial.println("[FOTA] Manifest hash algorithm: MD5");
+        LOG_I("FOTA", "Manifest hash algorithm: MD5");
     }
     else if (hashLength == 64)
     {
         hash_type_ = HashType::SHA256;
-        Serial.println("[FOTA] Manifest hash algorithm: SHA256");
+        LOG_I("FOTA", "Manifest hash algorithm: SHA256");
     }
     else
     {
-        Serial.print("[FOTA] Error: Unsupported manifest hash length: ");
-        Serial.println(hashLength);
+        LOG_E("FOTA", "Error: Unsupported manifest hash length: %u", (unsigned)hashLength);
         return false;
     }
 
@@ -258,22 +285,28 @@ bool ESP8266FOTA::processManifest(const JsonObject &fota)
     last_chunk_received_ = 0;
     chunk_verified_ = true;
     total_chunks_received_ = 0;
-    memset(chunks_received_bitmap_, 0, sizeof(chunks_received_bitmap_));
+    chunks_received_bitmap_.assign((total_chunks + 31) / 32, 0);
+    bytes_received_ = 0;
     bytes_written_ = 0;
+    range_offset_ = 0;
+    download_failures_ = 0;
     hash_initialized_ = false;
     update_session_initialized_ = false;
 
-    Serial.println("[FOTA] Manifest processed successfully:");
-    Serial.print("  Version: ");
-    Serial.println(version);
-    Serial.print("  Size: ");
-    Serial.println(size);
-    Serial.print("  Hash: ");
-    Serial.println(hash);
-    Serial.print("  Chunk Size: ");
-    Serial.println(chunk_size);
-    Serial.print("  Total Chunks: ");
-    Serial.println(total_chunks);
+    LOG_I("FOTA", "Manifest processed successfully:");
+    LOG_I("FOTA", "  Version: %s, size %u, chunk size %u, %u chunks", version.c_str(), (unsigned)size, chunk_size,
+          total_chunks);
+    LOG_I("FOTA", "  Hash: %s", hash.c_str());
+    if (manifest_.compression != FirmwareCompression::None || manifest_.delta())
+    {
+        LOG_I("FOTA", "  Transfer: %u bytes, %s%s%s", (unsigned)manifest_.transfer_size,
+              ESP8266FirmwareDecoder::compressionName(manifest_.compression), manifest_.delta() ? ", delta from " : "",
+              manifest_.delta() ? manifest_.base_version.c_str() : "");
+    }
+    if (manifest_.ranged())
+    {
+        LOG_I("FOTA", "  Download URL: %s", manifest_.url.c_str());
+    }
 
     return true;
 }
@@ -282,7 +315,13 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
 {
     if (!update_in_progress_ || !manifest_.valid)
     {
-        Serial.println("[FOTA] Error: No FOTA update in progress or invalid manifest");
+        LOG_E("FOTA", "Error: No FOTA update in progress or invalid manifest");
+        return false;
+    }
+
+    if (manifest_.ranged())
+    {
+        LOG_W("FOTA", "Warning: Ignoring config chunk during ranged download");
         return false;
     }
 
@@ -302,7 +341,7 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     // Verify total chunks matches manifest
     if (total_chunks != manifest_.total_chunks)
     {
-        Serial.println("[FOTA] Error: Chunk total_chunks mismatch with manifest");
+        LOG_E("FOTA", "Error: Chunk total_chunks mismatch with manifest");
         chunk_verified_ = false;
         return false;
     }
@@ -310,9 +349,7 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     // Check if we already received this chunk
     if (isChunkReceived(chunk_number))
     {
-        Serial.print("[FOTA] Warning: Chunk ");
-        Serial.print(chunk_number);
-        Serial.println(" already received, skipping");
+        LOG_W("FOTA", "Warning: Chunk %u already received, skipping", chunk_number);
         last_chunk_received_ = chunk_number;
         chunk_verified_ = true;
         return true;
@@ -321,9 +358,7 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     // Verify chunk MAC
     if (!verifyChunkMAC(data, mac))
     {
-        Serial.print("[FOTA] Error: Chunk ");
-        Serial.print(chunk_number);
-        Serial.println(" MAC verification failed");
+        LOG_E("FOTA", "Error: Chunk %u MAC verification failed", chunk_number);
         chunk_verified_ = false;
         return false;
     }
@@ -331,7 +366,7 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     // Ensure streaming update session is ready
     if (!beginStreamingUpdate())
     {
-        Serial.println("[FOTA] Error: Failed to initialize OTA streaming session");
+        LOG_E("FOTA", "Error: Failed to initialize OTA streaming session");
         chunk_verified_ = false;
         return false;
     }
@@ -340,7 +375,7 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     unsigned int decodedLength = ESP8266Security::getBase64DecodedLength(data);
     if (decodedLength == 0)
     {
-        Serial.println("[FOTA] Error: Invalid base64 data length");
+        LOG_E("FOTA", "Error: Invalid base64 data length");
         abortStreamingUpdate();
         chunk_verified_ = false;
         return false;
@@ -349,93 +384,229 @@ bool ESP8266FOTA::processChunk(const JsonObject &fota)
     unsigned char *decodedBuffer = new unsigned char[decodedLength];
     if (!decodedBuffer)
     {
-        Serial.println("[FOTA] Error: Failed to allocate memory for decoded chunk");
+        LOG_E("FOTA", "Error: Failed to allocate memory for decoded chunk");
         abortStreamingUpdate();
         chunk_verified_ = false;
         return false;
     }
 
     ESP8266Security::decodeBase64(data, decodedBuffer);
+    bool written = receiveFirmware(decodedBuffer, decodedLength);
+    delete[] decodedBuffer;
+
+    if (!written)
+    {
+        abortStreamingUpdate();
+        chunk_verified_ = false;
+        return false;
+    }
+
+    // Update status
+    markChunkReceived(chunk_number);
+    last_chunk_received_ = chunk_number;
+    chunk_verified_ = true;
+
+    LOG_I("FOTA", "Chunk %u stored successfully (%u/%u received)", chunk_number, total_chunks_received_,
+          manifest_.total_chunks);
+
+    // Check if all chunks received
+    if (isComplete())
+    {
+        completeUpdate();
+    }
+
+    return true;
+}
+
+bool ESP8266FOTA::receiveFirmware(const uint8_t *data, size_t length)
+{
+    MetricTimer timer(MetricStage::FOTA_CHUNK_APPLY);
+    if (bytes_received_ + length > manifest_.transfer_size)
+    {
+        LOG_E("FOTA", "Error: Received more data than manifest transfer size allows");
+        return false;
+    }
+
+    // Verified transfer bytes go through the decoder, which hands the
+    // reconstructed image to writeFirmware() in small blocks
+    if (!decoder_.write(data, length))
+    {
+        LOG_E("FOTA", "Error: Firmware image could not be reconstructed");
+        return false;
+    }
+
+    bytes_received_ += length;
+    return true;
+}
+
+bool ESP8266FOTA::writeFirmware(const uint8_t *data, size_t length)
+{
+    if (bytes_written_ + length > manifest_.size)
+    {
+        LOG_E("FOTA", "Error: Received more data than manifest size allows");
+        return false;
+    }
 
     if (hash_initialized_)
     {
         if (hash_type_ == HashType::SHA256)
         {
-            streaming_sha256_.update(decodedBuffer, decodedLength);
+            streaming_sha256_.update(data, length);
         }
         else if (hash_type_ == HashType::MD5)
         {
-            streaming_md5_.add(decodedBuffer, decodedLength);
+            streaming_md5_.add(data, length);
         }
     }
 
-    size_t written = Update.write(decodedBuffer, decodedLength);
-    delete[] decodedBuffer;
-
-    if (written != decodedLength)
+    size_t written = Update.write(const_cast<uint8_t *>(data), length);
+    if (written != length)
     {
-        Serial.print("[FOTA] Error: Failed to write chunk to flash. Expected ");
-        Serial.print(decodedLength);
-        Serial.print(" bytes, wrote ");
-        Serial.println(written);
+        LOG_E("FOTA", "Error: Failed to write chunk to flash. Expected %u bytes, wrote %u", (unsigned)length,
+              (unsigned)written);
         Update.printError(Serial);
-        abortStreamingUpdate();
-        chunk_verified_ = false;
         return false;
     }
 
     bytes_written_ += written;
-    if (bytes_written_ > manifest_.size)
+    return true;
+}
+
+void ESP8266FOTA::completeUpdate()
+{
+    LOG_I("FOTA", "All chunks received! Finalizing firmware...");
+
+    if (finalizeStreamingUpdate())
+    {
+        LOG_I("FOTA", "Firmware validation successful - Ready for installation!");
+        LOG_I("FOTA", "Rebooting to apply new firmware...");
+
+        // Mark that we're about to reboot for OTA update
+        configManager.setOTARebootFlag(true);
+
+        logRing.flush(); // Queued log lines would be lost over the reboot
+        ESP.restart();   // Apply new firmware
+    }
+    else
+    {
+        LOG_E("FOTA", "Error: Firmware finalization failed");
+    }
+}
+
+String ESP8266FOTA::resolveDownloadUrl(const String &url) const
+{
+    if (!url.startsWith("/"))
+        return url;
+
+    // Path only: same server as the config endpoint
+    const APIConfig &apiConfig = configManager.getAPIConfig();
+    String base = strlen(apiConfig.config_url) > 0 ? apiConfig.config_url : apiConfig.upload_url;
+    int hostStart = base.indexOf("://");
+    hostStart = (hostStart < 0) ? 0 : hostStart + 3;
+    int pathStart = base.indexOf('/', hostStart);
+    return (pathStart < 0 ? base : base.substring(0, pathStart)) + url;
+}
+
+bool ESP8266FOTA::acceptRangeData(const uint8_t *data, size_t length)
+{
+    // Only the requested bytes may reach the Updater: a 206 must start at
+    // our offset, and a plain 200 (Range ignored) is only usable from zero
+    int code = http_.code();
+    if (code == HTTP_CODE_PARTIAL_CONTENT)
+    {
+        if (bytes_received_ == range_offset_ && http_.contentRangeStart() != (long)range_offset_)
+        {
+            LOG_E("FOTA", "Error: Server returned range starting at %ld", http_.contentRangeStart());
+            return false;
+        }
+    }
+    else if (code != HTTP_CODE_OK || range_offset_ != 0)
     {
-        Serial.println("[FOTA] Error: Received more data than manifest size allows");
-        abortStreamingUpdate();
-        chunk_verified_ = false;
         return false;
     }
 
-    // Update status
-    markChunkReceived(chunk_number);
-    last_chunk_received_ = chunk_number;
+    if (!receiveFirmware(data, length))
+        return false;
+
+    // Every chunk whose last byte has now been consumed counts as received
+    uint16_t done = manifest_.chunk_size ? (uint16_t)(bytes_received_ / manifest_.chunk_size) : 0;
+    if (bytes_received_ == manifest_.transfer_size)
+        done = manifest_.total_chunks;
+    for (uint16_t chunk = total_chunks_received_; chunk < done; chunk++)
+    {
+        markChunkReceived(chunk);
+        last_chunk_received_ = chunk;
+    }
     chunk_verified_ = true;
+    return true;
+}
 
-    Serial.print("[FOTA] Chunk ");
-    Serial.print(chunk_number);
-    Serial.print(" stored successfully (");
-    Serial.print(total_chunks_received_);
-    Serial.print("/");
-    Serial.print(manifest_.total_chunks);
-    Serial.println(" received)");
+uint32_t ESP8266FOTA::downloadStep()
+{
+    if (!isDownloadPending())
+        return JOB_DONE;
 
-    // Check if all chunks received
-    if (isComplete())
+    if (!http_.busy())
     {
-        Serial.println("[FOTA] All chunks received! Finalizing firmware...");
-
-        if (finalizeStreamingUpdate())
+        if (!beginStreamingUpdate())
         {
-            Serial.println("[FOTA] Firmware validation successful - Ready for installation!");
-            Serial.println("[FOTA] Rebooting to apply new firmware...");
-            
-            // Mark that we're about to reboot for OTA update
-            configManager.setOTARebootFlag(true);
-            
-            delay(1000); // Give time for serial output
-            ESP.restart(); // Apply new firmware
-        }
-        else
-        {
-            Serial.println("[FOTA] Error: Firmware finalization failed");
+            LOG_E("FOTA", "Error: Failed to initialize OTA streaming session");
+            reset();
+            return JOB_DONE;
         }
+
+        // Resume from the last byte consumed; the decoder and Updater only accept data in order
+        range_offset_ = bytes_received_;
+        uint32_t end = range_offset_ + FOTA_RANGE_WINDOW_BYTES;
+        if (end > manifest_.transfer_size)
+            end = manifest_.transfer_size;
+
+        String range = "Range: bytes=";
+        range += range_offset_;
+        range += "-";
+        range += end - 1;
+        range += "\r\n";
+
+        LOG_D("FOTA", "GET bytes %u-%u of %u", (unsigned)range_offset_, (unsigned)(end - 1),
+              (unsigned)manifest_.transfer_size);
+
+        const APIConfig &apiConfig = configManager.getAPIConfig();
+        http_.setBodySink([this](const uint8_t *data, size_t length) { return acceptRangeData(data, length); });
+        http_.startGet(manifest_.url, range, apiConfig.timeout_ms, apiConfig.api_key);
     }
 
-    return true;
+    if (http_.poll())
+        return ASYNC_HTTP_POLL_MS;
+
+    if (isComplete())
+    {
+        completeUpdate();
+        return JOB_DONE;
+    }
+
+    if (bytes_received_ > range_offset_)
+    {
+        // Progress, even if the connection dropped mid-range: continue from there
+        download_failures_ = 0;
+        return 0;
+    }
+
+    LOG_W("FOTA", "Range request failed: %d", http_.code());
+    if (++download_failures_ >= FOTA_DOWNLOAD_MAX_FAILURES)
+    {
+        LOG_E("FOTA", "Error: Firmware download failed, abandoning update");
+        abortStreamingUpdate();
+        reset();
+        return JOB_DONE;
+    }
+    return FOTA_DOWNLOAD_RETRY_MS;
 }
 
 void ESP8266FOTA::markChunkReceived(uint16_t chunk_num)
 {
-    if (chunk_num < 512) // Max supported chunks
+    if (chunk_num / 32 < chunks_received_bitmap_.size())
     {
-        uint8_t byte_index = chunk_num / 32;
+        uint16_t byte_index = chunk_num / 32;
         uint8_t bit_index = chunk_num % 32;
         if (!(chunks_received_bitmap_[byte_index] & (1UL << bit_index)))
         {
@@ -447,8 +618,8 @@ void ESP8266FOTA::markChunkReceived(uint16_t chunk_num)
 
 bool ESP8266FOTA::isChunkReceived(uint16_t chunk_num) const
 {
-    if (chunk_num >= 512) return false;
-    uint8_t byte_index = chunk_num / 32;
+    if (chunk_num / 32 >= chunks_received_bitmap_.size()) return false;
+    uint16_t byte_index = chunk_num / 32;
     uint8_t bit_index = chunk_num % 32;
     return (chunks_received_bitmap_[byte_index] & (1UL << bit_index)) != 0;
 }
@@ -472,12 +643,8 @@ uint16_t ESP8266FOTA::getNextMissingChunk() const
 
 void ESP8266FOTA::addStatusToConfigRequest(JsonObject &requestObj)
 {
-    Serial.print("[DEBUG] addStatusToConfigRequest called - update_in_progress_: ");
-    Serial.print(update_in_progress_ ? "true" : "false");
-    Serial.print(", manifest_ack_sent_: ");
-    Serial.print(manifest_ack_sent_ ? "true" : "false");
-    Serial.print(", last_chunk_received_: ");
-    Serial.println(last_chunk_received_);
+    LOG_D("FOTA", "addStatusToConfigRequest called - update_in_progress_: %s, manifest_ack_sent_: %s, last_chunk_received_: %u",
+          update_in_progress_ ? "true" : "false", manifest_ack_sent_ ? "true" : "false", last_chunk_received_);
     
     // Add FOTA status if there's an ongoing update
     if (update_in_progress_)
@@ -489,7 +656,14 @@ void ESP8266FOTA::addStatusToConfigRequest(JsonObject &requestObj)
             JsonObject fotaStatusObj = requestObj.createNestedObject("fota_status");
             fotaStatusObj["manifest_ack"] = true;
             manifest_ack_sent_ = true;  // Mark that we've sent the ACK
-            Serial.println("[FOTA] Sending manifest acknowledgment (server will change status to 'active')");
+            LOG_I("FOTA", "Sending manifest acknowledgment (server will change status to 'active')");
+        }
+        else if (manifest_.ranged())
+        {
+            // Firmware comes from the download endpoint; report progress only
+            JsonObject fotaStatusObj = requestObj.createNestedObject("fota_status");
+            fotaStatusObj["bytes_received"] = bytes_received_;
+            fotaStatusObj["verified"] = chunk_verified_;
         }
         else if (total_chunks_received_ > 0)
         {
@@ -500,21 +674,19 @@ void ESP8266FOTA::addStatusToConfigRequest(JsonObject &requestObj)
             fotaStatusObj["chunk_received"] = last_chunk_received_;
             fotaStatusObj["verified"] = chunk_verified_;
             
-            Serial.print("[FOTA] Sending chunk_received: ");
-            Serial.print(last_chunk_received_);
-            Serial.print(", verified: ");
-            Serial.println(chunk_verified_ ? "true" : "false");
+            LOG_D("FOTA", "Sending chunk_received: %u, verified: %s", last_chunk_received_,
+                  chunk_verified_ ? "true" : "false");
         }
         else
         {
-            Serial.println("[DEBUG] FOTA in progress but no manifest ACK or chunk to send");
+            LOG_D("FOTA", "FOTA in progress but no manifest ACK or chunk to send");
         }
         // Note: Server automatically sends next chunk after receiving acknowledgment
         // No explicit chunk requests needed - server manages the flow
     }
     else
     {
-        Serial.println("[DEBUG] No FOTA in progress - no FOTA status added to request");
+        LOG_D("FOTA", "No FOTA in progress - no FOTA status added to request");
     }
 }
 
@@ -523,41 +695,46 @@ bool ESP8266FOTA::validateManifest(const FOTAManifest &manifest) const
     // Check basic fields
     if (manifest.version.isEmpty() || 
         manifest.size == 0 || 
+        manifest.transfer_size == 0 ||
         manifest.hash.isEmpty() || 
         manifest.chunk_size == 0 || 
         manifest.total_chunks == 0)
     {
-        Serial.println("[FOTA] Error: Invalid manifest data - missing required fields");
+        LOG_E("FOTA", "Error: Invalid manifest data - missing required fields");
         return false;
     }
     
     // Check reasonable size limits (e.g., max 4MB firmware)
-    if (manifest.size > 4 * 1024 * 1024)
+    if (manifest.size > FOTA_MAX_IMAGE_SIZE || manifest.transfer_size > FOTA_MAX_IMAGE_SIZE)
     {
-        Serial.println("[FOTA] Error: Firmware size too large");
+        LOG_E("FOTA", "Error: Firmware size too large");
         return false;
     }
-    
-    // Check chunk size is reasonable (e.g., 512-4096 bytes)
-    if (manifest.chunk_size < 512 || manifest.chunk_size > 4096)
+
+    // gzip is staged as is and inflated by the bootloader, so what is
+    // written (and hashed) is the compressed file itself
+    if (manifest.compression == FirmwareCompression::Gzip &&
+        (manifest.delta() || manifest.transfer_size != manifest.size))
     {
-        Serial.println("[FOTA] Error: Invalid chunk size");
+        LOG_E("FOTA", "Error: gzip images must be full images with size equal to transfer_size");
         return false;
     }
     
-    // Check total chunks limit (max 512 supported by bitmap)
-    if (manifest.total_chunks > 512)
+    // Chunks inside config responses must fit the JSON document; a ranged
+    // download only uses chunk_size for progress accounting
+    uint32_t maxChunk = manifest.ranged() ? 0xFFFF : FOTA_MAX_JSON_CHUNK_SIZE;
+    if (manifest.chunk_size < FOTA_MIN_CHUNK_SIZE || manifest.chunk_size > maxChunk)
     {
-        Serial.println("[FOTA] Error: Too many chunks (max 512 supported)");
+        LOG_E("FOTA", "Error: Invalid chunk size");
         return false;
     }
     
-    // Verify size/chunk calculation
+    // Verify size/chunk calculation; chunks split the transfer, not the image
     uint32_t expectedSize = (manifest.total_chunks - 1) * manifest.chunk_size + 
-                           (manifest.size % manifest.chunk_size == 0 ? manifest.chunk_size : manifest.size % manifest.chunk_size);
-    if (abs((int32_t)(expectedSize - manifest.size)) > (int32_t)manifest.chunk_size)
+                           (manifest.transfer_size % manifest.chunk_size == 0 ? manifest.chunk_size : manifest.transfer_size % manifest.chunk_size);
+    if (abs((int32_t)(expectedSize - manifest.transfer_size)) > (int32_t)manifest.chunk_size)
     {
-        Serial.println("[FOTA] Error: Size/chunk calculation mismatch");
+        LOG_E("FOTA", "Error: Size/chunk calculation mismatch");
         return false;
     }
     
@@ -569,14 +746,14 @@ bool ESP8266FOTA::validateChunk(uint16_t chunk_number, const String &data, const
     // Validate chunk data
     if (data.isEmpty() || mac.isEmpty())
     {
-        Serial.println("[FOTA] Error: Invalid chunk data - missing data or MAC");
+        LOG_E("FOTA", "Error: Invalid chunk data - missing data or MAC");
         return false;
     }
     
     // Check if chunk is within valid range
     if (chunk_number >= manifest_.total_chunks)
     {
-        Serial.println("[FOTA] Error: Chunk number out of range");
+        LOG_E("FOTA", "Error: Chunk number out of range");
         return false;
     }
     
@@ -620,7 +797,7 @@ bool ESP8266FOTA::verifyChunkMAC(const String &data, const String &mac)
 {
     if (mac.isEmpty())
     {
-        Serial.println("[FOTA] Error: Empty MAC");
+        LOG_E("FOTA", "Error: Empty MAC");
         return false;
     }
 
@@ -628,7 +805,7 @@ bool ESP8266FOTA::verifyChunkMAC(const String &data, const String &mac)
     const char *psk = configManager.getSecurityConfig().psk;
     if (strlen(psk) == 0)
     {
-        Serial.println("[FOTA] Error: No PSK configured for MAC verification");
+        LOG_E("FOTA", "Error: No PSK configured for MAC verification");
         return false;
     }
     
@@ -637,19 +814,17 @@ bool ESP8266FOTA::verifyChunkMAC(const String &data, const String &mac)
     // We need to calculate HMAC directly on the base64 string without nonce prefix
     String calculatedMac = calculateChunkHMAC(psk, data);
     
-    Serial.print("[FOTA] Expected MAC: ");
-    Serial.println(mac);
-    Serial.print("[FOTA] Calculated MAC: ");
-    Serial.println(calculatedMac);
+    LOG_V("FOTA", "Expected MAC: %s", mac.c_str());
+    LOG_V("FOTA", "Calculated MAC: %s", calculatedMac.c_str());
     
     bool macValid = calculatedMac.equalsIgnoreCase(mac);
     if (!macValid)
     {
-        Serial.println("[FOTA] Error: MAC verification failed");
+        LOG_E("FOTA", "Error: MAC verification failed");
         return false;
     }
     
-    Serial.println("[FOTA] MAC verification successful");
+    LOG_I("FOTA", "MAC verification successful");
     return true;
 }
 
@@ -688,6 +863,13 @@ void ESP8266FOTA::printDetailedStatus() const
         Serial.println(manifest_.version);
         Serial.print("  Firmware size: ");
         Serial.println(manifest_.size);
+        Serial.print("  Transfer: ");
+        Serial.print(bytes_received_);
+        Serial.print("/");
+        Serial.print(manifest_.transfer_size);
+        Serial.print(" bytes (");
+        Serial.print(ESP8266FirmwareDecoder::compressionName(manifest_.compression));
+        Serial.println(manifest_.delta() ? ", delta)" : ")");
         Serial.print("  Total chunks: ");
         Serial.println(manifest_.total_chunks);
         Serial.print("  Chunks received: ");
@@ -716,11 +898,12 @@ void ESP8266FOTA::printDetailedStatus() const
 
 void ESP8266FOTA::cleanupPreviousFOTA()
 {
-    Serial.println("[FOTA] Resetting previous FOTA state...");
+    LOG_I("FOTA", "Resetting previous FOTA state...");
 
     // ESP8266 Update class doesn't have abort() method
     // Just reset our tracking state
     update_session_initialized_ = false;
+    bytes_received_ = 0;
     bytes_written_ = 0;
     hash_initialized_ = false;
     streaming_sha256_.reset();
@@ -736,18 +919,26 @@ bool ESP8266FOTA::beginStreamingUpdate()
 
     if (!manifest_.valid || manifest_.size == 0)
     {
-        Serial.println("[FOTA] Error: Cannot start OTA - invalid manifest");
+        LOG_E("FOTA", "Error: Cannot start OTA - invalid manifest");
         return false;
     }
 
     if (!Update.begin(manifest_.size))
     {
-        Serial.println("[FOTA] Error: Update.begin failed");
+        LOG_E("FOTA", "Error: Update.begin failed");
         Update.printError(Serial);
         return false;
     }
 
+    if (!decoder_.begin(manifest_.compression, manifest_.delta(),
+                        [this](const uint8_t *data, size_t length) { return writeFirmware(data, length); }))
+    {
+        LOG_E("FOTA", "Error: Unsupported firmware encoding");
+        return false;
+    }
+
     update_session_initialized_ = true;
+    bytes_received_ = 0;
     bytes_written_ = 0;
 
     if (!hash_initialized_)
@@ -768,32 +959,36 @@ bool ESP8266FOTA::beginStreamingUpdate()
         }
     }
 
-    Serial.println("[FOTA] OTA streaming session started");
+    LOG_I("FOTA", "OTA streaming session started");
     return true;
 }
 
 bool ESP8266FOTA::finalizeStreamingUpdate()
 {
-    Serial.println("[FOTA] DEBUG: Entering finalizeStreamingUpdate()");
+    LOG_I("FOTA", "DEBUG: Entering finalizeStreamingUpdate()");
 
     if (!update_session_initialized_)
     {
-        Serial.println("[FOTA] Error: No OTA session to finalize");
+        LOG_E("FOTA", "Error: No OTA session to finalize");
         return false;
     }
 
-    Serial.print("[FOTA] DEBUG: Checking bytes - written: ");
-    Serial.print(bytes_written_);
-    Serial.print(", expected: ");
-    Serial.println(manifest_.size);
+    if (!decoder_.finish())
+    {
+        LOG_E("FOTA", "Error: Firmware stream ended mid-record");
+        update_session_initialized_ = false;
+        hash_initialized_ = false;
+        streaming_sha256_.reset();
+        streaming_md5_.begin();
+        return false;
+    }
+
+    LOG_D("FOTA", "Checking bytes - written: %u, expected: %u", (unsigned)bytes_written_, (unsigned)manifest_.size);
 
     if (bytes_written_ != manifest_.size)
     {
-        Serial.print("[FOTA] Error: Written bytes (");
-        Serial.print(bytes_written_);
-        Serial.print(") do not match manifest size (");
-        Serial.print(manifest_.size);
-        Serial.println(")");
+        LOG_E("FOTA", "Error: Written bytes (%u) do not match manifest size (%u)", (unsigned)bytes_written_,
+              (unsigned)manifest_.size);
         // Cannot abort on ESP8266, just reset state
         update_session_initialized_ = false;
         hash_initialized_ = false;
@@ -826,18 +1021,16 @@ bool ESP8266FOTA::finalizeStreamingUpdate()
     }
     else
     {
-        Serial.println("[FOTA] Warning: No hash algorithm selected; skipping validation");
+        LOG_W("FOTA", "Warning: No hash algorithm selected; skipping validation");
         hash_initialized_ = false;
     }
 
-    Serial.print("[FOTA] Expected hash: ");
-    Serial.println(manifest_.hash);
-    Serial.print("[FOTA] Calculated hash: ");
-    Serial.println(calculatedHash);
+    LOG_I("FOTA", "Expected hash: %s", manifest_.hash.c_str());
+    LOG_I("FOTA", "Calculated hash: %s", calculatedHash.c_str());
 
     if (calculatedHash.length() > 0 && !calculatedHash.equalsIgnoreCase(manifest_.hash))
     {
-        Serial.println("[FOTA] Error: Firmware hash validation failed");
+        LOG_E("FOTA", "Error: Firmware hash validation failed");
         // Cannot abort on ESP8266, just reset state
         update_session_initialized_ = false;
         streaming_sha256_.reset();
@@ -847,7 +1040,7 @@ bool ESP8266FOTA::finalizeStreamingUpdate()
 
     if (!Update.end())
     {
-        Serial.println("[FOTA] Error: Update.end failed");
+        LOG_E("FOTA", "Error: Update.end failed");
         Update.printError(Serial);
         // Cannot abort on ESP8266, just reset state
         update_session_initialized_ = false;
@@ -858,7 +1051,7 @@ bool ESP8266FOTA::finalizeStreamingUpdate()
 
     if (!Update.isFinished())
     {
-        Serial.println("[FOTA] Error: Update not finished after end");
+        LOG_E("FOTA", "Error: Update not finished after end");
         // Cannot abort on ESP8266, just reset state
         update_session_initialized_ = false;
         streaming_sha256_.reset();
@@ -866,7 +1059,7 @@ bool ESP8266FOTA::finalizeStreamingUpdate()
         return false;
     }
 
-    Serial.println("[FOTA] OTA streaming session finalized successfully");
+    LOG_I("FOTA", "OTA streaming session finalized successfully");
     update_session_initialized_ = false;
     return true;
 }
@@ -876,6 +1069,7 @@ void ESP8266FOTA::abortStreamingUpdate()
     // ESP8266 Update class doesn't have abort() method
     // Just reset our tracking state
     update_session_initialized_ = false;
+    bytes_received_ = 0;
     bytes_written_ = 0;
     hash_initialized_ = false;
     streaming_sha256_.reset();
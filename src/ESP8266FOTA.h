@@ -6,24 +6,46 @@
 #include <Hash.h>
 #include <SHA256.h>
 #include <Updater.h>
+#include <vector>
+#include "ESP8266AsyncHttp.h"
+#include "ESP8266FirmwareDecoder.h"
+
+#define FOTA_MAX_IMAGE_SIZE (4UL * 1024 * 1024)
+#define FOTA_MIN_CHUNK_SIZE 512
+#define FOTA_MAX_JSON_CHUNK_SIZE 4096   // Base64 chunks inside config responses
+#define FOTA_RANGE_WINDOW_BYTES 32768   // Bytes requested per ranged GET
+#define FOTA_DOWNLOAD_MAX_FAILURES 5    // Ranged GETs in a row without progress
+#define FOTA_DOWNLOAD_RETRY_MS 2000
+
 struct FOTAManifest
 {
     String version;
-    uint32_t size;
+    uint32_t size;         // Reconstructed image size; the hash covers these bytes
+    uint32_t transfer_size; // Bytes on the wire (compressed or delta), split into chunks
     String hash;
     uint16_t chunk_size;
     uint16_t total_chunks;
+    String url;            // Firmware download endpoint; empty = chunks via config responses
+    FirmwareCompression compression;
+    String base_version;   // Set for a delta patch against this running version
     bool valid;
     
     void reset()
     {
         version = "";
         size = 0;
+        transfer_size = 0;
         hash = "";
         chunk_size = 0;
         total_chunks = 0;
+        url = "";
+        compression = FirmwareCompression::None;
+        base_version = "";
         valid = false;
     }
+
+    bool ranged() const { return url.length() > 0; }
+    bool delta() const { return base_version.length() > 0; }
 };
 
 struct FOTAChunk
@@ -68,13 +90,19 @@ public:
     
     // Polling optimization
     unsigned long getRecommendedPollingInterval() const;
-    bool needsFastPolling() const { return update_in_progress_ && !isComplete(); }
+    bool needsFastPolling() const { return update_in_progress_ && !isComplete() && !manifest_.ranged(); }
     bool justStartedUpdate() const;
     void clearJustStartedFlag() { update_just_started_ = false; }
     void markManifestAckSent() { manifest_ack_sent_ = true; }
     
+    // Ranged download from the manifest URL, run as a scheduler job
+    bool isDownloadPending() const { return update_in_progress_ && manifest_.ranged() && manifest_ack_sent_ && !isComplete(); }
+    uint32_t downloadStep();
+
     // FOTA processing - works with secure wrapped JSON
     bool processSecureFOTAResponse(const String &secureResponse);
+    // Same for a response already parsed, e.g. through a field filter
+    bool processSecureFOTAResponse(JsonDocument &secureDoc);
     bool processPlainFOTAResponse(const JsonObject &fotaObj);
     
     // Add FOTA status to config request
@@ -100,14 +128,21 @@ private:
     bool manifest_received_;
     bool update_just_started_;
     bool manifest_ack_sent_;
-    uint32_t chunks_received_bitmap_[16]; // Bitmap to track received chunks (supports up to 512 chunks)
+    std::vector<uint32_t> chunks_received_bitmap_; // One bit per manifest chunk
     uint16_t total_chunks_received_;
     bool update_session_initialized_;
-    uint32_t bytes_written_;
+    uint32_t bytes_received_; // Transfer bytes fed to the decoder
+    uint32_t bytes_written_;  // Reconstructed bytes written to the Updater
+    ESP8266FirmwareDecoder decoder_;
     HashType hash_type_;
     SHA256 streaming_sha256_;
     MD5Builder streaming_md5_;
     bool hash_initialized_;
+
+    // Ranged download state
+    ESP8266AsyncHttp http_;
+    uint32_t range_offset_;     // First byte of the GET in flight
+    uint8_t download_failures_;
     
     // Internal processing
     bool processManifest(const JsonObject &fota);
@@ -122,6 +157,11 @@ private:
     bool verifyChunkMAC(const String &data, const String &mac);
     String calculateChunkHMAC(const char *psk, const String &base64Data);
     bool beginStreamingUpdate();
+    bool receiveFirmware(const uint8_t *data, size_t length);
+    bool writeFirmware(const uint8_t *data, size_t length);
+    bool acceptRangeData(const uint8_t *data, size_t length);
+    void completeUpdate();
+    String resolveDownloadUrl(const String &url) const;
     bool finalizeStreamingUpdate();
     void abortStreamingUpdate();
     
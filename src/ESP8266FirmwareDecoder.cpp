@@ -0,0 +1,299 @@
+#include "ESP8266FirmwareDecoder.h"
+#include "ESP8266Log.h"
+
+ESP8266FirmwareDecoder::ESP8266FirmwareDecoder()
+{
+    begin(FirmwareCompression::None, false, nullptr);
+}
+
+bool ESP8266FirmwareDecoder::parseCompression(const String &name, FirmwareCompression &compression)
+{
+    if (name.length() == 0 || name == "none")
+        compression = FirmwareCompression::None;
+    else if (name == "heatshrink")
+        compression = FirmwareCompression::Heatshrink;
+    else if (name == "gzip")
+        compression = FirmwareCompression::Gzip;
+    else
+        return false;
+    return true;
+}
+
+const char *ESP8266FirmwareDecoder::compressionName(FirmwareCompression compression)
+{
+    switch (compression)
+    {
+    case FirmwareCompression::Heatshrink:
+        return "heatshrink";
+    case FirmwareCompression::Gzip:
+        return "gzip";
+    default:
+        return "none";
+    }
+}
+
+bool ESP8266FirmwareDecoder::begin(FirmwareCompression compression, bool delta, const Output &output)
+{
+    compression_ = compression;
+    delta_ = delta;
+    failed_ = false;
+    output_ = output;
+
+    hsState_ = HsState::Tag;
+    hsAcc_ = 0;
+    hsBits_ = 0;
+    hsIndex_ = 0;
+    hsHead_ = 0;
+    memset(window_, 0, sizeof(window_));
+
+    deltaState_ = DeltaState::Magic;
+    op_ = 0;
+    field_ = 0;
+    fieldCount_ = 0;
+    varintShift_ = 0;
+    src_ = 0;
+    remaining_ = 0;
+    baseSize_ = delta ? ESP.getSketchSize() : 0;
+    baseBlock_ = UINT32_MAX;
+    outLength_ = 0;
+
+    // gzip is inflated by the bootloader, so there is nothing to patch on top
+    return !(delta && compression == FirmwareCompression::Gzip);
+}
+
+bool ESP8266FirmwareDecoder::write(const uint8_t *data, size_t length)
+{
+    if (failed_)
+        return false;
+
+    for (size_t i = 0; i < length && !failed_; i++)
+    {
+        if (compression_ == FirmwareCompression::Heatshrink)
+            heatshrinkByte(data[i]);
+        else if (delta_)
+            deltaByte(data[i]);
+        else
+            emit(data[i]);
+    }
+    return flush() && !failed_;
+}
+
+bool ESP8266FirmwareDecoder::finish()
+{
+    if (!flush() || failed_)
+        return false;
+    // Trailing heatshrink bits are padding; a delta must end with its END op
+    return !delta_ || deltaState_ == DeltaState::Done;
+}
+
+void ESP8266FirmwareDecoder::heatshrinkByte(uint8_t byte)
+{
+    const uint16_t mask = (1 << FW_HEATSHRINK_WINDOW_BITS) - 1;
+    for (int bit = 7; bit >= 0 && !failed_; bit--)
+    {
+        hsAcc_ = (hsAcc_ << 1) | ((byte >> bit) & 1);
+        hsBits_++;
+
+        switch (hsState_)
+        {
+        case HsState::Tag:
+            hsState_ = (hsAcc_ & 1) ? HsState::Literal : HsState::Index;
+            hsAcc_ = 0;
+            hsBits_ = 0;
+            break;
+
+        case HsState::Literal:
+            if (hsBits_ == 8)
+            {
+                uint8_t b = (uint8_t)hsAcc_;
+                window_[hsHead_++ & mask] = b;
+                if (delta_)
+                    deltaByte(b);
+                else
+                    emit(b);
+                hsState_ = HsState::Tag;
+                hsAcc_ = 0;
+                hsBits_ = 0;
+            }
+            break;
+
+        case HsState::Index:
+            if (hsBits_ == FW_HEATSHRINK_WINDOW_BITS)
+            {
+                hsIndex_ = hsAcc_ + 1;
+                hsState_ = HsState::Count;
+                hsAcc_ = 0;
+                hsBits_ = 0;
+            }
+            break;
+
+        case HsState::Count:
+            if (hsBits_ == FW_HEATSHRINK_LOOKAHEAD_BITS)
+            {
+                // Back-reference: count bytes starting index bytes back in the window
+                uint16_t count = hsAcc_ + 1;
+                for (uint16_t n = 0; n < count && !failed_; n++)
+                {
+                    uint8_t b = window_[(uint16_t)(hsHead_ - hsIndex_) & mask];
+                    window_[hsHead_++ & mask] = b;
+                    if (delta_)
+                        deltaByte(b);
+                    else
+                        emit(b);
+                }
+                hsState_ = HsState::Tag;
+                hsAcc_ = 0;
+                hsBits_ = 0;
+            }
+            break;
+        }
+    }
+}
+
+void ESP8266FirmwareDecoder::deltaByte(uint8_t byte)
+{
+    switch (deltaState_)
+    {
+    case DeltaState::Magic:
+        if (byte != (uint8_t)FW_DELTA_MAGIC[field_])
+        {
+            LOG_E("FOTA", "Error: Bad delta patch header");
+            failed_ = true;
+            return;
+        }
+        if (++field_ == 4)
+            deltaState_ = DeltaState::Op;
+        break;
+
+    case DeltaState::Op:
+        op_ = byte;
+        field_ = 0;
+        varintShift_ = 0;
+        fields_[0] = fields_[1] = 0;
+        if (op_ == FW_DELTA_END)
+        {
+            deltaState_ = DeltaState::Done;
+            return;
+        }
+        if (op_ == FW_DELTA_COPY || op_ == FW_DELTA_ADD)
+            fieldCount_ = 2;
+        else if (op_ == FW_DELTA_INSERT)
+            fieldCount_ = 1;
+        else
+        {
+            LOG_E("FOTA", "Error: Unknown delta op %u", op_);
+            failed_ = true;
+            return;
+        }
+        deltaState_ = DeltaState::Fields;
+        break;
+
+    case DeltaState::Fields:
+        if (varintShift_ > 28)
+        {
+            failed_ = true;
+            return;
+        }
+        fields_[field_] |= (uint32_t)(byte & 0x7F) << varintShift_;
+        varintShift_ += 7;
+        if (!(byte & 0x80))
+        {
+            varintShift_ = 0;
+            if (++field_ == fieldCount_)
+                startOp();
+        }
+        break;
+
+    case DeltaState::Insert:
+        emit(byte);
+        if (--remaining_ == 0)
+            deltaState_ = DeltaState::Op;
+        break;
+
+    case DeltaState::Add:
+        emit(baseByte(src_++) + byte);
+        if (--remaining_ == 0)
+            deltaState_ = DeltaState::Op;
+        break;
+
+    case DeltaState::Done:
+        LOG_E("FOTA", "Error: Data after end of delta patch");
+        failed_ = true;
+        break;
+    }
+}
+
+void ESP8266FirmwareDecoder::startOp()
+{
+    if (op_ == FW_DELTA_INSERT)
+    {
+        remaining_ = fields_[0];
+        deltaState_ = remaining_ ? DeltaState::Insert : DeltaState::Op;
+        return;
+    }
+
+    src_ = fields_[0];
+    remaining_ = fields_[1];
+    if (src_ + remaining_ > baseSize_ || src_ + remaining_ < src_)
+    {
+        LOG_E("FOTA", "Error: Delta patch reads past the running image");
+        failed_ = true;
+        return;
+    }
+
+    if (op_ == FW_DELTA_COPY)
+    {
+        copyFromBase(src_, remaining_);
+        deltaState_ = DeltaState::Op;
+    }
+    else
+    {
+        deltaState_ = remaining_ ? DeltaState::Add : DeltaState::Op;
+    }
+}
+
+void ESP8266FirmwareDecoder::copyFromBase(uint32_t src, uint32_t length)
+{
+    while (length > 0 && !failed_)
+    {
+        emit(baseByte(src++));
+        length--;
+        if ((length & 0x3FF) == 0)
+            yield(); // Large copies span many flash sectors
+    }
+}
+
+uint8_t ESP8266FirmwareDecoder::baseByte(uint32_t offset)
+{
+    // flashRead needs 4-byte aligned offsets and lengths; the running sketch
+    // starts at flash offset 0
+    uint32_t block = offset - (offset % FW_BASE_READ_BUFFER);
+    if (block != baseBlock_)
+    {
+        if (!ESP.flashRead(block, base_, sizeof(base_)))
+        {
+            LOG_E("FOTA", "Error: Failed to read running image");
+            failed_ = true;
+            return 0;
+        }
+        baseBlock_ = block;
+    }
+    return reinterpret_cast<const uint8_t *>(base_)[offset - block];
+}
+
+void ESP8266FirmwareDecoder::emit(uint8_t byte)
+{
+    out_[outLength_++] = byte;
+    if (outLength_ == sizeof(out_))
+        flush();
+}
+
+bool ESP8266FirmwareDecoder::flush()
+{
+    if (outLength_ == 0 || failed_)
+        return !failed_;
+    if (!output_ || !output_(out_, outLength_))
+        failed_ = true;
+    outLength_ = 0;
+    return !failed_;
+}
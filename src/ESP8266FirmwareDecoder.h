@@ -0,0 +1,105 @@
+#ifndef ESP8266_FIRMWARE_DECODER_H
+#define ESP8266_FIRMWARE_DECODER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// heatshrink parameters the server must compress with (heatshrink -e -w 10 -l 5)
+#define FW_HEATSHRINK_WINDOW_BITS 10
+#define FW_HEATSHRINK_LOOKAHEAD_BITS 5
+#define FW_DECODE_OUT_BUFFER 256 // Reconstructed bytes collected before each write
+#define FW_BASE_READ_BUFFER 256  // Running-image bytes read from flash at a time
+
+// Delta patch ops, applied to the running sketch image
+#define FW_DELTA_MAGIC "EWD1"
+#define FW_DELTA_END 0x00
+#define FW_DELTA_COPY 0x01   // varint src, varint len: bytes copied from the running image
+#define FW_DELTA_INSERT 0x02 // varint len, then len literal bytes
+#define FW_DELTA_ADD 0x03    // varint src, varint len, then len bytes added to the running image
+
+enum class FirmwareCompression : uint8_t
+{
+    None,
+    Heatshrink, // Decompressed on the device
+    Gzip        // Staged as is; eboot inflates it at boot
+};
+
+// Streaming firmware reconstruction between chunk verification and
+// Update.write(). Transfer bytes go in through write() in any split; the
+// reconstructed image comes out through the output callback in small blocks.
+// Stages: optional heatshrink decompression in a fixed 1KB window, then an
+// optional delta patch against the running image read back from flash.
+class ESP8266FirmwareDecoder
+{
+public:
+    typedef std::function<bool(const uint8_t *data, size_t length)> Output;
+
+    ESP8266FirmwareDecoder();
+
+    bool begin(FirmwareCompression compression, bool delta, const Output &output);
+    // Feed transfer bytes; false on a malformed stream or a failed write
+    bool write(const uint8_t *data, size_t length);
+    // True when the transfer ended on a clean boundary
+    bool finish();
+
+    static bool parseCompression(const String &name, FirmwareCompression &compression);
+    static const char *compressionName(FirmwareCompression compression);
+
+private:
+    enum class HsState : uint8_t
+    {
+        Tag,
+        Literal,
+        Index,
+        Count
+    };
+
+    enum class DeltaState : uint8_t
+    {
+        Magic,
+        Op,
+        Fields,
+        Insert,
+        Add,
+        Done
+    };
+
+    FirmwareCompression compression_;
+    bool delta_;
+    bool failed_;
+    Output output_;
+
+    // heatshrink
+    HsState hsState_;
+    uint16_t hsAcc_;
+    uint8_t hsBits_;
+    uint16_t hsIndex_;
+    uint16_t hsHead_;
+    uint8_t window_[1 << FW_HEATSHRINK_WINDOW_BITS];
+
+    // delta
+    DeltaState deltaState_;
+    uint8_t op_;
+    uint8_t field_;
+    uint8_t fieldCount_;
+    uint32_t fields_[2];
+    uint8_t varintShift_;
+    uint32_t src_;
+    uint32_t remaining_;
+    uint32_t baseSize_;
+    uint32_t baseBlock_; // Offset of the block held in base_, or UINT32_MAX
+
+    uint8_t out_[FW_DECODE_OUT_BUFFER];
+    size_t outLength_;
+    uint32_t base_[FW_BASE_READ_BUFFER / 4];
+
+    void heatshrinkByte(uint8_t byte);
+    void deltaByte(uint8_t byte);
+    void startOp();
+    void copyFromBase(uint32_t src, uint32_t length);
+    uint8_t baseByte(uint32_t offset);
+    void emit(uint8_t byte);
+    bool flush();
+};
+
+#endif // ESP8266_FIRMWARE_DECODER_H
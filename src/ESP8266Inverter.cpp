@@ -1,5 +1,7 @@
 #include "ESP8266Inverter.h"
 #include "ESP8266Parameters.h"
+#include "ESP8266RegisterCache.h"
+#include "ESP8266SlavePoller.h"
 
 ESP8266Inverter::ESP8266Inverter() : slaveAddress_(0x11)
 {
@@ -17,24 +19,61 @@ void ESP8266Inverter::setSlaveAddress(uint8_t slaveAddr)
 
 bool ESP8266Inverter::read(ParameterType id, float &out)
 {
-    const ParamDesc *param = find_param(id);
-    if (!param)
+    if (!find_param(id))
     {
         return false;
     }
 
-    uint16_t reg_addr = pgm_read_word(&param->reg);
-    float scale = pgm_read_float(&param->scale);
-
     uint16_t raw_value;
-    if (readSingleRegister(reg_addr, raw_value))
+    if (readSingleRegister(param_reg(id), raw_value))
     {
-        out = raw_value / scale;
+        out = raw_value / param_scale(id);
         return true;
     }
     return false;
 }
 
+bool ESP8266Inverter::readSpan(const PollSpan &span, Sample &sample)
+{
+    uint16_t values[ESP8266ModbusHandler::MAX_READ_REGS];
+    if (span.num_regs > ESP8266ModbusHandler::MAX_READ_REGS ||
+        !modbusHandler_.readRegisters(span.start_reg, span.num_regs, values, slaveAddress_))
+    {
+        return false;
+    }
+    registerCache.store(slaveAddress_, span.start_reg, values, span.num_regs);
+    fillSample(span, values, sample);
+    return true;
+}
+
+void ESP8266Inverter::fillSample(const PollSpan &span, const uint16_t *values, Sample &sample)
+{
+    // Fan the block back out into individual parameters
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        ParameterType id = static_cast<ParameterType>(i);
+        if (!(span.param_mask & ESP8266PollPlanner::paramBit(id)))
+            continue;
+
+        // Raw register value; scaling is applied lazily when the sample is read
+        sample.setRaw(id, values[param_reg(id) - span.start_reg]);
+    }
+}
+
+uint16_t ESP8266Inverter::readPlan(const ESP8266PollPlanner &plan, Sample &sample)
+{
+    uint16_t failedMask = 0;
+    for (size_t i = 0; i < plan.spanCount(); i++)
+    {
+        const PollSpan &span = plan.span(i);
+        if (!readSpan(span, sample))
+        {
+            failedMask |= span.param_mask;
+        }
+    }
+    return failedMask;
+}
+
 bool ESP8266Inverter::getACVoltage(float &voltage)
 {
     return read(ParameterType::AC_VOLTAGE, voltage);
@@ -99,12 +138,12 @@ bool ESP8266Inverter::getOutputPower(int &power)
 
 bool ESP8266Inverter::getACMeasurements(float &voltage, float &current, float &frequency)
 {
-    std::vector<uint16_t> values;
-    if (modbusHandler_.readRegisters(REG_AC_VOLTAGE, 3, values, slaveAddress_) && values.size() >= 3)
+    uint16_t values[3];
+    if (readCached(param_reg(ParameterType::AC_VOLTAGE), 3, values))
     {
-        voltage = values[0] / 10.0f;
-        current = values[1] / 10.0f;
-        frequency = values[2] / 100.0f;
+        voltage = values[0] / param_scale(ParameterType::AC_VOLTAGE);
+        current = values[1] / param_scale(ParameterType::AC_CURRENT);
+        frequency = values[2] / param_scale(ParameterType::AC_FREQUENCY);
         return true;
     }
     return false;
@@ -112,13 +151,13 @@ bool ESP8266Inverter::getACMeasurements(float &voltage, float &current, float &f
 
 bool ESP8266Inverter::getPVMeasurements(float &pv1Voltage, float &pv2Voltage, float &pv1Current, float &pv2Current)
 {
-    std::vector<uint16_t> values;
-    if (modbusHandler_.readRegisters(REG_PV1_VOLTAGE, 4, values, slaveAddress_) && values.size() >= 4)
+    uint16_t values[4];
+    if (readCached(param_reg(ParameterType::PV1_VOLTAGE), 4, values))
     {
-        pv1Voltage = values[0] / 10.0f;
-        pv2Voltage = values[1] / 10.0f;
-        pv1Current = values[2] / 10.0f;
-        pv2Current = values[3] / 10.0f;
+        pv1Voltage = values[0] / param_scale(ParameterType::PV1_VOLTAGE);
+        pv2Voltage = values[1] / param_scale(ParameterType::PV2_VOLTAGE);
+        pv1Current = values[2] / param_scale(ParameterType::PV1_CURRENT);
+        pv2Current = values[3] / param_scale(ParameterType::PV2_CURRENT);
         return true;
     }
     return false;
@@ -126,10 +165,10 @@ bool ESP8266Inverter::getPVMeasurements(float &pv1Voltage, float &pv2Voltage, fl
 
 bool ESP8266Inverter::getSystemStatus(float &temperature, int &exportPercent, int &outputPower)
 {
-    std::vector<uint16_t> values;
-    if (modbusHandler_.readRegisters(REG_TEMPERATURE, 3, values, slaveAddress_) && values.size() >= 3)
+    uint16_t values[3];
+    if (readCached(param_reg(ParameterType::TEMPERATURE), 3, values))
     {
-        temperature = values[0] / 10.0f;
+        temperature = values[0] / param_scale(ParameterType::TEMPERATURE);
         exportPercent = values[1];
         outputPower = values[2];
         return true;
@@ -137,23 +176,80 @@ bool ESP8266Inverter::getSystemStatus(float &temperature, int &exportPercent, in
     return false;
 }
 
+bool ESP8266Inverter::encodeWrite(ParameterType id, float value, uint16_t &raw)
+{
+    if (!param_writable(id))
+    {
+        return false;
+    }
+
+    float scaled = roundf(value * param_scale(id));
+    if (scaled < 0.0f || scaled > 65535.0f)
+    {
+        return false;
+    }
+    raw = static_cast<uint16_t>(scaled);
+    return true;
+}
+
+bool ESP8266Inverter::write(ParameterType id, float value)
+{
+    uint16_t raw;
+    return encodeWrite(id, value, raw) && writeSingleRegister(param_reg(id), raw);
+}
+
+bool ESP8266Inverter::writeRegisters(uint16_t startAddr, const uint16_t *values, uint16_t count)
+{
+    if (count == 1)
+        return writeSingleRegister(startAddr, values[0]);
+    // Let reads already in flight land first so they cannot repopulate the
+    // cache with pre-write values; even a failed write may have applied
+    if (slavePoller.busy())
+        slavePoller.wait();
+    registerCache.invalidate(slaveAddress_, startAddr, count);
+    return modbusHandler_.writeRegisters(startAddr, values, count, slaveAddress_);
+}
+
 bool ESP8266Inverter::setExportPowerPercent(int value)
 {
-    return writeSingleRegister(REG_EXPORT_POWER_PERCENT, static_cast<uint16_t>(value));
+    return write(ParameterType::EXPORT_POWER_PERCENT, value);
 }
 
 bool ESP8266Inverter::readSingleRegister(uint16_t regAddr, uint16_t &value)
 {
-    std::vector<uint16_t> values;
-    if (modbusHandler_.readRegisters(regAddr, 1, values, slaveAddress_) && !values.empty())
-    {
-        value = values[0];
+    return readCached(regAddr, 1, &value);
+}
+
+bool ESP8266Inverter::readCached(uint16_t startAddr, uint16_t count, uint16_t *values)
+{
+    if (registerCache.lookup(slaveAddress_, startAddr, count, values))
         return true;
+
+    // A poll cycle in flight is about to bring fresh values; join it
+    // instead of sending a second read behind it
+    if (slavePoller.busy())
+    {
+        slavePoller.wait(); // The poll job will close this cycle
+        if (registerCache.lookup(slaveAddress_, startAddr, count, values))
+            return true;
     }
-    return false;
+
+    // One block read for the whole neighbourhood, so the reads that follow
+    // in the same burst are hits
+    uint16_t fetchStart, fetchCount;
+    ESP8266RegisterCache::fetchRange(startAddr, count, fetchStart, fetchCount);
+    uint16_t block[ESP8266ModbusHandler::MAX_READ_REGS];
+    if (!modbusHandler_.readRegisters(fetchStart, fetchCount, block, slaveAddress_))
+        return false;
+    registerCache.store(slaveAddress_, fetchStart, block, fetchCount);
+    memcpy(values, block + (startAddr - fetchStart), count * sizeof(uint16_t));
+    return true;
 }
 
 bool ESP8266Inverter::writeSingleRegister(uint16_t regAddr, uint16_t value)
 {
+    if (slavePoller.busy())
+        slavePoller.wait(); // See writeRegisters
+    registerCache.invalidate(slaveAddress_, regAddr, 1);
     return modbusHandler_.writeRegister(regAddr, value, slaveAddress_);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include "ESP8266ModbusHandler.h"
 #include "ESP8266DataTypes.h"
+#include "ESP8266PollPlanner.h"
 #include <vector>
 
 class ESP8266Inverter
@@ -16,7 +17,9 @@ public:
     // Set the Modbus slave address from configuration
     void setSlaveAddress(uint8_t slaveAddr);
 
-    // New unified read method using parameter descriptor table
+    // New unified read method using parameter descriptor table. Reads other
+    // than readSpan/readPlan go through registerCache: a fresh value costs no
+    // round trip, and a miss fetches the register's whole block at once.
     bool read(ParameterType id, float &out);
 
     // Individual register read operations (legacy, now thin wrappers)
@@ -31,14 +34,32 @@ public:
     bool getExportPowerPercent(int &exportPercent); // Register 8: Export power percentage
     bool getOutputPower(int &power);                // Register 9: Inverter current output power
 
+    // Planned block reads: one readRegisters() per span, fanned out into the sample
+    // and stored in registerCache; these always go to the inverter.
+    // readPlan returns a bitmask of parameters that could not be read (0 = all ok).
+    bool readSpan(const PollSpan &span, Sample &sample);
+    uint16_t readPlan(const ESP8266PollPlanner &plan, Sample &sample);
+    // Store a span's decoded registers in the sample (raw values, no scaling)
+    static void fillSample(const PollSpan &span, const uint16_t *values, Sample &sample);
+
     // Combined read operations for efficiency
     bool getACMeasurements(float &voltage, float &current, float &frequency);
     bool getPVMeasurements(float &pv1Voltage, float &pv2Voltage, float &pv1Current, float &pv2Current);
     bool getSystemStatus(float &temperature, int &exportPercent, int &outputPower);
 
-    // Write operations
+    // Write operations; write() refuses parameters not marked writable in kParams
+    bool write(ParameterType id, float value);
+    // Engineering value to the raw register value write() would send; false
+    // when the parameter is not writable or the value does not fit
+    static bool encodeWrite(ParameterType id, float value, uint16_t &raw);
+    // One frame for consecutive registers: 0x06 for one, 0x10 for several
+    bool writeRegisters(uint16_t startAddr, const uint16_t *values, uint16_t count);
     bool setExportPowerPercent(int value); // Register 8: Set export power percentage
 
+    // Raw values of consecutive registers through registerCache; a miss
+    // joins a poll cycle in flight or fetches the whole block once
+    bool readCached(uint16_t startAddr, uint16_t count, uint16_t *values);
+
     // Direct access to Modbus operations if needed
     ESP8266ModbusHandler &getModbusHandler() { return modbusHandler_; }
 
@@ -46,18 +67,6 @@ private:
     ESP8266ModbusHandler modbusHandler_;
     uint8_t slaveAddress_;
 
-    // Device-specific constants - Register addresses
-    static const uint16_t REG_AC_VOLTAGE = 0;           // Vac1/L1 Phase voltage (gain: 10, unit: V)
-    static const uint16_t REG_AC_CURRENT = 1;           // Iac1/L1 Phase current (gain: 10, unit: A)
-    static const uint16_t REG_AC_FREQUENCY = 2;         // Fac1/L1 Phase frequency (gain: 100, unit: Hz)
-    static const uint16_t REG_PV1_VOLTAGE = 3;          // Vpv1/PV1 input voltage (gain: 10, unit: V)
-    static const uint16_t REG_PV2_VOLTAGE = 4;          // Vpv2/PV2 input voltage (gain: 10, unit: V)
-    static const uint16_t REG_PV1_CURRENT = 5;          // Ipv1/PV1 input current (gain: 10, unit: A)
-    static const uint16_t REG_PV2_CURRENT = 6;          // Ipv2/PV2 input current (gain: 10, unit: A)
-    static const uint16_t REG_TEMPERATURE = 7;          // Inverter internal temperature (gain: 10, unit: °C)
-    static const uint16_t REG_EXPORT_POWER_PERCENT = 8; // Export power percentage (gain: 1, unit: %)
-    static const uint16_t REG_OUTPUT_POWER = 9;         // Inverter current output power (gain: 1, unit: W)
-
     // Helper functions
     bool readSingleRegister(uint16_t regAddr, uint16_t &value);
     bool writeSingleRegister(uint16_t regAddr, uint16_t value);
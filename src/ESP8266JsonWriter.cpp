@@ -0,0 +1,185 @@
+#include "ESP8266JsonWriter.h"
+
+ESP8266JsonWriter::ESP8266JsonWriter(Print &out) : out_(out), hasItems_(0), depth_(0), afterKey_(false)
+{
+}
+
+void ESP8266JsonWriter::separator()
+{
+    if (afterKey_)
+    {
+        // Value directly follows its key
+        afterKey_ = false;
+        return;
+    }
+    if (depth_ == 0)
+        return;
+
+    uint32_t bit = 1u << (depth_ - 1);
+    if (hasItems_ & bit)
+        out_.write(',');
+    hasItems_ |= bit;
+}
+
+void ESP8266JsonWriter::push(char open)
+{
+    separator();
+    out_.write(open);
+    if (depth_ < JSON_WRITER_MAX_DEPTH)
+        depth_++;
+    hasItems_ &= ~(1u << (depth_ - 1));
+}
+
+void ESP8266JsonWriter::pop(char close)
+{
+    out_.write(close);
+    if (depth_ > 0)
+        depth_--;
+}
+
+void ESP8266JsonWriter::beginObject()
+{
+    push('{');
+}
+
+void ESP8266JsonWriter::beginObject(const char *name)
+{
+    key(name);
+    push('{');
+}
+
+void ESP8266JsonWriter::beginObject(const __FlashStringHelper *name)
+{
+    key(name);
+    push('{');
+}
+
+void ESP8266JsonWriter::endObject()
+{
+    pop('}');
+}
+
+void ESP8266JsonWriter::beginArray()
+{
+    push('[');
+}
+
+void ESP8266JsonWriter::beginArray(const char *name)
+{
+    key(name);
+    push('[');
+}
+
+void ESP8266JsonWriter::endArray()
+{
+    pop(']');
+}
+
+void ESP8266JsonWriter::key(const char *name)
+{
+    value(name);
+    out_.write(':');
+    afterKey_ = true;
+}
+
+void ESP8266JsonWriter::key(const __FlashStringHelper *name)
+{
+    separator();
+    out_.write('"');
+    out_.print(name);
+    out_.write("\":");
+    afterKey_ = true;
+}
+
+void ESP8266JsonWriter::value(const char *v)
+{
+    separator();
+    out_.write('"');
+    for (const char *p = v; p && *p; p++)
+    {
+        char c = *p;
+        switch (c)
+        {
+        case '"':
+            out_.write("\\\"");
+            break;
+        case '\\':
+            out_.write("\\\\");
+            break;
+        case '\n':
+            out_.write("\\n");
+            break;
+        case '\r':
+            out_.write("\\r");
+            break;
+        case '\t':
+            out_.write("\\t");
+            break;
+        default:
+            if ((uint8_t)c < 0x20)
+            {
+                static const char hex[] = "0123456789abcdef";
+                char esc[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0x0F], hex[c & 0x0F]};
+                out_.write(esc, sizeof(esc));
+            }
+            else
+            {
+                out_.write(c);
+            }
+            break;
+        }
+    }
+    out_.write('"');
+}
+
+void ESP8266JsonWriter::value(bool v)
+{
+    separator();
+    out_.print(v ? "true" : "false");
+}
+
+void ESP8266JsonWriter::value(int v)
+{
+    separator();
+    out_.print(v);
+}
+
+void ESP8266JsonWriter::value(unsigned int v)
+{
+    separator();
+    out_.print(v);
+}
+
+void ESP8266JsonWriter::value(long v)
+{
+    separator();
+    out_.print(v);
+}
+
+void ESP8266JsonWriter::value(unsigned long v)
+{
+    separator();
+    out_.print(v);
+}
+
+void ESP8266JsonWriter::value(float v, uint8_t digits)
+{
+    separator();
+    if (isnan(v) || isinf(v))
+        out_.print("null");
+    else
+        out_.print(v, digits);
+}
+
+void ESP8266JsonWriter::hexValue(const uint8_t *data, size_t length)
+{
+    static const char hex[] = "0123456789ABCDEF"; // Same alphabet as Compression::hex_encode
+    separator();
+    out_.write('"');
+    for (size_t i = 0; i < length; i++)
+    {
+        out_.write(hex[data[i] >> 4]);
+        out_.write(hex[data[i] & 0x0F]);
+    }
+    out_.write('"');
+}
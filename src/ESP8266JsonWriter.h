@@ -0,0 +1,58 @@
+#ifndef ESP8266_JSON_WRITER_H
+#define ESP8266_JSON_WRITER_H
+
+#include <Arduino.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Forward-only JSON serializer that writes straight to a Print (socket,
+// chunked encoder, secure wrapper, ...). Nothing is buffered, so the
+// serialized document never exists in RAM as a whole. Commas are inserted
+// automatically; the caller is responsible for balanced begin/end calls.
+class ESP8266JsonWriter
+{
+public:
+    explicit ESP8266JsonWriter(Print &out);
+
+    void beginObject();
+    void beginObject(const char *key);
+    void beginObject(const __FlashStringHelper *key);
+    void endObject();
+    void beginArray();
+    void beginArray(const char *key);
+    void endArray();
+
+    void key(const char *name);
+    // Flash key, written as-is: it must not need escaping
+    void key(const __FlashStringHelper *name);
+
+    void value(const char *v);
+    void value(const String &v) { value(v.c_str()); }
+    void value(bool v);
+    void value(int v);
+    void value(unsigned int v);
+    void value(long v);
+    void value(unsigned long v);
+    void value(float v, uint8_t digits = 3);
+    // Bytes written as an uppercase hex string
+    void hexValue(const uint8_t *data, size_t length);
+
+    template <typename T>
+    void field(const char *name, T v)
+    {
+        key(name);
+        value(v);
+    }
+
+private:
+    Print &out_;
+    uint32_t hasItems_; // Bit per nesting level: a value was already written
+    uint8_t depth_;
+    bool afterKey_;
+
+    void separator();
+    void push(char open);
+    void pop(char close);
+};
+
+#endif // ESP8266_JSON_WRITER_H
@@ -0,0 +1,90 @@
+#include "ESP8266Log.h"
+
+ESP8266LogRing logRing;
+
+ESP8266LogRing::ESP8266LogRing() : head_(0), count_(0), highWater_(0), dropped_(0), direct_(true)
+{
+}
+
+void ESP8266LogRing::printf_P(PGM_P fmt, ...)
+{
+    char line[LOG_LINE_MAX + 1];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf_P(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0)
+        return;
+
+    size_t length = (size_t)n;
+    if (length > LOG_LINE_MAX)
+    {
+        // Cut lines keep their newline so the next one starts cleanly
+        length = LOG_LINE_MAX;
+        memcpy(line + LOG_LINE_MAX - 4, "...\n", 4);
+    }
+    push(line, length);
+}
+
+void ESP8266LogRing::setDirect(bool direct)
+{
+    if (direct)
+        flush();
+    direct_ = direct;
+}
+
+void ESP8266LogRing::push(const char *data, size_t length)
+{
+    if (direct_)
+    {
+        Serial.write(reinterpret_cast<const uint8_t *>(data), length);
+        return;
+    }
+    if (length > LOG_RING_SIZE - count_)
+    {
+        drain();
+        if (length > LOG_RING_SIZE - count_)
+        {
+            dropped_++;
+            return;
+        }
+    }
+
+    size_t tail = (head_ + count_) % LOG_RING_SIZE;
+    size_t first = LOG_RING_SIZE - tail;
+    if (first > length)
+        first = length;
+    memcpy(buffer_ + tail, data, first);
+    memcpy(buffer_, data + first, length - first);
+    count_ += length;
+    if (count_ > highWater_)
+        highWater_ = count_;
+}
+
+void ESP8266LogRing::drain()
+{
+    while (count_ > 0)
+    {
+        int room = Serial.availableForWrite();
+        if (room <= 0)
+            return;
+        size_t run = LOG_RING_SIZE - head_;
+        if (run > count_)
+            run = count_;
+        if (run > (size_t)room)
+            run = room;
+        Serial.write(reinterpret_cast<const uint8_t *>(buffer_ + head_), run);
+        head_ = (head_ + run) % LOG_RING_SIZE;
+        count_ -= run;
+    }
+}
+
+void ESP8266LogRing::flush()
+{
+    while (count_ > 0)
+    {
+        drain();
+        yield();
+    }
+    Serial.flush();
+}
@@ -0,0 +1,99 @@
+#ifndef ESP8266_LOG_H
+#define ESP8266_LOG_H
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4    // Payload sizes, per-parameter poll values
+#define LOG_LEVEL_VERBOSE 5  // Request and response bodies
+
+// Set from platformio.ini build_flags, e.g. -DECOWATT_LOG_LEVEL=4
+#ifndef ECOWATT_LOG_LEVEL
+#define ECOWATT_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 2048 // Bytes of formatted output waiting for the UART
+#define LOG_LINE_MAX 160   // Longer lines are cut and end in "..."
+
+// Formatted log lines are copied into a RAM ring and leave it only as fast
+// as the UART FIFO accepts them, so logging from a job step never waits on
+// the serial port. A line that does not fit in the ring is dropped (and
+// counted) rather than blocking.
+class ESP8266LogRing
+{
+public:
+    ESP8266LogRing();
+
+    // fmt lives in flash; the LOG_* macros wrap it in PSTR()
+    void printf_P(PGM_P fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    // Direct mode writes each line straight to Serial (boot, before loop()
+    // drains the ring); the ring takes over once direct mode is switched off
+    void setDirect(bool direct);
+
+    // Move whatever the UART can take right now; call from loop()
+    void drain();
+    // Write everything out, waiting on the UART (before restarts and
+    // interactive output)
+    void flush();
+
+    size_t pending() const { return count_; }
+    uint32_t dropped() const { return dropped_; }
+    size_t highWater() const { return highWater_; }
+
+private:
+    char buffer_[LOG_RING_SIZE];
+    size_t head_; // Next byte to send
+    size_t count_;
+    size_t highWater_;
+    uint32_t dropped_;
+    bool direct_;
+
+    void push(const char *data, size_t length);
+};
+
+extern ESP8266LogRing logRing;
+
+// Levels above ECOWATT_LOG_LEVEL compile to nothing: neither the format
+// string nor the arguments reach the binary. Tags and formats must be string
+// literals; each call is one line, newline added.
+#define LOG_PRINT_(tag, fmt, ...) logRing.printf_P(PSTR("[" tag "] " fmt "\n"), ##__VA_ARGS__)
+#define LOG_NOTHING_(...) \
+    do                    \
+    {                     \
+    } while (0)
+
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(tag, fmt, ...) LOG_PRINT_(tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(...) LOG_NOTHING_()
+#endif
+
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(tag, fmt, ...) LOG_PRINT_(tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(...) LOG_NOTHING_()
+#endif
+
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(tag, fmt, ...) LOG_PRINT_(tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(...) LOG_NOTHING_()
+#endif
+
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(tag, fmt, ...) LOG_PRINT_(tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(...) LOG_NOTHING_()
+#endif
+
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_VERBOSE
+#define LOG_V(tag, fmt, ...) LOG_PRINT_(tag, fmt, ##__VA_ARGS__)
+#else
+#define LOG_V(...) LOG_NOTHING_()
+#endif
+
+#endif // ESP8266_LOG_H
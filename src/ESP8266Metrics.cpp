@@ -0,0 +1,238 @@
+#include "ESP8266Metrics.h"
+
+ESP8266Metrics metrics;
+
+static const char *const kStageNames[METRIC_STAGE_COUNT] = {
+    "wifi_reconnect", "gateway_rtt", "frame_parse", "upload_build", "upload_serialize", "upload_wrap",
+    "upload_connect", "upload_send", "upload_wait", "config_rtt", "save_config", "fota_chunk"};
+
+static const char *const kCounterNames[METRIC_COUNTER_COUNT] = {
+    "upload_retries", "upload_failures", "config_failures", "gateway_failures", "crc_errors", "wifi_reconnects",
+    "radio_on_s"};
+
+void LatencyHistogram::reset()
+{
+    for (uint8_t i = 0; i < METRICS_BUCKETS; i++)
+    {
+        buckets[i] = 0;
+    }
+    count = 0;
+    max_us = 0;
+    total_us = 0;
+}
+
+void LatencyHistogram::add(uint32_t us)
+{
+    uint8_t bucket = us ? (uint8_t)(32 - __builtin_clz(us)) : 0;
+    if (bucket >= METRICS_BUCKETS)
+        bucket = METRICS_BUCKETS - 1;
+    if (buckets[bucket] != UINT16_MAX)
+        buckets[bucket]++;
+    count++;
+    total_us += us;
+    if (us > max_us)
+        max_us = us;
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t pct) const
+{
+    if (count == 0)
+        return 0;
+
+    // Walk the buckets against their own total, which stops growing once one saturates
+    uint32_t inBuckets = 0;
+    for (uint8_t i = 0; i < METRICS_BUCKETS; i++)
+    {
+        inBuckets += buckets[i];
+    }
+    uint32_t rank = (inBuckets * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < METRICS_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t upper = i ? (1UL << i) : 0;
+            return upper < max_us ? upper : max_us;
+        }
+    }
+    return max_us;
+}
+
+ESP8266Metrics::ESP8266Metrics()
+{
+    reset();
+}
+
+void ESP8266Metrics::reset()
+{
+    for (uint8_t i = 0; i < METRIC_STAGE_COUNT; i++)
+    {
+        histograms_[i].reset();
+    }
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+        counters_[i] = 0;
+    }
+    heapLowWater_ = UINT32_MAX;
+    minMaxFreeBlock_ = UINT32_MAX;
+    peakFragmentation_ = 0;
+}
+
+void ESP8266Metrics::noteHeap(uint32_t freeHeap, uint32_t maxFreeBlock, uint8_t fragmentation)
+{
+    if (freeHeap < heapLowWater_)
+        heapLowWater_ = freeHeap;
+    if (maxFreeBlock < minMaxFreeBlock_)
+        minMaxFreeBlock_ = maxFreeBlock;
+    if (fragmentation > peakFragmentation_)
+        peakFragmentation_ = fragmentation;
+}
+
+const char *ESP8266Metrics::stageName(MetricStage stage)
+{
+    uint8_t i = static_cast<uint8_t>(stage);
+    return i < METRIC_STAGE_COUNT ? kStageNames[i] : "unknown";
+}
+
+const char *ESP8266Metrics::counterName(MetricCounter counter)
+{
+    uint8_t i = static_cast<uint8_t>(counter);
+    return i < METRIC_COUNTER_COUNT ? kCounterNames[i] : "unknown";
+}
+
+void ESP8266Metrics::summarize(MetricsSummary &out) const
+{
+    for (uint8_t i = 0; i < METRIC_STAGE_COUNT; i++)
+    {
+        const LatencyHistogram &h = histograms_[i];
+        out.stages[i].count = h.count;
+        out.stages[i].p50_us = h.percentile(50);
+        out.stages[i].p95_us = h.percentile(95);
+        out.stages[i].max_us = h.max_us;
+    }
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+        out.counters[i] = counters_[i];
+    }
+    out.heap_low_water = heapLowWater_ == UINT32_MAX ? 0 : heapLowWater_;
+    out.min_max_free_block = minMaxFreeBlock_ == UINT32_MAX ? 0 : minMaxFreeBlock_;
+    out.peak_fragmentation = peakFragmentation_;
+}
+
+void ESP8266Metrics::writeJson(ESP8266JsonWriter &json, const MetricsSummary &summary)
+{
+    // Stages that never ran are left out; each stage is [n, p50, p95, max] in us
+    json.beginObject("metrics");
+    json.beginObject("stages");
+    for (uint8_t i = 0; i < METRIC_STAGE_COUNT; i++)
+    {
+        const MetricsSummary::Stage &s = summary.stages[i];
+        if (s.count == 0)
+            continue;
+        json.beginArray(kStageNames[i]);
+        json.value((unsigned long)s.count);
+        json.value((unsigned long)s.p50_us);
+        json.value((unsigned long)s.p95_us);
+        json.value((unsigned long)s.max_us);
+        json.endArray();
+    }
+    json.endObject();
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+        json.field(kCounterNames[i], (unsigned long)summary.counters[i]);
+    }
+    json.field("heap_low_water", (unsigned long)summary.heap_low_water);
+    json.field("min_max_free_block", (unsigned long)summary.min_max_free_block);
+    json.field("peak_fragmentation", (unsigned int)summary.peak_fragmentation);
+    json.endObject();
+}
+
+void ESP8266Metrics::writeEnvelope(ESP8266UploadEnvelope &env, const MetricsSummary &summary)
+{
+    for (uint8_t i = 0; i < METRIC_STAGE_COUNT; i++)
+    {
+        const MetricsSummary::Stage &s = summary.stages[i];
+        if (s.count == 0)
+            continue;
+        env.uintField(EnvelopeKey::METRIC, i);
+        env.uintField(EnvelopeKey::METRIC_COUNT, s.count);
+        env.uintField(EnvelopeKey::METRIC_P50_US, s.p50_us);
+        env.uintField(EnvelopeKey::METRIC_P95_US, s.p95_us);
+        env.uintField(EnvelopeKey::METRIC_MAX_US, s.max_us);
+    }
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+        if (summary.counters[i] == 0)
+            continue;
+        env.uintField(EnvelopeKey::COUNTER, i);
+        env.uintField(EnvelopeKey::COUNTER_VALUE, summary.counters[i]);
+    }
+    env.uintField(EnvelopeKey::HEAP_LOW_WATER, summary.heap_low_water);
+    env.uintField(EnvelopeKey::HEAP_MIN_MAX_BLOCK, summary.min_max_free_block);
+    env.uintField(EnvelopeKey::HEAP_PEAK_FRAGMENTATION, summary.peak_fragmentation);
+}
+
+void ESP8266Metrics::print() const
+{
+    Serial.println("=== Metrics (us: n p50 p95 mean max) ===");
+    for (uint8_t i = 0; i < METRIC_STAGE_COUNT; i++)
+    {
+        const LatencyHistogram &h = histograms_[i];
+        Serial.print(kStageNames[i]);
+        Serial.print(": ");
+        if (h.count == 0)
+        {
+            Serial.println("-");
+            continue;
+        }
+        Serial.print(h.count);
+        Serial.print(" ");
+        Serial.print(h.percentile(50));
+        Serial.print(" ");
+        Serial.print(h.percentile(95));
+        Serial.print(" ");
+        Serial.print(h.mean());
+        Serial.print(" ");
+        Serial.println(h.max_us);
+
+        // Populated buckets as <upper edge>:<count>
+        Serial.print("  ");
+        for (uint8_t b = 0; b < METRICS_BUCKETS; b++)
+        {
+            if (h.buckets[b] == 0)
+                continue;
+            bool last = b == METRICS_BUCKETS - 1;
+            Serial.print(last ? ">=" : "<");
+            Serial.print(last ? (1UL << (b - 1)) : (1UL << b));
+            Serial.print(":");
+            Serial.print(h.buckets[b]);
+            Serial.print(" ");
+        }
+        Serial.println();
+    }
+
+    for (uint8_t i = 0; i < METRIC_COUNTER_COUNT; i++)
+    {
+        Serial.print(kCounterNames[i]);
+        Serial.print(": ");
+        Serial.println(counters_[i]);
+    }
+    Serial.print("Heap low-water: ");
+    Serial.print(heapLowWater_ == UINT32_MAX ? 0 : heapLowWater_);
+    Serial.print(" bytes, smallest max block ");
+    Serial.print(minMaxFreeBlock_ == UINT32_MAX ? 0 : minMaxFreeBlock_);
+    Serial.print(" bytes, peak fragmentation ");
+    Serial.print(peakFragmentation_);
+    Serial.println("%");
+    Serial.println("========================================");
+}
+
+MetricTimer::MetricTimer(MetricStage stage) : stage_(stage), startUs_(micros())
+{
+}
+
+MetricTimer::~MetricTimer()
+{
+    metrics.record(stage_, micros() - startUs_);
+}
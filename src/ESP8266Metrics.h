@@ -0,0 +1,124 @@
+#ifndef ESP8266_METRICS_H
+#define ESP8266_METRICS_H
+
+#include <Arduino.h>
+#include "ESP8266JsonWriter.h"
+#include "ESP8266UploadEnvelope.h"
+
+#define METRICS_BUCKETS 24 // Log2 microsecond buckets; the last one also holds everything above 8.4 s
+
+// Hot-path stages timed into a histogram each
+enum class MetricStage : uint8_t
+{
+    WIFI_RECONNECT = 0, // Link lost until associated again
+    GATEWAY_ROUND_TRIP, // One Modbus request/reply over the gateway channel
+    FRAME_PARSE,        // Reply CRC check and register extraction
+    UPLOAD_BUILD,       // Encoding a window into an upload context
+    UPLOAD_SERIALIZE,   // Writing the body, excluding wrap and socket time
+    UPLOAD_SECURE_WRAP, // Base64 and HMAC of the body
+    UPLOAD_CONNECT,     // TCP connect (zero on a kept-alive socket)
+    UPLOAD_SEND,        // Headers and body onto the socket
+    UPLOAD_WAIT,        // Request sent until response complete
+    CONFIG_ROUND_TRIP,  // Full signed config request, start to completion
+    SAVE_CONFIG,        // EEPROM commit
+    FOTA_CHUNK_APPLY,   // Decode and flash write of one FOTA chunk
+    COUNT
+};
+
+enum class MetricCounter : uint8_t
+{
+    UPLOAD_RETRIES = 0,
+    UPLOAD_FAILURES,
+    CONFIG_FAILURES,
+    GATEWAY_FAILURES,
+    CRC_ERRORS,
+    WIFI_RECONNECTS,
+    RADIO_ON_S, // Seconds the radio was powered
+    COUNT
+};
+
+#define METRIC_STAGE_COUNT static_cast<uint8_t>(MetricStage::COUNT)
+#define METRIC_COUNTER_COUNT static_cast<uint8_t>(MetricCounter::COUNT)
+
+// Fixed-size log-scale latency histogram. Bucket 0 holds 0 us, bucket k holds
+// [2^(k-1), 2^k) us; counts saturate instead of wrapping. Percentiles are
+// reported as the upper edge of the bucket they fall in, capped at the max.
+struct LatencyHistogram
+{
+    uint16_t buckets[METRICS_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+
+    void reset();
+    void add(uint32_t us);
+    uint32_t percentile(uint8_t pct) const;
+    uint32_t mean() const { return count ? (uint32_t)(total_us / count) : 0; }
+};
+
+// Per-stage figures as they went into one upload
+struct MetricsSummary
+{
+    struct Stage
+    {
+        uint32_t count;
+        uint32_t p50_us;
+        uint32_t p95_us;
+        uint32_t max_us;
+    } stages[METRIC_STAGE_COUNT];
+    uint32_t counters[METRIC_COUNTER_COUNT];
+    uint32_t heap_low_water;
+    uint32_t min_max_free_block;
+    uint8_t peak_fragmentation;
+};
+
+// Latency histograms, failure counters and heap low-water marks since boot
+// (or the last reset). Everything lives in fixed arrays; recording a value
+// never allocates, so it is safe on every hot path.
+class ESP8266Metrics
+{
+public:
+    ESP8266Metrics();
+
+    void record(MetricStage stage, uint32_t us) { histograms_[static_cast<uint8_t>(stage)].add(us); }
+    void count(MetricCounter counter, uint32_t n = 1) { counters_[static_cast<uint8_t>(counter)] += n; }
+    void noteHeap(uint32_t freeHeap, uint32_t maxFreeBlock, uint8_t fragmentation);
+    void reset();
+
+    const LatencyHistogram &histogram(MetricStage stage) const { return histograms_[static_cast<uint8_t>(stage)]; }
+    uint32_t counter(MetricCounter counter) const { return counters_[static_cast<uint8_t>(counter)]; }
+
+    void summarize(MetricsSummary &out) const;
+    // Compact "metrics" object / envelope records for an upload
+    static void writeJson(ESP8266JsonWriter &json, const MetricsSummary &summary);
+    static void writeEnvelope(ESP8266UploadEnvelope &env, const MetricsSummary &summary);
+
+    // Full dump, every populated bucket included
+    void print() const;
+
+    static const char *stageName(MetricStage stage);
+    static const char *counterName(MetricCounter counter);
+
+private:
+    LatencyHistogram histograms_[METRIC_STAGE_COUNT];
+    uint32_t counters_[METRIC_COUNTER_COUNT];
+    uint32_t heapLowWater_;
+    uint32_t minMaxFreeBlock_;
+    uint8_t peakFragmentation_;
+};
+
+// Times the enclosing scope into one stage
+class MetricTimer
+{
+public:
+    explicit MetricTimer(MetricStage stage);
+    ~MetricTimer();
+
+private:
+    MetricStage stage_;
+    uint32_t startUs_;
+};
+
+extern ESP8266Metrics metrics;
+
+#endif // ESP8266_METRICS_H
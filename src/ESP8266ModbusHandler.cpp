@@ -1,4 +1,6 @@
 #include "ESP8266ModbusHandler.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266Log.h"
 
 // Modbus CRC16 lookup table
 const uint16_t ESP8266ModbusHandler::crc16_table[256] = {
@@ -44,172 +46,263 @@ bool ESP8266ModbusHandler::begin()
     return adapter_.begin();
 }
 
-bool ESP8266ModbusHandler::readRegisters(uint16_t startAddr, uint16_t numRegs, std::vector<uint16_t> &values, uint8_t slaveAddr)
+bool ESP8266ModbusHandler::readRegisters(uint16_t startAddr, uint16_t numRegs, uint16_t *values, uint8_t slaveAddr)
 {
-    String frameHex = buildReadFrame(slaveAddr, startAddr, numRegs);
-    String responseHex;
-
-    if (!adapter_.sendReadRequest(frameHex, responseHex))
+    if (numRegs == 0 || numRegs > MAX_READ_REGS)
     {
-        Serial.println("[MODBUS] Failed to send read request");
+        LOG_E("MODBUS", "Invalid register count");
         return false;
     }
 
-    // Parse response
-    std::vector<uint8_t> response = hexToBytes(responseHex);
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t response[MAX_FRAME_SIZE];
+    size_t frameLength = buildReadFrame(frame, slaveAddr, startAddr, numRegs);
+    size_t responseLength = 0;
 
-    if (response.size() < 5)
+    if (!transact(false, frame, frameLength, response, sizeof(response), responseLength))
     {
-        Serial.println("[MODBUS] Response too short");
+        LOG_E("MODBUS", "Failed to send read request");
+        metrics.count(MetricCounter::GATEWAY_FAILURES);
         return false;
     }
 
-    // Check for exception
-    if (response[1] & 0x80)
+    return parseReadReply(response, responseLength, numRegs, values);
+}
+
+bool ESP8266ModbusHandler::parseReadReply(const uint8_t *reply, size_t length, uint16_t numRegs, uint16_t *values)
+{
+    MetricTimer parseTimer(MetricStage::FRAME_PARSE);
+    if (!validateReply(reply, length, 5, "Read"))
+        return false;
+
+    // Extract register values
+    uint8_t byteCount = reply[2];
+    if (length != (size_t)byteCount + 5 || byteCount != numRegs * 2)
     {
-        Serial.print("[MODBUS] Exception: ");
-        Serial.println(modbusExceptionMessage(response[2]));
+        LOG_E("MODBUS", "Invalid byte count");
         return false;
     }
 
-    // Verify CRC
-    uint16_t receivedCRC = (response[response.size() - 1] << 8) | response[response.size() - 2];
-    std::vector<uint8_t> dataForCRC(response.begin(), response.end() - 2);
-    uint16_t calculatedCRC = calculateCRC(dataForCRC);
-
-    if (receivedCRC != calculatedCRC)
+    const uint8_t *data = reply + 3;
+    for (uint16_t i = 0; i < numRegs; i++)
     {
-        Serial.println("[MODBUS] CRC mismatch");
-        return false;
+        values[i] = (data[i * 2] << 8) | data[i * 2 + 1];
     }
 
-    // Extract register values
-    uint8_t byteCount = response[2];
-    if (response.size() != byteCount + 5)
+    return true;
+}
+
+bool ESP8266ModbusHandler::readRegisters(uint16_t startAddr, uint16_t numRegs, std::vector<uint16_t> &values, uint8_t slaveAddr)
+{
+    values.resize(numRegs);
+    if (!readRegisters(startAddr, numRegs, values.data(), slaveAddr))
     {
-        Serial.println("[MODBUS] Invalid byte count");
+        values.clear();
         return false;
     }
+    return true;
+}
 
-    values.clear();
-    for (int i = 0; i < numRegs; i++)
+bool ESP8266ModbusHandler::writeRegister(uint16_t regAddr, uint16_t regValue, uint8_t slaveAddr)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t response[MAX_FRAME_SIZE];
+    size_t frameLength = buildWriteFrame(frame, slaveAddr, regAddr, regValue);
+    size_t responseLength = 0;
+
+    if (!transact(true, frame, frameLength, response, sizeof(response), responseLength))
     {
-        uint16_t value = (response[3 + i * 2] << 8) | response[4 + i * 2];
-        values.push_back(value);
+        LOG_E("MODBUS", "Failed to send write request");
+        metrics.count(MetricCounter::GATEWAY_FAILURES);
+        return false;
     }
 
-    return true;
+    MetricTimer parseTimer(MetricStage::FRAME_PARSE);
+    return validateReply(response, responseLength, 8, "Write");
 }
 
-bool ESP8266ModbusHandler::writeRegister(uint16_t regAddr, uint16_t regValue, uint8_t slaveAddr)
+bool ESP8266ModbusHandler::writeRegisters(uint16_t startAddr, const uint16_t *values, uint16_t numRegs, uint8_t slaveAddr)
 {
-    String frameHex = buildWriteFrame(slaveAddr, regAddr, regValue);
-    String responseHex;
+    if (numRegs == 0 || numRegs > MAX_WRITE_REGS)
+    {
+        LOG_E("MODBUS", "Invalid write count: %u", numRegs);
+        return false;
+    }
+
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t response[MAX_FRAME_SIZE];
+    size_t frameLength = buildWriteMultipleFrame(frame, slaveAddr, startAddr, values, numRegs);
+    size_t responseLength = 0;
 
-    if (!adapter_.sendWriteRequest(frameHex, responseHex))
+    if (!transact(true, frame, frameLength, response, sizeof(response), responseLength))
     {
-        Serial.println("[MODBUS] Failed to send write request");
+        LOG_E("MODBUS", "Failed to send write request");
+        metrics.count(MetricCounter::GATEWAY_FAILURES);
         return false;
     }
 
-    // Parse response
-    std::vector<uint8_t> response = hexToBytes(responseHex);
+    MetricTimer parseTimer(MetricStage::FRAME_PARSE);
+    if (!validateReply(response, responseLength, 8, "Write multiple"))
+        return false;
+
+    // The reply echoes the start address and register count
+    uint16_t echoedStart = (response[2] << 8) | response[3];
+    uint16_t echoedCount = (response[4] << 8) | response[5];
+    if (echoedStart != startAddr || echoedCount != numRegs)
+    {
+        LOG_E("MODBUS", "Write multiple reply mismatch");
+        return false;
+    }
+    return true;
+}
 
-    if (response.size() < 8)
+bool ESP8266ModbusHandler::validateReply(const uint8_t *reply, size_t length, size_t minLength, const char *context)
+{
+    if (length < minLength)
     {
-        Serial.println("[MODBUS] Write response too short");
+        LOG_E("MODBUS", "%s response too short", context);
         return false;
     }
 
     // Check for exception
-    if (response[1] & 0x80)
+    if (reply[1] & 0x80)
     {
-        Serial.print("[MODBUS] Write exception: ");
-        Serial.println(modbusExceptionMessage(response[2]));
+        LOG_E("MODBUS", "%s exception: %s", context, modbusExceptionMessage(reply[2]).c_str());
         return false;
     }
 
-    // Verify CRC
-    uint16_t receivedCRC = (response[response.size() - 1] << 8) | response[response.size() - 2];
-    std::vector<uint8_t> dataForCRC(response.begin(), response.end() - 2);
-    uint16_t calculatedCRC = calculateCRC(dataForCRC);
-
-    if (receivedCRC != calculatedCRC)
+    // Verify CRC in place over everything but the trailing CRC bytes
+    uint16_t receivedCRC = (reply[length - 1] << 8) | reply[length - 2];
+    if (receivedCRC != calculateCRC(reply, length - 2))
     {
-        Serial.println("[MODBUS] Write CRC mismatch");
+        LOG_E("MODBUS", "%s CRC mismatch", context);
+        metrics.count(MetricCounter::CRC_ERRORS);
         return false;
     }
 
     return true;
 }
 
-String ESP8266ModbusHandler::buildReadFrame(uint8_t slaveAddr, uint16_t startAddr, uint16_t numRegs)
+size_t ESP8266ModbusHandler::buildReadFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t startAddr, uint16_t numRegs)
 {
-    std::vector<uint8_t> frame;
+    frame[0] = slaveAddr;
+    frame[1] = 0x03; // Function code: Read Holding Registers
+    frame[2] = (startAddr >> 8) & 0xFF;
+    frame[3] = startAddr & 0xFF;
+    frame[4] = (numRegs >> 8) & 0xFF;
+    frame[5] = numRegs & 0xFF;
+
+    uint16_t crc = calculateCRC(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = (crc >> 8) & 0xFF;
+
+    return 8;
+}
 
-    frame.push_back(slaveAddr);
-    frame.push_back(0x03); // Function code: Read Holding Registers
-    frame.push_back((startAddr >> 8) & 0xFF);
-    frame.push_back(startAddr & 0xFF);
-    frame.push_back((numRegs >> 8) & 0xFF);
-    frame.push_back(numRegs & 0xFF);
+size_t ESP8266ModbusHandler::buildWriteFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t regAddr, uint16_t regValue)
+{
+    frame[0] = slaveAddr;
+    frame[1] = 0x06; // Function code: Write Single Register
+    frame[2] = (regAddr >> 8) & 0xFF;
+    frame[3] = regAddr & 0xFF;
+    frame[4] = (regValue >> 8) & 0xFF;
+    frame[5] = regValue & 0xFF;
+
+    uint16_t crc = calculateCRC(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = (crc >> 8) & 0xFF;
+
+    return 8;
+}
 
-    uint16_t crc = calculateCRC(frame);
-    frame.push_back(crc & 0xFF);
-    frame.push_back((crc >> 8) & 0xFF);
+size_t ESP8266ModbusHandler::buildWriteMultipleFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t startAddr,
+                                                     const uint16_t *values, uint16_t numRegs)
+{
+    frame[0] = slaveAddr;
+    frame[1] = 0x10; // Function code: Write Multiple Registers
+    frame[2] = (startAddr >> 8) & 0xFF;
+    frame[3] = startAddr & 0xFF;
+    frame[4] = (numRegs >> 8) & 0xFF;
+    frame[5] = numRegs & 0xFF;
+    frame[6] = (uint8_t)(numRegs * 2);
+
+    for (uint16_t i = 0; i < numRegs; i++)
+    {
+        frame[7 + i * 2] = (values[i] >> 8) & 0xFF;
+        frame[8 + i * 2] = values[i] & 0xFF;
+    }
+
+    size_t length = 7 + numRegs * 2;
+    uint16_t crc = calculateCRC(frame, length);
+    frame[length] = crc & 0xFF;
+    frame[length + 1] = (crc >> 8) & 0xFF;
 
-    return bytesToHex(frame);
+    return length + 2;
 }
 
-String ESP8266ModbusHandler::buildWriteFrame(uint8_t slaveAddr, uint16_t regAddr, uint16_t regValue)
+bool ESP8266ModbusHandler::transact(bool isWrite, const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength)
 {
-    std::vector<uint8_t> frame;
-
-    frame.push_back(slaveAddr);
-    frame.push_back(0x06); // Function code: Write Single Register
-    frame.push_back((regAddr >> 8) & 0xFF);
-    frame.push_back(regAddr & 0xFF);
-    frame.push_back((regValue >> 8) & 0xFF);
-    frame.push_back(regValue & 0xFF);
+    MetricTimer timer(MetricStage::GATEWAY_ROUND_TRIP);
+    replyLength = 0;
+    if (adapter_.usesBinaryTransport())
+    {
+        return isWrite ? adapter_.sendWriteFrame(frame, length, reply, replyCapacity, replyLength)
+                       : adapter_.sendReadFrame(frame, length, reply, replyCapacity, replyLength);
+    }
 
-    uint16_t crc = calculateCRC(frame);
-    frame.push_back(crc & 0xFF);
-    frame.push_back((crc >> 8) & 0xFF);
+    // Legacy JSON/hex gateway API
+    char frameHex[MAX_FRAME_SIZE * 2 + 1];
+    bytesToHex(frame, length, frameHex);
 
-    return bytesToHex(frame);
+    String responseHex;
+    bool ok = isWrite ? adapter_.sendWriteRequest(frameHex, responseHex)
+                      : adapter_.sendReadRequest(frameHex, responseHex);
+    if (!ok)
+        return false;
+    replyLength = hexToBytes(responseHex, reply, replyCapacity);
+    return true;
 }
 
-String ESP8266ModbusHandler::bytesToHex(const std::vector<uint8_t> &bytes)
+void ESP8266ModbusHandler::bytesToHex(const uint8_t *bytes, size_t length, char *hexOut)
 {
-    String hex = "";
-    for (uint8_t byte : bytes)
+    static const char hexChars[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < length; i++)
     {
-        if (byte < 0x10)
-            hex += "0";
-        hex += String(byte, HEX);
+        hexOut[i * 2] = hexChars[bytes[i] >> 4];
+        hexOut[i * 2 + 1] = hexChars[bytes[i] & 0x0F];
     }
-    hex.toUpperCase();
-    return hex;
+    hexOut[length * 2] = '\0';
 }
 
-std::vector<uint8_t> ESP8266ModbusHandler::hexToBytes(const String &hex)
+size_t ESP8266ModbusHandler::hexToBytes(const String &hex, uint8_t *bytesOut, size_t capacity)
 {
-    std::vector<uint8_t> bytes;
-    for (int i = 0; i < hex.length(); i += 2)
+    auto nibble = [](char c) -> int
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < hex.length() && count < capacity; i += 2)
     {
-        String byteString = hex.substring(i, i + 2);
-        bytes.push_back(strtol(byteString.c_str(), NULL, 16));
+        int hi = nibble(hex[i]);
+        int lo = nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0)
+            break;
+        bytesOut[count++] = (uint8_t)((hi << 4) | lo);
     }
-    return bytes;
+    return count;
 }
 
-uint16_t ESP8266ModbusHandler::calculateCRC(const std::vector<uint8_t> &data)
+uint16_t ESP8266ModbusHandler::calculateCRC(const uint8_t *data, size_t length)
 {
     uint16_t crc = 0xFFFF;
 
-    for (uint8_t byte : data)
+    for (size_t i = 0; i < length; i++)
     {
-        uint8_t index = (crc ^ byte) & 0xFF;
+        uint8_t index = (crc ^ data[i]) & 0xFF;
         crc = (crc >> 8) ^ crc16_table[index];
     }
 
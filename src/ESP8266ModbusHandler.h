@@ -10,23 +10,48 @@ class ESP8266ModbusHandler
 public:
     ESP8266ModbusHandler();
 
+    // Largest RTU frame (Modbus limits an ADU to 256 bytes) and registers per read
+    static const size_t MAX_FRAME_SIZE = 256;
+    static const uint16_t MAX_READ_REGS = 125;
+    static const uint16_t MAX_WRITE_REGS = 123; // Write Multiple Registers limit
+
     bool begin();
+
+    // Allocation-free API: registers are decoded in place into values[0..numRegs-1]
+    bool readRegisters(uint16_t startAddr, uint16_t numRegs, uint16_t *values, uint8_t slaveAddr = 0x11);
     bool readRegisters(uint16_t startAddr, uint16_t numRegs, std::vector<uint16_t> &values, uint8_t slaveAddr = 0x11);
     bool writeRegister(uint16_t regAddr, uint16_t regValue, uint8_t slaveAddr = 0x11);
+    // Function 0x10: values[0..numRegs-1] to consecutive registers in one frame
+    bool writeRegisters(uint16_t startAddr, const uint16_t *values, uint16_t numRegs, uint8_t slaveAddr = 0x11);
+
+    // Frame builders write into a caller buffer of at least MAX_FRAME_SIZE bytes and return the frame length
+    static size_t buildReadFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t startAddr, uint16_t numRegs);
+    static size_t buildWriteFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t regAddr, uint16_t regValue);
+    static size_t buildWriteMultipleFrame(uint8_t *frame, uint8_t slaveAddr, uint16_t startAddr, const uint16_t *values,
+                                          uint16_t numRegs);
+
+    // Check a read reply (length, exception, CRC, byte count) and decode its
+    // registers into values[0..numRegs-1]; shared with the pipelined poller
+    static bool parseReadReply(const uint8_t *reply, size_t length, uint16_t numRegs, uint16_t *values);
+
+    static uint16_t calculateCRC(const uint8_t *data, size_t length);
+    uint16_t calculateCRC(const std::vector<uint8_t> &data) { return calculateCRC(data.data(), data.size()); }
+    static String modbusExceptionMessage(uint8_t code);
 
-    uint16_t calculateCRC(const std::vector<uint8_t> &data);
-    String modbusExceptionMessage(uint8_t code);
+    // JSON/hex gateway API helpers; hexOut needs 2 * length + 1 bytes
+    static void bytesToHex(const uint8_t *bytes, size_t length, char *hexOut);
+    static size_t hexToBytes(const String &hex, uint8_t *bytesOut, size_t capacity);
 
 private:
     ESP8266ProtocolAdapter adapter_;
 
-    String buildReadFrame(uint8_t slaveAddr, uint16_t startAddr, uint16_t numRegs);
-    String buildWriteFrame(uint8_t slaveAddr, uint16_t regAddr, uint16_t regValue);
-    String bytesToHex(const std::vector<uint8_t> &bytes);
-    std::vector<uint8_t> hexToBytes(const String &hex);
+    // Send a frame over the configured transport (binary or JSON/hex) and return the raw reply
+    bool transact(bool isWrite, const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength);
+    // Common checks on a reply: minimum length, exception flag and CRC over (ptr,len)
+    static bool validateReply(const uint8_t *reply, size_t length, size_t minLength, const char *context);
 
     // CRC table for Modbus CRC16
     static const uint16_t crc16_table[256];
 };
 
-#endif // ESP8266_MODBUS_HANDLER_H
\ No newline at end of file
+#endif // ESP8266_MODBUS_HANDLER_H
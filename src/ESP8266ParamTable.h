@@ -0,0 +1,28 @@
+#ifndef ESP8266_PARAM_TABLE_H
+#define ESP8266_PARAM_TABLE_H
+
+// The inverter register map. Adding a parameter means adding one line here:
+// the ParameterType enum, PARAMETER_TYPE_COUNT, the kParams descriptor table
+// and the name lookups are all generated from this list.
+//
+//   X(id, cloud name, friendly name, unit, register, scale, upload scale, writable)
+//
+// cloud name   : register name used by config_update and write_register commands
+// scale        : raw register value / scale = engineering units
+// upload scale : engineering units * upload scale = integer sent in uploads
+//
+// Append new lines at the end: the enum value is the line's position and is
+// stored in EEPROM and spill files.
+#define ECOWATT_PARAMS(X)                                                                                \
+    X(AC_VOLTAGE, "voltage", "AC Voltage", "V", 0, 10.0f, 1000.0f, false)                                \
+    X(AC_CURRENT, "current", "AC Current", "A", 1, 10.0f, 1000.0f, false)                                \
+    X(AC_FREQUENCY, "frequency", "AC Frequency", "Hz", 2, 100.0f, 1000.0f, false)                        \
+    X(PV1_VOLTAGE, "pv1_voltage", "PV1 Voltage", "V", 3, 10.0f, 1.0f, false)                             \
+    X(PV2_VOLTAGE, "pv2_voltage", "PV2 Voltage", "V", 4, 10.0f, 1.0f, false)                             \
+    X(PV1_CURRENT, "pv1_current", "PV1 Current", "A", 5, 10.0f, 1.0f, false)                             \
+    X(PV2_CURRENT, "pv2_current", "PV2 Current", "A", 6, 10.0f, 1.0f, false)                             \
+    X(TEMPERATURE, "temperature", "Temperature", "°C", 7, 10.0f, 1.0f, false)                            \
+    X(EXPORT_POWER_PERCENT, "output_power_percentage", "Export Power Percent", "%", 8, 1.0f, 1.0f, true) \
+    X(OUTPUT_POWER, "power", "Output Power", "W", 9, 1.0f, 1.0f, false)
+
+#endif // ESP8266_PARAM_TABLE_H
@@ -1,44 +1,172 @@
 #include "ESP8266Parameters.h"
 #include <string.h>
 
-// Parameter descriptor table (stored in RAM as simple const data)
-const ParamDesc kParams[] = {
-    {ParameterType::AC_VOLTAGE, "AC Voltage", "V", 0, 10.0f},
-    {ParameterType::AC_CURRENT, "AC Current", "A", 1, 10.0f},
-    {ParameterType::AC_FREQUENCY, "AC Frequency", "Hz", 2, 100.0f},
-    {ParameterType::PV1_VOLTAGE, "PV1 Voltage", "V", 3, 10.0f},
-    {ParameterType::PV2_VOLTAGE, "PV2 Voltage", "V", 4, 10.0f},
-    {ParameterType::PV1_CURRENT, "PV1 Current", "A", 5, 10.0f},
-    {ParameterType::PV2_CURRENT, "PV2 Current", "A", 6, 10.0f},
-    {ParameterType::TEMPERATURE, "Temperature", "°C", 7, 10.0f},
-    {ParameterType::EXPORT_POWER_PERCENT, "Export Power Percent", "%", 8, 1.0f},
-    {ParameterType::OUTPUT_POWER, "Output Power", "W", 9, 1.0f}};
+// Flash copies of every string in the table
+#define PARAM_STRINGS_(id, cloud, name, unit, ...)              \
+    static const char kKey_##id[] PROGMEM = #id;                \
+    static const char kCloud_##id[] PROGMEM = cloud;            \
+    static const char kName_##id[] PROGMEM = name;              \
+    static const char kUnit_##id[] PROGMEM = unit;
+ECOWATT_PARAMS(PARAM_STRINGS_)
+#undef PARAM_STRINGS_
+
+#define PARAM_DESC_(id, cloud, name, unit, reg, scale, upload_scale, writable) \
+    {kKey_##id, kCloud_##id, kName_##id, kUnit_##id, reg, scale, upload_scale, writable},
+constexpr ParamDesc kParams[] PROGMEM = {ECOWATT_PARAMS(PARAM_DESC_)};
+#undef PARAM_DESC_
 
 const size_t kParamsCount = sizeof(kParams) / sizeof(kParams[0]);
+static_assert(sizeof(kParams) / sizeof(kParams[0]) == PARAMETER_TYPE_COUNT, "kParams must cover every ParameterType");
 
-const ParamDesc *find_param(ParameterType id)
+// ---- Perfect hash ----------------------------------------------------------
+//
+// Names hash with a seeded, case-folded FNV-1a into PARAM_HASH_SLOTS slots.
+// The seed is searched at compile time until no two names of a table share a
+// slot, so a lookup is one hash, one slot read and one strcmp_P.
+
+#define PARAM_HASH_SLOTS 32 // Power of two, at least twice PARAMETER_TYPE_COUNT
+#define PARAM_HASH_EMPTY 0xFF
+
+static_assert((PARAM_HASH_SLOTS & (PARAM_HASH_SLOTS - 1)) == 0, "PARAM_HASH_SLOTS must be a power of two");
+static_assert(PARAM_HASH_SLOTS >= 2 * PARAMETER_TYPE_COUNT, "Too few hash slots for the parameter table");
+
+static constexpr uint8_t paramHashSlot(const char *s, uint32_t seed)
 {
-    for (size_t i = 0; i < kParamsCount; i++)
+    uint32_t h = 2166136261u ^ seed;
+    for (; *s; s++)
     {
-        if (kParams[i].id == id)
-        {
-            return &kParams[i];
-        }
+        char c = *s;
+        if (c >= 'A' && c <= 'Z')
+            c = (char)(c - 'A' + 'a');
+        h = (h ^ (uint8_t)c) * 16777619u;
     }
-    return nullptr;
+    return (uint8_t)((h ^ (h >> 16)) & (PARAM_HASH_SLOTS - 1));
 }
 
-const ParamDesc *find_param_by_name(const char *name)
+struct ParamHashIndex
 {
-    if (!name)
-        return nullptr;
+    uint32_t seed;
+    uint8_t slots[PARAM_HASH_SLOTS]; // kParams index, or PARAM_HASH_EMPTY
+};
 
-    for (size_t i = 0; i < kParamsCount; i++)
+static constexpr ParamHashIndex buildHashIndex(const char *const (&names)[PARAMETER_TYPE_COUNT])
+{
+    ParamHashIndex index{};
+    for (uint32_t seed = 0; seed < 4096; seed++)
     {
-        if (strcmp(name, kParams[i].name) == 0)
+        bool collision = false;
+        for (uint8_t i = 0; i < PARAM_HASH_SLOTS; i++)
+        {
+            index.slots[i] = PARAM_HASH_EMPTY;
+        }
+        for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT && !collision; i++)
         {
-            return &kParams[i];
+            uint8_t slot = paramHashSlot(names[i], seed);
+            if (index.slots[slot] != PARAM_HASH_EMPTY)
+                collision = true;
+            index.slots[slot] = i;
+        }
+        if (!collision)
+        {
+            index.seed = seed;
+            return index;
         }
     }
-    return nullptr;
-}
\ No newline at end of file
+    index.seed = UINT32_MAX;
+    return index;
+}
+
+// Compile-time only: the literals never reach RAM
+#define PARAM_KEY_LITERAL_(id, ...) #id,
+#define PARAM_CLOUD_LITERAL_(id, cloud, ...) cloud,
+static constexpr const char *kKeyLiterals[] = {ECOWATT_PARAMS(PARAM_KEY_LITERAL_)};
+static constexpr const char *kCloudLiterals[] = {ECOWATT_PARAMS(PARAM_CLOUD_LITERAL_)};
+#undef PARAM_KEY_LITERAL_
+#undef PARAM_CLOUD_LITERAL_
+
+static constexpr ParamHashIndex kKeyIndex PROGMEM = buildHashIndex(kKeyLiterals);
+static constexpr ParamHashIndex kCloudIndex PROGMEM = buildHashIndex(kCloudLiterals);
+static_assert(kKeyIndex.seed != UINT32_MAX, "No collision-free seed for parameter keys; raise PARAM_HASH_SLOTS");
+static_assert(kCloudIndex.seed != UINT32_MAX, "No collision-free seed for cloud names; raise PARAM_HASH_SLOTS");
+
+static const ParamDesc *hashLookup(const ParamHashIndex &index, const char *name, bool key)
+{
+    if (!name)
+        return nullptr;
+    uint8_t i = pgm_read_byte(&index.slots[paramHashSlot(name, pgm_read_dword(&index.seed))]);
+    if (i == PARAM_HASH_EMPTY)
+        return nullptr;
+
+    // The slot holds the only possible match; confirm it
+    const ParamDesc *desc = &kParams[i];
+    if (key)
+        return strcasecmp_P(name, (PGM_P)pgm_read_ptr(&desc->key)) == 0 ? desc : nullptr;
+    return strcmp_P(name, (PGM_P)pgm_read_ptr(&desc->cloud)) == 0 ? desc : nullptr;
+}
+
+// ---- Lookups ---------------------------------------------------------------
+
+const ParamDesc *find_param(ParameterType id)
+{
+    uint8_t i = static_cast<uint8_t>(id);
+    return i < PARAMETER_TYPE_COUNT ? &kParams[i] : nullptr;
+}
+
+const ParamDesc *find_param_by_cloud_name(const char *name)
+{
+    return hashLookup(kCloudIndex, name, false);
+}
+
+const ParamDesc *find_param_by_key(const char *key)
+{
+    return hashLookup(kKeyIndex, key, true);
+}
+
+// Out-of-range ids fall back to neutral values so callers need no null checks
+PGM_P param_key(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? (PGM_P)pgm_read_ptr(&desc->key) : PSTR("UNKNOWN");
+}
+
+PGM_P param_cloud_name(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? (PGM_P)pgm_read_ptr(&desc->cloud) : PSTR("");
+}
+
+PGM_P param_name(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? (PGM_P)pgm_read_ptr(&desc->name) : PSTR("");
+}
+
+PGM_P param_unit(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? (PGM_P)pgm_read_ptr(&desc->unit) : PSTR("");
+}
+
+uint16_t param_reg(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? pgm_read_word(&desc->reg) : 0;
+}
+
+float param_scale(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? pgm_read_float(&desc->scale) : 1.0f;
+}
+
+float param_upload_scale(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc ? pgm_read_float(&desc->upload_scale) : 1.0f;
+}
+
+bool param_writable(ParameterType id)
+{
+    const ParamDesc *desc = find_param(id);
+    return desc && pgm_read_byte(&desc->writable);
+}
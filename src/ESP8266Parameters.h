@@ -4,22 +4,45 @@
 #include <Arduino.h>
 #include "ESP8266DataTypes.h"
 
-// Parameter descriptor structure
+// Parameter descriptor, generated from ECOWATT_PARAMS. The table and all of
+// its strings live in flash: read fields through pgm_read_* or the param_*
+// accessors below.
 struct ParamDesc
 {
-    ParameterType id;
-    const char *name;
+    const char *key;    // Enum identifier, e.g. "AC_VOLTAGE"; upload field name
+    const char *cloud;  // Register name used by config_update and commands
+    const char *name;   // Friendly name
     const char *unit;
     uint16_t reg;
-    float scale;
+    float scale;        // raw / scale = engineering units
+    float upload_scale; // engineering units * upload_scale = uploaded integer
+    bool writable;
 };
 
-// Global parameter descriptor table
+// Global parameter descriptor table, indexed by ParameterType
 extern const ParamDesc kParams[];
 extern const size_t kParamsCount;
 
-// Helper functions
+// O(1) enum lookup; nullptr for out-of-range ids
 const ParamDesc *find_param(ParameterType id);
-const ParamDesc *find_param_by_name(const char *name);
+// Perfect-hash name lookups; neither allocates. Keys match case-insensitively,
+// so "export_power_percent" finds EXPORT_POWER_PERCENT.
+const ParamDesc *find_param_by_cloud_name(const char *name);
+const ParamDesc *find_param_by_key(const char *key);
 
-#endif // ESP8266_PARAMETERS_H
\ No newline at end of file
+inline ParameterType param_id(const ParamDesc *desc)
+{
+    return static_cast<ParameterType>(desc - kParams);
+}
+
+// Field accessors; strings are PGM_P (usable with %s, strcmp_P and FPSTR)
+PGM_P param_key(ParameterType id);
+PGM_P param_cloud_name(ParameterType id);
+PGM_P param_name(ParameterType id);
+PGM_P param_unit(ParameterType id);
+uint16_t param_reg(ParameterType id);
+float param_scale(ParameterType id);
+float param_upload_scale(ParameterType id);
+bool param_writable(ParameterType id);
+
+#endif // ESP8266_PARAMETERS_H
@@ -0,0 +1,90 @@
+#include "ESP8266PollPlanner.h"
+#include "ESP8266Log.h"
+#include "ESP8266Parameters.h"
+
+ESP8266PollPlanner::ESP8266PollPlanner() : spanCount_(0), gapTolerance_(2), maxSpanRegs_(MODBUS_MAX_READ_REGS)
+{
+}
+
+void ESP8266PollPlanner::setMaxSpanRegs(uint8_t regs)
+{
+    if (regs == 0 || regs > MODBUS_MAX_READ_REGS)
+        regs = MODBUS_MAX_READ_REGS;
+    maxSpanRegs_ = regs;
+}
+
+void ESP8266PollPlanner::plan(const std::vector<ParameterType> &params)
+{
+    struct RegEntry
+    {
+        uint16_t reg;
+        ParameterType param;
+    };
+
+    // Resolve register addresses from the descriptor table
+    RegEntry entries[MAX_POLL_SPANS];
+    size_t count = 0;
+    for (ParameterType param : params)
+    {
+        if (!find_param(param) || count >= MAX_POLL_SPANS)
+            continue;
+        entries[count].reg = param_reg(param);
+        entries[count].param = param;
+        count++;
+    }
+
+    // Insertion sort by register address (at most MAX_POLL_SPANS entries)
+    for (size_t i = 1; i < count; i++)
+    {
+        RegEntry key = entries[i];
+        size_t j = i;
+        while (j > 0 && entries[j - 1].reg > key.reg)
+        {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = key;
+    }
+
+    // Greedily extend the current span while the next register is within the
+    // gap tolerance and the block stays under the size limit
+    spanCount_ = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const RegEntry &e = entries[i];
+        if (spanCount_ > 0)
+        {
+            PollSpan &cur = spans_[spanCount_ - 1];
+            uint16_t curEnd = cur.start_reg + cur.num_regs; // one past last register
+            if (e.reg < curEnd)
+            {
+                // Register already covered (shared register)
+                cur.param_mask |= paramBit(e.param);
+                continue;
+            }
+            uint16_t gap = e.reg - curEnd;
+            uint16_t newLen = e.reg - cur.start_reg + 1;
+            if (gap <= gapTolerance_ && newLen <= maxSpanRegs_)
+            {
+                cur.num_regs = newLen;
+                cur.param_mask |= paramBit(e.param);
+                continue;
+            }
+        }
+
+        PollSpan &next = spans_[spanCount_++];
+        next.start_reg = e.reg;
+        next.num_regs = 1;
+        next.param_mask = paramBit(e.param);
+    }
+}
+
+void ESP8266PollPlanner::printPlan() const
+{
+    LOG_I("PLANNER", "%u block read(s), gap tolerance %u regs", (unsigned)spanCount_, (unsigned)gapTolerance_);
+    for (size_t i = 0; i < spanCount_; i++)
+    {
+        LOG_I("PLANNER", "  - regs %u..%u (mask 0x%lX)", (unsigned)spans_[i].start_reg,
+              (unsigned)(spans_[i].start_reg + spans_[i].num_regs - 1), (unsigned long)spans_[i].param_mask);
+    }
+}
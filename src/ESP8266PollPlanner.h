@@ -0,0 +1,53 @@
+#ifndef ESP8266_POLL_PLANNER_H
+#define ESP8266_POLL_PLANNER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "ESP8266DataTypes.h"
+
+#define MAX_POLL_SPANS 10
+
+// One Modbus block read covering one or more enabled parameters
+struct PollSpan
+{
+    uint16_t start_reg;  // First register in the block
+    uint16_t num_regs;   // Number of registers to read (includes gap registers)
+    uint16_t param_mask; // Bit per ParameterType served by this block
+};
+
+// Groups enabled parameters from the kParams register map into the smallest
+// number of contiguous (or nearly contiguous) register spans so a poll cycle
+// costs one readRegisters() round trip per span instead of one per parameter.
+class ESP8266PollPlanner
+{
+public:
+    ESP8266PollPlanner();
+
+    // Registers that may be read and discarded to join two neighbouring spans
+    void setGapTolerance(uint8_t regs) { gapTolerance_ = regs; }
+    // Upper bound on registers per block (Modbus allows at most 125)
+    void setMaxSpanRegs(uint8_t regs);
+
+    uint8_t getGapTolerance() const { return gapTolerance_; }
+    uint8_t getMaxSpanRegs() const { return maxSpanRegs_; }
+
+    // Rebuild the plan for the given enabled parameters
+    void plan(const std::vector<ParameterType> &params);
+
+    size_t spanCount() const { return spanCount_; }
+    const PollSpan &span(size_t index) const { return spans_[index]; }
+
+    void printPlan() const;
+
+    static uint16_t paramBit(ParameterType param) { return (uint16_t)(1u << static_cast<uint8_t>(param)); }
+
+private:
+    PollSpan spans_[MAX_POLL_SPANS];
+    uint8_t spanCount_;
+    uint8_t gapTolerance_;
+    uint8_t maxSpanRegs_;
+
+    static const uint8_t MODBUS_MAX_READ_REGS = 125;
+};
+
+#endif // ESP8266_POLL_PLANNER_H
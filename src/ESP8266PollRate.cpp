@@ -0,0 +1,127 @@
+#include "ESP8266PollRate.h"
+#include "ESP8266PollPlanner.h"
+#include "ESP8266Log.h"
+
+ESP8266PollRate pollRate;
+
+// Values whose movement means the plant's output is changing
+static const ParameterType kTracked[] = {ParameterType::OUTPUT_POWER, ParameterType::AC_CURRENT,
+                                         ParameterType::PV1_CURRENT, ParameterType::PV2_CURRENT};
+
+ESP8266PollRate::ESP8266PollRate()
+    : adaptive_(false), base_(5000), min_(5000), max_(5000), interval_(5000), lastMask_(0), changeEwma_(0),
+      darkPolls_(0), changes_(0)
+{
+}
+
+void ESP8266PollRate::configure(const DeviceConfig &config)
+{
+    adaptive_ = config.adaptive_poll;
+    min_ = adaptive_ ? config.poll_min_ms : config.poll_interval_ms;
+    max_ = adaptive_ ? config.poll_max_ms : config.poll_interval_ms;
+    base_ = clamp(config.poll_interval_ms);
+    interval_ = base_;
+    lastMask_ = 0;
+    changeEwma_ = 0;
+    darkPolls_ = 0;
+}
+
+uint16_t ESP8266PollRate::clamp(uint32_t ms) const
+{
+    if (ms < min_)
+        return min_;
+    if (ms > max_)
+        return max_;
+    return (uint16_t)ms;
+}
+
+bool ESP8266PollRate::update(const Sample &sample)
+{
+    if (!adaptive_)
+        return false;
+
+    // Largest relative step of any tracked value since the last poll
+    uint32_t change = 0;
+    for (ParameterType param : kTracked)
+    {
+        if (!sample.hasValue(param))
+            continue;
+        uint16_t bit = ESP8266PollPlanner::paramBit(param);
+        float value = sample.getValue(param);
+        float &last = last_[static_cast<uint8_t>(param)];
+        if (lastMask_ & bit)
+        {
+            float base = fabsf(last) > POLL_RATE_CHANGE_FLOOR ? fabsf(last) : POLL_RATE_CHANGE_FLOOR;
+            uint32_t permille = (uint32_t)(fabsf(value - last) * 1000.0f / base);
+            if (permille > change)
+                change = permille;
+        }
+        last = value;
+        lastMask_ |= bit;
+    }
+    if (change > 1000)
+        change = 1000;
+    changeEwma_ = (uint16_t)((changeEwma_ * 3u + change) / 4u);
+
+    // Dark PV input (only when the PV channels are polled)
+    bool wasNight = night();
+    if (sample.hasValue(ParameterType::PV1_VOLTAGE) && sample.hasValue(ParameterType::PV1_CURRENT))
+    {
+        float pvW = sample.getValue(ParameterType::PV1_VOLTAGE) * sample.getValue(ParameterType::PV1_CURRENT);
+        if (sample.hasValue(ParameterType::PV2_VOLTAGE) && sample.hasValue(ParameterType::PV2_CURRENT))
+            pvW += sample.getValue(ParameterType::PV2_VOLTAGE) * sample.getValue(ParameterType::PV2_CURRENT);
+        if (pvW >= POLL_RATE_NIGHT_PV_W)
+            darkPolls_ = 0;
+        else if (darkPolls_ < POLL_RATE_NIGHT_SAMPLES)
+            darkPolls_++;
+    }
+
+    uint32_t next;
+    if (night())
+        next = max_;
+    else if (wasNight)
+        next = base_; // Sunrise: straight back to the baseline
+    else if (changeEwma_ >= POLL_RATE_FAST_PERMILLE)
+        next = interval_ / 2;
+    else if (changeEwma_ <= POLL_RATE_QUIET_PERMILLE)
+        next = (uint32_t)interval_ + interval_ / 4;
+    else if (interval_ < base_)
+        next = interval_ + interval_ / 4 < base_ ? interval_ + interval_ / 4 : base_; // Drift back up
+    else
+        next = interval_ - interval_ / 4 > base_ ? interval_ - interval_ / 4 : base_; // Drift back down
+    next = clamp(next);
+
+    if (next == interval_)
+        return false;
+    LOG_I("POLL", "Poll interval %u -> %u ms (change %u permille%s)", interval_, (unsigned)next, changeEwma_,
+          night() ? ", PV dark" : "");
+    interval_ = (uint16_t)next;
+    changes_++;
+    return true;
+}
+
+void ESP8266PollRate::printStatus() const
+{
+    Serial.print("Poll Rate: ");
+    if (!adaptive_)
+    {
+        Serial.print("fixed ");
+        Serial.print(interval_);
+        Serial.println(" ms");
+        return;
+    }
+    Serial.print("adaptive ");
+    Serial.print(interval_);
+    Serial.print(" ms (");
+    Serial.print(min_);
+    Serial.print("-");
+    Serial.print(max_);
+    Serial.print(", base ");
+    Serial.print(base_);
+    Serial.print("), change ");
+    Serial.print(changeEwma_);
+    Serial.print(" permille, ");
+    Serial.print(night() ? "PV dark, " : "");
+    Serial.print(changes_);
+    Serial.println(" changes");
+}
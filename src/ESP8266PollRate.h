@@ -0,0 +1,54 @@
+#ifndef ESP8266_POLL_RATE_H
+#define ESP8266_POLL_RATE_H
+
+#include <Arduino.h>
+#include "ESP8266Config.h"
+#include "ESP8266DataTypes.h"
+
+#define POLL_RATE_FAST_PERMILLE 30  // Smoothed change per poll that halves the interval
+#define POLL_RATE_QUIET_PERMILLE 5  // Below this the interval stretches by a quarter
+#define POLL_RATE_NIGHT_PV_W 5.0f   // PV input below this counts as dark
+#define POLL_RATE_NIGHT_SAMPLES 3   // Consecutive dark polls before the night rate
+#define POLL_RATE_CHANGE_FLOOR 1.0f // Engineering units; keeps near-zero values from looking jumpy
+
+// Adaptive poll interval. Each primary sample updates a smoothed relative
+// change of the power-carrying values (output power, AC current, PV
+// currents). Fast movement halves the interval towards poll_min_ms, a quiet
+// signal stretches it towards poll_max_ms, anything in between drifts back
+// to poll_interval_ms. While PV input stays dark the interval sits at
+// poll_max_ms, and the first lit sample returns it to the baseline. With
+// adaptive polling off the interval is poll_interval_ms.
+class ESP8266PollRate
+{
+public:
+    ESP8266PollRate();
+
+    void configure(const DeviceConfig &config);
+
+    // Feed one primary sample; true when the interval changed
+    bool update(const Sample &sample);
+
+    uint16_t interval() const { return interval_; }
+    bool adaptive() const { return adaptive_; }
+    bool night() const { return darkPolls_ >= POLL_RATE_NIGHT_SAMPLES; }
+    void printStatus() const;
+
+private:
+    bool adaptive_;
+    uint16_t base_;
+    uint16_t min_;
+    uint16_t max_;
+    uint16_t interval_;
+
+    float last_[PARAMETER_TYPE_COUNT];
+    uint16_t lastMask_;     // Tracked parameters with a previous value
+    uint16_t changeEwma_;   // Per mille, smoothed over about four polls
+    uint8_t darkPolls_;
+    uint32_t changes_;
+
+    uint16_t clamp(uint32_t ms) const;
+};
+
+extern ESP8266PollRate pollRate;
+
+#endif // ESP8266_POLL_RATE_H
@@ -1,48 +1,86 @@
 #include "ESP8266PollingConfig.h"
+#include "ESP8266Log.h"
 #include "ESP8266Inverter.h"
 #include "ESP8266Parameters.h"
 
-ESP8266PollingConfig::ESP8266PollingConfig()
+ESP8266PollingConfig::ESP8266PollingConfig() : slaveCount_(1)
 {
+    addresses_[0] = 0x11;
+    masks_[0] = 0;
 }
 
 void ESP8266PollingConfig::setParameters(const std::vector<ParameterType> &params)
 {
     enabledParameters_ = params;
+    masks_[0] = 0;
+    for (ParameterType param : params)
+    {
+        masks_[0] |= ESP8266PollPlanner::paramBit(param);
+    }
+    planners_[0].plan(enabledParameters_);
+}
+
+void ESP8266PollingConfig::setBlockReadLimits(uint8_t gapTolerance, uint8_t maxSpanRegs)
+{
+    for (uint8_t i = 0; i < MAX_SLAVES; i++)
+    {
+        planners_[i].setGapTolerance(gapTolerance);
+        planners_[i].setMaxSpanRegs(maxSpanRegs);
+    }
+    planners_[0].plan(enabledParameters_);
+    for (uint8_t i = 1; i < slaveCount_; i++)
+    {
+        planSlave(i);
+    }
 }
 
-String ESP8266PollingConfig::getParameterName(ParameterType param) const
+void ESP8266PollingConfig::setSlaves(uint8_t primaryAddress, const SlaveConfig *extra, uint8_t extraCount)
 {
-    const ParamDesc *desc = find_param(param);
-    if (desc)
+    if (extraCount > MAX_SLAVES - 1)
+        extraCount = MAX_SLAVES - 1;
+    addresses_[0] = primaryAddress;
+    slaveCount_ = 1 + extraCount;
+    for (uint8_t i = 1; i < slaveCount_; i++)
     {
-        const char *name_ptr = reinterpret_cast<const char *>(pgm_read_ptr(&desc->name));
-        return String(reinterpret_cast<const __FlashStringHelper *>(name_ptr));
+        addresses_[i] = extra[i - 1].address;
+        masks_[i] = extra[i - 1].param_mask;
+        planSlave(i);
     }
-    return String("");
 }
 
-String ESP8266PollingConfig::getParameterUnit(ParameterType param) const
+void ESP8266PollingConfig::planSlave(uint8_t slave)
 {
-    const ParamDesc *desc = find_param(param);
-    if (desc)
+    std::vector<ParameterType> params;
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
     {
-        const char *unit_ptr = reinterpret_cast<const char *>(pgm_read_ptr(&desc->unit));
-        return String(reinterpret_cast<const __FlashStringHelper *>(unit_ptr));
+        if (masks_[slave] & (1u << i))
+            params.push_back(static_cast<ParameterType>(i));
     }
-    return String("");
+    planners_[slave].plan(params);
+}
+
+PGM_P ESP8266PollingConfig::getParameterName(ParameterType param) const
+{
+    return param_name(param);
+}
+
+PGM_P ESP8266PollingConfig::getParameterUnit(ParameterType param) const
+{
+    return param_unit(param);
 }
 
 void ESP8266PollingConfig::printEnabledParameters() const
 {
-    Serial.println("[POLLING] Enabled parameters:");
+    LOG_I("POLLING", "Enabled parameters:");
     for (ParameterType param : enabledParameters_)
     {
-        String name = getParameterName(param);
-        String unit = getParameterUnit(param);
-        Serial.print("  - ");
-        Serial.print(name);
-        Serial.println(unit);
+        LOG_I("POLLING", "  - %s (%s)", getParameterName(param), getParameterUnit(param));
+    }
+    planners_[0].printPlan();
+    for (uint8_t i = 1; i < slaveCount_; i++)
+    {
+        LOG_I("POLLING", "Slave 0x%02X: mask 0x%04X", addresses_[i], masks_[i]);
+        planners_[i].printPlan();
     }
 }
 
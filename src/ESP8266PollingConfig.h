@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include <vector>
 #include "ESP8266DataTypes.h"
+#include "ESP8266PollPlanner.h"
+#include "ESP8266Config.h"
 
 class ESP8266Inverter; // Forward declaration
 
@@ -15,15 +17,34 @@ public:
     void setParameters(const std::vector<ParameterType> &params);
     const std::vector<ParameterType> &getEnabledParameters() const { return enabledParameters_; }
 
-    // Get parameter name and unit from descriptor table
-    String getParameterName(ParameterType param) const;
-    String getParameterUnit(ParameterType param) const;
+    // Block-read plan for the enabled parameters (rebuilt on every change)
+    void setBlockReadLimits(uint8_t gapTolerance, uint8_t maxSpanRegs);
+    const ESP8266PollPlanner &getPollPlan() const { return planners_[0]; }
+
+    // Slave 0 is the primary inverter (enabled parameters above); further
+    // inverters behind the same gateway follow with their own parameter sets
+    // and plans. Sample::slave indexes this list.
+    void setSlaves(uint8_t primaryAddress, const SlaveConfig *extra, uint8_t extraCount);
+    uint8_t slaveCount() const { return slaveCount_; }
+    uint8_t slaveAddress(uint8_t slave) const { return slave < slaveCount_ ? addresses_[slave] : 0; }
+    uint16_t slaveParamMask(uint8_t slave) const { return slave < slaveCount_ ? masks_[slave] : 0; }
+    const ESP8266PollPlanner &slavePlan(uint8_t slave) const { return planners_[slave]; }
+
+    // Get parameter name and unit from descriptor table (flash strings)
+    PGM_P getParameterName(ParameterType param) const;
+    PGM_P getParameterUnit(ParameterType param) const;
 
     void printEnabledParameters() const;
     bool isParameterEnabled(ParameterType param) const;
 
 private:
     std::vector<ParameterType> enabledParameters_;
+    ESP8266PollPlanner planners_[MAX_SLAVES];
+    uint8_t addresses_[MAX_SLAVES];
+    uint16_t masks_[MAX_SLAVES];
+    uint8_t slaveCount_;
+
+    void planSlave(uint8_t slave);
 };
 
 #endif // ESP8266_POLLING_CONFIG_H
\ No newline at end of file
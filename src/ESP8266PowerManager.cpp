@@ -0,0 +1,132 @@
+#include "ESP8266PowerManager.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266Log.h"
+
+ESP8266PowerManager powerManager;
+
+#define POWER_HOUR_MS 3600000UL
+
+ESP8266PowerManager::ESP8266PowerManager()
+    : mode_(POWER_MODE_ALWAYS_ON), asleep_(false), cacheValid_(false), fastAttempt_(false), wakePending_(false),
+      channel_(0), connectStartedAt_(0), lastTickAt_(0), hourStartedAt_(0), onMsPending_(0), hourS_(0),
+      lastHourS_(0), sleeps_(0), fastConnects_(0)
+{
+}
+
+void ESP8266PowerManager::begin(uint8_t mode)
+{
+    // Every reconnect calls WiFi.begin(); keep the SDK from rewriting the
+    // credentials in flash each time
+    WiFi.persistent(false);
+    lastTickAt_ = millis();
+    hourStartedAt_ = lastTickAt_;
+    setMode(mode);
+}
+
+void ESP8266PowerManager::setMode(uint8_t mode)
+{
+    mode_ = mode == POWER_MODE_SAVE ? POWER_MODE_SAVE : POWER_MODE_ALWAYS_ON;
+    if (saving())
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP, POWER_LISTEN_INTERVAL);
+    else
+        WiFi.setSleepMode(WIFI_MODEM_SLEEP); // SDK default: wake for every beacon
+    LOG_I("POWER", "Power mode: %s", saving() ? "save" : "always on");
+}
+
+void ESP8266PowerManager::connect(const WiFiConfig &wifi)
+{
+    fastAttempt_ = cacheValid_;
+    connectStartedAt_ = millis();
+    if (fastAttempt_)
+    {
+        WiFi.begin(wifi.ssid, wifi.password, channel_, bssid_);
+        fastConnects_++;
+    }
+    else
+    {
+        WiFi.begin(wifi.ssid, wifi.password);
+    }
+}
+
+void ESP8266PowerManager::noteConnected()
+{
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid)
+    {
+        memcpy(bssid_, bssid, sizeof(bssid_));
+        channel_ = WiFi.channel();
+        cacheValid_ = true;
+    }
+    fastAttempt_ = false;
+    wakePending_ = false;
+}
+
+void ESP8266PowerManager::sleep()
+{
+    if (asleep_)
+        return;
+    tick(); // Count the awake time up to here
+    WiFi.disconnect();
+    WiFi.forceSleepBegin();
+    delay(1); // Lets the SDK act on the request
+    asleep_ = true;
+    sleeps_++;
+    LOG_D("POWER", "Radio off");
+}
+
+void ESP8266PowerManager::wake(const WiFiConfig &wifi)
+{
+    if (!asleep_)
+        return;
+    tick(); // Asleep until here
+    WiFi.forceSleepWake();
+    delay(1);
+    WiFi.mode(WIFI_STA);
+    asleep_ = false;
+    wakePending_ = true;
+    connect(wifi);
+    LOG_D("POWER", "Radio on, reconnecting%s", fastAttempt_ ? " to cached AP" : "");
+}
+
+bool ESP8266PowerManager::waking() const
+{
+    return wakePending_ && WiFi.status() != WL_CONNECTED && millis() - connectStartedAt_ < POWER_FAST_CONNECT_MS;
+}
+
+void ESP8266PowerManager::tick()
+{
+    unsigned long now = millis();
+    if (!asleep_)
+        onMsPending_ += now - lastTickAt_;
+    lastTickAt_ = now;
+
+    uint32_t seconds = onMsPending_ / 1000;
+    if (seconds > 0)
+    {
+        onMsPending_ -= seconds * 1000;
+        hourS_ += seconds;
+        metrics.count(MetricCounter::RADIO_ON_S, seconds);
+    }
+    if (now - hourStartedAt_ >= POWER_HOUR_MS)
+    {
+        lastHourS_ = hourS_;
+        hourS_ = 0;
+        hourStartedAt_ += POWER_HOUR_MS;
+    }
+}
+
+void ESP8266PowerManager::printStatus() const
+{
+    Serial.print("Power: ");
+    Serial.print(saving() ? "save" : "always on");
+    Serial.print(asleep_ ? ", radio off" : ", radio on");
+    Serial.print(", on ");
+    Serial.print(hourS_);
+    Serial.print(" s this hour (last hour ");
+    Serial.print(lastHourS_);
+    Serial.print(" s), ");
+    Serial.print(sleeps_);
+    Serial.print(" sleeps, ");
+    Serial.print(fastConnects_);
+    Serial.println(" cached-AP connects");
+}
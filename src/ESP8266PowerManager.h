@@ -0,0 +1,77 @@
+#ifndef ESP8266_POWER_MANAGER_H
+#define ESP8266_POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "ESP8266Config.h"
+
+#define POWER_MODE_ALWAYS_ON 0 // Radio associated and awake (SDK default)
+#define POWER_MODE_SAVE 1      // Modem sleep, batched network windows, radio off in long gaps
+
+#define POWER_CHECK_INTERVAL_MS 250   // Period of the power job
+#define POWER_SLEEP_MIN_GAP_MS 20000  // Radio off only when the next activity is at least this far
+#define POWER_WAKE_LEAD_MS 3000       // Wake this long before the next poll or upload window
+#define POWER_FAST_CONNECT_MS 4000    // Cached BSSID/channel attempt before a full scan
+#define POWER_LISTEN_INTERVAL 3       // DTIM beacons skipped in modem sleep
+
+// Radio power control. In save mode the modem sleeps between beacons while
+// associated, and the power job turns the radio off entirely across gaps
+// long enough to be worth a reconnect. Reconnects go straight to the cached
+// BSSID and channel instead of scanning; a cached attempt that fails falls
+// back to a full WiFi.begin(). Radio-on time is accounted in whole seconds,
+// per clock hour and into the radio_on_s metrics counter.
+class ESP8266PowerManager
+{
+public:
+    ESP8266PowerManager();
+
+    void begin(uint8_t mode);
+    void setMode(uint8_t mode);
+    uint8_t mode() const { return mode_; }
+    bool saving() const { return mode_ == POWER_MODE_SAVE; }
+
+    // WiFi.begin(), using the cached access point when there is one
+    void connect(const WiFiConfig &wifi);
+    // Remember the access point of the link that just came up
+    void noteConnected();
+    // The last connect() went to the cached access point and has not come up;
+    // give it POWER_FAST_CONNECT_MS before trying again
+    bool fastAttempt() const { return fastAttempt_; }
+    // The cached access point did not answer; scan next time
+    void forgetAccessPoint() { cacheValid_ = false; }
+
+    void sleep();
+    void wake(const WiFiConfig &wifi);
+    bool asleep() const { return asleep_; }
+    // A wake-up reconnect is still within its fast-connect time
+    bool waking() const;
+    // Network work should wait: the radio is off or still coming back up
+    bool linkPending() const { return asleep_ || waking(); }
+
+    // Fold elapsed radio-on time into the counters; call periodically
+    void tick();
+    uint32_t radioOnLastHourS() const { return lastHourS_; }
+    void printStatus() const;
+
+private:
+    uint8_t mode_;
+    bool asleep_;
+    bool cacheValid_;
+    bool fastAttempt_;
+    bool wakePending_;
+    uint8_t bssid_[6];
+    int32_t channel_;
+    unsigned long connectStartedAt_;
+
+    unsigned long lastTickAt_;
+    unsigned long hourStartedAt_;
+    uint32_t onMsPending_; // Radio-on time not yet counted as whole seconds
+    uint32_t hourS_;       // Radio-on seconds in the running hour
+    uint32_t lastHourS_;
+    uint32_t sleeps_;
+    uint32_t fastConnects_;
+};
+
+extern ESP8266PowerManager powerManager;
+
+#endif // ESP8266_POWER_MANAGER_H
@@ -1,6 +1,7 @@
 #include "ESP8266ProtocolAdapter.h"
+#include "ESP8266Log.h"
 
-ESP8266ProtocolAdapter::ESP8266ProtocolAdapter() : lastConnectionCheck_(0)
+ESP8266ProtocolAdapter::ESP8266ProtocolAdapter() : http_("gateway")
 {
 }
 
@@ -13,8 +14,7 @@ bool ESP8266ProtocolAdapter::connectWiFi()
 {
     const WiFiConfig &wifiConfig = configManager.getWiFiConfig();
 
-    Serial.print("[WiFi] Connecting to ");
-    Serial.println(wifiConfig.ssid);
+    LOG_I("WiFi", "Connecting to %s", wifiConfig.ssid);
 
     WiFi.hostname(wifiConfig.hostname);
     WiFi.begin(wifiConfig.ssid, wifiConfig.password);
@@ -24,54 +24,62 @@ bool ESP8266ProtocolAdapter::connectWiFi()
     while (WiFi.status() != WL_CONNECTED && millis() - startTime < 15000)
     {
         delay(500);
-        Serial.print(".");
     }
 
     if (WiFi.status() == WL_CONNECTED)
     {
-        Serial.println();
-        Serial.print("[WiFi] Connected! IP address: ");
-        Serial.println(WiFi.localIP());
+        LOG_I("WiFi", "Connected! IP address: %s", WiFi.localIP().toString().c_str());
         return true;
     }
     else
     {
-        Serial.println();
-        Serial.println("[WiFi] Connection failed!");
+        LOG_E("WiFi", "Connection failed!");
         return false;
     }
 }
 
-bool ESP8266ProtocolAdapter::sendReadRequest(const String &frameHex, String &outFrameHex)
+bool ESP8266ProtocolAdapter::ensureConnected()
 {
-    // Check connection periodically
-    if (millis() - lastConnectionCheck_ > CONNECTION_CHECK_INTERVAL)
-    {
-        if (!isConnected())
-        {
-            Serial.println("[WiFi] Connection lost, attempting reconnect...");
-            connectWiFi();
-        }
-        lastConnectionCheck_ = millis();
-    }
-
+    // Reconnection is handled by the scheduler's wifi job; never block a poll here
     if (!isConnected())
     {
-        Serial.println("[HTTP] WiFi not connected");
+        LOG_W("HTTP", "WiFi not connected");
         return false;
     }
+    return true;
+}
+
+bool ESP8266ProtocolAdapter::sendReadRequest(const String &frameHex, String &outFrameHex)
+{
+    if (!ensureConnected())
+        return false;
 
     const APIConfig &apiConfig = configManager.getAPIConfig();
     return postJSON(apiConfig.read_url, frameHex, outFrameHex);
 }
 
+bool ESP8266ProtocolAdapter::sendReadFrame(const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength)
+{
+    if (!ensureConnected())
+        return false;
+
+    const APIConfig &apiConfig = configManager.getAPIConfig();
+    return postBinary(apiConfig.read_url, frame, length, reply, replyCapacity, replyLength);
+}
+
+bool ESP8266ProtocolAdapter::sendWriteFrame(const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength)
+{
+    if (!ensureConnected())
+        return false;
+
+    const APIConfig &apiConfig = configManager.getAPIConfig();
+    return postBinary(apiConfig.write_url, frame, length, reply, replyCapacity, replyLength);
+}
+
 bool ESP8266ProtocolAdapter::sendWriteRequest(const String &frameHex, String &outFrameHex)
 {
-    if (!isConnected())
-    {
-        Serial.println("[HTTP] WiFi not connected");
+    if (!ensureConnected())
         return false;
-    }
 
     const APIConfig &apiConfig = configManager.getAPIConfig();
     return postJSON(apiConfig.write_url, frameHex, outFrameHex);
@@ -81,10 +89,6 @@ bool ESP8266ProtocolAdapter::postJSON(const String &url, const String &frameHex,
 {
     const APIConfig &apiConfig = configManager.getAPIConfig();
 
-    httpClient_.begin(wifiClient_, url);
-    setupHTTPHeaders(httpClient_);
-    httpClient_.setTimeout(apiConfig.timeout_ms);
-
     // Create JSON payload
     StaticJsonDocument<512> jsonDoc;
     jsonDoc["frame"] = frameHex;
@@ -92,20 +96,23 @@ bool ESP8266ProtocolAdapter::postJSON(const String &url, const String &frameHex,
     String payload;
     serializeJson(jsonDoc, payload);
 
-    Serial.print("[HTTP] POST to: ");
-    Serial.println(url);
-    Serial.print("[HTTP] Payload: ");
-    Serial.println(payload);
+    LOG_D("HTTP", "POST to: %s", url.c_str());
+    LOG_V("HTTP", "Payload: %s", payload.c_str());
 
-    int httpResponseCode = httpClient_.POST(payload);
+    // A poll needs the reply before it can continue, so wait on the gateway
+    // channel; uploads and config requests keep running on theirs
+    int httpResponseCode = HTTPC_ERROR_NOT_CONNECTED;
+    if (http_.start(url, "application/json", reinterpret_cast<const uint8_t *>(payload.c_str()), payload.length(),
+                    apiConfig.timeout_ms, apiConfig.api_key))
+    {
+        httpResponseCode = http_.wait();
+    }
+    const String &response = http_.response();
 
     if (httpResponseCode > 0)
     {
-        String response = httpClient_.getString();
-        Serial.print("[HTTP] Response code: ");
-        Serial.println(httpResponseCode);
-        Serial.print("[HTTP] Response: ");
-        Serial.println(response);
+        LOG_D("HTTP", "Response code: %d", httpResponseCode);
+        LOG_V("HTTP", "Response: %s", response.c_str());
 
         if (httpResponseCode == HTTP_CODE_OK)
         {
@@ -115,44 +122,54 @@ bool ESP8266ProtocolAdapter::postJSON(const String &url, const String &frameHex,
 
             if (error)
             {
-                Serial.print("[HTTP] JSON parsing failed: ");
-                Serial.println(error.c_str());
-                httpClient_.end();
+                LOG_E("HTTP", "JSON parsing failed: %s", error.c_str());
                 return false;
             }
 
             if (responseDoc.containsKey("frame"))
             {
                 outFrameHex = responseDoc["frame"].as<String>();
-                httpClient_.end();
                 return true;
             }
             else
             {
-                Serial.println("[HTTP] Response missing 'frame' field");
+                LOG_E("HTTP", "Response missing 'frame' field");
             }
         }
     }
     else
     {
-        Serial.print("[HTTP] Error: ");
-        Serial.println(httpClient_.errorToString(httpResponseCode));
+        LOG_E("HTTP", "Error: %s", HTTPClient::errorToString(httpResponseCode).c_str());
     }
 
-    httpClient_.end();
     return false;
 }
 
-void ESP8266ProtocolAdapter::setupHTTPHeaders(HTTPClient &client)
+bool ESP8266ProtocolAdapter::postBinary(const String &url, const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength)
 {
     const APIConfig &apiConfig = configManager.getAPIConfig();
 
-    client.addHeader("Content-Type", "application/json");
-    client.addHeader("Accept", "application/json");
+    replyLength = 0;
+    int httpResponseCode = HTTPC_ERROR_NOT_CONNECTED;
+    http_.setResponseBuffer(reply, replyCapacity);
+    if (http_.start(url, "application/octet-stream", frame, length, apiConfig.timeout_ms, apiConfig.api_key))
+    {
+        httpResponseCode = http_.wait();
+        replyLength = http_.responseLength();
+    }
+
+    if (httpResponseCode == HTTP_CODE_OK)
+    {
+        return replyLength > 0;
+    }
 
-    if (strlen(apiConfig.api_key) > 0)
+    if (httpResponseCode > 0)
     {
-        String authHeader = "Bearer " + String(apiConfig.api_key);
-        client.addHeader("Authorization", authHeader);
+        LOG_E("HTTP", "Binary frame response code: %d", httpResponseCode);
     }
-}
\ No newline at end of file
+    else
+    {
+        LOG_E("HTTP", "Error: %s", HTTPClient::errorToString(httpResponseCode).c_str());
+    }
+    return false;
+}
@@ -7,6 +7,7 @@
 #include <WiFiClient.h>
 #include <ArduinoJson.h>
 #include "ESP8266Config.h"
+#include "ESP8266AsyncHttp.h"
 
 class ESP8266ProtocolAdapter
 {
@@ -17,18 +18,21 @@ public:
     bool sendReadRequest(const String &frameHex, String &outFrameHex);
     bool sendWriteRequest(const String &frameHex, String &outFrameHex);
 
+    // Binary transport: raw RTU frame out, raw reply into a caller-provided buffer
+    bool sendReadFrame(const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength);
+    bool sendWriteFrame(const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength);
+    bool usesBinaryTransport() const { return configManager.getAPIConfig().modbus_transport == MODBUS_TRANSPORT_BINARY; }
+
     bool isConnected() const { return WiFi.status() == WL_CONNECTED; }
 
 private:
-    HTTPClient httpClient_;
-    WiFiClient wifiClient_;
-
     bool postJSON(const String &url, const String &frameHex, String &outFrameHex);
+    bool postBinary(const String &url, const uint8_t *frame, size_t length, uint8_t *reply, size_t replyCapacity, size_t &replyLength);
+    bool ensureConnected();
     bool connectWiFi();
-    void setupHTTPHeaders(HTTPClient &client);
 
-    unsigned long lastConnectionCheck_;
-    static const unsigned long CONNECTION_CHECK_INTERVAL = 30000; // 30 seconds
+    // Gateway requests share one kept-alive channel of their own
+    ESP8266AsyncHttp http_;
 };
 
 #endif // ESP8266_PROTOCOL_ADAPTER_H
\ No newline at end of file
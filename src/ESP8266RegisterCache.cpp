@@ -0,0 +1,171 @@
+#include "ESP8266RegisterCache.h"
+#include "ESP8266ModbusHandler.h"
+#include "ESP8266Parameters.h"
+#include "ESP8266PollRate.h"
+
+ESP8266RegisterCache registerCache;
+
+ESP8266RegisterCache::ESP8266RegisterCache() : hits_(0), misses_(0), invalidations_(0)
+{
+    clear();
+}
+
+void ESP8266RegisterCache::clear()
+{
+    for (Entry &entry : entries_)
+        entry.valid = false;
+}
+
+uint32_t ESP8266RegisterCache::ttlMs(uint16_t reg)
+{
+    uint32_t interval = pollRate.interval();
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        ParameterType id = static_cast<ParameterType>(i);
+        if (param_reg(id) == reg && param_writable(id))
+            return interval * REGISTER_CACHE_SETPOINT_TTL_POLLS;
+    }
+    return interval;
+}
+
+bool ESP8266RegisterCache::cacheable(uint16_t reg)
+{
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        if (param_reg(static_cast<ParameterType>(i)) == reg)
+            return true;
+    }
+    return false;
+}
+
+void ESP8266RegisterCache::fetchRange(uint16_t start, uint16_t count, uint16_t &fetchStart, uint16_t &fetchCount)
+{
+    uint16_t lowest = 0xFFFF;
+    uint16_t highest = 0;
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        uint16_t reg = param_reg(static_cast<ParameterType>(i));
+        lowest = reg < lowest ? reg : lowest;
+        highest = reg > highest ? reg : highest;
+    }
+
+    uint16_t end = start + count - 1;
+    uint16_t blockStart = start - start % REGISTER_CACHE_BLOCK_REGS;
+    uint16_t blockEnd = blockStart + REGISTER_CACHE_BLOCK_REGS - 1;
+    uint16_t mapStart = blockStart > lowest ? blockStart : lowest;
+    uint16_t mapEnd = blockEnd < highest ? blockEnd : highest;
+
+    // Widen the request over the known registers of its block, never past
+    // the register map and never beyond one read
+    fetchStart = start;
+    uint16_t fetchEnd = end;
+    if (mapStart <= mapEnd)
+    {
+        fetchStart = mapStart < start ? mapStart : start;
+        fetchEnd = mapEnd > end ? mapEnd : end;
+    }
+    if (fetchEnd - fetchStart + 1 > ESP8266ModbusHandler::MAX_READ_REGS)
+    {
+        fetchStart = start;
+        fetchEnd = end;
+    }
+    fetchCount = fetchEnd - fetchStart + 1;
+}
+
+ESP8266RegisterCache::Entry *ESP8266RegisterCache::find(uint8_t slave, uint16_t reg)
+{
+    for (Entry &entry : entries_)
+    {
+        if (entry.valid && entry.slave == slave && entry.reg == reg)
+            return &entry;
+    }
+    return nullptr;
+}
+
+ESP8266RegisterCache::Entry *ESP8266RegisterCache::slotFor(uint8_t slave, uint16_t reg)
+{
+    Entry *existing = find(slave, reg);
+    if (existing)
+        return existing;
+
+    // A free slot, then an expired entry, otherwise the oldest one
+    Entry *expired = nullptr;
+    Entry *oldest = &entries_[0];
+    uint32_t now = millis();
+    for (Entry &entry : entries_)
+    {
+        if (!entry.valid)
+            return &entry;
+        if (!expired && now - entry.storedAt >= ttlMs(entry.reg))
+            expired = &entry;
+        if (now - entry.storedAt > now - oldest->storedAt)
+            oldest = &entry;
+    }
+    return expired ? expired : oldest;
+}
+
+void ESP8266RegisterCache::store(uint8_t slave, uint16_t start, const uint16_t *values, uint16_t count)
+{
+    uint32_t now = millis();
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (!cacheable(start + i))
+            continue;
+        Entry *entry = slotFor(slave, start + i);
+        entry->storedAt = now;
+        entry->reg = start + i;
+        entry->value = values[i];
+        entry->slave = slave;
+        entry->valid = true;
+    }
+}
+
+bool ESP8266RegisterCache::lookup(uint8_t slave, uint16_t start, uint16_t count, uint16_t *values)
+{
+    uint32_t now = millis();
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint16_t reg = start + i;
+        Entry *entry = find(slave, reg);
+        if (!entry || now - entry->storedAt >= ttlMs(reg))
+        {
+            misses_++;
+            return false;
+        }
+        values[i] = entry->value;
+    }
+    hits_++;
+    return true;
+}
+
+void ESP8266RegisterCache::invalidate(uint8_t slave, uint16_t start, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        Entry *entry = find(slave, start + i);
+        if (entry)
+        {
+            entry->valid = false;
+            invalidations_++;
+        }
+    }
+}
+
+void ESP8266RegisterCache::printStatus() const
+{
+    uint8_t used = 0;
+    for (const Entry &entry : entries_)
+        used += entry.valid ? 1 : 0;
+
+    Serial.print("Register cache: ");
+    Serial.print(used);
+    Serial.print("/");
+    Serial.print(REGISTER_CACHE_SIZE);
+    Serial.print(" entries, ");
+    Serial.print(hits_);
+    Serial.print(" hits, ");
+    Serial.print(misses_);
+    Serial.print(" misses, ");
+    Serial.print(invalidations_);
+    Serial.println(" invalidated");
+}
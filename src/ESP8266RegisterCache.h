@@ -0,0 +1,66 @@
+#ifndef ESP8266_REGISTER_CACHE_H
+#define ESP8266_REGISTER_CACHE_H
+
+#include <Arduino.h>
+#include "ESP8266Config.h"
+#include "ESP8266DataTypes.h"
+
+// One entry per parameter register of every slave, so a full poll cycle of
+// all inverters never evicts. Registers outside the parameter table, such as
+// those a span bridges over, are not cached.
+#define REGISTER_CACHE_SIZE (MAX_SLAVES * PARAMETER_TYPE_COUNT)
+#define REGISTER_CACHE_BLOCK_REGS 16       // A miss fetches the aligned block of this many registers
+#define REGISTER_CACHE_SETPOINT_TTL_POLLS 12 // Writable registers only change through writes
+
+// Read-through cache of raw register values keyed by (Modbus address,
+// register). Every successful span read of the poller is stored, so a
+// diagnostic or command that lands between two polls is answered without
+// another gateway round trip. A measurement stays fresh for one poll
+// interval; a writable register for REGISTER_CACHE_SETPOINT_TTL_POLLS
+// intervals, since writes through ESP8266Inverter invalidate it. When the
+// table is full an expired entry is replaced first, else the oldest.
+class ESP8266RegisterCache
+{
+public:
+    ESP8266RegisterCache();
+
+    // Store values[0..count-1] read from consecutive registers
+    void store(uint8_t slave, uint16_t start, const uint16_t *values, uint16_t count);
+    // Copy fresh values for every register in the range; false on any miss
+    bool lookup(uint8_t slave, uint16_t start, uint16_t count, uint16_t *values);
+    void invalidate(uint8_t slave, uint16_t start, uint16_t count);
+    void clear();
+
+    // Registers a miss on [start, start + count) should fetch: the aligned
+    // block around the range, limited to the parameter table's registers
+    static void fetchRange(uint16_t start, uint16_t count, uint16_t &fetchStart, uint16_t &fetchCount);
+    // Freshness limit of one register at the current poll interval
+    static uint32_t ttlMs(uint16_t reg);
+
+    uint32_t hits() const { return hits_; }
+    uint32_t misses() const { return misses_; }
+    void printStatus() const;
+
+private:
+    struct Entry
+    {
+        uint32_t storedAt;
+        uint16_t reg;
+        uint16_t value;
+        uint8_t slave;
+        bool valid;
+    };
+
+    Entry entries_[REGISTER_CACHE_SIZE];
+    uint32_t hits_;
+    uint32_t misses_;
+    uint32_t invalidations_;
+
+    static bool cacheable(uint16_t reg);
+    Entry *find(uint8_t slave, uint16_t reg);
+    Entry *slotFor(uint8_t slave, uint16_t reg);
+};
+
+extern ESP8266RegisterCache registerCache;
+
+#endif // ESP8266_REGISTER_CACHE_H
@@ -0,0 +1,106 @@
+#include "ESP8266ReportFilter.h"
+
+ESP8266ReportFilter reportFilter;
+
+ESP8266ReportFilter::ESP8266ReportFilter() : activeMask_(0)
+{
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        deadband_[i] = 0;
+        maxSilenceMs_[i] = 0;
+    }
+    reset();
+}
+
+void ESP8266ReportFilter::configure(const DeviceConfig &config)
+{
+    activeMask_ = 0;
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        deadband_[i] = config.deadband[i];
+        uint16_t silence = config.max_silence_s[i] ? config.max_silence_s[i] : REPORT_DEFAULT_MAX_SILENCE_S;
+        maxSilenceMs_[i] = silence * 1000UL;
+        if (deadband_[i] > 0)
+            activeMask_ |= (uint16_t)(1u << i);
+    }
+    reset();
+}
+
+void ESP8266ReportFilter::reset()
+{
+    for (uint8_t s = 0; s < MAX_SLAVES; s++)
+    {
+        for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+        {
+            last_[s][i] = 0;
+            lastAt_[s][i] = 0;
+        }
+        reportedMask_[s] = 0;
+    }
+    samplesSeen_ = 0;
+    samplesSkipped_ = 0;
+    valuesStored_ = 0;
+    valuesSuppressed_ = 0;
+    heartbeats_ = 0;
+}
+
+bool ESP8266ReportFilter::apply(Sample &sample)
+{
+    samplesSeen_++;
+    uint8_t slave = sample.slave < MAX_SLAVES ? sample.slave : 0;
+    uint16_t *last = last_[slave];
+    uint32_t *lastAt = lastAt_[slave];
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        uint16_t bit = (uint16_t)(1u << i);
+        if (!(sample.present_mask & bit))
+            continue;
+
+        uint16_t value = sample.raw[i];
+        if ((activeMask_ & bit) && (reportedMask_[slave] & bit))
+        {
+            uint16_t moved = value > last[i] ? value - last[i] : last[i] - value;
+            bool heartbeat = sample.timestamp - lastAt[i] >= maxSilenceMs_[i];
+            if (moved <= deadband_[i] && !heartbeat)
+            {
+                sample.present_mask &= (uint16_t)~bit;
+                valuesSuppressed_++;
+                continue;
+            }
+            if (moved <= deadband_[i])
+                heartbeats_++;
+        }
+
+        last[i] = value;
+        lastAt[i] = sample.timestamp;
+        reportedMask_[slave] |= bit;
+        valuesStored_++;
+    }
+
+    if (sample.present_mask == 0)
+    {
+        samplesSkipped_++;
+        return false;
+    }
+    return true;
+}
+
+void ESP8266ReportFilter::printStatus() const
+{
+    Serial.print("Deadband: ");
+    if (!active())
+    {
+        Serial.println("off (every sample stored)");
+        return;
+    }
+    Serial.print(samplesSkipped_);
+    Serial.print("/");
+    Serial.print(samplesSeen_);
+    Serial.print(" samples skipped, ");
+    Serial.print(valuesSuppressed_);
+    Serial.print(" values suppressed, ");
+    Serial.print(valuesStored_);
+    Serial.print(" stored (");
+    Serial.print(heartbeats_);
+    Serial.println(" heartbeats)");
+}
@@ -0,0 +1,48 @@
+#ifndef ESP8266_REPORT_FILTER_H
+#define ESP8266_REPORT_FILTER_H
+
+#include <Arduino.h>
+#include "ESP8266Config.h"
+#include "ESP8266DataTypes.h"
+
+#define REPORT_DEFAULT_MAX_SILENCE_S 300 // Heartbeat when a deadband is set without max_silence
+
+// Report-by-exception. A value is stored only when it has moved beyond its
+// parameter's deadband since the last stored value, or when that parameter's
+// max-silence heartbeat is due. Unreported values are cleared from the
+// sample, so its present_mask becomes the change bitmap; a sample with
+// nothing left is not buffered at all. A deadband of 0 stores every value.
+// Each slave keeps its own last values, so inverters never mask each other.
+class ESP8266ReportFilter
+{
+public:
+    ESP8266ReportFilter();
+
+    // Load deadbands (raw register units) and heartbeats; forgets last values
+    void configure(const DeviceConfig &config);
+    void reset();
+
+    // Clear the values that need not be stored; false when none are left
+    bool apply(Sample &sample);
+
+    bool active() const { return activeMask_ != 0; }
+    void printStatus() const;
+
+private:
+    uint16_t deadband_[PARAMETER_TYPE_COUNT];
+    uint32_t maxSilenceMs_[PARAMETER_TYPE_COUNT];
+    uint16_t last_[MAX_SLAVES][PARAMETER_TYPE_COUNT];
+    uint32_t lastAt_[MAX_SLAVES][PARAMETER_TYPE_COUNT];
+    uint16_t activeMask_;               // Parameters with a deadband
+    uint16_t reportedMask_[MAX_SLAVES]; // Parameters with a stored value to compare against
+
+    uint32_t samplesSeen_;
+    uint32_t samplesSkipped_;
+    uint32_t valuesStored_;
+    uint32_t valuesSuppressed_;
+    uint32_t heartbeats_;
+};
+
+extern ESP8266ReportFilter reportFilter;
+
+#endif // ESP8266_REPORT_FILTER_H
@@ -0,0 +1,76 @@
+#include "ESP8266SampleStore.h"
+
+ESP8266SampleStore::ESP8266SampleStore(ESP8266DataBuffer &buffer, ESP8266ReportFilter &filter,
+                                       ESP8266SpillQueue &spill)
+    : buffer_(buffer), filter_(filter), spill_(spill)
+{
+}
+
+StoreResult ESP8266SampleStore::store(Sample &sample, uint16_t failedMask)
+{
+    if (failedMask != 0)
+        return StoreResult::FAILED;
+
+    // Report-by-exception: only values that moved (or are due a heartbeat) are kept
+    if (!filter_.apply(sample))
+        return StoreResult::UNCHANGED;
+
+    if (!buffer_.hasSpace() && buffer_.reserved() == 0)
+    {
+        // RAM is full (cloud unreachable): move the oldest block to flash.
+        // Not while an upload holds a window of the ring between retries.
+        spillOldest();
+    }
+    if (!buffer_.hasSpace())
+        return StoreResult::DISCARDED;
+
+    buffer_.append(sample);
+    return StoreResult::STORED;
+}
+
+bool ESP8266SampleStore::spillOldest()
+{
+    SampleWindow window = buffer_.reserveWindow(SPILL_BLOCK_SAMPLES);
+    if (window.empty())
+        return false;
+
+    if (spill_.append(window))
+    {
+        buffer_.releaseWindow();
+        return true;
+    }
+    buffer_.cancelWindow();
+    return false;
+}
+
+SampleWindow ESP8266SampleStore::takeWindow(Sample *batch, size_t capacity, bool &fromSpill)
+{
+    fromSpill = false;
+    if (!spill_.empty())
+    {
+        size_t count = spill_.peek(batch, capacity);
+        if (count > 0)
+        {
+            fromSpill = true;
+            return SampleWindow(batch, count, 0, count);
+        }
+    }
+    if (buffer_.empty())
+        return SampleWindow();
+    return buffer_.reserveWindow(capacity);
+}
+
+void ESP8266SampleStore::consumeWindow(bool fromSpill)
+{
+    if (fromSpill)
+        spill_.pop();
+    else
+        buffer_.releaseWindow();
+}
+
+void ESP8266SampleStore::keepWindow(bool fromSpill)
+{
+    // A peeked spill record stays at the head of the queue by itself
+    if (!fromSpill)
+        buffer_.cancelWindow();
+}
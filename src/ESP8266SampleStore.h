@@ -0,0 +1,49 @@
+#ifndef ESP8266_SAMPLE_STORE_H
+#define ESP8266_SAMPLE_STORE_H
+
+#include <Arduino.h>
+#include "ESP8266DataTypes.h"
+#include "ESP8266ReportFilter.h"
+#include "ESP8266SpillQueue.h"
+
+// What became of one polled sample
+enum class StoreResult : uint8_t
+{
+    STORED,    // Appended to the RAM ring
+    FAILED,    // Some span could not be read; the sample is not kept
+    UNCHANGED, // No value moved beyond its deadband
+    DISCARDED  // Ring full and its oldest block could not be spilled
+};
+
+// Where polled samples wait for the cloud: report filter, then the RAM
+// ring, with the oldest block moved to the flash spill queue once the ring
+// is full. Uploads drain the oldest data first and consume it only after
+// the server has acknowledged it. Works on the objects it is given, so the
+// soak runs the firmware's own storage path on private ones.
+class ESP8266SampleStore
+{
+public:
+    ESP8266SampleStore(ESP8266DataBuffer &buffer, ESP8266ReportFilter &filter, ESP8266SpillQueue &spill);
+
+    StoreResult store(Sample &sample, uint16_t failedMask);
+    // Move the oldest block of RAM samples into the spill queue
+    bool spillOldest();
+
+    bool empty() const { return buffer_.empty() && spill_.empty(); }
+
+    // Oldest data first: spilled blocks decoded into batch, else a zero-copy
+    // window of the ring, up to capacity samples either way. fromSpill says
+    // which; the samples stay in place until consumeWindow() or keepWindow().
+    SampleWindow takeWindow(Sample *batch, size_t capacity, bool &fromSpill);
+    void consumeWindow(bool fromSpill); // ACK received: drop the window from its source
+    void keepWindow(bool fromSpill);    // Upload failed: the window goes out again next time
+
+private:
+    ESP8266DataBuffer &buffer_;
+    ESP8266ReportFilter &filter_;
+    ESP8266SpillQueue &spill_;
+};
+
+extern ESP8266SampleStore sampleStore;
+
+#endif // ESP8266_SAMPLE_STORE_H
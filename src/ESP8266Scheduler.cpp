@@ -0,0 +1,149 @@
+#include "ESP8266Scheduler.h"
+#include "ESP8266Log.h"
+
+ESP8266Scheduler scheduler;
+
+ESP8266Scheduler::ESP8266Scheduler() : jobCount_(0), requested_(0)
+{
+    memset(jobs_, 0, sizeof(jobs_));
+    for (uint8_t i = 0; i < MAX_SCHEDULER_JOBS; i++)
+    {
+        requestedAt_[i] = 0;
+    }
+}
+
+int8_t ESP8266Scheduler::addJob(const char *name, JobStep step)
+{
+    if (jobCount_ >= MAX_SCHEDULER_JOBS)
+    {
+        LOG_E("SCHED", "Job table full");
+        return -1;
+    }
+    Job &job = jobs_[jobCount_];
+    job.name = name;
+    job.step = step;
+    job.active = false;
+    return (int8_t)jobCount_++;
+}
+
+void IRAM_ATTR ESP8266Scheduler::request(int8_t id)
+{
+    if (id < 0 || id >= (int8_t)MAX_SCHEDULER_JOBS)
+        return;
+    uint32_t bit = 1u << id;
+    if (!(requested_ & bit))
+    {
+        requestedAt_[id] = millis();
+        requested_ |= bit;
+    }
+}
+
+bool ESP8266Scheduler::isActive(int8_t id) const
+{
+    if (id < 0 || id >= (int8_t)jobCount_)
+        return false;
+    return jobs_[id].active || (requested_ & (1u << id));
+}
+
+void ESP8266Scheduler::collectRequests()
+{
+    noInterrupts();
+    uint32_t pending = requested_;
+    requested_ = 0;
+    interrupts();
+
+    for (uint8_t i = 0; i < jobCount_ && pending; i++)
+    {
+        if (!(pending & (1u << i)))
+            continue;
+        Job &job = jobs_[i];
+        if (job.active)
+        {
+            // Already queued or running: one run serves both requests
+            job.stats.coalesced++;
+            continue;
+        }
+        job.active = true;
+        job.started = false;
+        job.dueAt = requestedAt_[i];
+        job.resumeAt = requestedAt_[i];
+    }
+}
+
+bool ESP8266Scheduler::runOnce()
+{
+    collectRequests();
+
+    // Highest priority (lowest index) job whose resume time has come
+    unsigned long now = millis();
+    Job *next = nullptr;
+    for (uint8_t i = 0; i < jobCount_; i++)
+    {
+        Job &job = jobs_[i];
+        if (job.active && (long)(now - job.resumeAt) >= 0)
+        {
+            next = &job;
+            break;
+        }
+    }
+    if (!next)
+        return false;
+
+    if (!next->started)
+    {
+        uint32_t lateness = now - next->dueAt;
+        next->stats.lateness_total_ms += lateness;
+        if (lateness > next->stats.lateness_max_ms)
+            next->stats.lateness_max_ms = lateness;
+        next->started = true;
+    }
+
+    unsigned long t0 = millis();
+    uint32_t wait = next->step();
+    uint32_t elapsed = millis() - t0;
+    next->stats.steps++;
+    if (elapsed > next->stats.step_max_ms)
+        next->stats.step_max_ms = elapsed;
+
+    if (wait == JOB_DONE)
+    {
+        next->active = false;
+        next->stats.runs++;
+    }
+    else
+    {
+        next->resumeAt = millis() + wait;
+    }
+    return true;
+}
+
+void ESP8266Scheduler::resetStats()
+{
+    for (uint8_t i = 0; i < jobCount_; i++)
+    {
+        memset(&jobs_[i].stats, 0, sizeof(jobs_[i].stats));
+    }
+}
+
+void ESP8266Scheduler::printStats() const
+{
+    for (uint8_t i = 0; i < jobCount_; i++)
+    {
+        const Job &job = jobs_[i];
+        Serial.print("Job ");
+        Serial.print(job.name);
+        Serial.print(": ");
+        Serial.print(job.stats.runs);
+        Serial.print(" runs, ");
+        Serial.print(job.stats.steps);
+        Serial.print(" steps, lateness avg ");
+        Serial.print(job.stats.runs ? job.stats.lateness_total_ms / job.stats.runs : 0);
+        Serial.print(" ms / max ");
+        Serial.print(job.stats.lateness_max_ms);
+        Serial.print(" ms, longest step ");
+        Serial.print(job.stats.step_max_ms);
+        Serial.print(" ms, coalesced ");
+        Serial.print(job.stats.coalesced);
+        Serial.println(job.active ? " (active)" : "");
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef ESP8266_SCHEDULER_H
+#define ESP8266_SCHEDULER_H
+
+#include <Arduino.h>
+
+#define MAX_SCHEDULER_JOBS 9
+#define SCHEDULER_IDLE_MS 10 // loop() sleep when no job is due
+
+// Value returned by a job step when the job has finished; any other value is
+// the number of milliseconds to wait before the next step (0 = next pass)
+#define JOB_DONE 0xFFFFFFFFu
+
+typedef uint32_t (*JobStep)();
+
+// Per-job timing statistics
+struct JobStats
+{
+    uint32_t runs;            // Completed runs
+    uint32_t steps;           // Steps executed
+    uint32_t coalesced;       // Requests that arrived while the job was already active
+    uint32_t lateness_max_ms; // Request to first step
+    uint32_t lateness_total_ms;
+    uint32_t step_max_ms;     // Longest single step
+};
+
+// Cooperative scheduler for loop(). Each job is a resumable state machine:
+// a step does a bounded amount of work and either finishes or asks to be
+// resumed after a delay, so a job waiting on a backoff or a WiFi reconnect
+// never blocks the others. Timer ISRs only call request(); loop() calls
+// runOnce(), which runs one step of the highest-priority due job. Jobs are
+// prioritised in registration order.
+class ESP8266Scheduler
+{
+public:
+    ESP8266Scheduler();
+
+    // Register a job; returns its id, or -1 when the table is full
+    int8_t addJob(const char *name, JobStep step);
+
+    // Ask for a job to run as soon as possible. ISR-safe.
+    void IRAM_ATTR request(int8_t id);
+    // Start a job that keeps rescheduling itself (e.g. monitors)
+    void start(int8_t id) { request(id); }
+
+    bool isActive(int8_t id) const;
+
+    // Run one step of the most urgent due job. Returns false when idle.
+    bool runOnce();
+
+    void printStats() const;
+    void resetStats();
+
+private:
+    struct Job
+    {
+        const char *name;
+        JobStep step;
+        bool active;
+        bool started;           // First step of the current run has executed
+        unsigned long dueAt;    // When the current run was requested
+        unsigned long resumeAt; // Next step not before this time
+        JobStats stats;
+    };
+
+    Job jobs_[MAX_SCHEDULER_JOBS];
+    uint8_t jobCount_;
+
+    // Requests from ISR context, folded into the job table by runOnce()
+    volatile uint32_t requested_;
+    volatile unsigned long requestedAt_[MAX_SCHEDULER_JOBS];
+
+    void collectRequests();
+};
+
+extern ESP8266Scheduler scheduler;
+
+#endif // ESP8266_SCHEDULER_H
@@ -3,79 +3,148 @@
 #include <SHA256.h>
 #include <base64.hpp>
 
-String ESP8266Security::calculateHMAC(const char *key, const uint32_t nonce, const String &payload)
+// "<nonce>." prefix of the signed message
+static int formatNoncePrefix(uint32_t nonce, char *out, size_t capacity)
 {
-    // Construct the canonical message to be signed.
-    String message_to_sign = String(nonce) + "." + payload;
+    return snprintf(out, capacity, "%lu.", (unsigned long)nonce);
+}
 
-    SHA256 sha256;
+// Appends everything written to it to a String
+class StringPrint : public Print
+{
+public:
+    explicit StringPrint(String &out) : out_(out) {}
+    size_t write(uint8_t byte) override
+    {
+        out_.concat((char)byte);
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t length) override
+    {
+        out_.concat(reinterpret_cast<const char *>(data), length);
+        return length;
+    }
+    using Print::write;
 
-    // Reset HMAC with the provided key
-    sha256.resetHMAC(key, strlen(key));
+private:
+    String &out_;
+};
+
+SecureWriter::SecureWriter(Print &sink, const char *psk, uint32_t nonce)
+    : sink_(sink), psk_(psk), nonce_(nonce), groupLen_(0), payloadBytes_(0), wrapMicros_(0)
+{
+}
 
-    // Update HMAC with the message to sign
-    sha256.update(message_to_sign.c_str(), message_to_sign.length());
+void SecureWriter::begin()
+{
+    // MAC covers "<nonce>.<base64 payload>"
+    char prefix[12];
+    int n = formatNoncePrefix(nonce_, prefix, sizeof(prefix));
+    hmac_.resetHMAC(psk_, strlen(psk_));
+    hmac_.update(prefix, n);
+
+    sink_.print("{\"nonce\":");
+    sink_.print((unsigned long)nonce_);
+    sink_.print(",\"payload\":\"");
+}
 
-    // Finalize HMAC calculation
-    uint8_t mac_result[SHA256::HASH_SIZE];
-    sha256.finalizeHMAC(key, strlen(key), mac_result, sizeof(mac_result));
+void SecureWriter::flushGroup()
+{
+    if (groupLen_ == 0)
+        return;
+    unsigned char encoded[GROUP_BYTES / 3 * 4 + 1];
+    uint32_t started = micros();
+    unsigned int encodedLen = encode_base64(group_, groupLen_, encoded);
+    hmac_.update(encoded, encodedLen);
+    wrapMicros_ += micros() - started;
+    sink_.write(encoded, encodedLen);
+    groupLen_ = 0;
+}
 
-    // Convert the raw binary signature into a hexadecimal string.
-    String mac_hex_string = "";
-    mac_hex_string.reserve(sizeof(mac_result) * 2 + 1); // Pre-allocate memory for efficiency
+size_t SecureWriter::write(uint8_t byte)
+{
+    group_[groupLen_++] = byte;
+    payloadBytes_++;
+    if (groupLen_ == GROUP_BYTES)
+        flushGroup();
+    return 1;
+}
 
-    for (int i = 0; i < sizeof(mac_result); i++)
+size_t SecureWriter::write(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
     {
-        char hex_buf[3]; // Buffer for 2 hex characters plus a null terminator
-        sprintf(hex_buf, "%02x", mac_result[i]);
-        mac_hex_string += hex_buf;
+        write(data[i]);
     }
-
-    return mac_hex_string;
+    return length;
 }
 
-String ESP8266Security::createSecureWrapper(const DynamicJsonDocument &original_doc)
+void SecureWriter::finish()
 {
-    // Serialize the original data payload into a string.
-    String payload_str;
-    serializeJson(original_doc, payload_str);
+    flushGroup(); // Only the final group may carry '=' padding
+
+    uint8_t mac[SHA256::HASH_SIZE];
+    uint32_t started = micros();
+    hmac_.finalizeHMAC(psk_, strlen(psk_), mac, sizeof(mac));
 
-    return createSecureWrapper(payload_str);
+    char macHex[SHA256::HASH_SIZE * 2];
+    ESP8266Security::macToHex(mac, macHex);
+    wrapMicros_ += micros() - started;
+
+    sink_.print("\",\"mac\":\"");
+    sink_.write(reinterpret_cast<const uint8_t *>(macHex), sizeof(macHex));
+    sink_.write('"');
 }
 
-String ESP8266Security::createSecureWrapper(const String serialized_payload)
+void ESP8266Security::macToHex(const uint8_t *mac, char *hexOut)
 {
-    // Encode the payload string with Base64 for simplified confidentiality.
-    // Calculate required buffer size
-    unsigned int encoded_length = encode_base64_length(serialized_payload.length());
-    unsigned char *encoded_buffer = new unsigned char[encoded_length + 1];
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < SHA256::HASH_SIZE; i++)
+    {
+        hexOut[i * 2] = hex[mac[i] >> 4];
+        hexOut[i * 2 + 1] = hex[mac[i] & 0x0F];
+    }
+}
 
-    // Encode the payload
-    encode_base64((const unsigned char *)serialized_payload.c_str(), serialized_payload.length(), encoded_buffer);
-    encoded_buffer[encoded_length] = '\0'; // Null terminate
+String ESP8266Security::calculateHMAC(const char *key, const uint32_t nonce, const String &payload)
+{
+    SHA256 sha256;
+    sha256.resetHMAC(key, strlen(key));
 
-    String encoded_payload = String((char *)encoded_buffer);
-    delete[] encoded_buffer;
+    // Canonical message "<nonce>.<payload>", hashed piecewise
+    char prefix[12];
+    int n = formatNoncePrefix(nonce, prefix, sizeof(prefix));
+    sha256.update(prefix, n);
+    sha256.update(payload.c_str(), payload.length());
 
-    // Get the next unique nonce. This also saves the new value to EEPROM.
-    uint32_t nonce_to_use = configManager.getNextNonce();
+    uint8_t mac_result[SHA256::HASH_SIZE];
+    sha256.finalizeHMAC(key, strlen(key), mac_result, sizeof(mac_result));
 
-    // Get the Pre-Shared Key from configuration.
-    const char *psk = configManager.getSecurityConfig().psk;
+    char mac_hex[SHA256::HASH_SIZE * 2 + 1];
+    macToHex(mac_result, mac_hex);
+    mac_hex[SHA256::HASH_SIZE * 2] = '\0';
+    return String(mac_hex);
+}
 
-    // Calculate the HMAC signature on the nonce and the *encoded* payload.
-    String mac_signature = calculateHMAC(psk, nonce_to_use, encoded_payload);
+void ESP8266Security::writeSecureWrapper(Print &sink, const JsonDocument &doc, uint32_t nonce)
+{
+    SecureWriter secure(sink, configManager.getSecurityConfig().psk, nonce);
+    secure.begin();
+    serializeJson(doc, secure);
+    secure.finish();
+    secure.close();
+}
 
-    // Assemble the final, secure JSON wrapper.
-    DynamicJsonDocument secure_doc(1024);
-    secure_doc["nonce"] = nonce_to_use;
-    secure_doc["payload"] = encoded_payload;
-    secure_doc["mac"] = mac_signature;
+String ESP8266Security::createSecureWrapper(const JsonDocument &original_doc)
+{
+    // Get the next unique nonce
+    uint32_t nonce_to_use = configManager.getNextNonce();
 
-    // Serialize the final wrapper to a string and return it.
+    // Wrapper is ~4/3 of the payload plus nonce and MAC fields
     String final_secure_payload;
-    serializeJson(secure_doc, final_secure_payload);
-
+    final_secure_payload.reserve(encode_base64_length(measureJson(original_doc)) + 112);
+    StringPrint out(final_secure_payload);
+    writeSecureWrapper(out, original_doc, nonce_to_use);
     return final_secure_payload;
 }
 
@@ -3,21 +3,61 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <SHA256.h>
+
+// Streams a secure wrapper {"nonce":N,"payload":"<base64>","mac":"<hex>"}
+// to a sink without holding the payload in memory. Payload bytes written to
+// this Print are base64-encoded in small groups and fed to the HMAC as they
+// go out. finish() writes the MAC and leaves the wrapper object open so the
+// caller can append further fields before writing the closing brace.
+class SecureWriter : public Print
+{
+public:
+    SecureWriter(Print &sink, const char *psk, uint32_t nonce);
+
+    void begin();
+    size_t write(uint8_t byte) override;
+    size_t write(const uint8_t *data, size_t length) override;
+    using Print::write;
+    void finish();
+    // Close the wrapper object after finish() and any extra fields
+    void close() { sink_.write('}'); }
+
+    size_t payloadBytes() const { return payloadBytes_; }
+    // Time spent base64-encoding and hashing so far, sink writes excluded
+    uint32_t wrapMicros() const { return wrapMicros_; }
+
+private:
+    static const size_t GROUP_BYTES = 48; // Encodes to 64 base64 characters
+
+    Print &sink_;
+    const char *psk_;
+    uint32_t nonce_;
+    SHA256 hmac_;
+    uint8_t group_[GROUP_BYTES];
+    size_t groupLen_;
+    size_t payloadBytes_;
+    uint32_t wrapMicros_;
+
+    void flushGroup();
+};
 
 class ESP8266Security
 {
 public:
+    // HMAC-SHA256 over "<nonce>.<payload>" as lowercase hex; the message is
+    // fed to the hash in pieces instead of being concatenated first
     static String calculateHMAC(const char *key, const uint32_t nonce, const String &payload);
 
-    static String createSecureWrapper(const DynamicJsonDocument &original_doc);
+    // Stream the complete secure wrapper for doc into sink. Memory use is a
+    // fixed few hundred bytes regardless of the payload size.
+    static void writeSecureWrapper(Print &sink, const JsonDocument &doc, uint32_t nonce);
 
-    template <size_t N>
-    static String createSecureWrapper(const StaticJsonDocument<N> &original_doc)
-    {
-        String payload_str;
-        serializeJson(original_doc, payload_str);
-        return createSecureWrapper(payload_str);
-    }
+    // Convenience for small messages: the wrapper as a String, with a fresh nonce
+    static String createSecureWrapper(const JsonDocument &original_doc);
+
+    // 32-byte MAC to 64 lowercase hex characters (no terminator)
+    static void macToHex(const uint8_t *mac, char *hexOut);
 
     // Base64 utility functions
     static unsigned int getBase64EncodedLength(unsigned int inputLength);
@@ -26,9 +66,6 @@ public:
     static bool encodeBase64(const unsigned char *input, unsigned int inputLength, unsigned char *output);
     static bool decodeBase64(const String &base64Data, unsigned char *output);
     static bool decodeBase64(const unsigned char *input, unsigned int inputLength, unsigned char *output);
-
-private:
-    static String createSecureWrapper(const String serialized_payload);
 };
 
 #endif // ESP8266_SECURITY_H
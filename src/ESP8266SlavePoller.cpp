@@ -0,0 +1,215 @@
+#include "ESP8266SlavePoller.h"
+#include <ArduinoJson.h>
+#include "ESP8266Config.h"
+#include "ESP8266Inverter.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266RegisterCache.h"
+#include "ESP8266Log.h"
+
+ESP8266SlavePoller slavePoller;
+
+ESP8266SlavePoller::ESP8266SlavePoller()
+    : config_(nullptr), nextSlave_(0), active_(false), cycleStart_(0), cycleSerialUs_(0), cycles_(0),
+      lastCycleMs_(0), lastSerialMs_(0)
+{
+    static const char *const kLaneNames[] = {"poll-a", "poll-b", "poll-c", "poll-d"};
+    static_assert(POLL_PIPELINE_DEPTH <= sizeof(kLaneNames) / sizeof(kLaneNames[0]), "Name every poll lane");
+    for (uint8_t i = 0; i < POLL_PIPELINE_DEPTH; i++)
+    {
+        // Channels register themselves for housekeeping, so they are never copied
+        lanes_[i].http = new ESP8266AsyncHttp(kLaneNames[i]);
+        lanes_[i].active = false;
+    }
+}
+
+bool ESP8266SlavePoller::start(const ESP8266PollingConfig &config, uint32_t timestamp)
+{
+    if (active_)
+        return false;
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        // Reconnection is handled by the scheduler's wifi job
+        LOG_W("POLL", "WiFi not connected, skipping poll cycle");
+        return false;
+    }
+
+    config_ = &config;
+    for (uint8_t i = 0; i < config.slaveCount(); i++)
+    {
+        SlaveState &state = slaves_[i];
+        state.sample = Sample();
+        state.sample.timestamp = timestamp;
+        state.sample.slave = i;
+        state.failedMask = 0;
+        state.nextSpan = 0;
+        state.inFlight = false;
+    }
+    nextSlave_ = 0;
+    cycleStart_ = millis();
+    cycleSerialUs_ = 0;
+    active_ = true;
+    return true;
+}
+
+bool ESP8266SlavePoller::issue(Lane &lane)
+{
+    const APIConfig &api = configManager.getAPIConfig();
+    uint8_t count = config_->slaveCount();
+    for (uint8_t tried = 0; tried < count; tried++)
+    {
+        uint8_t slave = nextSlave_;
+        nextSlave_ = (nextSlave_ + 1) % count;
+
+        SlaveState &state = slaves_[slave];
+        const ESP8266PollPlanner &plan = config_->slavePlan(slave);
+        if (state.inFlight || state.nextSpan >= plan.spanCount())
+            continue;
+
+        const PollSpan &span = plan.span(state.nextSpan);
+        ESP8266ModbusHandler::buildReadFrame(lane.frame, config_->slaveAddress(slave), span.start_reg, span.num_regs);
+
+        bool started;
+        if (api.modbus_transport == MODBUS_TRANSPORT_BINARY)
+        {
+            lane.http->setResponseBuffer(lane.reply, sizeof(lane.reply));
+            started = lane.http->start(api.read_url, "application/octet-stream", lane.frame, sizeof(lane.frame),
+                                       api.timeout_ms, api.api_key);
+        }
+        else
+        {
+            char hex[sizeof(lane.frame) * 2 + 1];
+            ESP8266ModbusHandler::bytesToHex(lane.frame, sizeof(lane.frame), hex);
+            int length = snprintf(lane.body, sizeof(lane.body), "{\"frame\":\"%s\"}", hex);
+            started = lane.http->start(api.read_url, "application/json", reinterpret_cast<const uint8_t *>(lane.body),
+                                       (size_t)length, api.timeout_ms, api.api_key);
+        }
+
+        lane.slave = slave;
+        lane.span = state.nextSpan;
+        state.nextSpan++;
+        if (!started)
+        {
+            state.failedMask |= span.param_mask;
+            metrics.count(MetricCounter::GATEWAY_FAILURES);
+            deliverIfDone(slave);
+            continue;
+        }
+        state.inFlight = true;
+        lane.startedUs = micros();
+        lane.active = true;
+        return true;
+    }
+    return false;
+}
+
+bool ESP8266SlavePoller::readReply(Lane &lane, uint16_t numRegs, uint16_t *values)
+{
+    int code = lane.http->code();
+    if (code != HTTP_CODE_OK)
+    {
+        LOG_E("POLL", "Slave 0x%02X read failed: %d", config_->slaveAddress(lane.slave), code);
+        return false;
+    }
+
+    if (configManager.getAPIConfig().modbus_transport == MODBUS_TRANSPORT_BINARY)
+        return ESP8266ModbusHandler::parseReadReply(lane.reply, lane.http->responseLength(), numRegs, values);
+
+    // Legacy JSON/hex gateway API: {"frame":"<HEX>"}
+    StaticJsonDocument<512> doc;
+    if (deserializeJson(doc, lane.http->response()) || !doc.containsKey("frame"))
+    {
+        LOG_E("POLL", "Bad gateway reply from slave 0x%02X", config_->slaveAddress(lane.slave));
+        return false;
+    }
+    size_t length = ESP8266ModbusHandler::hexToBytes(doc["frame"].as<String>(), lane.reply, sizeof(lane.reply));
+    return ESP8266ModbusHandler::parseReadReply(lane.reply, length, numRegs, values);
+}
+
+void ESP8266SlavePoller::finish(Lane &lane)
+{
+    uint32_t roundTripUs = micros() - lane.startedUs;
+    metrics.record(MetricStage::GATEWAY_ROUND_TRIP, roundTripUs);
+    cycleSerialUs_ += roundTripUs;
+    lane.active = false;
+
+    SlaveState &state = slaves_[lane.slave];
+    const PollSpan &span = config_->slavePlan(lane.slave).span(lane.span);
+    uint16_t values[ESP8266ModbusHandler::MAX_READ_REGS];
+    if (span.num_regs <= ESP8266ModbusHandler::MAX_READ_REGS && readReply(lane, span.num_regs, values))
+    {
+        registerCache.store(config_->slaveAddress(lane.slave), span.start_reg, values, span.num_regs);
+        ESP8266Inverter::fillSample(span, values, state.sample);
+    }
+    else
+    {
+        state.failedMask |= span.param_mask;
+        metrics.count(MetricCounter::GATEWAY_FAILURES);
+    }
+    state.inFlight = false;
+    deliverIfDone(lane.slave);
+}
+
+void ESP8266SlavePoller::deliverIfDone(uint8_t slave)
+{
+    SlaveState &state = slaves_[slave];
+    if (state.inFlight || state.nextSpan < config_->slavePlan(slave).spanCount())
+        return;
+    if (handler_)
+        handler_(state.sample, state.failedMask);
+}
+
+bool ESP8266SlavePoller::poll()
+{
+    if (!active_)
+        return false;
+
+    for (uint8_t i = 0; i < POLL_PIPELINE_DEPTH; i++)
+    {
+        Lane &lane = lanes_[i];
+        if (lane.active && !lane.http->poll())
+            finish(lane);
+    }
+
+    // Refill idle lanes; issue() also retires spans that cannot be started
+    bool inFlight = false;
+    for (uint8_t i = 0; i < POLL_PIPELINE_DEPTH; i++)
+    {
+        Lane &lane = lanes_[i];
+        if (!lane.active)
+            issue(lane);
+        inFlight = inFlight || lane.active;
+    }
+
+    if (!inFlight)
+    {
+        // Nothing left to send or wait for: every slave has been delivered
+        active_ = false;
+        cycles_++;
+        lastCycleMs_ = millis() - cycleStart_;
+        lastSerialMs_ = cycleSerialUs_ / 1000;
+    }
+    return active_;
+}
+
+void ESP8266SlavePoller::wait()
+{
+    while (poll())
+    {
+        yield();
+    }
+}
+
+void ESP8266SlavePoller::printStatus() const
+{
+    Serial.print("Poll cycles: ");
+    Serial.print(cycles_);
+    Serial.print(", last ");
+    Serial.print(lastCycleMs_);
+    Serial.print(" ms for ");
+    Serial.print(lastSerialMs_);
+    Serial.print(" ms of round trips over ");
+    Serial.print(config_ ? config_->slaveCount() : 0);
+    Serial.print(" slave(s), ");
+    Serial.print(POLL_PIPELINE_DEPTH);
+    Serial.println(" lanes");
+}
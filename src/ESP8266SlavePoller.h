@@ -0,0 +1,85 @@
+#ifndef ESP8266_SLAVE_POLLER_H
+#define ESP8266_SLAVE_POLLER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "ESP8266AsyncHttp.h"
+#include "ESP8266ModbusHandler.h"
+#include "ESP8266PollingConfig.h"
+
+#define POLL_PIPELINE_DEPTH 2 // Gateway requests in flight at once, one channel each
+#define POLL_JSON_BODY_MAX 40 // {"frame":"<16 hex>"} for an 8-byte read frame
+
+// Receives one slave's sample when its last span has completed; failedMask
+// holds the parameters whose span could not be read
+typedef std::function<void(Sample &sample, uint16_t failedMask)> SlaveSampleHandler;
+
+// Polls every configured inverter once per cycle. Span reads are issued
+// round-robin across slaves on up to POLL_PIPELINE_DEPTH gateway channels,
+// never two at once for the same slave, so one inverter's reply time
+// overlaps the next request instead of the cycle being a serial chain of
+// round trips. Every sample of a cycle carries the cycle's start timestamp
+// and its slave index.
+class ESP8266SlavePoller
+{
+public:
+    ESP8266SlavePoller();
+
+    void onSample(const SlaveSampleHandler &handler) { handler_ = handler; }
+
+    // Start a cycle over the config's slaves; false while one is running
+    bool start(const ESP8266PollingConfig &config, uint32_t timestamp);
+    // Advance the cycle; true while reads remain
+    bool poll();
+    // Drive the cycle to completion, for callers that need the samples now
+    void wait();
+    bool busy() const { return active_; }
+
+    // Duration of the last complete cycle, and the sum of its round trips
+    uint32_t lastCycleMs() const { return lastCycleMs_; }
+    uint32_t lastSerialMs() const { return lastSerialMs_; }
+    void printStatus() const;
+
+private:
+    struct SlaveState
+    {
+        Sample sample;
+        uint16_t failedMask;
+        uint8_t nextSpan;
+        bool inFlight;
+    };
+
+    struct Lane
+    {
+        ESP8266AsyncHttp *http;
+        bool active;
+        uint8_t slave;
+        uint8_t span;
+        uint32_t startedUs;
+        uint8_t frame[8]; // Read Holding Registers request
+        uint8_t reply[ESP8266ModbusHandler::MAX_FRAME_SIZE];
+        char body[POLL_JSON_BODY_MAX];
+    };
+
+    const ESP8266PollingConfig *config_;
+    SlaveSampleHandler handler_;
+    SlaveState slaves_[MAX_SLAVES];
+    Lane lanes_[POLL_PIPELINE_DEPTH];
+    uint8_t nextSlave_; // Round-robin cursor
+    bool active_;
+    unsigned long cycleStart_;
+    uint32_t cycleSerialUs_;
+
+    uint32_t cycles_;
+    uint32_t lastCycleMs_;
+    uint32_t lastSerialMs_;
+
+    bool issue(Lane &lane);
+    void finish(Lane &lane);
+    bool readReply(Lane &lane, uint16_t numRegs, uint16_t *values);
+    void deliverIfDone(uint8_t slave);
+};
+
+extern ESP8266SlavePoller slavePoller;
+
+#endif // ESP8266_SLAVE_POLLER_H
@@ -0,0 +1,624 @@
+#include "ESP8266SoakBench.h"
+#include <SHA256.h>
+#include "ESP8266Aggregator.h"
+#include "ESP8266Compression.h"
+#include "ESP8266Config.h"
+#include "ESP8266Inverter.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266ModbusHandler.h"
+#include "ESP8266Parameters.h"
+#include "ESP8266PowerManager.h"
+#include "ESP8266ReportFilter.h"
+#include "ESP8266SampleStore.h"
+#include "ESP8266SlavePoller.h"
+#include "ESP8266SpillQueue.h"
+#include "ESP8266UploadEnvelope.h"
+
+namespace
+{
+    // Mock cloud endpoint: keeps the request body for verification
+    class CloudSink : public Print
+    {
+    public:
+        size_t write(uint8_t byte) override
+        {
+            body.push_back(byte);
+            return 1;
+        }
+        size_t write(const uint8_t *data, size_t length) override
+        {
+            body.insert(body.end(), data, data + length);
+            return length;
+        }
+        using Print::write;
+
+        std::vector<uint8_t> body;
+    };
+
+    const uint32_t kDayMs = 86400000UL;
+
+    // Varints of a SAMPLE_* record, one per sample
+    bool decodeVarints(const uint8_t *value, size_t length, std::vector<uint32_t> &out)
+    {
+        out.clear();
+        size_t offset = 0;
+        while (offset < length)
+        {
+            uint32_t number;
+            if (!Compression::varint_decode(value, length, offset, number))
+                return false;
+            out.push_back(number);
+        }
+        return true;
+    }
+}
+
+// The firmware's storage and upload objects, private to one run
+struct ESP8266SoakBench::Run
+{
+    ESP8266PollingConfig config;
+    ESP8266DataBuffer buffer;
+    ESP8266ReportFilter filter;
+    ESP8266SpillQueue spill;
+    ESP8266SampleStore store;
+    std::vector<Sample> batch; // Spilled samples of the upload window, as spillBatch on the device
+    std::vector<CommandResult> commands;
+    ConfigAck ack;
+    UploadContext upload;
+
+    Run(const ESP8266PollingConfig &polling, size_t bufferSamples)
+        : config(polling), buffer(bufferSamples), spill(SOAK_SPILL_DIR), store(buffer, filter, spill),
+          batch(UPLOAD_BATCH_MAX_SAMPLES), ack(), upload()
+    {
+    }
+};
+
+ESP8266SoakBench soakBench;
+
+ESP8266SoakBench::ESP8266SoakBench()
+    : out_(nullptr), run_(nullptr), cycleMs_(0), lcg_(0), nonce_(0), endMs_(0), nextPoll_(0), nextUpload_(0),
+      busyUntil_(0), day_(0)
+{
+    memset(&options_, 0, sizeof(options_));
+    memset(&result_, 0, sizeof(result_));
+}
+
+SoakOptions ESP8266SoakBench::defaults()
+{
+    const DeviceConfig &device = configManager.getDeviceConfig();
+    SoakOptions options;
+    options.days = 1;
+    options.lossPercent = 0;
+    options.latencyMs = 200;
+    options.outagePercent = 0;
+    options.pollIntervalMs = device.poll_interval_ms;
+    options.uploadIntervalMs = device.upload_interval_ms;
+    options.bufferSamples = device.buffer_size;
+    return options;
+}
+
+uint16_t ESP8266SoakBench::mockRegister(uint16_t reg, uint32_t secondOfDay, uint32_t &lcg)
+{
+    // Daylight from 06:00 to 18:00, peaking at noon
+    float sun = 0.0f;
+    if (secondOfDay > 21600 && secondOfDay < 64800)
+        sun = sinf(PI * (secondOfDay - 21600) / 43200.0f);
+    lcg = lcg * 1103515245u + 12345u;
+    float jitter = ((float)((lcg >> 16) % 201) - 100.0f) / 100.0f;
+
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        ParameterType param = static_cast<ParameterType>(i);
+        if (param_reg(param) != reg)
+            continue;
+
+        float value;
+        switch (param)
+        {
+        case ParameterType::AC_VOLTAGE:
+            value = 230.0f + 2.0f * jitter;
+            break;
+        case ParameterType::AC_CURRENT:
+            value = 10.0f * sun + 0.05f * jitter;
+            break;
+        case ParameterType::AC_FREQUENCY:
+            value = 50.0f + 0.02f * jitter;
+            break;
+        case ParameterType::PV1_VOLTAGE:
+        case ParameterType::PV2_VOLTAGE:
+            value = sun > 0.0f ? 300.0f + 20.0f * sun + jitter : 0.0f;
+            break;
+        case ParameterType::PV1_CURRENT:
+        case ParameterType::PV2_CURRENT:
+            value = 8.0f * sun;
+            break;
+        case ParameterType::TEMPERATURE:
+            value = 25.0f + 15.0f * sun + 0.1f * jitter;
+            break;
+        case ParameterType::EXPORT_POWER_PERCENT:
+            value = 100.0f;
+            break;
+        case ParameterType::OUTPUT_POWER:
+            value = 3000.0f * sun + 10.0f * jitter;
+            break;
+        default:
+            value = 0.0f;
+            break;
+        }
+
+        float raw = roundf(value * param_scale(param));
+        return raw <= 0.0f ? 0 : raw >= 65535.0f ? 65535 : (uint16_t)raw;
+    }
+    return 0; // Gap register
+}
+
+size_t ESP8266SoakBench::mockReply(uint8_t address, const PollSpan &span, uint32_t secondOfDay, uint32_t &lcg,
+                                   uint8_t *reply)
+{
+    reply[0] = address;
+    reply[1] = 0x03; // Read Holding Registers
+    reply[2] = (uint8_t)(span.num_regs * 2);
+    for (uint16_t i = 0; i < span.num_regs; i++)
+    {
+        uint16_t value = mockRegister(span.start_reg + i, secondOfDay, lcg);
+        reply[3 + i * 2] = (value >> 8) & 0xFF;
+        reply[4 + i * 2] = value & 0xFF;
+    }
+
+    size_t length = 3 + span.num_regs * 2;
+    uint16_t crc = ESP8266ModbusHandler::calculateCRC(reply, length);
+    reply[length] = crc & 0xFF;
+    reply[length + 1] = (crc >> 8) & 0xFF;
+    return length + 2;
+}
+
+bool ESP8266SoakBench::verifyEnvelope(const std::vector<uint8_t> &body, const char *psk, const UploadContext &ctx)
+{
+    const size_t headerSize = 8;
+    if (body.size() < headerSize + SHA256::HASH_SIZE || body[0] != ENVELOPE_MAGIC_0 || body[1] != ENVELOPE_MAGIC_1 ||
+        body[2] != ENVELOPE_VERSION)
+        return false;
+    uint32_t nonce = body[4] | (body[5] << 8) | (body[6] << 16) | ((uint32_t)body[7] << 24);
+    if (nonce != ctx.nonce)
+        return false;
+
+    size_t end = body.size() - SHA256::HASH_SIZE;
+    SHA256 hmac;
+    uint8_t mac[SHA256::HASH_SIZE];
+    hmac.resetHMAC(psk, strlen(psk));
+    hmac.update(body.data(), end);
+    hmac.finalizeHMAC(psk, strlen(psk), mac, sizeof(mac));
+    if (memcmp(mac, body.data() + end, sizeof(mac)) != 0)
+        return false;
+
+    // What the cloud should find, rebuilt from the samples rather than from
+    // the upload's own encodings
+    const ESP8266PollingConfig &config = *ctx.config;
+    const SampleWindow &samples = ctx.samples;
+    std::vector<uint32_t> masks;
+    std::vector<uint32_t> addresses;
+    std::vector<uint32_t> offsets;
+    bool sparse = config.slaveCount() > 1;
+    size_t expectedFields = 0;
+    for (uint8_t slave = 0; slave < config.slaveCount(); slave++)
+    {
+        uint16_t slaveFields = 0;
+        for (const Sample &s : samples)
+        {
+            if (s.slave == slave)
+                slaveFields |= s.present_mask & config.slaveParamMask(slave);
+        }
+        for (uint8_t p = 0; p < PARAMETER_TYPE_COUNT; p++)
+        {
+            if (slaveFields & ESP8266PollPlanner::paramBit(static_cast<ParameterType>(p)))
+                expectedFields++;
+        }
+    }
+    for (const Sample &s : samples)
+    {
+        masks.push_back(s.present_mask & config.slaveParamMask(s.slave));
+        sparse = sparse || masks.back() != config.slaveParamMask(s.slave);
+        addresses.push_back(config.slaveAddress(s.slave));
+        offsets.push_back(s.timestamp - samples.front().timestamp);
+    }
+
+    // Walk the records; SLAVE switches inverter, FIELD starts a field whose
+    // FIELD_* records follow
+    const uint8_t *data = body.data();
+    size_t offset = headerSize;
+    uint8_t slave = 0;
+    int param = -1;
+    uint32_t codec = 0;
+    uint32_t count = 0;
+    uint32_t pollCount = 0;
+    size_t fields = 0;
+    size_t commands = 0;
+    size_t acks = 0;
+    bool sawOffsets = false;
+    bool sawMasks = false;
+    std::vector<long> expected;
+    std::vector<long> decoded;
+    std::vector<uint32_t> varints;
+    while (offset < end)
+    {
+        uint8_t key = data[offset++];
+        uint32_t length;
+        if (!Compression::varint_decode(data, end, offset, length) || length > end - offset)
+            return false;
+        const uint8_t *value = data + offset;
+        size_t valueOffset = 0;
+        uint32_t number = 0;
+        offset += length;
+
+        switch (key)
+        {
+        case EnvelopeKey::POLL_COUNT:
+            if (!Compression::varint_decode(value, length, valueOffset, pollCount))
+                return false;
+            break;
+        case EnvelopeKey::SAMPLE_OFFSETS:
+            if (!decodeVarints(value, length, varints) || varints != offsets)
+                return false;
+            sawOffsets = true;
+            break;
+        case EnvelopeKey::SAMPLE_MASKS:
+            if (!decodeVarints(value, length, varints) || varints != masks)
+                return false;
+            sawMasks = true;
+            break;
+        case EnvelopeKey::SAMPLE_SLAVES:
+            if (!decodeVarints(value, length, varints) || varints != addresses)
+                return false;
+            break;
+        case EnvelopeKey::SLAVE:
+            if (!Compression::varint_decode(value, length, valueOffset, number))
+                return false;
+            slave = config.slaveCount();
+            for (uint8_t i = 0; i < config.slaveCount(); i++)
+            {
+                if (config.slaveAddress(i) == number)
+                    slave = i;
+            }
+            if (slave >= config.slaveCount())
+                return false;
+            break;
+        case EnvelopeKey::COMMAND:
+            commands++;
+            break;
+        case EnvelopeKey::ACK_ACCEPTED:
+        case EnvelopeKey::ACK_REJECTED:
+        case EnvelopeKey::ACK_UNCHANGED:
+            acks++;
+            break;
+        case EnvelopeKey::FIELD:
+            if (!Compression::varint_decode(value, length, valueOffset, number) || number >= PARAMETER_TYPE_COUNT)
+                return false;
+            param = (int)number;
+            fields++;
+            break;
+        case EnvelopeKey::FIELD_CODEC:
+            if (!Compression::varint_decode(value, length, valueOffset, number) || number >= Compression::CODEC_COUNT)
+                return false;
+            codec = number;
+            break;
+        case EnvelopeKey::FIELD_N_SAMPLES:
+            if (!Compression::varint_decode(value, length, valueOffset, count))
+                return false;
+            break;
+        case EnvelopeKey::FIELD_VERIFY_OK:
+        case EnvelopeKey::VERIFY_OK_ALL:
+            if (!Compression::varint_decode(value, length, valueOffset, number) || number != 1)
+                return false;
+            break;
+        case EnvelopeKey::FIELD_DATA:
+            if (param < 0)
+                return false;
+            expected.clear();
+            for (const Sample &s : samples)
+            {
+                ParameterType p = static_cast<ParameterType>(param);
+                if (s.slave == slave && s.hasValue(p))
+                    expected.push_back(ESP8266Aggregator::uploadValue(s, p));
+            }
+            if (!Compression::decode_series(static_cast<Compression::Codec>(codec), value, length, count, decoded) ||
+                decoded != expected)
+                return false;
+            break;
+        default:
+            break; // Metadata and metrics the soak does not check
+        }
+    }
+
+    // Every sample placed, every field sent once, every report carried
+    size_t ackCount = 0;
+    if (ctx.configAck && ctx.configAck->has_ack)
+        ackCount = ctx.configAck->accepted.size() + ctx.configAck->rejected.size() +
+                   ctx.configAck->unchanged.size();
+    return pollCount == samples.size() && sawMasks == sparse && sawOffsets == (sparse || ctx.adaptive) &&
+           fields == expectedFields && commands == ctx.commandCount && acks == ackCount;
+}
+
+bool ESP8266SoakBench::begin(Print &out, const SoakOptions &options, const ESP8266PollingConfig &config)
+{
+    if (run_)
+        return false;
+
+    // The longest slave sets the cycle; other slaves' reads overlap on the
+    // poll lanes
+    size_t spans = 0;
+    size_t longest = 0;
+    for (uint8_t i = 0; i < config.slaveCount(); i++)
+    {
+        size_t count = config.slavePlan(i).spanCount();
+        spans += count;
+        if (count > longest)
+            longest = count;
+    }
+    if (spans == 0 || options.pollIntervalMs == 0 || options.uploadIntervalMs == 0 || options.bufferSamples == 0)
+    {
+        out.println("SOAK,error,nothing to poll");
+        return false;
+    }
+    size_t rounds = (spans + POLL_PIPELINE_DEPTH - 1) / POLL_PIPELINE_DEPTH;
+
+    memset(&result_, 0, sizeof(result_));
+    result_.freeHeapStart = ESP.getFreeHeap();
+    result_.freeHeapLow = result_.freeHeapStart;
+    result_.maxBlockLow = ESP.getMaxFreeBlockSize();
+
+    // The config is copied so a change mid-run cannot swap it out
+    run_ = new Run(config, options.bufferSamples);
+    run_->filter.configure(configManager.getDeviceConfig());
+    // Left over from a run cut short by a reboot
+    run_->spill.begin();
+    run_->spill.clear();
+
+    out_ = &out;
+    options_ = options;
+    cycleMs_ = (uint32_t)(rounds > longest ? rounds : longest) * options.latencyMs;
+    lcg_ = 12345; // Deterministic so runs are comparable
+    nonce_ = 1;   // Private nonces; the device's counter is not used
+    endMs_ = (uint64_t)options.days * kDayMs;
+    nextPoll_ = 0;
+    nextUpload_ = options.uploadIntervalMs;
+    busyUntil_ = 0;
+    day_ = 0;
+    queueReports();
+    return true;
+}
+
+bool ESP8266SoakBench::step()
+{
+    if (!run_)
+        return false;
+
+    // Simulated ticks until the time slice is used up; at most one upload,
+    // the expensive tick, per step
+    uint32_t started = millis();
+    bool uploaded = false;
+    bool finished = false;
+    while (!uploaded && millis() - started < SOAK_STEP_MS)
+    {
+        uint64_t now = nextPoll_ <= nextUpload_ ? nextPoll_ : nextUpload_;
+        if (now >= endMs_)
+        {
+            finished = true;
+            break;
+        }
+
+        // Progress once per simulated day; each day also brings reports
+        if (now / kDayMs > day_)
+        {
+            day_ = now / kDayMs;
+            out_->printf("SOAK,day,%u,%u,%u,%u,%u,%u\n", day_, result_.stored, result_.delivered,
+                         result_.dropped + run_->spill.droppedSamples(), ESP.getFreeHeap(),
+                         ESP.getHeapFragmentation());
+            queueReports();
+        }
+        uint32_t secondOfDay = (uint32_t)((now % kDayMs) / 1000);
+
+        if (now == nextPoll_)
+        {
+            nextPoll_ += options_.pollIntervalMs;
+            pollTick(now, secondOfDay);
+        }
+        else
+        {
+            nextUpload_ += options_.uploadIntervalMs;
+            uploaded = uploadTick(now, secondOfDay);
+        }
+    }
+    result_.elapsedMs += millis() - started;
+
+    if (!finished)
+        return true;
+
+    result_.buffered = run_->buffer.size() + run_->spill.pendingSamples();
+    result_.dropped += run_->spill.droppedSamples();
+    if (options_.days > day_)
+        out_->printf("SOAK,day,%u,%u,%u,%u,%u,%u\n", (unsigned)options_.days, result_.stored, result_.delivered,
+                     result_.dropped, ESP.getFreeHeap(), ESP.getHeapFragmentation());
+    run_->spill.clear();
+    delete run_;
+    run_ = nullptr;
+    result_.freeHeapEnd = ESP.getFreeHeap();
+
+    report(*out_, result_);
+    return false;
+}
+
+void ESP8266SoakBench::queueReports()
+{
+    CommandResult result;
+    result.status = "success";
+    result.has_result = true;
+    result.target_register = "export_power";
+    result.value = 100;
+    if (run_->commands.size() < COMMAND_RESULTS_MAX)
+        run_->commands.push_back(result);
+
+    run_->ack.accepted.clear();
+    run_->ack.accepted.push_back("poll_interval");
+    run_->ack.has_ack = true;
+}
+
+void ESP8266SoakBench::pollTick(uint64_t now, uint32_t secondOfDay)
+{
+    if (now < busyUntil_)
+    {
+        // The previous cycle is still waiting on the gateway
+        result_.missedPolls++;
+        return;
+    }
+    result_.polls++;
+    busyUntil_ = now + cycleMs_;
+
+    // One sample per slave, delivered as the slave poller delivers it
+    const ESP8266PollingConfig &config = run_->config;
+    uint8_t reply[ESP8266ModbusHandler::MAX_FRAME_SIZE];
+    uint16_t values[ESP8266ModbusHandler::MAX_READ_REGS];
+    for (uint8_t slave = 0; slave < config.slaveCount(); slave++)
+    {
+        const ESP8266PollPlanner &plan = config.slavePlan(slave);
+        Sample sample;
+        sample.timestamp = (uint32_t)now;
+        sample.slave = slave;
+        uint16_t failedMask = 0;
+        for (size_t i = 0; i < plan.spanCount(); i++)
+        {
+            const PollSpan &span = plan.span(i);
+            lcg_ = lcg_ * 1103515245u + 12345u;
+            size_t length = 0;
+            if ((lcg_ >> 16) % 100 >= options_.lossPercent)
+                length = mockReply(config.slaveAddress(slave), span, secondOfDay, lcg_, reply);
+            if (length > 0 && span.num_regs <= ESP8266ModbusHandler::MAX_READ_REGS &&
+                ESP8266ModbusHandler::parseReadReply(reply, length, span.num_regs, values))
+            {
+                ESP8266Inverter::fillSample(span, values, sample);
+            }
+            else
+            {
+                failedMask |= span.param_mask;
+                result_.failedReads++;
+            }
+        }
+
+        switch (run_->store.store(sample, failedMask))
+        {
+        case StoreResult::STORED:
+            result_.stored++;
+            break;
+        case StoreResult::FAILED:
+            result_.failedSamples++;
+            break;
+        case StoreResult::UNCHANGED:
+            result_.unchanged++;
+            break;
+        case StoreResult::DISCARDED:
+            result_.dropped++;
+            break;
+        }
+    }
+}
+
+bool ESP8266SoakBench::uploadTick(uint64_t now, uint32_t secondOfDay)
+{
+    Run &run = *run_;
+    if (run.store.empty())
+        return false;
+    uint32_t outageS = options_.outagePercent * 864UL;
+    if (secondOfDay >= SOAK_OUTAGE_START_S && secondOfDay < SOAK_OUTAGE_START_S + outageS)
+    {
+        result_.failedUploads++;
+        return false;
+    }
+
+    // One window per upload tick, oldest data first, prepared as the upload
+    // job prepares it
+    UploadContext &ctx = run.upload;
+    ctx.samples = run.store.takeWindow(run.batch.data(), run.batch.size(), ctx.fromSpill);
+    if (ctx.samples.empty())
+        return false;
+    ctx.rollupMode = false;
+    ctx.rollups.clear();
+    ctx.nonce = nonce_++;
+    ctx.deviceId = "soak";
+    ctx.sendTime = (uint32_t)now;
+    ctx.sessionId = ctx.nonce;
+    ctx.commandResults = &run.commands;
+    ctx.commandCount = run.commands.size();
+    ctx.configAck = &run.ack;
+    ctx.adaptive = false;
+    ctx.pollIntervalMs = options_.pollIntervalMs;
+    ctx.powerMode = POWER_MODE_ALWAYS_ON;
+    ctx.radioOnLastHourS = 0;
+    ESP8266UploadBuilder::encode(ctx, run.config);
+    metrics.summarize(ctx.metrics);
+
+    const char *psk = configManager.getSecurityConfig().psk;
+    CloudSink cloud;
+    ESP8266UploadBuilder::writeEnvelope(cloud, ctx, psk);
+
+    // Heap is at its peak here: window encodings and the body
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t maxBlock = ESP.getMaxFreeBlockSize();
+    uint8_t fragmentation = ESP.getHeapFragmentation();
+    if (freeHeap < result_.freeHeapLow)
+        result_.freeHeapLow = freeHeap;
+    if (maxBlock < result_.maxBlockLow)
+        result_.maxBlockLow = maxBlock;
+    if (fragmentation > result_.fragmentationPeak)
+        result_.fragmentationPeak = fragmentation;
+
+    if (verifyEnvelope(cloud.body, psk, ctx))
+    {
+        result_.uploads++;
+        result_.delivered += ctx.samples.size();
+        result_.commands += ctx.commandCount;
+        result_.wireBytes += cloud.body.size();
+        run.store.consumeWindow(ctx.fromSpill);
+        run.commands.clear();
+        run.ack.has_ack = false;
+    }
+    else
+    {
+        result_.rejected++;
+        run.store.keepWindow(ctx.fromSpill);
+    }
+    ctx.samples = SampleWindow();
+    std::vector<FieldEncoding>().swap(ctx.fields);
+    return true;
+}
+
+void ESP8266SoakBench::report(Print &out, const SoakResult &result)
+{
+    float seconds = result.elapsedMs / 1000.0f;
+    float samplesPerS = seconds > 0.0f ? result.delivered / seconds : 0.0f;
+    float bytesPerSample = result.delivered ? (float)result.wireBytes / result.delivered : 0.0f;
+    float lossPct = result.stored ? 100.0f * result.dropped / result.stored : 0.0f;
+
+    out.printf("SOAK,polls,%u\n", result.polls);
+    out.printf("SOAK,missed_polls,%u\n", result.missedPolls);
+    out.printf("SOAK,failed_reads,%u\n", result.failedReads);
+    out.printf("SOAK,failed_samples,%u\n", result.failedSamples);
+    out.printf("SOAK,unchanged,%u\n", result.unchanged);
+    out.printf("SOAK,stored,%u\n", result.stored);
+    out.printf("SOAK,delivered,%u\n", result.delivered);
+    out.printf("SOAK,commands,%u\n", result.commands);
+    out.printf("SOAK,buffered,%u\n", result.buffered);
+    out.printf("SOAK,dropped,%u\n", result.dropped);
+    out.print("SOAK,loss_pct,");
+    out.println(lossPct, 3);
+    out.printf("SOAK,uploads,%u\n", result.uploads);
+    out.printf("SOAK,failed_uploads,%u\n", result.failedUploads);
+    out.printf("SOAK,rejected,%u\n", result.rejected);
+    out.printf("SOAK,elapsed_ms,%u\n", result.elapsedMs);
+    out.print("SOAK,samples_per_s,");
+    out.println(samplesPerS, 1);
+    out.print("SOAK,bytes_per_sample,");
+    out.println(bytesPerSample, 3);
+    out.printf("SOAK,heap_free_low,%u\n", result.freeHeapLow);
+    out.printf("SOAK,heap_max_block_low,%u\n", result.maxBlockLow);
+    out.printf("SOAK,heap_fragmentation_peak,%u\n", result.fragmentationPeak);
+    out.printf("SOAK,heap_drift,%d\n", (int)(result.freeHeapStart - result.freeHeapEnd));
+}
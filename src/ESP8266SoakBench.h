@@ -0,0 +1,118 @@
+#ifndef ESP8266_SOAK_BENCH_H
+#define ESP8266_SOAK_BENCH_H
+
+#include <Arduino.h>
+#include <vector>
+#include "ESP8266DataTypes.h"
+#include "ESP8266PollingConfig.h"
+#include "ESP8266UploadBuilder.h"
+
+#define SOAK_MAX_DAYS 30         // Longest simulated run accepted by the serial command
+#define SOAK_OUTAGE_START_S 43200 // Daily cloud outage starts at simulated noon
+#define SOAK_STEP_MS 20           // Run time of one scheduler step
+#define SOAK_SPILL_DIR "/soak"    // The run's own spill queue, emptied when it ends
+
+struct SoakOptions
+{
+    uint16_t days;              // Simulated days of polling
+    uint8_t lossPercent;        // Gateway span reads that get no reply
+    uint16_t latencyMs;         // Gateway round trip per span read
+    uint8_t outagePercent;      // Share of each day the cloud is unreachable
+    uint32_t pollIntervalMs;    // Simulated poll tick
+    uint32_t uploadIntervalMs;  // Simulated upload tick
+    size_t bufferSamples;       // Ring buffer capacity, as on the device
+};
+
+// Totals of one soak run
+struct SoakResult
+{
+    uint32_t polls;          // Poll ticks that started a cycle
+    uint32_t missedPolls;    // Poll ticks skipped because the previous cycle was still reading
+    uint32_t failedReads;    // Span reads without a reply
+    uint32_t failedSamples;  // Samples not kept because a span failed
+    uint32_t unchanged;      // Samples the report filter left out
+    uint32_t stored;         // Samples appended to the ring buffer
+    uint32_t dropped;        // Samples lost: ring full and not spilled, or spill segments dropped
+    uint32_t delivered;      // Samples the mock cloud decoded and verified
+    uint32_t commands;       // Command results the mock cloud received
+    uint32_t buffered;       // Samples still in the ring or the spill queue when the run ended
+    uint32_t uploads;        // Envelopes accepted by the mock cloud
+    uint32_t failedUploads;  // Upload ticks that hit an outage
+    uint32_t rejected;       // Envelopes failing the HMAC or decode checks
+    uint64_t wireBytes;      // Envelope bytes, header and MAC included
+    uint32_t elapsedMs;      // Time spent in soak steps, other jobs excluded
+    uint32_t freeHeapStart;
+    uint32_t freeHeapEnd;
+    uint32_t freeHeapLow;    // Lowest free heap seen while an upload was built
+    uint32_t maxBlockLow;    // Smallest largest-free-block seen
+    uint8_t fragmentationPeak;
+};
+
+// Accelerated end-to-end soak of the data path on the device itself. A
+// mock gateway answers every slave's span reads with CRC-framed Read
+// Holding Registers replies (synthetic day curves, optional loss). Each
+// slave's sample goes through the firmware's own ESP8266SampleStore (report
+// filter, ring buffer, spill queue) and each upload window through
+// ESP8266UploadBuilder into the signed binary envelope the device sends,
+// command results and a config ack included. A mock cloud checks the HMAC
+// and decodes every record back against the samples that went out.
+// Time is simulated, so days of polling run in seconds; the store, its
+// spill directory (SOAK_SPILL_DIR) and the polling config are private
+// copies, so neither the network nor the device's own buffer and state are
+// touched. The run is a scheduler job: each step() simulates ticks for
+// SOAK_STEP_MS and returns, so real polls and uploads keep their slots.
+// Prints progress once per simulated day and one summary:
+//
+//   SOAK,day,<day>,<stored>,<delivered>,<dropped>,<free_heap>,<fragmentation>
+//   SOAK,<metric>,<value>
+class ESP8266SoakBench
+{
+public:
+    ESP8266SoakBench();
+
+    // Options from the device config: its poll and upload rates and buffer size
+    static SoakOptions defaults();
+    // Start a run over a copy of config; false when one is running or there
+    // is nothing to poll
+    bool begin(Print &out, const SoakOptions &options, const ESP8266PollingConfig &config);
+    // Advance the run by one time slice; false once it has finished and
+    // printed its summary
+    bool step();
+    bool running() const { return run_ != nullptr; }
+
+private:
+    struct Run; // Private pipeline, allocated for one run
+
+    Print *out_;
+    SoakOptions options_;
+    SoakResult result_;
+    Run *run_;
+    uint32_t cycleMs_; // Simulated gateway time of one poll cycle
+    uint32_t lcg_;
+    uint32_t nonce_;
+    uint64_t endMs_;
+    uint64_t nextPoll_;
+    uint64_t nextUpload_;
+    uint64_t busyUntil_; // The simulated gateway is busy with a cycle until here
+    uint32_t day_;
+
+    void pollTick(uint64_t now, uint32_t secondOfDay);
+    // False when the tick had nothing to send or hit an outage
+    bool uploadTick(uint64_t now, uint32_t secondOfDay);
+    // A command result and a config ack for the next upload to carry
+    void queueReports();
+
+    // Mock gateway: register value at a simulated time of day
+    static uint16_t mockRegister(uint16_t reg, uint32_t secondOfDay, uint32_t &lcg);
+    // Build the reply the gateway would send for one span read
+    static size_t mockReply(uint8_t address, const PollSpan &span, uint32_t secondOfDay, uint32_t &lcg,
+                            uint8_t *reply);
+    // Mock cloud: check the envelope's HMAC, then every field, sample
+    // record and report against what the upload carried
+    static bool verifyEnvelope(const std::vector<uint8_t> &body, const char *psk, const UploadContext &ctx);
+    static void report(Print &out, const SoakResult &result);
+};
+
+extern ESP8266SoakBench soakBench;
+
+#endif // ESP8266_SOAK_BENCH_H
@@ -0,0 +1,522 @@
+#include "ESP8266SpillQueue.h"
+#include "ESP8266Compression.h"
+#include "ESP8266ModbusHandler.h"
+#include "ESP8266Log.h"
+
+ESP8266SpillQueue spillQueue;
+
+ESP8266SpillQueue::ESP8266SpillQueue(const char *dir)
+    : dir_(dir), mounted_(false), readSeg_(0), readOffset_(0), lastSeg_(0), writeOffset_(0), peekedLength_(0),
+      peekedCount_(0), pendingSamples_(0), spilledTotal_(0), drainedTotal_(0), droppedTotal_(0),
+      drainSessionSamples_(0), drainSessionStart_(0)
+{
+}
+
+String ESP8266SpillQueue::segmentPath(uint32_t seg) const
+{
+    return String(dir_) + "/" + String(seg) + ".seg";
+}
+
+String ESP8266SpillQueue::cursorPath() const
+{
+    return String(dir_) + "/cursor";
+}
+
+uint32_t ESP8266SpillQueue::segmentSize(uint32_t seg) const
+{
+    File f = LittleFS.open(segmentPath(seg), "r");
+    if (!f)
+        return 0;
+    uint32_t size = f.size();
+    f.close();
+    return size;
+}
+
+bool ESP8266SpillQueue::begin()
+{
+    if (!LittleFS.begin())
+    {
+        LOG_E("SPILL", "Failed to mount LittleFS, spill queue disabled");
+        return false;
+    }
+    mounted_ = true;
+    LittleFS.mkdir(dir_);
+
+    // Restore the drain cursor
+    bool haveCursor = false;
+    File cursor = LittleFS.open(cursorPath(), "r");
+    if (cursor && cursor.size() == 8)
+    {
+        uint8_t buf[8];
+        if (cursor.read(buf, sizeof(buf)) == sizeof(buf))
+        {
+            memcpy(&readSeg_, buf, 4);
+            memcpy(&readOffset_, buf + 4, 4);
+            haveCursor = true;
+        }
+    }
+    if (cursor)
+        cursor.close();
+
+    // Find the segment range on flash
+    bool anySegment = false;
+    uint32_t minSeg = 0;
+    uint32_t maxSeg = 0;
+    Dir dir = LittleFS.openDir(dir_);
+    while (dir.next())
+    {
+        String name = dir.fileName();
+        if (!name.endsWith(".seg"))
+            continue;
+        uint32_t seg = (uint32_t)name.toInt();
+        if (haveCursor && seg < readSeg_)
+        {
+            // Already drained before the last reboot
+            LittleFS.remove(segmentPath(seg));
+            continue;
+        }
+        if (!anySegment || seg < minSeg)
+            minSeg = seg;
+        if (!anySegment || seg > maxSeg)
+            maxSeg = seg;
+        anySegment = true;
+    }
+
+    if (!anySegment)
+    {
+        if (!haveCursor)
+            readSeg_ = 0;
+        readOffset_ = 0;
+        lastSeg_ = readSeg_;
+        writeOffset_ = 0;
+    }
+    else
+    {
+        if (!haveCursor || readSeg_ < minSeg)
+        {
+            readSeg_ = minSeg;
+            readOffset_ = 0;
+        }
+        lastSeg_ = maxSeg;
+        writeOffset_ = segmentSize(lastSeg_);
+    }
+
+    recount();
+
+    LOG_I("SPILL", "Queue ready: %u samples pending on flash", (unsigned)pendingSamples_);
+    return true;
+}
+
+uint32_t ESP8266SpillQueue::countSamples(uint32_t seg, uint32_t fromOffset) const
+{
+    File f = LittleFS.open(segmentPath(seg), "r");
+    if (!f)
+        return 0;
+
+    uint32_t size = f.size();
+    uint32_t offset = fromOffset;
+    uint32_t total = 0;
+    while (offset + 4 <= size)
+    {
+        uint8_t head[7];
+        f.seek(offset, SeekSet);
+        size_t got = f.read(head, sizeof(head));
+        if (got < 3)
+            break;
+        uint16_t len = head[0] | (head[1] << 8);
+        if (len == 0 || len > SPILL_MAX_RECORD_BYTES || offset + len + 4 > size)
+            break; // Truncated tail from a power loss mid-append
+
+        size_t pos = 0;
+        uint32_t count = 0;
+        if (!Compression::varint_decode(head + 2, got - 2, pos, count))
+            break;
+        total += count;
+        offset += len + 4;
+    }
+    f.close();
+    return total;
+}
+
+void ESP8266SpillQueue::recount()
+{
+    pendingSamples_ = 0;
+    for (uint32_t seg = readSeg_; seg <= lastSeg_; seg++)
+    {
+        pendingSamples_ += countSamples(seg, seg == readSeg_ ? readOffset_ : 0);
+    }
+}
+
+void ESP8266SpillQueue::saveCursor()
+{
+    File f = LittleFS.open(cursorPath(), "w");
+    if (!f)
+        return;
+    uint8_t buf[8];
+    memcpy(buf, &readSeg_, 4);
+    memcpy(buf + 4, &readOffset_, 4);
+    f.write(buf, sizeof(buf));
+    f.close();
+}
+
+void ESP8266SpillQueue::advanceSegment()
+{
+    lastSeg_++;
+    writeOffset_ = 0;
+    while (lastSeg_ - readSeg_ + 1 > SPILL_MAX_SEGMENTS)
+    {
+        dropOldestSegment();
+    }
+}
+
+void ESP8266SpillQueue::dropOldestSegment()
+{
+    uint32_t dropped = countSamples(readSeg_, readOffset_);
+    LOG_W("SPILL", "Queue full, dropping oldest segment (%u samples)", (unsigned)dropped);
+
+    LittleFS.remove(segmentPath(readSeg_));
+    pendingSamples_ = (dropped > pendingSamples_) ? 0 : pendingSamples_ - dropped;
+    droppedTotal_ += dropped;
+    readSeg_++;
+    readOffset_ = 0;
+    peekedLength_ = 0;
+    saveCursor();
+}
+
+void ESP8266SpillQueue::finishSegment()
+{
+    // Whole-segment delete: a drained block is freed rather than rewritten
+    LittleFS.remove(segmentPath(readSeg_));
+    if (readSeg_ >= lastSeg_)
+    {
+        lastSeg_ = readSeg_ + 1;
+        writeOffset_ = 0;
+    }
+    readSeg_++;
+    readOffset_ = 0;
+    saveCursor();
+}
+
+bool ESP8266SpillQueue::append(const SampleWindow &samples)
+{
+    if (!mounted_ || samples.empty())
+        return false;
+
+    std::vector<uint8_t> payload;
+    encode(samples, payload);
+    if (payload.size() > SPILL_MAX_RECORD_BYTES)
+    {
+        LOG_E("SPILL", "Record too large, not spilled");
+        return false;
+    }
+
+    uint32_t recordLen = payload.size() + 4;
+    if (writeOffset_ > 0 && writeOffset_ + recordLen > SPILL_SEGMENT_BYTES)
+    {
+        advanceSegment();
+    }
+
+    File f = LittleFS.open(segmentPath(lastSeg_), "a");
+    if (!f)
+    {
+        LOG_E("SPILL", "Failed to open segment for append");
+        return false;
+    }
+
+    uint16_t crc = ESP8266ModbusHandler::calculateCRC(payload.data(), payload.size());
+    uint8_t head[2] = {(uint8_t)(payload.size() & 0xFF), (uint8_t)(payload.size() >> 8)};
+    uint8_t tail[2] = {(uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+    size_t written = f.write(head, 2);
+    written += f.write(payload.data(), payload.size());
+    written += f.write(tail, 2);
+    f.close();
+
+    if (written != recordLen)
+    {
+        // Leave the partial record behind and continue in a fresh segment
+        LOG_W("SPILL", "Short write, rotating segment");
+        advanceSegment();
+        return false;
+    }
+
+    uint32_t count = samples.size() < SPILL_BLOCK_SAMPLES ? samples.size() : SPILL_BLOCK_SAMPLES;
+    if (pendingSamples_ == 0)
+    {
+        // A new backlog starts; restart the drain rate measurement
+        drainSessionSamples_ = 0;
+        drainSessionStart_ = 0;
+    }
+    writeOffset_ += recordLen;
+    pendingSamples_ += count;
+    spilledTotal_ += count;
+
+    LOG_I("SPILL", "Spilled %u samples (%u bytes) to segment %u", (unsigned)count, (unsigned)recordLen,
+          (unsigned)lastSeg_);
+    return true;
+}
+
+bool ESP8266SpillQueue::readRecord(File &f, uint32_t offset, uint32_t segmentSize, Sample *out, size_t capacity,
+                                   size_t &count, uint32_t &length)
+{
+    uint8_t head[2];
+    f.seek(offset, SeekSet);
+    if (f.read(head, 2) != 2)
+        return false;
+    uint16_t len = head[0] | (head[1] << 8);
+    if (len == 0 || len > SPILL_MAX_RECORD_BYTES || offset + len + 4 > segmentSize)
+        return false;
+
+    std::vector<uint8_t> payload(len);
+    uint8_t tail[2];
+    if (f.read(payload.data(), len) != len || f.read(tail, 2) != 2)
+        return false;
+    uint16_t crc = tail[0] | (tail[1] << 8);
+    if (crc != ESP8266ModbusHandler::calculateCRC(payload.data(), len))
+        return false;
+
+    count = decode(payload.data(), len, out, capacity);
+    length = len + 4;
+    return count > 0;
+}
+
+size_t ESP8266SpillQueue::peek(Sample *out, size_t capacity)
+{
+    peekedLength_ = 0;
+    if (!mounted_)
+        return 0;
+
+    while (pendingSamples_ > 0)
+    {
+        uint32_t size = segmentSize(readSeg_);
+        if (readOffset_ >= size)
+        {
+            if (readSeg_ >= lastSeg_)
+            {
+                pendingSamples_ = 0;
+                break;
+            }
+            finishSegment();
+            continue;
+        }
+
+        File f = LittleFS.open(segmentPath(readSeg_), "r");
+        size_t count = 0;
+        uint32_t length = 0;
+        bool valid = f && readRecord(f, readOffset_, size, out, capacity, count, length);
+        if (valid)
+        {
+            // Further records of this segment while another whole block fits;
+            // a bad one is left for the next peek to skip
+            while (capacity - count >= SPILL_BLOCK_SAMPLES && readOffset_ + length < size)
+            {
+                size_t more = 0;
+                uint32_t moreLength = 0;
+                if (!readRecord(f, readOffset_ + length, size, out + count, capacity - count, more, moreLength))
+                    break;
+                count += more;
+                length += moreLength;
+            }
+        }
+        if (f)
+            f.close();
+
+        if (valid)
+        {
+            peekedLength_ = length;
+            peekedCount_ = count;
+            if (drainSessionStart_ == 0)
+                drainSessionStart_ = millis();
+            return count;
+        }
+
+        // The rest of this segment cannot be trusted; move on
+        LOG_W("SPILL", "Corrupt record in segment %u, skipping rest of segment", (unsigned)readSeg_);
+        if (readSeg_ >= lastSeg_)
+        {
+            finishSegment();
+            pendingSamples_ = 0;
+            break;
+        }
+        finishSegment();
+        recount();
+    }
+    return 0;
+}
+
+void ESP8266SpillQueue::pop()
+{
+    if (peekedLength_ == 0)
+        return;
+
+    readOffset_ += peekedLength_;
+    pendingSamples_ = (peekedCount_ > pendingSamples_) ? 0 : pendingSamples_ - peekedCount_;
+    drainedTotal_ += peekedCount_;
+    drainSessionSamples_ += peekedCount_;
+    peekedLength_ = 0;
+
+    if (readOffset_ >= segmentSize(readSeg_))
+        finishSegment();
+    else
+        saveCursor();
+}
+
+void ESP8266SpillQueue::clear()
+{
+    if (!mounted_)
+        return;
+    for (uint32_t seg = readSeg_; seg <= lastSeg_; seg++)
+    {
+        LittleFS.remove(segmentPath(seg));
+    }
+    LittleFS.remove(cursorPath());
+    readSeg_ = 0;
+    readOffset_ = 0;
+    lastSeg_ = 0;
+    writeOffset_ = 0;
+    peekedLength_ = 0;
+    pendingSamples_ = 0;
+    drainSessionSamples_ = 0;
+    drainSessionStart_ = 0;
+}
+
+uint32_t ESP8266SpillQueue::pendingBytes() const
+{
+    if (!mounted_ || pendingSamples_ == 0)
+        return 0;
+    uint32_t total = 0;
+    for (uint32_t seg = readSeg_; seg <= lastSeg_; seg++)
+    {
+        total += segmentSize(seg);
+    }
+    return total > readOffset_ ? total - readOffset_ : 0;
+}
+
+uint32_t ESP8266SpillQueue::drainRatePerMinute() const
+{
+    if (drainSessionStart_ == 0 || drainSessionSamples_ == 0)
+        return 0;
+    uint32_t elapsed = millis() - drainSessionStart_;
+    if (elapsed == 0)
+        elapsed = 1;
+    return (uint32_t)((uint64_t)drainSessionSamples_ * 60000ULL / elapsed);
+}
+
+void ESP8266SpillQueue::printStatus() const
+{
+    if (!mounted_)
+    {
+        Serial.println("Spill Queue: unavailable (LittleFS not mounted)");
+        return;
+    }
+
+    Serial.print("Spill Queue: ");
+    Serial.print(pendingSamples_);
+    Serial.print(" samples (");
+    Serial.print(pendingBytes());
+    Serial.print(" bytes in ");
+    Serial.print(pendingSamples_ ? lastSeg_ - readSeg_ + 1 : 0);
+    Serial.println(" segment(s))");
+
+    Serial.print("Spill Drain: ");
+    Serial.print(drainRatePerMinute());
+    Serial.print(" samples/min, ");
+    Serial.print(drainedTotal_);
+    Serial.print(" drained, ");
+    Serial.print(spilledTotal_);
+    Serial.print(" spilled, ");
+    Serial.print(droppedTotal_);
+    Serial.println(" dropped");
+}
+
+void ESP8266SpillQueue::encode(const SampleWindow &samples, std::vector<uint8_t> &out)
+{
+    size_t count = samples.size() < SPILL_BLOCK_SAMPLES ? samples.size() : SPILL_BLOCK_SAMPLES;
+    out.clear();
+    out.reserve(count * 8);
+
+    uint16_t unionMask = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        unionMask |= samples[i].present_mask;
+    }
+
+    Compression::varint_encode(count, out);
+    Compression::varint_encode(unionMask, out);
+    Compression::varint_encode(samples[0].timestamp, out);
+    for (size_t i = 1; i < count; i++)
+    {
+        Compression::varint_encode(samples[i].timestamp - samples[i - 1].timestamp, out);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        // The slave index rides above the mask bits; slave 0 encodes as before
+        Compression::varint_encode(samples[i].present_mask | ((uint32_t)samples[i].slave << 16), out);
+    }
+
+    // Column per parameter: raw values delta-coded across the samples that have it
+    for (uint8_t bit = 0; bit < PARAMETER_TYPE_COUNT; bit++)
+    {
+        uint16_t flag = (uint16_t)(1u << bit);
+        if (!(unionMask & flag))
+            continue;
+        int32_t prev = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!(samples[i].present_mask & flag))
+                continue;
+            int32_t value = samples[i].raw[bit];
+            Compression::varint_encode(Compression::zigzag_encode(value - prev), out);
+            prev = value;
+        }
+    }
+}
+
+size_t ESP8266SpillQueue::decode(const uint8_t *data, size_t len, Sample *out, size_t capacity)
+{
+    size_t pos = 0;
+    uint32_t count = 0;
+    uint32_t unionMask = 0;
+    uint32_t value = 0;
+
+    if (!Compression::varint_decode(data, len, pos, count) || count == 0 || count > capacity)
+        return 0;
+    if (!Compression::varint_decode(data, len, pos, unionMask))
+        return 0;
+
+    if (!Compression::varint_decode(data, len, pos, value))
+        return 0;
+    out[0] = Sample();
+    out[0].timestamp = value;
+    for (uint32_t i = 1; i < count; i++)
+    {
+        if (!Compression::varint_decode(data, len, pos, value))
+            return 0;
+        out[i] = Sample();
+        out[i].timestamp = out[i - 1].timestamp + value;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!Compression::varint_decode(data, len, pos, value))
+            return 0;
+        out[i].present_mask = (uint16_t)value;
+        out[i].slave = (uint8_t)(value >> 16);
+    }
+
+    for (uint8_t bit = 0; bit < PARAMETER_TYPE_COUNT; bit++)
+    {
+        uint16_t flag = (uint16_t)(1u << bit);
+        if (!(unionMask & flag))
+            continue;
+        int32_t prev = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!(out[i].present_mask & flag))
+                continue;
+            if (!Compression::varint_decode(data, len, pos, value))
+                return 0;
+            prev += Compression::zigzag_decode(value);
+            out[i].raw[bit] = (uint16_t)prev;
+        }
+    }
+    return count;
+}
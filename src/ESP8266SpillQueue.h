@@ -0,0 +1,94 @@
+#ifndef ESP8266_SPILL_QUEUE_H
+#define ESP8266_SPILL_QUEUE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <vector>
+#include "ESP8266DataTypes.h"
+
+#define SPILL_DIR "/spill"
+#define SPILL_SEGMENT_BYTES 4096 // One LittleFS block per segment
+#define SPILL_MAX_SEGMENTS 16    // 64 KB of flash before the oldest segment is dropped
+#define SPILL_BLOCK_SAMPLES 50   // Samples per compressed record (one upload batch)
+#define SPILL_MAX_RECORD_BYTES 2048
+
+// Log-structured on-flash queue for samples that no longer fit in RAM while
+// the cloud is unreachable. Samples are appended as compressed records
+// (delta + zigzag + varint per parameter, CRC16 trailer) to segment files
+// that are only ever appended to and deleted whole once drained, so flash
+// blocks are never rewritten in place. A small cursor file remembers how far
+// the uploader has drained across reboots. Each queue owns one directory.
+//
+// Record layout: [u16 payload length][payload][u16 CRC16 of payload]
+// Payload: varint count, varint union mask, varint first timestamp,
+//          varint timestamp deltas, varint per-sample masks (slave index
+//          in bits 16 and up), then per parameter in the union mask the
+//          zigzag-varint deltas of raw values.
+class ESP8266SpillQueue
+{
+public:
+    explicit ESP8266SpillQueue(const char *dir = SPILL_DIR);
+
+    // Mount LittleFS and recover segments and the drain cursor
+    bool begin();
+
+    // Append up to SPILL_BLOCK_SAMPLES samples as one compressed record
+    bool append(const SampleWindow &samples);
+
+    // Decode the oldest record into out without consuming it, followed by
+    // further records of the same segment while another SPILL_BLOCK_SAMPLES
+    // fit, so a catch-up upload can carry several blocks. Corrupt or
+    // truncated records are skipped. Returns the number of samples decoded.
+    size_t peek(Sample *out, size_t capacity);
+    // Consume the records returned by the last peek()
+    void pop();
+    // Delete every segment and the cursor; the queue starts over empty
+    void clear();
+
+    bool empty() const { return pendingSamples_ == 0; }
+    uint32_t pendingSamples() const { return pendingSamples_; }
+    uint32_t pendingBytes() const;
+    // Samples lost to whole-segment drops while the queue was full
+    uint32_t droppedSamples() const { return droppedTotal_; }
+    // Samples drained per minute since the current backlog started draining
+    uint32_t drainRatePerMinute() const;
+
+    void printStatus() const;
+
+private:
+    const char *dir_;
+    bool mounted_;
+    uint32_t readSeg_;    // Drain cursor; also the oldest segment on flash
+    uint32_t readOffset_;
+    uint32_t lastSeg_;    // Segment currently being appended to
+    uint32_t writeOffset_;
+    uint32_t peekedLength_; // Bytes of the record returned by peek(), 0 if none
+    uint32_t peekedCount_;
+
+    uint32_t pendingSamples_;
+    uint32_t spilledTotal_;
+    uint32_t drainedTotal_;
+    uint32_t droppedTotal_;
+    uint32_t drainSessionSamples_;
+    unsigned long drainSessionStart_;
+
+    String segmentPath(uint32_t seg) const;
+    String cursorPath() const;
+    uint32_t segmentSize(uint32_t seg) const;
+    uint32_t countSamples(uint32_t seg, uint32_t fromOffset) const;
+    void recount();
+    void saveCursor();
+    void advanceSegment();
+    void finishSegment();
+    void dropOldestSegment();
+
+    // Decode the record at offset; its on-flash size goes to length
+    static bool readRecord(File &f, uint32_t offset, uint32_t segmentSize, Sample *out, size_t capacity, size_t &count,
+                           uint32_t &length);
+    static void encode(const SampleWindow &samples, std::vector<uint8_t> &out);
+    static size_t decode(const uint8_t *data, size_t len, Sample *out, size_t capacity);
+};
+
+extern ESP8266SpillQueue spillQueue;
+
+#endif // ESP8266_SPILL_QUEUE_H
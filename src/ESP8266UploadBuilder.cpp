@@ -0,0 +1,477 @@
+#include "ESP8266UploadBuilder.h"
+#include "ESP8266JsonWriter.h"
+#include "ESP8266Parameters.h"
+#include "ESP8266PollPlanner.h"
+#include "ESP8266PowerManager.h"
+#include "ESP8266Security.h"
+#include "ESP8266UploadEnvelope.h"
+
+namespace
+{
+    // Simple CRC32 (polynomial 0xEDB88320) for MAC stub
+    uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            crc ^= data[i];
+            for (int j = 0; j < 8; ++j)
+            {
+                uint32_t mask = -(crc & 1u);
+                crc = (crc >> 1) ^ (0xEDB88320u & mask);
+            }
+        }
+        return crc;
+    }
+
+    // Pass-through Print that keeps a running CRC32 of the bytes written
+    class Crc32Print : public Print
+    {
+    public:
+        explicit Crc32Print(Print &out) : out_(out), crc_(0xFFFFFFFFu) {}
+
+        size_t write(uint8_t byte) override
+        {
+            crc_ = crc32_update(crc_, &byte, 1);
+            return out_.write(byte);
+        }
+        size_t write(const uint8_t *data, size_t length) override
+        {
+            crc_ = crc32_update(crc_, data, length);
+            return out_.write(data, length);
+        }
+        using Print::write;
+
+        // CRC of everything written so far followed by one more byte that is not sent
+        uint32_t valueWith(uint8_t extra) const { return ~crc32_update(crc_, &extra, 1); }
+
+    private:
+        Print &out_;
+        uint32_t crc_;
+    };
+}
+
+void ESP8266UploadBuilder::collectSeries(const SampleWindow &samples, ParameterType param, std::vector<long> &series,
+                                         RunningStats *stats, uint8_t slave)
+{
+    series.clear();
+    series.reserve(samples.size());
+    if (stats)
+        stats->reset();
+    for (const auto &s : samples)
+    {
+        if (s.slave != slave || !s.hasValue(param))
+            continue;
+        int32_t scaled = ESP8266Aggregator::uploadValue(s, param);
+        series.push_back(scaled);
+        if (stats)
+            stats->add(scaled);
+    }
+}
+
+bool ESP8266UploadBuilder::encodeField(const SampleWindow &samples, ParameterType param, uint8_t slave,
+                                       FieldEncoding &field)
+{
+    std::vector<long> series;
+    RunningStats stats;
+    collectSeries(samples, param, series, &stats, slave);
+    if (series.empty())
+        return false; // nothing to add
+
+    // Smallest codec for this field and window, verified by decoding it back
+    unsigned long t0 = micros();
+    field.codec = Compression::encode_best(series, field.encoded);
+    Compression::delta_compress(series, field.deltas);
+    std::vector<long> recon;
+    bool verify_ok = Compression::decode_series(field.codec, field.encoded.data(), field.encoded.size(), series.size(), recon) &&
+                     recon == series;
+    unsigned long t1 = micros();
+
+    field.param = param;
+    field.slave = slave;
+    field.n_samples = series.size();
+    field.minV = stats.minV;
+    field.maxV = stats.maxV;
+    field.avg = stats.mean;
+    field.cpu_ms = (t1 - t0) / 1000.0f;
+    field.verify_ok = verify_ok;
+    return true;
+}
+
+uint16_t ESP8266UploadBuilder::changeMask(const UploadContext &ctx, const Sample &s)
+{
+    return s.present_mask & ctx.config->slaveParamMask(s.slave);
+}
+
+void ESP8266UploadBuilder::encode(UploadContext &ctx, const ESP8266PollingConfig &config)
+{
+    const SampleWindow &samples = ctx.samples;
+    ctx.config = &config;
+    // Derive window timing from first/last sample timestamps
+    ctx.window_start = samples.empty() ? 0 : samples.front().timestamp;
+    ctx.window_end = samples.empty() ? 0 : samples.back().timestamp;
+    if (ctx.rollupMode)
+    {
+        ctx.window_start = ctx.rollups.front().start_ms;
+        ctx.window_end = ctx.rollups.back().end_ms;
+    }
+
+    // Compress every field once; only the compact results are kept
+    ctx.totalOriginalBytes = 0;
+    ctx.totalCompressedBytes = 0;
+    ctx.totalCpuMs = 0.0f;
+    ctx.verifyAll = true;
+
+    // Primary inverter first, in the configured order; then each further
+    // slave's parameters in table order
+    const auto enabledParams = config.getEnabledParameters();
+    uint8_t slaveCount = config.slaveCount();
+    std::vector<FieldEncoding> &fields = ctx.fields;
+    fields.clear();
+    fields.reserve(enabledParams.size() * slaveCount);
+    auto addField = [&](ParameterType p, uint8_t slave)
+    {
+        fields.emplace_back();
+        if (!encodeField(samples, p, slave, fields.back()))
+        {
+            fields.pop_back();
+            return;
+        }
+        const FieldEncoding &f = fields.back();
+        ctx.totalOriginalBytes += 4 * f.n_samples;
+        ctx.totalCompressedBytes += f.encoded.size();
+        ctx.totalCpuMs += f.cpu_ms;
+        ctx.verifyAll = ctx.verifyAll && f.verify_ok;
+    };
+    for (ParameterType p : enabledParams)
+        addField(p, 0);
+    for (uint8_t slave = 1; slave < slaveCount; slave++)
+    {
+        for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+        {
+            ParameterType p = static_cast<ParameterType>(i);
+            if (config.slaveParamMask(slave) & ESP8266PollPlanner::paramBit(p))
+                addField(p, slave);
+        }
+    }
+
+    // Deadband-filtered (or partially failed) samples: the server needs each
+    // sample's time and change bitmap to place the shorter field series.
+    // Several inverters always interleave, so their samples also carry the
+    // slave address.
+    bool multiSlave = slaveCount > 1;
+    ctx.sparse = multiSlave;
+    for (const auto &s : samples)
+    {
+        uint16_t slaveMask = config.slaveParamMask(s.slave);
+        ctx.sparse = ctx.sparse || (s.present_mask & slaveMask) != slaveMask;
+    }
+    // An adaptive interval leaves no fixed spacing to rebuild the timeline from
+    ctx.timed = ctx.sparse || ctx.adaptive;
+    ctx.sampleOffsets.clear();
+    ctx.sampleMasks.clear();
+    ctx.sampleSlaves.clear();
+    for (const auto &s : samples)
+    {
+        if (ctx.timed)
+            Compression::varint_encode(s.timestamp - ctx.window_start, ctx.sampleOffsets);
+        if (ctx.sparse)
+            Compression::varint_encode(changeMask(ctx, s), ctx.sampleMasks);
+        if (ctx.sparse && multiSlave)
+            Compression::varint_encode(config.slaveAddress(s.slave), ctx.sampleSlaves);
+    }
+}
+
+// Members of one slave's "fields" object
+void ESP8266UploadBuilder::writeFieldObjects(ESP8266JsonWriter &json, const UploadContext &ctx, uint8_t slave)
+{
+    for (const FieldEncoding &f : ctx.fields)
+    {
+        if (f.slave != slave)
+            continue;
+        json.beginObject(FPSTR(param_key(f.param)));
+        json.field("method", Compression::codec_name(f.codec));
+        json.field("param_id", static_cast<int>(f.param));
+        json.field("n_samples", (int)f.n_samples);
+        json.field("bytes_len", (int)f.encoded.size());
+        json.field("cpu_time_ms", f.cpu_ms);
+        json.field("verify_ok", f.verify_ok);
+        json.field("original_bytes", (int)(4 * f.n_samples));
+
+        json.beginObject("agg");
+        json.field("min", f.minV);
+        json.field("avg", f.avg);
+        json.field("max", f.maxV);
+        json.endObject();
+
+        json.beginArray("payload");
+        for (int32_t d : f.deltas)
+            json.value((long)d);
+        json.endArray();
+        json.key("payload_varint_hex");
+        json.hexValue(f.encoded.data(), f.encoded.size());
+        json.endObject();
+    }
+}
+
+// Payload JSON, written directly into the secure wrapper
+void ESP8266UploadBuilder::writePayload(Print &out, const UploadContext &ctx)
+{
+    const ESP8266PollingConfig &config = *ctx.config;
+    ESP8266JsonWriter json(out);
+    json.beginObject();
+    json.field("device_id", ctx.deviceId);
+    json.field("timestamp", (unsigned long)ctx.sendTime);
+    json.field("session_id", (unsigned long)ctx.sessionId);
+    json.field("window_start_ms", (unsigned long)ctx.window_start);
+    json.field("window_end_ms", (unsigned long)ctx.window_end);
+    json.field("poll_count", (int)ctx.samples.size());
+    json.field("poll_interval_ms", (unsigned int)ctx.pollIntervalMs);
+    if (ctx.adaptive)
+        json.field("poll_mode", "adaptive");
+    if (ctx.rollupMode)
+    {
+        json.field("mode", "rollup");
+        json.field("backlog_samples", (unsigned long)ctx.backlogSamples);
+    }
+
+    // Include command results if available: "command_result" is the latest,
+    // "command_results" has one entry per command
+    if (ctx.commandCount > 0)
+    {
+        const CommandResult &latest = (*ctx.commandResults)[ctx.commandCount - 1];
+        json.beginObject("command_result");
+        json.field("status", latest.status);
+        if (latest.executed_at.length() > 0)
+            json.field("executed_at", latest.executed_at);
+        if (latest.error_message.length() > 0)
+            json.field("error_message", latest.error_message);
+        json.endObject();
+
+        json.beginArray("command_results");
+        for (size_t i = 0; i < ctx.commandCount; i++)
+        {
+            const CommandResult &result = (*ctx.commandResults)[i];
+            json.beginObject();
+            json.field("target_register", result.target_register);
+            json.field("value", result.value);
+            json.field("status", result.status);
+            if (result.executed_at.length() > 0)
+                json.field("executed_at", result.executed_at);
+            if (result.error_message.length() > 0)
+                json.field("error_message", result.error_message);
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    // Include config acknowledgment if available
+    if (ctx.configAck && ctx.configAck->has_ack)
+    {
+        const ConfigAck &ack = *ctx.configAck;
+        json.beginObject("config_ack");
+        json.beginArray("accepted");
+        for (const String &param : ack.accepted)
+            json.value(param);
+        json.endArray();
+        json.beginArray("rejected");
+        for (const String &param : ack.rejected)
+            json.value(param);
+        json.endArray();
+        json.beginArray("unchanged");
+        for (const String &param : ack.unchanged)
+            json.value(param);
+        json.endArray();
+        json.endObject();
+    }
+
+    if (ctx.rollupMode)
+    {
+        json.beginArray("rollups");
+        for (const Rollup &r : ctx.rollups)
+        {
+            json.beginObject();
+            json.field("start_ms", (unsigned long)r.start_ms);
+            json.field("end_ms", (unsigned long)r.end_ms);
+            json.beginObject("fields");
+            for (ParameterType p : config.getEnabledParameters())
+            {
+                const RunningStats &st = r.get(p);
+                if (st.count == 0)
+                    continue;
+                json.beginObject(FPSTR(param_key(p)));
+                json.field("n", (unsigned long)st.count);
+                json.field("min", (long)st.minV);
+                json.field("max", (long)st.maxV);
+                json.field("mean", st.mean);
+                json.field("var", st.variance());
+                json.endObject();
+            }
+            json.endObject();
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    if (ctx.timed)
+    {
+        json.beginArray("sample_offsets_ms");
+        for (const auto &s : ctx.samples)
+            json.value((unsigned long)(s.timestamp - ctx.window_start));
+        json.endArray();
+    }
+    if (ctx.sparse)
+    {
+        json.beginArray("change_masks");
+        for (const auto &s : ctx.samples)
+            json.value((unsigned int)changeMask(ctx, s));
+        json.endArray();
+        if (config.slaveCount() > 1)
+        {
+            json.beginArray("sample_slaves");
+            for (const auto &s : ctx.samples)
+                json.value((unsigned int)config.slaveAddress(s.slave));
+            json.endArray();
+        }
+    }
+
+    json.beginObject("fields");
+    writeFieldObjects(json, ctx, 0);
+    json.endObject();
+
+    // Further inverters behind the gateway, each with its own fields
+    if (config.slaveCount() > 1)
+    {
+        json.field("slave_address", (unsigned int)config.slaveAddress(0));
+        json.beginArray("slaves");
+        for (uint8_t slave = 1; slave < config.slaveCount(); slave++)
+        {
+            json.beginObject();
+            json.field("slave", (unsigned int)config.slaveAddress(slave));
+            json.beginObject("fields");
+            writeFieldObjects(json, ctx, slave);
+            json.endObject();
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    // Upload-level metadata for original/compressed sizes and verification
+    json.field("original_payload_size_bytes_total", (int)ctx.totalOriginalBytes);
+    json.field("compressed_payload_size_bytes_total", (int)ctx.totalCompressedBytes);
+    json.field("cpu_time_ms_total", ctx.totalCpuMs);
+    json.field("verify_ok_all", ctx.verifyAll);
+    json.field("power_mode", ctx.powerMode == POWER_MODE_SAVE ? "save" : "always_on");
+    json.field("radio_on_s_last_hour", (unsigned long)ctx.radioOnLastHourS);
+    ESP8266Metrics::writeJson(json, ctx.metrics);
+    json.endObject();
+}
+
+uint32_t ESP8266UploadBuilder::writeJson(Print &socket, const UploadContext &ctx, const char *psk)
+{
+    Crc32Print crc(socket);
+    SecureWriter secure(crc, psk, ctx.nonce);
+    secure.begin();
+    writePayload(secure, ctx);
+    secure.finish();
+
+    // mac_crc32 covers the wrapper as it would serialize without this field
+    uint32_t macCrc = crc.valueWith('}');
+    socket.print(",\"mac_crc32\":");
+    socket.print((unsigned long)macCrc);
+    secure.close();
+    return secure.wrapMicros();
+}
+
+uint32_t ESP8266UploadBuilder::writeEnvelope(Print &socket, const UploadContext &ctx, const char *psk)
+{
+    const ESP8266PollingConfig &config = *ctx.config;
+    ESP8266UploadEnvelope env(socket, psk);
+    env.begin(ctx.nonce);
+    env.stringField(EnvelopeKey::DEVICE_ID, ctx.deviceId);
+    env.uintField(EnvelopeKey::TIMESTAMP, ctx.sendTime);
+    env.uintField(EnvelopeKey::SESSION_ID, ctx.sessionId);
+    env.uintField(EnvelopeKey::WINDOW_START_MS, ctx.window_start);
+    env.uintField(EnvelopeKey::WINDOW_END_MS, ctx.window_end);
+    env.uintField(EnvelopeKey::POLL_COUNT, ctx.samples.size());
+    env.uintField(EnvelopeKey::POLL_INTERVAL_MS, ctx.pollIntervalMs);
+    if (ctx.rollupMode)
+        env.uintField(EnvelopeKey::BACKLOG_SAMPLES, ctx.backlogSamples);
+
+    for (size_t i = 0; i < ctx.commandCount; i++)
+    {
+        const CommandResult &result = (*ctx.commandResults)[i];
+        env.stringField(EnvelopeKey::COMMAND, result.target_register);
+        env.intField(EnvelopeKey::COMMAND_VALUE, result.value);
+        env.stringField(EnvelopeKey::COMMAND_STATUS, result.status);
+        if (result.executed_at.length() > 0)
+            env.stringField(EnvelopeKey::COMMAND_EXECUTED_AT, result.executed_at);
+        if (result.error_message.length() > 0)
+            env.stringField(EnvelopeKey::COMMAND_ERROR, result.error_message);
+    }
+    if (ctx.configAck && ctx.configAck->has_ack)
+    {
+        const ConfigAck &ack = *ctx.configAck;
+        for (const String &param : ack.accepted)
+            env.stringField(EnvelopeKey::ACK_ACCEPTED, param);
+        for (const String &param : ack.rejected)
+            env.stringField(EnvelopeKey::ACK_REJECTED, param);
+        for (const String &param : ack.unchanged)
+            env.stringField(EnvelopeKey::ACK_UNCHANGED, param);
+    }
+
+    if (ctx.timed)
+        env.bytesField(EnvelopeKey::SAMPLE_OFFSETS, ctx.sampleOffsets.data(), ctx.sampleOffsets.size());
+    if (ctx.sparse)
+    {
+        env.bytesField(EnvelopeKey::SAMPLE_MASKS, ctx.sampleMasks.data(), ctx.sampleMasks.size());
+        if (!ctx.sampleSlaves.empty())
+            env.bytesField(EnvelopeKey::SAMPLE_SLAVES, ctx.sampleSlaves.data(), ctx.sampleSlaves.size());
+    }
+
+    for (const Rollup &r : ctx.rollups)
+    {
+        env.uintField(EnvelopeKey::ROLLUP, r.start_ms);
+        env.uintField(EnvelopeKey::ROLLUP_END_MS, r.end_ms);
+        for (ParameterType p : config.getEnabledParameters())
+        {
+            const RunningStats &st = r.get(p);
+            if (st.count == 0)
+                continue;
+            env.uintField(EnvelopeKey::FIELD, static_cast<uint8_t>(p));
+            env.uintField(EnvelopeKey::FIELD_N_SAMPLES, st.count);
+            env.intField(EnvelopeKey::FIELD_MIN, st.minV);
+            env.intField(EnvelopeKey::FIELD_MAX, st.maxV);
+            env.floatField(EnvelopeKey::FIELD_AVG, st.mean);
+            env.floatField(EnvelopeKey::FIELD_VARIANCE, st.variance());
+        }
+    }
+
+    uint8_t slave = 0;
+    for (const FieldEncoding &f : ctx.fields)
+    {
+        if (f.slave != slave)
+        {
+            slave = f.slave;
+            env.uintField(EnvelopeKey::SLAVE, config.slaveAddress(slave));
+        }
+        env.uintField(EnvelopeKey::FIELD, static_cast<uint8_t>(f.param));
+        env.uintField(EnvelopeKey::FIELD_CODEC, static_cast<uint8_t>(f.codec));
+        env.uintField(EnvelopeKey::FIELD_N_SAMPLES, f.n_samples);
+        env.intField(EnvelopeKey::FIELD_MIN, f.minV);
+        env.intField(EnvelopeKey::FIELD_MAX, f.maxV);
+        env.floatField(EnvelopeKey::FIELD_AVG, f.avg);
+        env.uintField(EnvelopeKey::FIELD_CPU_TIME_US, (uint32_t)(f.cpu_ms * 1000.0f));
+        env.boolField(EnvelopeKey::FIELD_VERIFY_OK, f.verify_ok);
+        env.bytesField(EnvelopeKey::FIELD_DATA, f.encoded.data(), f.encoded.size());
+    }
+
+    env.uintField(EnvelopeKey::ORIGINAL_BYTES_TOTAL, ctx.totalOriginalBytes);
+    env.uintField(EnvelopeKey::COMPRESSED_BYTES_TOTAL, ctx.totalCompressedBytes);
+    env.uintField(EnvelopeKey::CPU_TIME_US_TOTAL, (uint32_t)(ctx.totalCpuMs * 1000.0f));
+    env.boolField(EnvelopeKey::VERIFY_OK_ALL, ctx.verifyAll);
+    env.uintField(EnvelopeKey::POWER_MODE, ctx.powerMode);
+    env.uintField(EnvelopeKey::RADIO_ON_S_LAST_HOUR, ctx.radioOnLastHourS);
+    ESP8266Metrics::writeEnvelope(env, ctx.metrics);
+    env.finish();
+    return env.macMicros();
+}
@@ -0,0 +1,110 @@
+#ifndef ESP8266_UPLOAD_BUILDER_H
+#define ESP8266_UPLOAD_BUILDER_H
+
+#include <Arduino.h>
+#include <vector>
+#include "ESP8266Aggregator.h"
+#include "ESP8266CommandQueue.h"
+#include "ESP8266Compression.h"
+#include "ESP8266DataTypes.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266PollingConfig.h"
+
+// Configuration acknowledgment structure
+struct ConfigAck
+{
+    std::vector<String> accepted;
+    std::vector<String> rejected;
+    std::vector<String> unchanged;
+    bool has_ack;
+};
+
+// Per-parameter compression result, computed once per upload and then
+// serialized straight to the socket on every attempt
+struct FieldEncoding
+{
+    ParameterType param;
+    uint8_t slave; // Index in the polling config's slave list
+    size_t n_samples;
+    long minV;
+    long maxV;
+    float avg;
+    float cpu_ms;
+    bool verify_ok;
+    Compression::Codec codec;
+    std::vector<int32_t> deltas;  // Codec-independent delta series for the "payload" array
+    std::vector<uint8_t> encoded; // Bytes produced by the chosen codec
+};
+
+// One upload in flight. Built once when the job starts and resent unchanged
+// (same nonce) on every retry, so a backoff costs no CPU and no nonce.
+struct UploadContext
+{
+    SampleWindow samples;
+    bool fromSpill;
+    int attempt;
+    bool acked; // Set by the upload channel's completion callback
+    uint32_t nonce;
+    String deviceId;
+    uint32_t window_start;
+    uint32_t window_end;
+    uint32_t sendTime;
+    uint32_t sessionId;
+    std::vector<FieldEncoding> fields;
+    bool rollupMode;             // Backlog catch-up: queued rollups instead of raw samples
+    std::vector<Rollup> rollups; // Queue snapshot, so retries resend the same rollups
+    uint32_t backlogSamples;
+    bool sparse;                       // Some samples lack some fields: send timing and change masks
+    bool timed;                        // Send per-sample timing: sparse, or the poll interval adapts
+    bool adaptive;                     // Poll interval adapts to the inverter's dynamics
+    uint16_t pollIntervalMs;           // Interval in effect when the upload was built
+    uint8_t powerMode;                 // POWER_MODE_* when the upload was built
+    uint32_t radioOnLastHourS;         // Radio-on seconds in the last full hour
+    std::vector<uint8_t> sampleOffsets; // varint ms since window_start, per sample
+    std::vector<uint8_t> sampleMasks;   // varint present_mask, per sample
+    std::vector<uint8_t> sampleSlaves;  // varint slave address, per sample (several inverters only)
+    size_t totalOriginalBytes;   // sum of 4 * n_samples per field
+    size_t totalCompressedBytes; // sum of varint-encoded bytes_len per field
+    float totalCpuMs;            // sum of cpu_time_ms per field
+    bool verifyAll;              // AND of per-field verify_ok
+    MetricsSummary metrics;      // Latency summary as of preparation, resent unchanged
+    const ESP8266PollingConfig *config;                // Slaves and parameters the fields were encoded for
+    const std::vector<CommandResult> *commandResults; // The leading commandCount entries go out
+    size_t commandCount;
+    const ConfigAck *configAck; // Reported when it has an ack
+};
+
+// Upload bodies, shared by the firmware and the soak. encode() does the
+// expensive part once per upload; the writers only serialize its results,
+// so every retry sends the same bytes.
+class ESP8266UploadBuilder
+{
+public:
+    // Window bounds, every field compressed and verified, and the per-sample
+    // timing, change masks and slave addresses the window needs. Reads the
+    // samples (or rollups) and the interval, power and command fields
+    // already set in ctx.
+    static void encode(UploadContext &ctx, const ESP8266PollingConfig &config);
+
+    // Both writers return the microseconds spent wrapping (base64/HMAC), for
+    // the serialize/wrap split.
+    // Signed JSON: secure wrapper around the payload plus a CRC32 of the wrapper
+    static uint32_t writeJson(Print &out, const UploadContext &ctx, const char *psk);
+    // Binary envelope: raw codec bytes once, small integer keys, HMAC over the body
+    static uint32_t writeEnvelope(Print &out, const UploadContext &ctx, const char *psk);
+
+    // Scaled integer series of one parameter across a window, as uploaded;
+    // the window's statistics are gathered in the same pass
+    static void collectSeries(const SampleWindow &samples, ParameterType param, std::vector<long> &series,
+                              RunningStats *stats = nullptr, uint8_t slave = 0);
+
+private:
+    static bool encodeField(const SampleWindow &samples, ParameterType param, uint8_t slave, FieldEncoding &field);
+    // A sample's change bitmap as both formats report it: present fields
+    // the sample's inverter actually polls
+    static uint16_t changeMask(const UploadContext &ctx, const Sample &s);
+    static void writeFieldObjects(ESP8266JsonWriter &json, const UploadContext &ctx, uint8_t slave);
+    static void writePayload(Print &out, const UploadContext &ctx);
+};
+
+#endif // ESP8266_UPLOAD_BUILDER_H
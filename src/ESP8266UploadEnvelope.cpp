@@ -0,0 +1,87 @@
+#include "ESP8266UploadEnvelope.h"
+#include "ESP8266Compression.h"
+
+ESP8266UploadEnvelope::ESP8266UploadEnvelope(Print &out, const char *psk) : out_(out), psk_(psk), written_(0), macMicros_(0)
+{
+}
+
+void ESP8266UploadEnvelope::emit(const uint8_t *data, size_t length)
+{
+    uint32_t started = micros();
+    hmac_.update(data, length);
+    macMicros_ += micros() - started;
+    out_.write(data, length);
+    written_ += length;
+}
+
+void ESP8266UploadEnvelope::emitVarint(uint32_t value)
+{
+    uint8_t buf[5];
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        buf[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+    emit(buf, n);
+}
+
+size_t ESP8266UploadEnvelope::varintSize(uint32_t value)
+{
+    size_t n = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+void ESP8266UploadEnvelope::begin(uint32_t nonce)
+{
+    hmac_.resetHMAC(psk_, strlen(psk_));
+    uint8_t header[8] = {ENVELOPE_MAGIC_0, ENVELOPE_MAGIC_1, ENVELOPE_VERSION, 0,
+                         (uint8_t)(nonce & 0xFF), (uint8_t)((nonce >> 8) & 0xFF),
+                         (uint8_t)((nonce >> 16) & 0xFF), (uint8_t)(nonce >> 24)};
+    emit(header, sizeof(header));
+}
+
+void ESP8266UploadEnvelope::uintField(uint8_t key, uint32_t value)
+{
+    emit(&key, 1);
+    emitVarint(varintSize(value));
+    emitVarint(value);
+}
+
+void ESP8266UploadEnvelope::intField(uint8_t key, int32_t value)
+{
+    uintField(key, Compression::zigzag_encode(value));
+}
+
+void ESP8266UploadEnvelope::floatField(uint8_t key, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t buf[4] = {(uint8_t)(bits & 0xFF), (uint8_t)((bits >> 8) & 0xFF),
+                      (uint8_t)((bits >> 16) & 0xFF), (uint8_t)(bits >> 24)};
+    bytesField(key, buf, sizeof(buf));
+}
+
+void ESP8266UploadEnvelope::bytesField(uint8_t key, const uint8_t *data, size_t length)
+{
+    emit(&key, 1);
+    emitVarint(length);
+    if (length > 0)
+        emit(data, length);
+}
+
+void ESP8266UploadEnvelope::finish()
+{
+    uint8_t mac[SHA256::HASH_SIZE];
+    uint32_t started = micros();
+    hmac_.finalizeHMAC(psk_, strlen(psk_), mac, sizeof(mac));
+    macMicros_ += micros() - started;
+    out_.write(mac, sizeof(mac));
+    written_ += sizeof(mac);
+}
@@ -0,0 +1,119 @@
+#ifndef ESP8266_UPLOAD_ENVELOPE_H
+#define ESP8266_UPLOAD_ENVELOPE_H
+
+#include <Arduino.h>
+#include <SHA256.h>
+
+#define ENVELOPE_MAGIC_0 'E'
+#define ENVELOPE_MAGIC_1 'W'
+#define ENVELOPE_VERSION 1
+#define ENVELOPE_CONTENT_TYPE "application/octet-stream"
+
+// Compact binary upload body, used instead of the JSON secure wrapper when
+// APIConfig.upload_format is UPLOAD_FORMAT_BINARY.
+//
+//   header : 'E' 'W' | u8 version | u8 flags | u32 nonce (little endian)
+//   records: u8 key | varint length | value bytes   (repeated)
+//   trailer: 32-byte HMAC-SHA256(psk, header + records)
+//
+// Integers are varints (signed ones zigzag first), floats are 4 bytes little
+// endian, strings and codec output are raw bytes. Records are flat: a
+// FIELD record starts a new field and the FIELD_* records that follow
+// describe it, likewise for the command result and config ack lists. A
+// catch-up upload carries ROLLUP records instead of codec data, each followed
+// by FIELD records with count, min, max, mean and variance. METRIC and
+// COUNTER records carry the device's latency summary the same way. With
+// more than one inverter, a SLAVE record precedes each further slave's
+// FIELD records and SAMPLE_SLAVES gives every sample's slave address.
+namespace EnvelopeKey
+{
+    enum : uint8_t
+    {
+        DEVICE_ID = 1,
+        TIMESTAMP = 2,
+        SESSION_ID = 3,
+        WINDOW_START_MS = 4,
+        WINDOW_END_MS = 5,
+        POLL_COUNT = 6,
+        ORIGINAL_BYTES_TOTAL = 7,
+        COMPRESSED_BYTES_TOTAL = 8,
+        CPU_TIME_US_TOTAL = 9,
+        VERIFY_OK_ALL = 10,
+        BACKLOG_SAMPLES = 11,  // Spilled samples waiting when a rollup upload was built
+        SAMPLE_OFFSETS = 12,   // varints: ms since window start, one per sample
+        SAMPLE_MASKS = 13,     // varints: change bitmap (fields present), one per sample
+        SLAVE = 14,            // value: Modbus address; the FIELD records that follow are its own
+        SAMPLE_SLAVES = 15,    // varints: Modbus slave address, one per sample
+
+        COMMAND_STATUS = 16,
+        COMMAND_EXECUTED_AT = 17,
+        COMMAND_ERROR = 18,
+        COMMAND = 19,                 // value: target register; starts a result whose COMMAND_* records follow
+        ACK_ACCEPTED = 20,
+        ACK_REJECTED = 21,
+        ACK_UNCHANGED = 22,
+        RADIO_ON_S_LAST_HOUR = 23,    // Seconds the radio was on in the last full hour
+        HEAP_LOW_WATER = 24,          // Lowest free heap seen, bytes
+        HEAP_MIN_MAX_BLOCK = 25,      // Smallest largest-free-block seen, bytes
+        HEAP_PEAK_FRAGMENTATION = 26, // percent
+        POLL_INTERVAL_MS = 27,        // Poll interval when the upload was built
+        POWER_MODE = 28,              // POWER_MODE_ALWAYS_ON or POWER_MODE_SAVE
+        COMMAND_VALUE = 29,           // signed, value the command asked for
+
+        FIELD = 32,            // value: param_id; starts a new field
+        FIELD_CODEC = 33,      // Compression::Codec
+        FIELD_N_SAMPLES = 34,
+        FIELD_MIN = 35,        // signed
+        FIELD_MAX = 36,        // signed
+        FIELD_AVG = 37,        // float
+        FIELD_CPU_TIME_US = 38,
+        FIELD_VERIFY_OK = 39,
+        FIELD_DATA = 40,       // codec bytes
+        FIELD_VARIANCE = 41,   // float, sample variance
+
+        ROLLUP = 48,           // value: start_ms; starts a new rollup whose FIELD records follow
+        ROLLUP_END_MS = 49,
+
+        METRIC = 56,           // value: MetricStage; starts a stage whose METRIC_* records follow
+        METRIC_COUNT = 57,
+        METRIC_P50_US = 58,
+        METRIC_P95_US = 59,
+        METRIC_MAX_US = 60,
+        COUNTER = 61,          // value: MetricCounter; COUNTER_VALUE follows
+        COUNTER_VALUE = 62,
+    };
+}
+
+class ESP8266UploadEnvelope
+{
+public:
+    ESP8266UploadEnvelope(Print &out, const char *psk);
+
+    void begin(uint32_t nonce);
+    void uintField(uint8_t key, uint32_t value);
+    void intField(uint8_t key, int32_t value);
+    void floatField(uint8_t key, float value);
+    void boolField(uint8_t key, bool value) { uintField(key, value ? 1 : 0); }
+    void bytesField(uint8_t key, const uint8_t *data, size_t length);
+    void stringField(uint8_t key, const char *value) { bytesField(key, (const uint8_t *)value, strlen(value)); }
+    void stringField(uint8_t key, const String &value) { bytesField(key, (const uint8_t *)value.c_str(), value.length()); }
+    // Append the HMAC trailer
+    void finish();
+
+    size_t bytesWritten() const { return written_; }
+    // Time spent in the HMAC so far
+    uint32_t macMicros() const { return macMicros_; }
+
+private:
+    Print &out_;
+    const char *psk_;
+    SHA256 hmac_;
+    size_t written_;
+    uint32_t macMicros_;
+
+    void emit(const uint8_t *data, size_t length);
+    void emitVarint(uint32_t value);
+    static size_t varintSize(uint32_t value);
+};
+
+#endif // ESP8266_UPLOAD_ENVELOPE_H
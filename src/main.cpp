@@ -17,47 +17,72 @@
 #include "ESP8266Compression.h"
 #include "ESP8266Security.h"
 #include "ESP8266FOTA.h"
+#include "ESP8266AsyncHttp.h"
+#include "ESP8266SpillQueue.h"
+#include "ESP8266JsonWriter.h"
+#include "ESP8266UploadEnvelope.h"
+#include "ESP8266CodecBench.h"
+#include "ESP8266SoakBench.h"
+#include "ESP8266Scheduler.h"
+#include "ESP8266Aggregator.h"
+#include "ESP8266ReportFilter.h"
+#include "ESP8266Parameters.h"
+#include "ESP8266Metrics.h"
+#include "ESP8266Log.h"
+#include "ESP8266SlavePoller.h"
+#include "ESP8266PollRate.h"
+#include "ESP8266PowerManager.h"
+#include "ESP8266CommandQueue.h"
+#include "ESP8266RegisterCache.h"
+#include "ESP8266SampleStore.h"
+#include "ESP8266UploadBuilder.h"
 #include <LittleFS.h>
 
 // Global objects
 ESP8266Inverter inverter;
-ESP8266DataBuffer dataBuffer(10); // Smaller buffer for ESP8266
+ESP8266DataBuffer dataBuffer(MAX_BUFFER_SAMPLES); // Compact fixed-layout samples
+ESP8266SampleStore sampleStore(dataBuffer, reportFilter, spillQueue);
 ESP8266PollingConfig pollingConfig;
 ESP8266FOTA fota;
 
-// Command execution structures
-struct PendingCommand
-{
-    String action;
-    String target_register;
-    int value;
-    unsigned long received_at;
-    bool valid;
-};
+// Cloud requests run on their own channels so they overlap gateway reads
+ESP8266AsyncHttp uploadHttp("upload");
+ESP8266AsyncHttp configHttp("config");
+bool configRequestOk = false; // Set by the config channel's completion callback
+
+// Conditional config checks: the ETag of the last full config response, and
+// whether the server has since reported a change we have not fetched yet
+String configEtag;
+bool configChangePending = false;
+int configCheckCode = 0;
+
+// Command results waiting for the next upload, oldest first
+std::vector<CommandResult> commandResults;
+// Leading commandResults entries the upload in flight carries; they stay put
+// until it finishes
+size_t commandResultsSent = 0;
 
-struct CommandResult
+// Configuration acknowledgment state
+ConfigAck lastConfigAck = {{}, {}, {}, false};
+
+// Heap health captured before and after each poll cycle
+struct HeapSnapshot
 {
-    String status;
-    String executed_at;
-    String error_message;
-    bool has_result;
+    uint32_t free_heap;
+    uint32_t max_free_block;
+    uint8_t fragmentation; // percent
 };
 
-// Configuration acknowledgment structure
-struct ConfigAck
+struct HeapPollStats
 {
-    std::vector<String> accepted;
-    std::vector<String> rejected;
-    std::vector<String> unchanged;
-    bool has_ack;
+    HeapSnapshot before;
+    HeapSnapshot after;
+    uint32_t min_max_free_block;
+    uint8_t peak_fragmentation;
+    uint32_t cycles;
 };
 
-// Command execution state
-PendingCommand pendingCommand = {"", "", 0, 0, false};
-CommandResult lastCommandResult = {"", "", "", false};
-
-// Configuration acknowledgment state
-ConfigAck lastConfigAck = {{}, {}, {}, false};
+HeapPollStats heapPollStats = {{0, 0, 0}, {0, 0, 0}, UINT32_MAX, 0, 0};
 
 // Timers
 Ticker pollTicker;
@@ -67,6 +92,12 @@ Ticker configRequestTicker;
 // Status variables
 unsigned long startTime;
 bool systemInitialized = false;
+// Spill queue draining between upload ticks once the cloud is reachable again
+#define SPILL_DRAIN_INTERVAL_MS 2000
+unsigned long lastUploadAt = 0;
+bool lastUploadOk = false;
+uint8_t uploadFailures = 0;            // Consecutive failed uploads
+unsigned long uploadBackoffUntil = 0;  // No new upload before this while uploadFailures > 0
 bool pendingConfigurationUpdate = false;
 
 // Function prototypes
@@ -74,55 +105,94 @@ void setup();
 void loop();
 bool initializeSystem();
 void pollSensors();
-void uploadData();
-void requestConfigUpdate();
+bool beginPollCycle();
+void endPollCycle();
+void storePolledSample(Sample &sample, uint16_t failedMask);
 void executeCommand();
 void setupPollingConfig();
 void applyNewConfiguration();
 void updateConfigPollingRate();
 void printSystemStatus();
 void handleSerialCommands();
-bool uploadToServer(const std::vector<Sample> &samples);
-bool sendConfigRequest();
-bool executeWriteRegisterCommand(const String &register_name, int value, CommandResult &result);
-
-// Simple CRC32 (polynomial 0xEDB88320) for MAC stub
-static uint32_t crc32_calc(const uint8_t *data, size_t len)
+bool startConfigRequest();
+bool configCheckAllowed();
+bool startConfigCheck();
+bool handleConfigResponse(int code, const uint8_t *body, size_t length);
+void registerJobs();
+uint32_t pollStep();
+uint32_t wifiStep();
+uint32_t commandStep();
+uint32_t uploadStep();
+uint32_t configStep();
+uint32_t fotaStep();
+uint32_t firmwareStep();
+uint32_t powerStep();
+uint32_t soakStep();
+void queueCommandBatch(const JsonArray &batch);
+bool resolveWriteCommand(const String &register_name, int value, uint16_t &reg, uint16_t &raw, CommandResult &result);
+
+static HeapSnapshot takeHeapSnapshot()
 {
-    uint32_t crc = 0xFFFFFFFFu;
-    for (size_t i = 0; i < len; ++i)
-    {
-        crc ^= data[i];
-        for (int j = 0; j < 8; ++j)
-        {
-            uint32_t mask = -(crc & 1u);
-            crc = (crc >> 1) ^ (0xEDB88320u & mask);
-        }
-    }
-    return ~crc;
+    HeapSnapshot snap;
+    snap.free_heap = ESP.getFreeHeap();
+    snap.max_free_block = ESP.getMaxFreeBlockSize();
+    snap.fragmentation = ESP.getHeapFragmentation();
+    return snap;
 }
 
-// Flags set from timer callbacks (ISR context) to defer work to loop()
-volatile bool pollPending = false;
-volatile bool uploadPending = false;
-volatile bool configRequestPending = false;
+// Scheduler jobs, registered in priority order by registerJobs(). Timer
+// callbacks (ISR context) only request a job; the work runs from loop().
+int8_t pollJob = -1;
+int8_t wifiJob = -1;
+int8_t commandJob = -1;
+int8_t uploadJob = -1;
+int8_t configJob = -1;
+int8_t fotaJob = -1;
+int8_t firmwareJob = -1;
+int8_t powerJob = -1;
+int8_t soakJob = -1;
+
+#define WIFI_CHECK_INTERVAL_MS 1000     // Link check period of the wifi job
+#define WIFI_RECONNECT_TIMEOUT_MS 15000 // Restart WiFi.begin() after this long
+#define FOTA_MONITOR_INTERVAL_MS 250    // Config polling rate check period
+#define UPLOAD_MAX_ATTEMPTS 3
+#define UPLOAD_BACKOFF_BASE_MS 5000    // Pause after the first failed upload, doubled per further failure
+#define UPLOAD_BACKOFF_MAX_MS 300000
+#define CONFIG_RESPONSE_MAX 2048       // Config replies are parsed from here, never from a heap String
+#define UPLOAD_RESPONSE_MAX 256        // Upload replies only carry a status
+#define CONFIG_MAX_ATTEMPTS 2
+#define CONFIG_RETRY_DELAY_MS 2000
+#define CONFIG_LONG_POLL_REARM_MS 1000 // Gap between held config checks
+
+// Fixed response buffers of the config and upload channels
+static uint8_t configResponse[CONFIG_RESPONSE_MAX];
+static uint8_t uploadResponse[UPLOAD_RESPONSE_MAX];
 
 // Dynamic config polling interval tracking
 unsigned long currentConfigPollingInterval = 5000;
 
+// Last timer ticks, so the power job knows when the radio is next needed
+volatile unsigned long lastPollTickAt = 0;
+volatile unsigned long lastUploadTickAt = 0;
+
 void IRAM_ATTR onPollTimer()
 {
-    pollPending = true;
+    lastPollTickAt = millis();
+    scheduler.request(pollJob);
 }
 
 void IRAM_ATTR onUploadTimer()
 {
-    uploadPending = true;
+    lastUploadTickAt = millis();
+    scheduler.request(uploadJob);
+    // Save mode batches config checks into the upload window
+    if (powerManager.saving())
+        scheduler.request(configJob);
 }
 
 void IRAM_ATTR onConfigRequestTimer()
 {
-    configRequestPending = true;
+    scheduler.request(configJob);
 }
 
 void setup()
@@ -143,41 +213,49 @@ void setup()
         // Check if we just rebooted from an OTA update
         if (configManager.getBootStatusConfig().ota_reboot_pending)
         {
-            Serial.println("[BOOT] Detected successful OTA reboot");
+            LOG_I("BOOT", "Detected successful OTA reboot");
             configManager.setBootStatus("success", "");
         }
         else if (!configManager.getBootStatusConfig().boot_success_reported)
         {
-            Serial.println("[BOOT] Setting boot status to success");
+            LOG_I("BOOT", "Setting boot status to success");
             configManager.setBootStatus("success", "");
         }
 
         fota.begin();
+        spillQueue.begin();
         setupPollingConfig();
+        registerJobs();
 
         // Start polling and upload timers
         const DeviceConfig &deviceConfig = configManager.getDeviceConfig();
-        // Timer callbacks must be ISR-safe: set a flag and perform heavy work in loop()
-        pollTicker.attach_ms(deviceConfig.poll_interval_ms, onPollTimer);
+        // Timer callbacks must be ISR-safe: they only request scheduler jobs
+        pollTicker.attach_ms(pollRate.interval(), onPollTimer);
         uploadTicker.attach_ms(deviceConfig.upload_interval_ms, onUploadTimer);
 
-        // Start configuration request timer (every 5 seconds)
-        configRequestTicker.attach_ms(5000, onConfigRequestTimer);
+        // Start the configuration request timer at the normal rate; the FOTA
+        // monitor retunes it for fast FOTA polling, long-poll re-arming and
+        // power save batching
+        configRequestTicker.attach_ms(currentConfigPollingInterval, onConfigRequestTimer);
 
-        Serial.println("[MAIN] System initialized successfully");
+        LOG_I("MAIN", "System initialized successfully");
         printSystemStatus();
     }
     else
     {
-        Serial.println("[MAIN] System initialization failed!");
+        LOG_E("MAIN", "System initialization failed!");
         configManager.setBootStatus("failure", "System initialization failed");
     }
+
+    // From here on log lines queue in RAM and loop() drains them
+    logRing.setDirect(false);
 }
 
 void loop()
 {
     // Handle serial commands for configuration
     handleSerialCommands();
+    logRing.drain();
 
     // Basic watchdog - restart if system hangs
     static unsigned long lastLoopTime = 0;
@@ -185,79 +263,64 @@ void loop()
 
     if (currentTime - lastLoopTime > 60000)
     { // 1 minute timeout
-        Serial.println("[WATCHDOG] Loop timeout - restarting");
+        LOG_E("WATCHDOG", "Loop timeout - restarting");
+        logRing.flush();
         ESP.restart();
     }
     lastLoopTime = currentTime;
 
-    // Check for deferred tasks set by timers
-    if (pollPending)
-    {
-        // Clear flag before executing to avoid missing new requests
-        pollPending = false;
-        pollSensors();
-    }
-
-    if (uploadPending)
-    {
-        uploadPending = false;
-        uploadData();
-    }
-
-    if (configRequestPending)
+    // Drain the flash backlog one block at a time between upload ticks, only
+    // while uploads succeed and never ahead of a due poll
+    if (systemInitialized && lastUploadOk && !scheduler.isActive(pollJob) && !scheduler.isActive(uploadJob) &&
+        !spillQueue.empty() &&
+        millis() - lastUploadAt >= SPILL_DRAIN_INTERVAL_MS)
     {
-        configRequestPending = false;
-        requestConfigUpdate();
+        scheduler.request(uploadJob);
     }
 
-    // Update config polling rate based on FOTA status
-    updateConfigPollingRate();
-
-    // Execute pending commands
-    if (pendingCommand.valid)
+    // One step of the most urgent job; steps never wait on delay(), loop()
+    // only sleeps when nothing is due
+    if (!scheduler.runOnce())
     {
-        executeCommand();
+        // Idle: release keep-alive sockets the servers will have dropped
+        ESP8266AsyncHttp::closeIdleAll();
+        delay(SCHEDULER_IDLE_MS);
     }
-
-    delay(100);
 }
 
 bool initializeSystem()
 {
-    Serial.println("[INIT] Starting system initialization...");
+    LOG_I("INIT", "Starting system initialization...");
 
     // Initialize configuration manager
     if (!configManager.begin())
     {
-        Serial.println("[INIT] Failed to load configuration, using defaults");
+        LOG_E("INIT", "Failed to load configuration, using defaults");
     }
 
     // Initialize WiFi connection
     const WiFiConfig &wifiConfig = configManager.getWiFiConfig();
+    powerManager.begin(configManager.getDeviceConfig().power_mode);
     WiFi.mode(WIFI_STA);
     WiFi.hostname(wifiConfig.hostname);
     WiFi.begin(wifiConfig.ssid, wifiConfig.password);
 
-    Serial.print("[INIT] Connecting to WiFi: ");
-    Serial.println(wifiConfig.ssid);
+    LOG_I("INIT", "Connecting to WiFi: %s", wifiConfig.ssid);
 
     int wifi_timeout = 0;
     while (WiFi.status() != WL_CONNECTED && wifi_timeout < 30)
     {
         delay(1000);
-        Serial.print(".");
         wifi_timeout++;
     }
-    Serial.println();
 
     if (WiFi.status() == WL_CONNECTED)
     {
-        Serial.print("[INIT] WiFi connected! IP: ");
-        Serial.println(WiFi.localIP());
+        LOG_I("INIT", "WiFi connected! IP: %s", WiFi.localIP().toString().c_str());
 
         // Configure time synchronization
         configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-        Serial.println("[INIT] Time synchronization configured");
+        LOG_I("INIT", "Time synchronization configured");
 
         // Wait for time sync
         time_t now = time(nullptr);
@@ -271,39 +334,38 @@ bool initializeSystem()
 
         if (now >= 8 * 3600 * 2)
         {
-            Serial.println("[INIT] Time synchronized successfully");
+            LOG_I("INIT", "Time synchronized successfully");
         }
         else
         {
-            Serial.println("[INIT] Warning: Time synchronization may not be complete");
+            LOG_W("INIT", "Warning: Time synchronization may not be complete");
         }
     }
     else
     {
-        Serial.println("[INIT] Error: Failed to connect to WiFi");
+        LOG_E("INIT", "Error: Failed to connect to WiFi");
         return false;
     }
 
     // Configure inverter with slave address from configuration
     const DeviceConfig &deviceConfig = configManager.getDeviceConfig();
     inverter.setSlaveAddress(deviceConfig.slave_address);
-    Serial.print("[INIT] Inverter slave address set to: 0x");
-    Serial.println(deviceConfig.slave_address, HEX);
+    LOG_I("INIT", "Inverter slave address set to: 0x%X", deviceConfig.slave_address);
 
     // Initialize inverter communication
     if (!inverter.begin())
     {
-        Serial.println("[INIT] Failed to initialize inverter communication");
+        LOG_E("INIT", "Failed to initialize inverter communication");
         return false;
     }
 
-    Serial.println("[INIT] System initialization complete");
+    LOG_I("INIT", "System initialization complete");
     return true;
 }
 
 void setupPollingConfig()
 {
-    Serial.println("[CONFIG] Setting up polling configuration...");
+    LOG_I("CONFIG", "Setting up polling configuration...");
 
     // Read parameters from configManager instead of hardcoded values
     const DeviceConfig &deviceConfig = configManager.getDeviceConfig();
@@ -315,12 +377,19 @@ void setupPollingConfig()
     }
 
     pollingConfig.setParameters(params);
+    pollingConfig.setSlaves(deviceConfig.slave_address, deviceConfig.extra_slaves, deviceConfig.num_extra_slaves);
+    pollingConfig.setBlockReadLimits(deviceConfig.block_gap_tolerance, deviceConfig.block_max_regs);
+    reportFilter.configure(deviceConfig);
+    pollRate.configure(deviceConfig);
     pollingConfig.printEnabledParameters();
 }
 
 void applyNewConfiguration()
 {
-    Serial.println("[CONFIG] Applying new configuration...");
+    LOG_I("CONFIG", "Applying new configuration...");
+
+    // Finish a running cycle first; it walks the current plans
+    slavePoller.wait();
 
     // Reconfigure polling parameters
     setupPollingConfig();
@@ -328,11 +397,12 @@ void applyNewConfiguration()
     // Update polling timer with new interval
     const DeviceConfig &deviceConfig = configManager.getDeviceConfig();
     pollTicker.detach();
-    pollTicker.attach_ms(deviceConfig.poll_interval_ms, onPollTimer);
+    pollTicker.attach_ms(pollRate.interval(), onPollTimer);
+    if (deviceConfig.power_mode != powerManager.mode())
+        powerManager.setMode(deviceConfig.power_mode);
 
-    Serial.print("[CONFIG] New polling interval: ");
-    Serial.print(deviceConfig.poll_interval_ms);
-    Serial.println(" ms");
+    LOG_I("CONFIG", "New polling interval: %u ms%s", (unsigned)deviceConfig.poll_interval_ms,
+          deviceConfig.adaptive_poll ? " (adaptive baseline)" : "");
 }
 
 void updateConfigPollingRate()
@@ -340,13 +410,21 @@ void updateConfigPollingRate()
     // Check if FOTA just started - if so, immediately request next chunk
     if (fota.justStartedUpdate())
     {
-        Serial.println("[FOTA] FOTA update started - triggering immediate config request");
-        configRequestPending = true;
+        LOG_I("FOTA", "FOTA update started - triggering immediate config request");
+        scheduler.request(configJob);
         fota.clearJustStartedFlag();  // Clear the flag after triggering immediate request
     }
     
-    // Get the recommended polling interval from FOTA
+    // Get the recommended polling interval from FOTA; while the server can
+    // hold a conditional check, a new one starts as soon as the last returns.
+    // Save mode has no config timer: checks ride along with uploads (0 below).
     unsigned long recommendedInterval = fota.getRecommendedPollingInterval();
+    bool batched = powerManager.saving() && !fota.needsFastPolling();
+    bool longPoll = !batched && configManager.getAPIConfig().config_long_poll_s > 0 && configCheckAllowed();
+    if (longPoll)
+        recommendedInterval = CONFIG_LONG_POLL_REARM_MS;
+    if (batched)
+        recommendedInterval = 0;
     
     // Only update if the interval has changed to avoid unnecessary timer resets
     if (recommendedInterval != currentConfigPollingInterval)
@@ -355,219 +433,370 @@ void updateConfigPollingRate()
         
         // Update the configuration request timer
         configRequestTicker.detach();
-        configRequestTicker.attach_ms(currentConfigPollingInterval, onConfigRequestTimer);
+        if (!batched)
+            configRequestTicker.attach_ms(currentConfigPollingInterval, onConfigRequestTimer);
         
-        if (fota.needsFastPolling())
+        if (batched)
+        {
+            LOG_I("POWER", "Config checks batched with uploads");
+        }
+        else if (fota.needsFastPolling())
+        {
+            LOG_I("FOTA", "Switching to fast polling: %lu ms", currentConfigPollingInterval);
+        }
+        else if (longPoll)
         {
-            Serial.print("[FOTA] Switching to fast polling: ");
-            Serial.print(currentConfigPollingInterval);
-            Serial.println(" ms");
+            LOG_I("CONFIG", "Switching to long-poll config checks");
         }
         else
         {
-            Serial.print("[CONFIG] Reverting to normal polling: ");
-            Serial.print(currentConfigPollingInterval);
-            Serial.println(" ms");
+            LOG_I("CONFIG", "Reverting to normal polling: %lu ms", currentConfigPollingInterval);
         }
     }
 }
 
-void pollSensors()
+// Poll job: one pipelined cycle over every configured inverter, yielding
+// while gateway replies are outstanding
+uint32_t pollStep()
 {
-    if (!systemInitialized)
-        return;
+    static bool cycling = false;
+    if (!cycling)
+    {
+        // Save mode: the power job brings the radio up for this poll
+        if (powerManager.linkPending())
+            return POWER_CHECK_INTERVAL_MS;
+        if (!beginPollCycle())
+            return JOB_DONE;
+        cycling = true;
+    }
+    if (slavePoller.poll())
+        return ASYNC_HTTP_POLL_MS;
+    cycling = false;
+    endPollCycle();
+    return JOB_DONE;
+}
+
+uint32_t commandStep()
+{
+    executeCommand();
+    return JOB_DONE;
+}
+
+// Runs for the life of the device: follows FOTA's recommended config rate
+// and starts the firmware download once a ranged manifest is acknowledged
+uint32_t fotaStep()
+{
+    updateConfigPollingRate();
+    if (fota.isDownloadPending() && !scheduler.isActive(firmwareJob))
+        scheduler.request(firmwareJob);
+    return FOTA_MONITOR_INTERVAL_MS;
+}
 
-    Serial.println("[POLL] Starting sensor polling...");
+uint32_t firmwareStep()
+{
+    return fota.downloadStep();
+}
 
-    Sample sample;
-    sample.timestamp = millis() - startTime;
+// Runs for the life of the device: restarts WiFi.begin() while the link is
+// down, without ever waiting for the association to complete. Reconnects try
+// the cached access point first and fall back to a full scan.
+uint32_t wifiStep()
+{
+    static bool reconnecting = false;
+    static bool linkUp = false;
+    static unsigned long reconnectStartedAt = 0;
+    static unsigned long linkLostAt = 0;
 
-    bool allSuccess = true;
-    const auto &enabledParams = pollingConfig.getEnabledParameters();
+    // Radio deliberately off, or a wake-up reconnect still in its window
+    if (powerManager.linkPending())
+        return WIFI_CHECK_INTERVAL_MS;
 
-    for (ParameterType paramType : enabledParams)
+    if (WiFi.status() == WL_CONNECTED)
     {
-        float value;
-
-        if (inverter.read(paramType, value))
+        if (!linkUp)
         {
-            sample.setValue(paramType, value);
-            // Get name and unit from parameter descriptor table
-            String friendlyName = pollingConfig.getParameterName(paramType);
-            String unit = pollingConfig.getParameterUnit(paramType);
-
-            // Fallback to default conversion if name/unit not found
-            if (friendlyName.length() == 0)
-            {
-                friendlyName = parameterTypeToString(paramType);
-            }
-            if (unit.length() == 0)
-            {
-                switch (paramType)
-                {
-                case ParameterType::AC_VOLTAGE:
-                case ParameterType::PV1_VOLTAGE:
-                case ParameterType::PV2_VOLTAGE:
-                    unit = " V";
-                    break;
-                case ParameterType::AC_CURRENT:
-                case ParameterType::PV1_CURRENT:
-                case ParameterType::PV2_CURRENT:
-                    unit = " A";
-                    break;
-                case ParameterType::AC_FREQUENCY:
-                    unit = " Hz";
-                    break;
-                case ParameterType::TEMPERATURE:
-                    unit = " °C";
-                    break;
-                case ParameterType::OUTPUT_POWER:
-                    unit = " W";
-                    break;
-                case ParameterType::EXPORT_POWER_PERCENT:
-                    unit = " %";
-                    break;
-                default:
-                    unit = "";
-                    break;
-                }
-            }
-            Serial.print("[POLL] ");
-            Serial.print(friendlyName);
-            Serial.print(": ");
-            Serial.print(value, 2);
-            Serial.println(unit);
+            powerManager.noteConnected();
+            linkUp = true;
         }
-        else
+        if (reconnecting)
         {
-            Serial.print("[POLL] Failed to read ");
-            String paramName = pollingConfig.getParameterName(paramType);
-            if (paramName.length() > 0)
-            {
-                Serial.println(paramName);
-            }
-            else
-            {
-                Serial.println(parameterTypeToString(paramType));
-            }
-            allSuccess = false;
+            LOG_I("WiFi", "Reconnected! IP address: %s", WiFi.localIP().toString().c_str());
+            reconnecting = false;
+            uint32_t downMs = millis() - linkLostAt;
+            metrics.record(MetricStage::WIFI_RECONNECT, downMs < UINT32_MAX / 1000 ? downMs * 1000 : UINT32_MAX);
+            metrics.count(MetricCounter::WIFI_RECONNECTS);
         }
+        return WIFI_CHECK_INTERVAL_MS;
     }
+    linkUp = false;
 
-    if (allSuccess && dataBuffer.hasSpace())
-    {
-        dataBuffer.append(sample);
-        Serial.print("[BUFFER] Sample added, buffer size: ");
-        Serial.println(dataBuffer.size());
-    }
-    else if (!allSuccess)
-    {
-        Serial.println("[POLL] Poll failed for some parameters");
-    }
-    else
+    uint32_t timeout = powerManager.fastAttempt() ? POWER_FAST_CONNECT_MS : WIFI_RECONNECT_TIMEOUT_MS;
+    if (!reconnecting || millis() - reconnectStartedAt >= timeout)
     {
-        Serial.println("[BUFFER] Buffer full, sample discarded");
+        if (powerManager.fastAttempt())
+            powerManager.forgetAccessPoint(); // It did not answer in time: scan
+        if (reconnecting)
+            LOG_W("WiFi", "Reconnect timed out, retrying...");
+        else
+            LOG_W("WiFi", "Connection lost, attempting reconnect...");
+        if (!reconnecting)
+            linkLostAt = millis();
+        WiFi.disconnect();
+        powerManager.connect(configManager.getWiFiConfig());
+        reconnecting = true;
+        reconnectStartedAt = millis();
     }
+    return WIFI_CHECK_INTERVAL_MS;
+}
+
+// Milliseconds until a periodic timer next fires, given its last tick
+static uint32_t untilNextTick(unsigned long lastTickAt, uint32_t periodMs, unsigned long now)
+{
+    uint32_t elapsed = now - lastTickAt;
+    return elapsed < periodMs ? periodMs - elapsed : 0;
+}
+
+// True while any job may still need the network
+static bool networkBusy()
+{
+    return slavePoller.busy() || scheduler.isActive(pollJob) || scheduler.isActive(commandJob) ||
+           scheduler.isActive(uploadJob) || scheduler.isActive(configJob) || scheduler.isActive(firmwareJob);
 }
 
-void uploadData()
+// Runs for the life of the device: accounts radio-on time and, in save mode,
+// turns the radio off across gaps to the next poll or upload window that
+// are long enough to pay for a reconnect, and back on just before them
+uint32_t powerStep()
 {
-    if (!systemInitialized || dataBuffer.empty())
+    powerManager.tick();
+    const WiFiConfig &wifiConfig = configManager.getWiFiConfig();
+    if (!powerManager.saving() || fota.needsFastPolling())
     {
-        Serial.println("[UPLOAD] No data to upload");
-        return;
+        powerManager.wake(wifiConfig);
+        return POWER_CHECK_INTERVAL_MS;
     }
 
-    static bool uploadInProgress = false;
-    if (uploadInProgress)
+    unsigned long now = millis();
+    uint32_t gap = untilNextTick(lastPollTickAt, pollRate.interval(), now);
+    uint32_t untilUpload = untilNextTick(lastUploadTickAt, configManager.getDeviceConfig().upload_interval_ms, now);
+    if (untilUpload < gap)
+        gap = untilUpload;
+
+    if (powerManager.asleep())
     {
-        Serial.println("[UPLOAD] Previous upload still in progress; skipping this tick");
-        return;
+        if (gap <= POWER_WAKE_LEAD_MS || networkBusy())
+            powerManager.wake(wifiConfig);
     }
-    uploadInProgress = true;
+    else if (gap >= POWER_SLEEP_MIN_GAP_MS && !networkBusy() && WiFi.status() == WL_CONNECTED)
+    {
+        ESP8266AsyncHttp::closeAll();
+        powerManager.sleep();
+    }
+    return POWER_CHECK_INTERVAL_MS;
+}
 
-    Serial.println("[UPLOAD] Starting data upload...");
+// Started by the soak command; each step simulates one bounded slice, so the
+// loop watchdog keeps being fed and due jobs run in between
+uint32_t soakStep()
+{
+    return soakBench.step() ? 0 : JOB_DONE;
+}
 
-    // Non-destructive snapshot; clear only after ACK success
-    auto samples = dataBuffer.snapshot();
-    Serial.print("[UPLOAD] Uploading ");
-    Serial.print(samples.size());
-    Serial.println(" samples");
+// Registration order is priority order: sampling first, then the cheap link
+// monitor, then network work
+void registerJobs()
+{
+    pollJob = scheduler.addJob("poll", pollStep);
+    wifiJob = scheduler.addJob("wifi", wifiStep);
+    commandJob = scheduler.addJob("command", commandStep);
+    uploadJob = scheduler.addJob("upload", uploadStep);
+    configJob = scheduler.addJob("config", configStep);
+    fotaJob = scheduler.addJob("fota", fotaStep);
+    firmwareJob = scheduler.addJob("firmware", firmwareStep);
+    powerJob = scheduler.addJob("power", powerStep);
+    soakJob = scheduler.addJob("soak", soakStep); // Last: runs only when nothing else is due
+
+    scheduler.start(wifiJob);
+    scheduler.start(fotaJob);
+    scheduler.start(powerJob);
+
+    slavePoller.onSample(storePolledSample);
+}
 
-    if (uploadToServer(samples))
+// Runs once per slave and cycle, as soon as that slave's last span is in
+void storePolledSample(Sample &sample, uint16_t failedMask)
+{
+    // Rollups cover the primary inverter; they see every value read, even if
+    // the buffer drops it
+    if (sample.slave == 0)
     {
-        Serial.println("[UPLOAD] Upload successful");
-        dataBuffer.clear();
-
-        // Clear command result after successful upload
-        if (lastCommandResult.has_result)
+        aggregator.add(sample);
+        // The primary inverter's dynamics set the rate for every slave
+        if (pollRate.update(sample))
         {
-            Serial.println("[COMMAND] Command result successfully reported to cloud");
-            lastCommandResult.has_result = false;
+            pollTicker.detach();
+            pollTicker.attach_ms(pollRate.interval(), onPollTimer);
         }
+    }
+    uint16_t slaveMask = pollingConfig.slaveParamMask(sample.slave);
 
-        // Clear config acknowledgment after successful upload
-        if (lastConfigAck.has_ack)
+    for (uint8_t i = 0; i < PARAMETER_TYPE_COUNT; i++)
+    {
+        ParameterType paramType = static_cast<ParameterType>(i);
+        uint16_t bit = ESP8266PollPlanner::paramBit(paramType);
+        if (!(slaveMask & bit))
+            continue;
+        if (failedMask & bit)
         {
-            Serial.println("[CONFIG] Configuration acknowledgment successfully reported to cloud");
-            lastConfigAck.has_ack = false;
-            lastConfigAck.accepted.clear();
-            lastConfigAck.rejected.clear();
-            lastConfigAck.unchanged.clear();
+            LOG_W("POLL", "Failed to read %s on slave 0x%02X", param_name(paramType),
+                  pollingConfig.slaveAddress(sample.slave));
+            continue;
         }
 
-        // Apply pending configuration changes after successful upload
-        if (pendingConfigurationUpdate)
-        {
-            Serial.println("[CONFIG] Applying pending configuration changes...");
-            applyNewConfiguration();
-            pendingConfigurationUpdate = false;
-            Serial.println("[CONFIG] New configuration applied successfully");
-        }
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_DEBUG
+        float value = sample.getValue(paramType);
+        LOG_D("POLL", "0x%02X %s: %.2f %s", pollingConfig.slaveAddress(sample.slave), param_name(paramType), value,
+              param_unit(paramType));
+#endif
     }
-    else
+
+    switch (sampleStore.store(sample, failedMask))
     {
-        Serial.println("[UPLOAD] Upload failed");
+    case StoreResult::STORED:
+        LOG_D("BUFFER", "Sample added, buffer size: %u", (unsigned)dataBuffer.size());
+        break;
+    case StoreResult::FAILED:
+        LOG_W("POLL", "Poll failed for some parameters");
+        break;
+    case StoreResult::UNCHANGED:
+        LOG_I("BUFFER", "No value moved beyond its deadband, sample not stored");
+        break;
+    case StoreResult::DISCARDED:
+        LOG_W("BUFFER", "Buffer full, sample discarded");
+        break;
     }
-
-    uploadInProgress = false;
 }
 
-void requestConfigUpdate()
+bool beginPollCycle()
 {
     if (!systemInitialized)
+        return false;
+
+    LOG_D("POLL", "Starting sensor polling...");
+    heapPollStats.before = takeHeapSnapshot();
+    // One block read per planned span and slave, pipelined across slaves
+    return slavePoller.start(pollingConfig, millis() - startTime);
+}
+
+void endPollCycle()
+{
+    LOG_D("POLL", "Cycle done in %lu ms (%lu ms of gateway round trips)", (unsigned long)slavePoller.lastCycleMs(),
+          (unsigned long)slavePoller.lastSerialMs());
+
+    // Track heap fragmentation across the cycle
+    heapPollStats.after = takeHeapSnapshot();
+    heapPollStats.cycles++;
+    if (heapPollStats.after.max_free_block < heapPollStats.min_max_free_block)
+        heapPollStats.min_max_free_block = heapPollStats.after.max_free_block;
+    if (heapPollStats.after.fragmentation > heapPollStats.peak_fragmentation)
+        heapPollStats.peak_fragmentation = heapPollStats.after.fragmentation;
+    metrics.noteHeap(heapPollStats.after.free_heap, heapPollStats.after.max_free_block, heapPollStats.after.fragmentation);
+
+    LOG_D("HEAP", "Poll: free %u -> %u, max block %u -> %u, frag %u%% -> %u%%",
+          (unsigned)heapPollStats.before.free_heap, (unsigned)heapPollStats.after.free_heap,
+          (unsigned)heapPollStats.before.max_free_block, (unsigned)heapPollStats.after.max_free_block,
+          heapPollStats.before.fragmentation, heapPollStats.after.fragmentation);
+}
+
+// Blocking poll cycle for the serial "test" command
+void pollSensors()
+{
+    if (slavePoller.busy())
     {
-        Serial.println("[CONFIG] System not initialized, skipping config request");
+        slavePoller.wait(); // The poll job will close this cycle
         return;
     }
+    if (!beginPollCycle())
+        return;
+    slavePoller.wait();
+    endPollCycle();
+}
 
-    static bool configRequestInProgress = false;
-    if (configRequestInProgress)
+// Config job: a conditional check while nothing has changed, otherwise a full
+// signed request; polls the config channel until the completion callback has
+// run and retries once after a non-blocking wait
+uint32_t configStep()
+{
+    static int attempt = 0;
+    static bool checking = false;
+    if (!configHttp.busy())
     {
-        Serial.println("[CONFIG] Previous config request still in progress; skipping this tick");
-        return;
+        if (powerManager.linkPending())
+            return POWER_CHECK_INTERVAL_MS;
+        if (!systemInitialized)
+        {
+            LOG_W("CONFIG", "System not initialized, skipping config request");
+            return JOB_DONE;
+        }
+        checking = configCheckAllowed();
+        if (attempt == 0 && !checking)
+            LOG_I("CONFIG", "Requesting configuration update from cloud...");
+        if (!(checking ? startConfigCheck() : startConfigRequest()))
+        {
+            attempt = 0;
+            return JOB_DONE;
+        }
     }
-    configRequestInProgress = true;
 
-    Serial.println("[CONFIG] Requesting configuration update from cloud...");
+    if (configHttp.poll())
+        return ASYNC_HTTP_POLL_MS;
 
-    if (sendConfigRequest())
+    if (checking)
+    {
+        if (configCheckCode == HTTP_CODE_NOT_MODIFIED)
+        {
+            attempt = 0;
+            return JOB_DONE;
+        }
+        if (configCheckCode >= 200 && configCheckCode < 300)
+        {
+            // Something is waiting for us: fetch it with a full request now
+            LOG_I("CONFIG", "Server reports a change, requesting full configuration");
+            configChangePending = true;
+            attempt = 0;
+            return 0;
+        }
+        if (configCheckCode >= 400 && configCheckCode < 500)
+        {
+            // Server does not support conditional checks: full requests only
+            LOG_I("CONFIG", "Conditional check not supported, using full requests");
+            configEtag = "";
+            attempt = 0;
+            return 0;
+        }
+    }
+    else if (configRequestOk)
     {
-        Serial.println("[CONFIG] Configuration request successful");
+        LOG_I("CONFIG", "Configuration request successful");
+        attempt = 0;
+        return JOB_DONE;
     }
-    else
+
+    if (++attempt < CONFIG_MAX_ATTEMPTS)
     {
-        Serial.println("[CONFIG] Configuration request failed");
+        LOG_W("CONFIG", "Retrying configuration request...");
+        return CONFIG_RETRY_DELAY_MS;
     }
 
-    configRequestInProgress = false;
+    LOG_E("CONFIG", "Configuration request failed");
+    metrics.count(MetricCounter::CONFIG_FAILURES);
+    attempt = 0;
+    return JOB_DONE;
 }
 
-bool sendConfigRequest()
+bool startConfigRequest()
 {
     const APIConfig &apiConfig = configManager.getAPIConfig();
-    HTTPClient httpClient;
-    WiFiClient wifiClient;
 
     // Use config_url endpoint for configuration requests, fallback to upload_url
     const char *configUrl;
@@ -578,14 +807,12 @@ bool sendConfigRequest()
     else
         configUrl = "http://10.63.73.102:5000/config";
 
-    httpClient.begin(wifiClient, configUrl);
-    Serial.print("[HTTP] Config request to: ");
-    Serial.println(configUrl);
-    httpClient.addHeader("Content-Type", "application/json");
-    httpClient.setTimeout(apiConfig.timeout_ms);
+    LOG_D("HTTP", "Config request to: %s", configUrl);
 
-    // Build device status request as per specification
-    StaticJsonDocument<512> requestDoc;
+    // Build device status request as per specification. Static: the body is
+    // written from a later step of the config job.
+    static StaticJsonDocument<512> requestDoc;
+    requestDoc.clear();
     requestDoc["device_id"] = WiFi.hostname();
     requestDoc["firmware_version"] = configManager.getFirmwareVersion();
     requestDoc["status"] = "ready";
@@ -606,951 +833,1217 @@ bool sendConfigRequest()
             bootData["error_message"] = "";
         }
         
-        Serial.println("[CONFIG] Adding boot status to config request");
+        LOG_I("CONFIG", "Adding boot status to config request");
     }
 
     // Add FOTA status if there's an ongoing update
     JsonObject requestObj = requestDoc.as<JsonObject>();
     fota.addStatusToConfigRequest(requestObj);
 
-    // Add security features encryption, signing, etc. as needed here
-    String securePayload = ESP8266Security::createSecureWrapper(requestDoc);
-
-    Serial.print("[HTTP] Config request payload: ");
-    Serial.println(securePayload);
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_VERBOSE
+    char preview[LOG_LINE_MAX];
+    serializeJson(requestDoc, preview, sizeof(preview));
+    LOG_V("HTTP", "Config request payload: %s", preview);
+#endif
 
-    const int maxAttempts = 2;
-    for (int attempt = 0; attempt < maxAttempts; attempt++)
+    // Secure wrapper is streamed to the socket; each attempt is a fresh signed request
+    static uint32_t nonce;
+    nonce = configManager.getNextNonce();
+    auto writeBody = [](Print &out)
+    {
+        ESP8266Security::writeSecureWrapper(out, requestDoc, nonce);
+    };
+    auto onDone = [](int code)
     {
-        int code = httpClient.POST(securePayload);
+        const HttpTiming &t = configHttp.timing();
         if (code > 0)
+            metrics.record(MetricStage::CONFIG_ROUND_TRIP, t.connect_us + t.send_us + t.wait_us);
+        configRequestOk = handleConfigResponse(code, configHttp.responseData(), configHttp.responseLength());
+        if (configRequestOk)
+        {
+            // Servers without ETag support leave this empty: full requests only
+            configEtag = configHttp.etag();
+            configChangePending = false;
+        }
+    };
+
+    configRequestOk = false;
+    configHttp.setResponseBuffer(configResponse, sizeof(configResponse));
+    return configHttp.start(configUrl, "application/json", writeBody, apiConfig.timeout_ms, nullptr, onDone);
+}
+
+// Conditional checks carry nothing to report, so they are only used once the
+// server has handed out an ETag and no boot status or FOTA progress is pending
+bool configCheckAllowed()
+{
+    return configEtag.length() > 0 && !configChangePending && !fota.isUpdateInProgress() &&
+           !configManager.needsBootStatusReport();
+}
+
+// Unsigned GET with If-None-Match: the server answers 304 when nothing has
+// changed, or 200 when a config update, command or FOTA manifest is waiting.
+// The reply only triggers a full signed request, so it needs no MAC, nonce
+// or base64. With long-poll enabled the server may hold the 304 until
+// something changes.
+bool startConfigCheck()
+{
+    const APIConfig &apiConfig = configManager.getAPIConfig();
+    String url = strlen(apiConfig.config_url) > 0 ? apiConfig.config_url : apiConfig.upload_url;
+    url += (url.indexOf('?') < 0) ? "?device_id=" : "&device_id=";
+    url += WiFi.hostname();
+
+    String headers = "If-None-Match: ";
+    headers += configEtag;
+    headers += "\r\n";
+    uint32_t timeout = apiConfig.timeout_ms;
+    // A held check would keep the radio up between save-mode windows
+    if (apiConfig.config_long_poll_s > 0 && !powerManager.saving())
+    {
+        headers += "Prefer: wait=";
+        headers += apiConfig.config_long_poll_s;
+        headers += "\r\n";
+        timeout = apiConfig.config_long_poll_s * 1000UL + apiConfig.timeout_ms;
+        if (timeout > 0xFFFF)
+            timeout = 0xFFFF;
+    }
+
+    configCheckCode = 0;
+    auto onDone = [](int code)
+    {
+        configCheckCode = code;
+    };
+    return configHttp.startGet(url, headers, (uint16_t)timeout, nullptr, onDone);
+}
+
+// Cloud register names used by config_update
+static bool cloudRegisterToParam(const char *name, ParameterType &param)
+{
+    const ParamDesc *desc = find_param_by_cloud_name(name);
+    if (!desc)
+        return false;
+    param = param_id(desc);
+    return true;
+}
+
+// Parse config_update "deadband" (engineering units) and "max_silence"
+// (seconds) objects keyed by cloud register name into raw-unit tables that
+// start as a copy of the current settings. False on any invalid entry.
+static bool parseReportingUpdate(const JsonObject &configUpdate, uint16_t *deadband, uint16_t *maxSilence)
+{
+    bool valid = true;
+    JsonObject bands = configUpdate["deadband"];
+    for (JsonPair kv : bands)
+    {
+        ParameterType param;
+        float value = kv.value().as<float>();
+        bool known = cloudRegisterToParam(kv.key().c_str(), param);
+        float raw = known ? value * param_scale(param) : -1.0f;
+        if (!known || value < 0.0f || raw > 65535.0f)
+        {
+            LOG_E("CONFIG", "Error: Invalid deadband for '%s'", kv.key().c_str());
+            valid = false;
+            continue;
+        }
+        deadband[static_cast<uint8_t>(param)] = (uint16_t)roundf(raw);
+    }
+
+    JsonObject silences = configUpdate["max_silence"];
+    for (JsonPair kv : silences)
+    {
+        ParameterType param;
+        long seconds = kv.value().as<long>();
+        if (!cloudRegisterToParam(kv.key().c_str(), param) || seconds < 0 || seconds > 65535)
+        {
+            LOG_E("CONFIG", "Error: Invalid max_silence for '%s'", kv.key().c_str());
+            valid = false;
+            continue;
+        }
+        maxSilence[static_cast<uint8_t>(param)] = (uint16_t)seconds;
+    }
+    return valid;
+}
+
+// Parse config_update "slaves": [{"address": N, "registers": [...]}], the
+// inverters polled besides the primary one. False on any invalid entry.
+static bool parseSlavesUpdate(const JsonArray &slavesArray, uint8_t primaryAddress, SlaveConfig *slaves, uint8_t &count)
+{
+    count = 0;
+    if (slavesArray.isNull() || slavesArray.size() > MAX_SLAVES - 1)
+    {
+        LOG_E("CONFIG", "Error: Invalid slaves array (at most %u entries)", MAX_SLAVES - 1);
+        return false;
+    }
+
+    for (JsonObject entry : slavesArray)
+    {
+        int address = entry["address"] | 0;
+        if (address < 1 || address > 247 || address == primaryAddress)
+        {
+            LOG_E("CONFIG", "Error: Invalid slave address %d", address);
+            return false;
+        }
+        for (uint8_t i = 0; i < count; i++)
         {
-            String response = httpClient.getString();
-            Serial.print("[HTTP] Config response code: ");
-            Serial.println(code);
-            Serial.print("[HTTP] Config response: ");
-            Serial.println(response);
+            if (slaves[i].address == address)
+            {
+                LOG_E("CONFIG", "Error: Duplicate slave address %d", address);
+                return false;
+            }
+        }
 
-            if (code == HTTP_CODE_OK)
+        uint16_t mask = 0;
+        for (JsonVariant reg : entry["registers"].as<JsonArray>())
+        {
+            ParameterType param;
+            if (!cloudRegisterToParam(reg | "", param))
             {
-                StaticJsonDocument<1024> respDoc;
-                if (deserializeJson(respDoc, response) == DeserializationError::Ok)
-                {
-                    // Check for config_update message format
-                    if (respDoc.containsKey("config_update"))
-                    {
-                        JsonObject configUpdate = respDoc["config_update"].as<JsonObject>();
-                        Serial.print("[CONFIG] Received config_update: ");
-                        serializeJson(configUpdate, Serial);
-                        Serial.println();
+                LOG_E("CONFIG", "Error: Invalid register '%s' for slave %d", reg | "", address);
+                return false;
+            }
+            mask |= ESP8266PollPlanner::paramBit(param);
+        }
+        if (mask == 0)
+        {
+            LOG_E("CONFIG", "Error: No registers for slave %d", address);
+            return false;
+        }
 
-                        // Parse configuration update
-                        bool configValid = true;
-                        std::vector<String> acceptedParams;
-                        std::vector<String> rejectedParams;
-                        std::vector<String> unchangedParams;
+        slaves[count].address = (uint8_t)address;
+        slaves[count].param_mask = mask;
+        count++;
+    }
+    return true;
+}
 
-                        uint16_t newInterval = 0;
-                        std::vector<ParameterType> newParams;
+// Fields of a config response the device acts on. Whatever else the server
+// sends is skipped while parsing and never takes document space.
+static const JsonDocument &configResponseFilter()
+{
+    static StaticJsonDocument<128> filter;
+    if (filter.isNull())
+    {
+        filter["config_update"] = true;
+        filter["command"] = true;
+        filter["commands"] = true;
+        filter["fota"] = true;
+        // Secure FOTA wrapper
+        filter["nonce"] = true;
+        filter["payload"] = true;
+        filter["mac"] = true;
+    }
+    return filter;
+}
 
-                        // Get current configuration for comparison
-                        const DeviceConfig &currentConfig = configManager.getDeviceConfig();
+// Runs from the config channel's completion callback, with the body in the
+// channel's fixed response buffer
+bool handleConfigResponse(int code, const uint8_t *body, size_t length)
+{
+    if (code > 0)
+    {
+        LOG_D("HTTP", "Config response code: %d", code);
+        LOG_V("HTTP", "Config response: %.*s", (int)length, (const char *)body);
 
-                        // Parse sampling_interval
-                        if (configUpdate.containsKey("sampling_interval"))
+        // The buffer is armed per request; a body elsewhere means it was not
+        if (body != configResponse)
+        {
+            LOG_E("HTTP", "Config response missed its buffer");
+            return false;
+        }
+        if (code == HTTP_CODE_OK)
+        {
+            StaticJsonDocument<1536> respDoc; // Room for a full slaves list
+            if (deserializeJson(respDoc, (const char *)body, length,
+                                DeserializationOption::Filter(configResponseFilter())) == DeserializationError::Ok)
+            {
+                // Check for config_update message format
+                if (respDoc.containsKey("config_update"))
+                {
+                    JsonObject configUpdate = respDoc["config_update"].as<JsonObject>();
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_INFO
+                    char preview[LOG_LINE_MAX];
+                    serializeJson(configUpdate, preview, sizeof(preview));
+                    LOG_I("CONFIG", "Received config_update: %s", preview);
+#endif
+
+                    // Parse configuration update
+                    bool configValid = true;
+                    std::vector<String> acceptedParams;
+                    std::vector<String> rejectedParams;
+                    std::vector<String> unchangedParams;
+
+                    uint16_t newInterval = 0;
+                    std::vector<ParameterType> newParams;
+
+                    // Get current configuration for comparison
+                    const DeviceConfig &currentConfig = configManager.getDeviceConfig();
+
+                    // Parse sampling_interval
+                    if (configUpdate.containsKey("sampling_interval"))
+                    {
+                        newInterval = configUpdate["sampling_interval"] | 0;
+                        if (newInterval > 0 && newInterval >= 1000 && newInterval <= 60000)
                         {
-                            newInterval = configUpdate["sampling_interval"] | 0;
-                            if (newInterval > 0 && newInterval >= 1000 && newInterval <= 60000)
+                            // Check if the value is actually different from current
+                            if (newInterval != currentConfig.poll_interval_ms)
                             {
-                                // Check if the value is actually different from current
-                                if (newInterval != currentConfig.poll_interval_ms)
-                                {
-                                    acceptedParams.push_back("sampling_interval");
-                                    Serial.print("[CONFIG] New sampling interval: ");
-                                    Serial.print(newInterval);
-                                    Serial.println(" ms");
-                                }
-                                else
-                                {
-                                    unchangedParams.push_back("sampling_interval");
-                                    Serial.print("[CONFIG] Sampling interval unchanged: ");
-                                    Serial.print(newInterval);
-                                    Serial.println(" ms");
-                                }
+                                acceptedParams.push_back("sampling_interval");
+                                LOG_I("CONFIG", "New sampling interval: %u ms", newInterval);
                             }
                             else
                             {
-                                rejectedParams.push_back("sampling_interval");
-                                Serial.println("[CONFIG] Error: Invalid sampling_interval (must be 1000-60000ms)");
-                                configValid = false;
+                                unchangedParams.push_back("sampling_interval");
+                                LOG_I("CONFIG", "Sampling interval unchanged: %u ms", newInterval);
                             }
                         }
+                        else
+                        {
+                            rejectedParams.push_back("sampling_interval");
+                            LOG_E("CONFIG", "Error: Invalid sampling_interval (must be 1000-60000ms)");
+                            configValid = false;
+                        }
+                    }
 
-                        // Parse registers array
-                        if (configUpdate.containsKey("registers"))
+                    // Parse registers array
+                    if (configUpdate.containsKey("registers"))
+                    {
+                        JsonArray registersArray = configUpdate["registers"];
+                        if (!registersArray.isNull())
                         {
-                            JsonArray registersArray = configUpdate["registers"];
-                            if (!registersArray.isNull())
+                            bool registersValid = true;
+                            for (JsonVariant reg : registersArray)
                             {
-                                bool registersValid = true;
-                                for (JsonVariant reg : registersArray)
-                                {
-                                    String regStr = reg.as<String>();
-
-                                    // Map cloud register names to our parameter types
-                                    ParameterType paramType;
-                                    if (regStr == "voltage")
-                                        paramType = ParameterType::AC_VOLTAGE;
-                                    else if (regStr == "current")
-                                        paramType = ParameterType::AC_CURRENT;
-                                    else if (regStr == "frequency")
-                                        paramType = ParameterType::AC_FREQUENCY;
-                                    else if (regStr == "temperature")
-                                        paramType = ParameterType::TEMPERATURE;
-                                    else if (regStr == "power")
-                                        paramType = ParameterType::OUTPUT_POWER;
-                                    else if (regStr == "pv1_voltage")
-                                        paramType = ParameterType::PV1_VOLTAGE;
-                                    else if (regStr == "pv2_voltage")
-                                        paramType = ParameterType::PV2_VOLTAGE;
-                                    else if (regStr == "pv1_current")
-                                        paramType = ParameterType::PV1_CURRENT;
-                                    else if (regStr == "pv2_current")
-                                        paramType = ParameterType::PV2_CURRENT;
-                                    else if (regStr == "output_power_percentage")
-                                        paramType = ParameterType::EXPORT_POWER_PERCENT;
-                                    else
-                                    {
-                                        Serial.print("[CONFIG] Error: Invalid register '");
-                                        Serial.print(regStr);
-                                        Serial.println("' - skipping");
-                                        registersValid = false;
-                                        continue;
-                                    }
+                                const char *regStr = reg | "";
 
-                                    newParams.push_back(paramType);
-                                    Serial.print("[CONFIG] Valid register: ");
-                                    Serial.println(regStr);
+                                // Map cloud register names to our parameter types
+                                ParameterType paramType;
+                                if (!cloudRegisterToParam(regStr, paramType))
+                                {
+                                    LOG_E("CONFIG", "Error: Invalid register '%s' - skipping", regStr);
+                                    registersValid = false;
+                                    continue;
                                 }
 
-                                if (registersValid && !newParams.empty())
+                                newParams.push_back(paramType);
+                                LOG_D("CONFIG", "Valid register: %s", regStr);
+                            }
+
+                            if (registersValid && !newParams.empty())
+                            {
+                                // Check if the registers have actually changed
+                                bool registersChanged = false;
+                                if (newParams.size() != currentConfig.num_enabled_params)
                                 {
-                                    // Check if the registers have actually changed
-                                    bool registersChanged = false;
-                                    if (newParams.size() != currentConfig.num_enabled_params)
-                                    {
-                                        registersChanged = true;
-                                    }
-                                    else
+                                    registersChanged = true;
+                                }
+                                else
+                                {
+                                    // Check if any parameters are different
+                                    for (size_t i = 0; i < newParams.size(); i++)
                                     {
-                                        // Check if any parameters are different
-                                        for (size_t i = 0; i < newParams.size(); i++)
+                                        bool found = false;
+                                        for (uint8_t j = 0; j < currentConfig.num_enabled_params; j++)
                                         {
-                                            bool found = false;
-                                            for (uint8_t j = 0; j < currentConfig.num_enabled_params; j++)
+                                            if (newParams[i] == currentConfig.enabled_params[j])
                                             {
-                                                if (newParams[i] == currentConfig.enabled_params[j])
-                                                {
-                                                    found = true;
-                                                    break;
-                                                }
-                                            }
-                                            if (!found)
-                                            {
-                                                registersChanged = true;
+                                                found = true;
                                                 break;
                                             }
                                         }
+                                        if (!found)
+                                        {
+                                            registersChanged = true;
+                                            break;
+                                        }
                                     }
+                                }
 
-                                    if (registersChanged)
-                                    {
-                                        acceptedParams.push_back("registers");
-                                        Serial.println("[CONFIG] Registers configuration will be updated");
-                                    }
-                                    else
-                                    {
-                                        unchangedParams.push_back("registers");
-                                        Serial.println("[CONFIG] Registers configuration unchanged");
-                                    }
+                                if (registersChanged)
+                                {
+                                    acceptedParams.push_back("registers");
+                                    LOG_I("CONFIG", "Registers configuration will be updated");
                                 }
                                 else
                                 {
-                                    rejectedParams.push_back("registers");
-                                    if (newParams.empty())
-                                        Serial.println("[CONFIG] Error: No valid registers found");
-                                    configValid = false;
+                                    unchangedParams.push_back("registers");
+                                    LOG_I("CONFIG", "Registers configuration unchanged");
                                 }
                             }
                             else
                             {
                                 rejectedParams.push_back("registers");
-                                Serial.println("[CONFIG] Error: Invalid registers array");
+                                if (newParams.empty())
+                                    LOG_E("CONFIG", "Error: No valid registers found");
                                 configValid = false;
                             }
                         }
-
-                        // Store configuration if valid (but don't apply immediately)
-                        if (configValid && (!acceptedParams.empty()))
+                        else
                         {
-                            Serial.println("[CONFIG] Storing new configuration for next upload cycle...");
+                            rejectedParams.push_back("registers");
+                            LOG_E("CONFIG", "Error: Invalid registers array");
+                            configValid = false;
+                        }
+                    }
 
-                            // Update configuration only for accepted parameters
-                            if (newInterval > 0 && std::find(acceptedParams.begin(), acceptedParams.end(), "sampling_interval") != acceptedParams.end())
-                            {
-                                if (!newParams.empty() && std::find(acceptedParams.begin(), acceptedParams.end(), "registers") != acceptedParams.end())
-                                {
-                                    configManager.updatePollingConfig(newInterval, newParams);
-                                }
-                                else
-                                {
-                                    // Only update interval, keep current parameters
-                                    const DeviceConfig &currentConfig = configManager.getDeviceConfig();
-                                    std::vector<ParameterType> currentParams;
-                                    for (uint8_t i = 0; i < currentConfig.num_enabled_params; ++i)
-                                    {
-                                        currentParams.push_back(currentConfig.enabled_params[i]);
-                                    }
-                                    configManager.updatePollingConfig(newInterval, currentParams);
-                                }
-                            }
-                            else if (!newParams.empty() && std::find(acceptedParams.begin(), acceptedParams.end(), "registers") != acceptedParams.end())
-                            {
-                                // Only update parameters, keep current interval
-                                const DeviceConfig &currentConfig = configManager.getDeviceConfig();
-                                configManager.updatePollingConfig(currentConfig.poll_interval_ms, newParams);
-                            }
+                    // Parse per-parameter deadband / max_silence (report-by-exception)
+                    uint16_t newDeadband[PARAMETER_TYPE_COUNT];
+                    uint16_t newMaxSilence[PARAMETER_TYPE_COUNT];
+                    memcpy(newDeadband, currentConfig.deadband, sizeof(newDeadband));
+                    memcpy(newMaxSilence, currentConfig.max_silence_s, sizeof(newMaxSilence));
+                    if (configUpdate.containsKey("deadband") || configUpdate.containsKey("max_silence"))
+                    {
+                        if (!parseReportingUpdate(configUpdate, newDeadband, newMaxSilence))
+                        {
+                            rejectedParams.push_back("deadband");
+                            configValid = false;
+                        }
+                        else if (memcmp(newDeadband, currentConfig.deadband, sizeof(newDeadband)) != 0 ||
+                                 memcmp(newMaxSilence, currentConfig.max_silence_s, sizeof(newMaxSilence)) != 0)
+                        {
+                            acceptedParams.push_back("deadband");
+                            LOG_I("CONFIG", "Deadband configuration will be updated");
+                        }
+                        else
+                        {
+                            unchangedParams.push_back("deadband");
+                            LOG_I("CONFIG", "Deadband configuration unchanged");
+                        }
+                    }
 
-                            if (configManager.saveConfig())
+                    // Parse further inverters behind the same gateway
+                    SlaveConfig newSlaves[MAX_SLAVES - 1];
+                    uint8_t newSlaveCount = 0;
+                    if (configUpdate.containsKey("slaves"))
+                    {
+                        bool slavesValid = parseSlavesUpdate(configUpdate["slaves"].as<JsonArray>(),
+                                                             currentConfig.slave_address, newSlaves, newSlaveCount);
+                        bool slavesChanged = newSlaveCount != currentConfig.num_extra_slaves;
+                        for (uint8_t i = 0; i < newSlaveCount && !slavesChanged; i++)
+                        {
+                            slavesChanged = newSlaves[i].address != currentConfig.extra_slaves[i].address ||
+                                            newSlaves[i].param_mask != currentConfig.extra_slaves[i].param_mask;
+                        }
+
+                        if (!slavesValid)
+                        {
+                            rejectedParams.push_back("slaves");
+                            configValid = false;
+                        }
+                        else if (slavesChanged)
+                        {
+                            acceptedParams.push_back("slaves");
+                            LOG_I("CONFIG", "Slaves will be updated: %u besides the primary", newSlaveCount);
+                        }
+                        else
+                        {
+                            unchangedParams.push_back("slaves");
+                            LOG_I("CONFIG", "Slaves unchanged");
+                        }
+                    }
+
+                    // Parse the adaptive poll mode and its interval bounds
+                    bool newAdaptive = currentConfig.adaptive_poll;
+                    uint16_t newPollMin = currentConfig.poll_min_ms;
+                    uint16_t newPollMax = currentConfig.poll_max_ms;
+                    if (configUpdate.containsKey("adaptive_poll"))
+                    {
+                        JsonObject adaptive = configUpdate["adaptive_poll"];
+                        newAdaptive = adaptive["enabled"] | newAdaptive;
+                        long minMs = adaptive["min_interval"] | (long)newPollMin;
+                        long maxMs = adaptive["max_interval"] | (long)newPollMax;
+                        if (adaptive.isNull() || minMs < 1000 || maxMs > 60000 || minMs > maxMs)
+                        {
+                            rejectedParams.push_back("adaptive_poll");
+                            LOG_E("CONFIG", "Error: Invalid adaptive_poll (need 1000 <= min_interval <= max_interval <= 60000)");
+                            configValid = false;
+                        }
+                        else if (newAdaptive != currentConfig.adaptive_poll || minMs != currentConfig.poll_min_ms ||
+                                 maxMs != currentConfig.poll_max_ms)
+                        {
+                            newPollMin = (uint16_t)minMs;
+                            newPollMax = (uint16_t)maxMs;
+                            acceptedParams.push_back("adaptive_poll");
+                            LOG_I("CONFIG", "Adaptive polling will be %s: %u-%u ms", newAdaptive ? "on" : "off",
+                                  newPollMin, newPollMax);
+                        }
+                        else
+                        {
+                            unchangedParams.push_back("adaptive_poll");
+                            LOG_I("CONFIG", "Adaptive polling unchanged");
+                        }
+                    }
+
+                    // Parse the radio power mode
+                    uint8_t newPowerMode = currentConfig.power_mode;
+                    if (configUpdate.containsKey("power_mode"))
+                    {
+                        const char *mode = configUpdate["power_mode"] | "";
+                        if (strcmp(mode, "save") == 0 || strcmp(mode, "always_on") == 0)
+                        {
+                            newPowerMode = strcmp(mode, "save") == 0 ? POWER_MODE_SAVE : POWER_MODE_ALWAYS_ON;
+                            if (newPowerMode != currentConfig.power_mode)
                             {
-                                Serial.println("[CONFIG] Configuration saved to EEPROM");
-                                // Mark that we have a pending configuration update to apply after next successful upload
-                                pendingConfigurationUpdate = true;
-                                Serial.println("[CONFIG] Configuration will take effect after next successful upload cycle");
+                                acceptedParams.push_back("power_mode");
+                                LOG_I("CONFIG", "Power mode will be %s", mode);
                             }
                             else
                             {
-                                Serial.println("[CONFIG] Error: Failed to save configuration");
-                                rejectedParams.insert(rejectedParams.end(), acceptedParams.begin(), acceptedParams.end());
-                                acceptedParams.clear();
+                                unchangedParams.push_back("power_mode");
+                                LOG_I("CONFIG", "Power mode unchanged");
                             }
                         }
-                        else if (acceptedParams.empty() && unchangedParams.empty() && rejectedParams.empty())
-                        {
-                            Serial.println("[CONFIG] No configuration parameters found in update");
-                        }
-                        else if (!acceptedParams.empty())
+                        else
                         {
-                            Serial.println("[CONFIG] Configuration update rejected due to validation errors");
+                            rejectedParams.push_back("power_mode");
+                            LOG_E("CONFIG", "Error: Invalid power_mode '%s' (save or always_on)", mode);
+                            configValid = false;
                         }
+                    }
 
-                        // Store acknowledgment for next upload instead of sending immediately
-                        lastConfigAck.accepted.clear();
-                        lastConfigAck.rejected.clear();
-                        lastConfigAck.unchanged.clear();
+                    // Store configuration if valid (but don't apply immediately)
+                    if (configValid && (!acceptedParams.empty()))
+                    {
+                        LOG_I("CONFIG", "Storing new configuration for next upload cycle...");
 
-                        for (const String &param : acceptedParams)
+                        if (std::find(acceptedParams.begin(), acceptedParams.end(), "power_mode") != acceptedParams.end())
                         {
-                            lastConfigAck.accepted.push_back(param);
+                            configManager.setPowerMode(newPowerMode);
                         }
 
-                        for (const String &param : rejectedParams)
+                        if (std::find(acceptedParams.begin(), acceptedParams.end(), "adaptive_poll") != acceptedParams.end())
                         {
-                            lastConfigAck.rejected.push_back(param);
+                            configManager.setAdaptivePolling(newAdaptive, newPollMin, newPollMax);
                         }
 
-                        for (const String &param : unchangedParams)
+                        if (std::find(acceptedParams.begin(), acceptedParams.end(), "slaves") != acceptedParams.end())
                         {
-                            lastConfigAck.unchanged.push_back(param);
+                            configManager.setExtraSlaves(newSlaves, newSlaveCount);
                         }
 
-                        lastConfigAck.has_ack = true;
-
-                        Serial.print("[CONFIG] Configuration acknowledgment prepared for next upload: accepted=");
-                        Serial.print(acceptedParams.size());
-                        Serial.print(", rejected=");
-                        Serial.print(rejectedParams.size());
-                        Serial.print(", unchanged=");
-                        Serial.println(unchangedParams.size());
-
-                        // Mark boot status as reported if we successfully sent it
-                        if (configManager.needsBootStatusReport())
+                        if (std::find(acceptedParams.begin(), acceptedParams.end(), "deadband") != acceptedParams.end())
                         {
-                            configManager.markBootSuccessReported();
-                            Serial.println("[CONFIG] Boot status reported successfully");
+                            configManager.setReportingConfig(newDeadband, newMaxSilence);
                         }
 
-                        httpClient.end();
-                        return true;
-                    }
-                    // Check for command message format
-                    else if (respDoc.containsKey("command"))
-                    {
-                        JsonObject command = respDoc["command"].as<JsonObject>();
-                        Serial.print("[COMMAND] Received command: ");
-                        serializeJson(command, Serial);
-                        Serial.println();
-
-                        // Parse command
-                        String action = command["action"] | "";
-                        String target_register = command["target_register"] | "";
-                        int value = command["value"] | 0;
-
-                        // Validate command
-                        if (action == "write_register" && target_register.length() > 0)
+                        // Update configuration only for accepted parameters
+                        if (newInterval > 0 && std::find(acceptedParams.begin(), acceptedParams.end(), "sampling_interval") != acceptedParams.end())
                         {
-                            // Store the command for execution
-                            pendingCommand.action = action;
-                            pendingCommand.target_register = target_register;
-                            pendingCommand.value = value;
-                            pendingCommand.received_at = millis();
-                            pendingCommand.valid = true;
-
-                            Serial.print("[COMMAND] Queued write command: register=");
-                            Serial.print(target_register);
-                            Serial.print(", value=");
-                            Serial.println(value);
+                            if (!newParams.empty() && std::find(acceptedParams.begin(), acceptedParams.end(), "registers") != acceptedParams.end())
+                            {
+                                configManager.updatePollingConfig(newInterval, newParams);
+                            }
+                            else
+                            {
+                                // Only update interval, keep current parameters
+                                const DeviceConfig &currentConfig = configManager.getDeviceConfig();
+                                std::vector<ParameterType> currentParams;
+                                for (uint8_t i = 0; i < currentConfig.num_enabled_params; ++i)
+                                {
+                                    currentParams.push_back(currentConfig.enabled_params[i]);
+                                }
+                                configManager.updatePollingConfig(newInterval, currentParams);
+                            }
                         }
-                        else
+                        else if (!newParams.empty() && std::find(acceptedParams.begin(), acceptedParams.end(), "registers") != acceptedParams.end())
                         {
-                            Serial.println("[COMMAND] Error: Invalid command format");
+                            // Only update parameters, keep current interval
+                            const DeviceConfig &currentConfig = configManager.getDeviceConfig();
+                            configManager.updatePollingConfig(currentConfig.poll_interval_ms, newParams);
                         }
 
-                        // Mark boot status as reported if we successfully sent it
-                        if (configManager.needsBootStatusReport())
+                        if (configManager.saveConfig())
                         {
-                            configManager.markBootSuccessReported();
-                            Serial.println("[CONFIG] Boot status reported successfully");
+                            LOG_I("CONFIG", "Configuration saved to EEPROM");
+                            // Mark that we have a pending configuration update to apply after next successful upload
+                            pendingConfigurationUpdate = true;
+                            LOG_I("CONFIG", "Configuration will take effect after next successful upload cycle");
                         }
+                        else
+                        {
+                            LOG_E("CONFIG", "Error: Failed to save configuration");
+                            rejectedParams.insert(rejectedParams.end(), acceptedParams.begin(), acceptedParams.end());
+                            acceptedParams.clear();
+                        }
+                    }
+                    else if (acceptedParams.empty() && unchangedParams.empty() && rejectedParams.empty())
+                    {
+                        LOG_I("CONFIG", "No configuration parameters found in update");
+                    }
+                    else if (!acceptedParams.empty())
+                    {
+                        LOG_E("CONFIG", "Configuration update rejected due to validation errors");
+                    }
+
+                    // Store acknowledgment for next upload instead of sending immediately
+                    lastConfigAck.accepted.clear();
+                    lastConfigAck.rejected.clear();
+                    lastConfigAck.unchanged.clear();
 
-                        httpClient.end();
-                        return true;
+                    for (const String &param : acceptedParams)
+                    {
+                        lastConfigAck.accepted.push_back(param);
                     }
-                    
-                    
-                    // Process the entire response through FOTA (handles secure wrapper if needed)
-                    String responseStr = response;
-                    if (fota.processSecureFOTAResponse(responseStr))
+
+                    for (const String &param : rejectedParams)
                     {
-                        Serial.println("[CONFIG] FOTA processing completed successfully");
-                        
-                        // Mark boot status as reported if we successfully sent it
-                        if (configManager.needsBootStatusReport())
-                        {
-                            configManager.markBootSuccessReported();
-                            Serial.println("[CONFIG] Boot status reported successfully");
-                        }
-                        
-                        httpClient.end();
-                        return true;
+                        lastConfigAck.rejected.push_back(param);
                     }
-                    else
+
+                    for (const String &param : unchangedParams)
                     {
-                        // No configuration update, command, or FOTA available
-                        Serial.println("[CONFIG] No configuration update, command, or FOTA available");
-                        
-                        // Mark boot status as reported if we successfully sent it
-                        if (configManager.needsBootStatusReport())
-                        {
-                            configManager.markBootSuccessReported();
-                            Serial.println("[CONFIG] Boot status reported successfully");
-                        }
-                        
-                        httpClient.end();
-                        return true;
+                        lastConfigAck.unchanged.push_back(param);
                     }
+
+                    lastConfigAck.has_ack = true;
+
+                    LOG_I("CONFIG", "Configuration acknowledgment prepared for next upload: accepted=%u, rejected=%u, unchanged=%u",
+                          (unsigned)acceptedParams.size(), (unsigned)rejectedParams.size(),
+                          (unsigned)unchangedParams.size());
+
+                    // Mark boot status as reported if we successfully sent it
+                    if (configManager.needsBootStatusReport())
+                    {
+                        configManager.markBootSuccessReported();
+                        LOG_I("CONFIG", "Boot status reported successfully");
+                    }
+
+                    return true;
+                }
+                // Check for command message format: one "command", or a
+                // "commands" batch that is queued all or nothing
+                else if (respDoc.containsKey("command") || respDoc.containsKey("commands"))
+                {
+                    JsonArray batch = respDoc["commands"].as<JsonArray>();
+                    if (batch.isNull())
+                    {
+                        batch = respDoc.createNestedArray("commands");
+                        batch.add(respDoc["command"].as<JsonObject>());
+                    }
+#if ECOWATT_LOG_LEVEL >= LOG_LEVEL_INFO
+                    char preview[LOG_LINE_MAX];
+                    serializeJson(batch, preview, sizeof(preview));
+                    LOG_I("COMMAND", "Received %u command(s): %s", (unsigned)batch.size(), preview);
+#endif
+                    queueCommandBatch(batch);
+
+                    // Mark boot status as reported if we successfully sent it
+                    if (configManager.needsBootStatusReport())
+                    {
+                        configManager.markBootSuccessReported();
+                        LOG_I("CONFIG", "Boot status reported successfully");
+                    }
+
+                    return true;
+                }
+                
+                
+                // Process the response through FOTA (handles secure wrapper if needed)
+                if (fota.processSecureFOTAResponse(respDoc))
+                {
+                    LOG_I("CONFIG", "FOTA processing completed successfully");
+                    
+                    // Mark boot status as reported if we successfully sent it
+                    if (configManager.needsBootStatusReport())
+                    {
+                        configManager.markBootSuccessReported();
+                        LOG_I("CONFIG", "Boot status reported successfully");
+                    }
+                    
+                    return true;
                 }
                 else
                 {
-                    Serial.println("[CONFIG] Failed to parse JSON response");
+                    // No configuration update, command, or FOTA available
+                    LOG_I("CONFIG", "No configuration update, command, or FOTA available");
+                    
+                    // Mark boot status as reported if we successfully sent it
+                    if (configManager.needsBootStatusReport())
+                    {
+                        configManager.markBootSuccessReported();
+                        LOG_I("CONFIG", "Boot status reported successfully");
+                    }
+                    
+                    return true;
                 }
             }
             else
             {
-                Serial.print("[CONFIG] HTTP error code: ");
-                Serial.println(code);
+                LOG_E("CONFIG", "Failed to parse JSON response");
             }
         }
         else
         {
-            Serial.print("[CONFIG] HTTP error: ");
-            Serial.println(httpClient.errorToString(code));
-        }
-
-        if (attempt < maxAttempts - 1)
-        {
-            Serial.println("[CONFIG] Retrying configuration request...");
-            delay(2000);
+            LOG_E("CONFIG", "HTTP error code: %d", code);
         }
     }
+    else
+    {
+        LOG_E("CONFIG", "HTTP error: %s", HTTPClient::errorToString(code).c_str());
+    }
 
-    httpClient.end();
     return false;
 }
 
-void executeCommand()
+// Current UTC time as ISO 8601, for command results
+static String isoTimestamp()
 {
-    if (!pendingCommand.valid)
-        return;
-
-    Serial.println("[COMMAND] Executing pending command...");
-
-    CommandResult result = {"", "", "", false};
+    time_t now = time(nullptr);
+    struct tm *timeinfo = gmtime(&now);
+    char timestamp[25];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
+    return String(timestamp);
+}
 
-    if (pendingCommand.action == "write_register")
+// Keep a result for the next upload. When too many pile up the oldest one
+// not in the upload in flight goes; if they all are, the new one does.
+static void storeCommandResult(const CommandResult &result)
+{
+    if (commandResults.size() >= COMMAND_RESULTS_MAX)
     {
-        if (executeWriteRegisterCommand(pendingCommand.target_register, pendingCommand.value, result))
-        {
-            result.status = "success";
-            // Generate proper ISO8601 timestamp
-            // Since ESP8266 doesn't have RTC, we'll use a simplified timestamp
-            // In production, you would sync with NTP or use the timestamp from the server
-            time_t now = time(nullptr);
-            struct tm *timeinfo = gmtime(&now);
-            char timestamp[25];
-            strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", timeinfo);
-            result.executed_at = String(timestamp);
-            Serial.println("[COMMAND] Command executed successfully");
-        }
-        else
+        if (commandResultsSent >= commandResults.size())
         {
-            result.status = "failure";
-            if (result.error_message.length() == 0)
-                result.error_message = "Command execution failed";
-            Serial.print("[COMMAND] Command execution failed: ");
-            Serial.println(result.error_message);
+            LOG_W("COMMAND", "Too many unreported results, dropping %s = %d", result.target_register.c_str(),
+                  result.value);
+            return;
         }
+        LOG_W("COMMAND", "Too many unreported results, dropping the oldest unsent one");
+        commandResults.erase(commandResults.begin() + commandResultsSent);
     }
-    else
-    {
-        result.status = "failure";
-        result.error_message = "Unsupported action: " + pendingCommand.action;
-        Serial.print("[COMMAND] Unsupported action: ");
-        Serial.println(pendingCommand.action);
-    }
-
-    // Store result for next transmission
-    lastCommandResult = result;
-    lastCommandResult.has_result = true;
+    commandResults.push_back(result);
+    commandResults.back().has_result = true;
+}
 
-    // Clear pending command
-    pendingCommand.valid = false;
+static CommandResult commandFailure(const PendingCommand &command, const String &error)
+{
+    CommandResult result = {"failure", "", error, true, command.target_register, command.value};
+    return result;
 }
 
-bool executeWriteRegisterCommand(const String &register_name, int value, CommandResult &result)
+static PendingCommand parseCommand(const JsonObject &entry)
 {
-    Serial.print("[COMMAND] Writing to register: ");
-    Serial.print(register_name);
-    Serial.print(" = ");
-    Serial.println(value);
+    PendingCommand command;
+    command.action = entry["action"] | "";
+    command.target_register = entry["target_register"] | "";
+    command.value = entry["value"] | 0;
+    command.received_at = millis();
+    command.valid = true;
+    return command;
+}
 
-    // Map register names to our system
-    // Only register 8 (export power percentage) is writable according to specification
-    if (register_name == "output_power_percentage" || register_name == "export_power_percent")
+// Validate a batch of cloud commands and queue it. Either every command is
+// queued or none is, and each rejected command gets a failure result,
+// including those past the first error or beyond the queue's capacity.
+void queueCommandBatch(const JsonArray &batch)
+{
+    PendingCommand commands[COMMAND_QUEUE_SIZE];
+    size_t count = 0;
+    String error;
+    for (JsonObject entry : batch)
     {
-        // Use the inverter's setExportPowerPercent method
-        if (inverter.setExportPowerPercent(value))
+        if (count == COMMAND_QUEUE_SIZE)
         {
-            Serial.print("[COMMAND] Successfully wrote ");
-            Serial.print(value);
-            Serial.print(" to ");
-            Serial.println(register_name);
-            return true;
-        }
-        else
-        {
-            result.error_message = "Failed to write to inverter register";
-            Serial.println("[COMMAND] Error: Failed to write to inverter register");
-            return false;
+            error = "Too many commands in one batch";
+            break;
         }
+        PendingCommand &command = commands[count++];
+        command = parseCommand(entry);
+
+        uint16_t reg, raw;
+        CommandResult check;
+        if (command.action != "write_register" || command.target_register.length() == 0)
+            error = "Invalid command format";
+        else if (!resolveWriteCommand(command.target_register, command.value, reg, raw, check))
+            error = check.error_message;
+        if (error.length() > 0)
+            break;
     }
-    else
+    if (error.length() == 0 && count > COMMAND_QUEUE_SIZE - commandQueue.size())
+        error = "Command queue full";
+
+    if (error.length() > 0)
     {
-        result.error_message = "Register '" + register_name + "' is not writable";
-        Serial.print("[COMMAND] Error: Register '");
-        Serial.print(register_name);
-        Serial.println("' is not writable");
-        return false;
+        LOG_E("COMMAND", "Error: %s, rejecting %u command(s)", error.c_str(), (unsigned)batch.size());
+        for (JsonObject entry : batch)
+            storeCommandResult(commandFailure(parseCommand(entry), "Batch rejected: " + error));
+        return;
     }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        commandQueue.push(commands[i]);
+        LOG_I("COMMAND", "Queued write command: register=%s, value=%d", commands[i].target_register.c_str(),
+              commands[i].value);
+    }
+    scheduler.request(commandJob);
 }
 
-bool uploadToServer(const std::vector<Sample> &samples)
+// Drains the whole queue. Writes are resolved to registers, the last write
+// to a register wins, and each run of consecutive registers goes out as one
+// frame, so a multi-register update costs as few round trips as possible.
+void executeCommand()
 {
-    const APIConfig &apiConfig = configManager.getAPIConfig();
-    HTTPClient httpClient;
-    WiFiClient wifiClient;
+    PendingCommand batch[COMMAND_QUEUE_SIZE];
+    size_t count = commandQueue.takeAll(batch, COMMAND_QUEUE_SIZE);
+    if (count == 0)
+        return;
 
-    // Use upload_url for cloud ingestion
-    const char *uploadUrl = apiConfig.upload_url[0] != '\0' ? apiConfig.upload_url : "http://10.63.73.102:5000/upload";
-    httpClient.begin(wifiClient, uploadUrl);
-    Serial.print("[HTTP] POST to: ");
-    Serial.println(uploadUrl);
-    httpClient.addHeader("Content-Type", "application/json");
-    httpClient.setTimeout(apiConfig.timeout_ms);
-
-    // Build payload expected by frontend with compression + aggregation
-    DynamicJsonDocument jsonDoc(8192);
-    // Session/window metadata
-    static uint32_t session_counter = 0;
-    // Derive window timing from first/last sample timestamps
-    uint32_t window_start = samples.empty() ? 0 : samples.front().timestamp;
-    uint32_t window_end = samples.empty() ? 0 : samples.back().timestamp;
-    jsonDoc["device_id"] = WiFi.hostname();
-    jsonDoc["timestamp"] = millis() - startTime; // client send time
-    jsonDoc["session_id"] = (uint32_t)(ESP.getChipId() ^ millis() ^ (++session_counter));
-    jsonDoc["window_start_ms"] = window_start;
-    jsonDoc["window_end_ms"] = window_end;
-    jsonDoc["poll_count"] = (int)samples.size();
-
-    // Include command result if available
-    if (lastCommandResult.has_result)
-    {
-        JsonObject commandResult = jsonDoc.createNestedObject("command_result");
-        commandResult["status"] = lastCommandResult.status;
-        if (lastCommandResult.executed_at.length() > 0)
-            commandResult["executed_at"] = lastCommandResult.executed_at;
-        if (lastCommandResult.error_message.length() > 0)
-            commandResult["error_message"] = lastCommandResult.error_message;
-
-        Serial.print("[COMMAND] Including command result in upload: ");
-        serializeJson(commandResult, Serial);
-        Serial.println();
-    }
-
-    // Include config acknowledgment if available
-    if (lastConfigAck.has_ack)
+    LOG_I("COMMAND", "Executing %u queued command(s)...", (unsigned)count);
+
+    struct RegisterWrite
     {
-        JsonObject configAck = jsonDoc.createNestedObject("config_ack");
+        uint16_t reg;
+        uint16_t raw;
+        uint8_t command; // Index in batch
+    };
+    CommandResult results[COMMAND_QUEUE_SIZE];
+    RegisterWrite writes[COMMAND_QUEUE_SIZE];
+    size_t numWrites = 0;
 
-        JsonArray acceptedArray = configAck.createNestedArray("accepted");
-        for (const String &param : lastConfigAck.accepted)
+    for (size_t i = 0; i < count; i++)
+    {
+        results[i] = {"", "", "", true, batch[i].target_register, batch[i].value};
+        if (batch[i].action != "write_register")
         {
-            acceptedArray.add(param);
+            results[i].status = "failure";
+            results[i].error_message = "Unsupported action: " + batch[i].action;
+            LOG_E("COMMAND", "Unsupported action: %s", batch[i].action.c_str());
+            continue;
         }
 
-        JsonArray rejectedArray = configAck.createNestedArray("rejected");
-        for (const String &param : lastConfigAck.rejected)
+        RegisterWrite write = {0, 0, (uint8_t)i};
+        if (!resolveWriteCommand(batch[i].target_register, batch[i].value, write.reg, write.raw, results[i]))
         {
-            rejectedArray.add(param);
+            results[i].status = "failure";
+            continue;
         }
 
-        JsonArray unchangedArray = configAck.createNestedArray("unchanged");
-        for (const String &param : lastConfigAck.unchanged)
+        // Keep writes sorted by register; a later write replaces an earlier one
+        size_t pos = 0;
+        while (pos < numWrites && writes[pos].reg < write.reg)
+            pos++;
+        if (pos < numWrites && writes[pos].reg == write.reg)
         {
-            unchangedArray.add(param);
+            CommandResult &replaced = results[writes[pos].command];
+            replaced.status = "superseded";
+            replaced.error_message = "Replaced by a later write to the same register";
+            writes[pos] = write;
+            continue;
         }
-
-        Serial.print("[CONFIG] Including config acknowledgment in upload: ");
-        serializeJson(configAck, Serial);
-        Serial.println();
+        for (size_t j = numWrites; j > pos; j--)
+            writes[j] = writes[j - 1];
+        writes[pos] = write;
+        numWrites++;
     }
 
-    // Accumulators for a single-document (non-chunked) build
-    size_t totalOriginalBytes = 0;   // sum of 4 * n_samples per field
-    size_t totalCompressedBytes = 0; // sum of varint-encoded bytes_len per field
-    float totalCpuMs = 0.0f;         // sum of cpu_time_ms per field
-    bool verifyAll = true;           // AND of per-field verify_ok
-
-    // Helper to append a single parameter field into a doc and accumulate totals
-    auto appendParamField = [&](DynamicJsonDocument &doc, ParameterType param)
+    // One frame per run of consecutive registers
+    size_t start = 0;
+    while (start < numWrites)
     {
-        JsonObject fieldsObjLoc = doc["fields"].isNull() ? doc.createNestedObject("fields") : doc["fields"].as<JsonObject>();
-
-        // Collect scaled integer series for this parameter
-        std::vector<long> series;
-        series.reserve(samples.size());
-        for (const auto &s : samples)
+        size_t end = start + 1;
+        while (end < numWrites && writes[end].reg == writes[end - 1].reg + 1 &&
+               end - start < ESP8266ModbusHandler::MAX_WRITE_REGS)
+            end++;
+
+        uint16_t values[COMMAND_QUEUE_SIZE];
+        for (size_t k = start; k < end; k++)
+            values[k - start] = writes[k].raw;
+        bool ok = inverter.writeRegisters(writes[start].reg, values, (uint16_t)(end - start));
+        String executedAt = ok ? isoTimestamp() : String();
+        LOG_I("COMMAND", "%s %u register(s) from %u in one frame", ok ? "Wrote" : "Failed to write",
+              (unsigned)(end - start), writes[start].reg);
+
+        // Verify through the cache: the write invalidated these registers, so
+        // this is one block read that also refreshes them for later readers
+        uint16_t readBack[COMMAND_QUEUE_SIZE];
+        bool verified = ok && inverter.readCached(writes[start].reg, (uint16_t)(end - start), readBack);
+        if (ok && !verified)
+            LOG_W("COMMAND", "Could not read back register(s) from %u", writes[start].reg);
+
+        for (size_t k = start; k < end; k++)
         {
-            if (!s.hasValue(param))
-                continue;
-            float v = s.getValue(param);
-            long scaled = 0;
-            if (param == ParameterType::AC_VOLTAGE || param == ParameterType::AC_CURRENT || param == ParameterType::AC_FREQUENCY)
-                scaled = (long)roundf(v * 1000.0f);
-            else
-                scaled = (long)roundf(v);
-            series.push_back(scaled);
-        }
-        if (series.empty())
-            return; // nothing to add
-
-        long minV = series[0], maxV = series[0];
-        long sum = 0;
-        for (long x : series)
-        {
-            if (x < minV)
-                minV = x;
-            if (x > maxV)
-                maxV = x;
-            sum += x;
-        }
-        float avg = (float)sum / (float)series.size();
-
-        unsigned long t0 = micros();
-        std::vector<int32_t> deltas;
-        Compression::delta_compress(series, deltas);
-        std::vector<uint8_t> varintBytes;
-        Compression::encode_deltas_varint(deltas, varintBytes);
-        bool verify_ok = true;
-        {
-            std::vector<int32_t> deltas2;
-            if (!Compression::decode_deltas_varint(varintBytes, deltas2))
-                verify_ok = false;
-            else
+            CommandResult &result = results[writes[k].command];
+            result.status = ok ? "success" : "failure";
+            result.executed_at = executedAt;
+            if (!ok)
             {
-                std::vector<long> recon;
-                Compression::delta_decompress(deltas2, recon);
-                if (recon.size() != series.size())
-                    verify_ok = false;
-                else
-                {
-                    for (size_t i = 0; i < recon.size(); ++i)
-                    {
-                        if (recon[i] != series[i])
-                        {
-                            verify_ok = false;
-                            break;
-                        }
-                    }
-                }
+                result.error_message = "Failed to write to inverter register";
+            }
+            else if (verified && readBack[k - start] != writes[k].raw)
+            {
+                result.status = "failure";
+                result.error_message = "Inverter reports " + String(readBack[k - start]) + " after the write";
             }
         }
-        unsigned long t1 = micros();
-        float cpu_ms = (t1 - t0) / 1000.0f;
-        size_t bytes_len = varintBytes.size();
-
-        String paramName = parameterTypeToString(param);
-        JsonObject field = fieldsObjLoc.createNestedObject(paramName.c_str());
-        field["method"] = "Delta";
-        field["param_id"] = static_cast<int>(param);
-        field["n_samples"] = (int)series.size();
-        field["bytes_len"] = (int)bytes_len;
-        field["cpu_time_ms"] = cpu_ms;
-        field["verify_ok"] = verify_ok;
-        field["original_bytes"] = (int)(4 * series.size());
-
-        JsonObject agg = field.createNestedObject("agg");
-        agg["min"] = (long)minV;
-        agg["avg"] = avg;
-        agg["max"] = (long)maxV;
-
-        JsonArray payloadArr = field.createNestedArray("payload");
-        for (auto d : deltas)
-            payloadArr.add((long)d);
-        field["payload_varint_hex"] = Compression::hex_encode(varintBytes);
-
-        // Accumulate upload-level totals
-        totalOriginalBytes += (4 * series.size());
-        totalCompressedBytes += bytes_len;
-        totalCpuMs += cpu_ms;
-        verifyAll = verifyAll && verify_ok;
-    };
+        start = end;
+    }
 
-    const auto enabledParams = pollingConfig.getEnabledParameters();
+    // Store results for next transmission
+    for (size_t i = 0; i < count; i++)
+    {
+        if (results[i].status == "failure")
+            LOG_E("COMMAND", "Command %s = %d failed: %s", results[i].target_register.c_str(), results[i].value,
+                  results[i].error_message.c_str());
+        storeCommandResult(results[i]);
+    }
+}
 
-    // First, attempt to build a single-chunk payload and see if it fits
-    for (ParameterType p : enabledParams)
+// Cloud register name first, then the parameter key ("export_power_percent");
+// only parameters marked writable in kParams are accepted. Yields the
+// register and its raw value.
+bool resolveWriteCommand(const String &register_name, int value, uint16_t &reg, uint16_t &raw, CommandResult &result)
+{
+    const ParamDesc *desc = find_param_by_cloud_name(register_name.c_str());
+    if (!desc)
+        desc = find_param_by_key(register_name.c_str());
+    if (!desc || !param_writable(param_id(desc)))
+    {
+        result.error_message = "Register '" + register_name + "' is not writable";
+        LOG_E("COMMAND", "Error: Register '%s' is not writable", register_name.c_str());
+        return false;
+    }
+    if (!ESP8266Inverter::encodeWrite(param_id(desc), value, raw))
     {
-        appendParamField(jsonDoc, p);
+        result.error_message = "Value " + String(value) + " out of range for '" + register_name + "'";
+        LOG_E("COMMAND", "Error: Value %d out of range for '%s'", value, register_name.c_str());
+        return false;
     }
+    reg = param_reg(param_id(desc));
+    return true;
+}
 
-    // Add upload-level metadata for original/compressed sizes and verification
-    jsonDoc["original_payload_size_bytes_total"] = (int)totalOriginalBytes;
-    jsonDoc["compressed_payload_size_bytes_total"] = (int)totalCompressedBytes;
-    jsonDoc["cpu_time_ms_total"] = totalCpuMs;
-    jsonDoc["verify_ok_all"] = verifyAll;
+static UploadContext uploadCtx;
+// Base64/HMAC time of the last upload body, for the serialize/wrap split
+static uint32_t uploadWrapUs = 0;
 
-    const size_t PAYLOAD_THRESHOLD = 3500; // bytes; adjust if needed
+// Compute metadata and encode every field once; only the compact results are kept
+static void prepareUpload(UploadContext &ctx)
+{
+    MetricTimer timer(MetricStage::UPLOAD_BUILD);
+    // Session/window metadata
+    static uint32_t session_counter = 0;
+    ctx.deviceId = WiFi.hostname();
+    ctx.sendTime = millis() - startTime; // client send time
+    ctx.sessionId = (uint32_t)(ESP.getChipId() ^ millis() ^ (++session_counter));
 
-    // Function to send a document with retry/backoff
-    auto sendWithRetry = [&](DynamicJsonDocument &doc) -> bool
+    // Results that arrive while this upload is in flight wait for the next one
+    commandResultsSent = commandResults.size();
+    if (commandResultsSent > 0)
     {
-        // Compute MAC over JSON without mac field
-        String tmp;
-        serializeJson(doc, tmp);
-        uint32_t macLocal = crc32_calc(reinterpret_cast<const uint8_t *>(tmp.c_str()), tmp.length());
-        doc["mac_crc32"] = macLocal;
-        tmp = String();
-        serializeJson(doc, tmp);
+        LOG_I("COMMAND", "Including %u command result(s) in upload, last: %s", (unsigned)commandResultsSent,
+              commandResults[commandResultsSent - 1].status.c_str());
+    }
+    if (lastConfigAck.has_ack)
+    {
+        LOG_I("CONFIG", "Including config acknowledgment in upload: %u accepted, %u rejected, %u unchanged",
+              (unsigned)lastConfigAck.accepted.size(), (unsigned)lastConfigAck.rejected.size(),
+              (unsigned)lastConfigAck.unchanged.size());
+    }
 
-        Serial.print("[HTTP] Payload size: ");
-        Serial.println(tmp.length());
+    // Interval, power and report state as of now; retries resend it unchanged
+    ctx.commandResults = &commandResults;
+    ctx.commandCount = commandResultsSent;
+    ctx.configAck = &lastConfigAck;
+    ctx.adaptive = pollRate.adaptive();
+    ctx.pollIntervalMs = pollRate.interval();
+    ctx.powerMode = powerManager.mode();
+    ctx.radioOnLastHourS = powerManager.radioOnLastHourS();
+    ESP8266UploadBuilder::encode(ctx, pollingConfig);
+
+    HeapSnapshot heap = takeHeapSnapshot();
+    metrics.noteHeap(heap.free_heap, heap.max_free_block, heap.fragmentation);
+    metrics.summarize(ctx.metrics);
+
+    // One nonce per upload; retries resend the same signed message
+    ctx.nonce = configManager.getNextNonce();
+}
 
-        const int maxAttempts = 3;
-        int attemptLocal = 0;
-        while (attemptLocal < maxAttempts)
-        {
-            int code = httpClient.POST(tmp);
-            if (code > 0)
-            {
-                String response = httpClient.getString();
-                Serial.print("[HTTP] Response code: ");
-                Serial.println(code);
-                Serial.print("[HTTP] Response: ");
-                Serial.println(response);
+static Sample spillBatch[UPLOAD_BATCH_MAX_SAMPLES];
 
-                if (code == HTTP_CODE_OK)
-                {
-                    StaticJsonDocument<1024> respDoc;
-                    if (deserializeJson(respDoc, response) == DeserializationError::Ok)
-                    {
-                        const char *status = respDoc["status"] | "";
-                        if (strcmp(status, "ok") == 0)
-                        {
-                            return true;
-                        }
-                    }
-                }
-            }
-            else
-            {
-                Serial.print("[HTTP] Error: ");
-                Serial.println(httpClient.errorToString(code));
-            }
-            ++attemptLocal;
-            if (attemptLocal < maxAttempts)
-            {
-                uint32_t backoffMs = (1u << (attemptLocal - 1)) * 1000u;
-                if (backoffMs > 4000u)
-                    backoffMs = 4000u;
-                Serial.print("[HTTP] Retry attempt ");
-                Serial.print(attemptLocal + 1);
-                Serial.print(" in ");
-                Serial.print(backoffMs);
-                Serial.println(" ms");
-                delay(backoffMs);
-            }
-        }
-        return false;
-    };
+// True when the rollup queue spans the given block, so rollups can stand in for it
+static bool rollupsCover(const Sample *block, size_t count)
+{
+    size_t n = aggregator.pendingCount();
+    return n > 0 && count > 0 && block[0].timestamp >= aggregator.pending(0).start_ms &&
+           block[count - 1].timestamp <= aggregator.pending(n - 1).end_ms;
+}
 
-    // Add security features encryption, signing, etc. as needed here
-    String securePayload = ESP8266Security::createSecureWrapper(jsonDoc);
+// Drop spilled blocks that lie inside an acknowledged rollup span
+static size_t dropCoveredSpill(uint32_t start_ms, uint32_t end_ms)
+{
+    size_t dropped = 0;
+    while (!spillQueue.empty())
+    {
+        size_t count = spillQueue.peek(spillBatch, SPILL_BLOCK_SAMPLES);
+        if (count == 0 || spillBatch[0].timestamp < start_ms || spillBatch[count - 1].timestamp > end_ms)
+            break;
+        spillQueue.pop();
+        dropped += count;
+        yield();
+    }
+    return dropped;
+}
 
-    // Assign existing doc to parsed secure payload
-    jsonDoc.clear();
-    deserializeJson(jsonDoc, securePayload);
+// Random delay between half and all of ms, so devices that failed together
+// do not retry together
+static uint32_t withJitter(uint32_t ms)
+{
+    return ms / 2 + (uint32_t)random(ms / 2 + 1);
+}
 
-    // If the single doc is too large, chunk by fields
-    String firstPayload;
-    serializeJson(jsonDoc, firstPayload);
-    if (firstPayload.length() <= PAYLOAD_THRESHOLD)
+// Oldest data first: spilled blocks from flash, else a zero-copy window of
+// the RAM ring. Either source is consumed only after ACK success. A backlog
+// is merged into one request of up to UPLOAD_BATCH_MAX_SAMPLES, so catching
+// up costs one nonce, MAC and round trip per batch rather than per block.
+// While the spilled backlog is large, queued rollups replace the raw blocks
+// they cover, so catch-up cost per upload stays bounded.
+static bool beginUpload(UploadContext &ctx)
+{
+    if (!systemInitialized || sampleStore.empty())
     {
-        bool ok = sendWithRetry(jsonDoc);
-        httpClient.end();
-        return ok;
+        LOG_D("UPLOAD", "No data to upload");
+        return false;
     }
+    if (uploadFailures > 0 && (long)(millis() - uploadBackoffUntil) < 0)
+    {
+        LOG_D("UPLOAD", "Backing off after %u failed upload(s), %lu ms left", uploadFailures,
+              (unsigned long)(uploadBackoffUntil - millis()));
+        return false;
+    }
+    lastUploadAt = millis();
 
-    Serial.println("[UPLOAD] Payload exceeds threshold, chunking by fields");
+    LOG_I("UPLOAD", "Starting data upload...");
 
-    // Build per-field chunks
-    struct FieldNameParam
-    {
-        String name;
-        ParameterType param;
-    };
-    std::vector<FieldNameParam> fieldList;
-    for (auto p : enabledParams)
+    ctx.rollupMode = false;
+    ctx.rollups.clear();
+    ctx.samples = sampleStore.takeWindow(spillBatch, UPLOAD_BATCH_MAX_SAMPLES, ctx.fromSpill);
+    // Rollups cover the primary inverter only, so several inverters always
+    // drain their raw backlog
+    if (ctx.fromSpill && pollingConfig.slaveCount() == 1 && spillQueue.pendingSamples() >= ROLLUP_BACKLOG_SAMPLES &&
+        rollupsCover(spillBatch, ctx.samples.size()))
     {
-        FieldNameParam f{parameterTypeToString(p), p};
-        fieldList.push_back(f);
+        ctx.rollupMode = true;
+        ctx.fromSpill = false;
+        ctx.backlogSamples = spillQueue.pendingSamples();
+        for (size_t i = 0; i < aggregator.pendingCount(); i++)
+            ctx.rollups.push_back(aggregator.pending(i));
+        ctx.samples = SampleWindow();
+        LOG_I("UPLOAD", "Backlog of %u spilled samples, sending %u rollups instead", (unsigned)ctx.backlogSamples,
+              (unsigned)ctx.rollups.size());
+        prepareUpload(ctx);
+        return true;
     }
+    if (ctx.samples.empty())
+        return false;
+    LOG_I("UPLOAD", "Uploading %u %s", (unsigned)ctx.samples.size(), ctx.fromSpill ? "spilled samples" : "samples");
+
+    prepareUpload(ctx);
+    return true;
+}
 
-    // Helper to append a single parameter into a chunk doc and accumulate chunk-level totals only
-    auto appendParamFieldChunk = [&](DynamicJsonDocument &doc, ParameterType param,
-                                     size_t &chunkOriginalBytes, size_t &chunkCompressedBytes,
-                                     float &chunkCpuMs, bool &chunkVerifyAll)
+// Runs from the upload channel's completion callback, with the body in the
+// channel's fixed response buffer; true when the server acknowledged the upload
+static bool handleUploadResponse(int code, const uint8_t *body, size_t length)
+{
+    LOG_D("HTTP", "Payload size: %u", (unsigned)uploadHttp.bytesSent());
+    if (code > 0)
     {
-        JsonObject fieldsObjLoc = doc["fields"].isNull() ? doc.createNestedObject("fields") : doc["fields"].as<JsonObject>();
+        LOG_D("HTTP", "Response code: %d", code);
+        LOG_V("HTTP", "Response: %.*s", (int)length, (const char *)body);
 
-        // Collect scaled integer series for this parameter
-        std::vector<long> series;
-        series.reserve(samples.size());
-        for (const auto &s : samples)
+        // The buffer is armed per request; a body elsewhere means it was not
+        if (body != uploadResponse)
         {
-            if (!s.hasValue(param))
-                continue;
-            float v = s.getValue(param);
-            long scaled = 0;
-            if (param == ParameterType::AC_VOLTAGE || param == ParameterType::AC_CURRENT || param == ParameterType::AC_FREQUENCY)
-                scaled = (long)roundf(v * 1000.0f);
-            else
-                scaled = (long)roundf(v);
-            series.push_back(scaled);
-        }
-        if (series.empty())
-            return; // nothing to add
-
-        long minV = series[0], maxV = series[0];
-        long sum = 0;
-        for (long x : series)
-        {
-            if (x < minV)
-                minV = x;
-            if (x > maxV)
-                maxV = x;
-            sum += x;
-        }
-        float avg = (float)sum / (float)series.size();
-
-        unsigned long t0 = micros();
-        std::vector<int32_t> deltas;
-        Compression::delta_compress(series, deltas);
-        std::vector<uint8_t> varintBytes;
-        Compression::encode_deltas_varint(deltas, varintBytes);
-        bool verify_ok = true;
-        {
-            std::vector<int32_t> deltas2;
-            if (!Compression::decode_deltas_varint(varintBytes, deltas2))
-                verify_ok = false;
-            else
-            {
-                std::vector<long> recon;
-                Compression::delta_decompress(deltas2, recon);
-                if (recon.size() != series.size())
-                    verify_ok = false;
-                else
-                {
-                    for (size_t i = 0; i < recon.size(); ++i)
-                    {
-                        if (recon[i] != series[i])
-                        {
-                            verify_ok = false;
-                            break;
-                        }
-                    }
-                }
-            }
+            LOG_E("HTTP", "Upload response missed its buffer");
+            return false;
         }
-        unsigned long t1 = micros();
-        float cpu_ms = (t1 - t0) / 1000.0f;
-        size_t bytes_len = varintBytes.size();
-
-        String paramName = parameterTypeToString(param);
-        JsonObject field = fieldsObjLoc.createNestedObject(paramName.c_str());
-        field["method"] = "Delta";
-        field["param_id"] = static_cast<int>(param);
-        field["n_samples"] = (int)series.size();
-        field["bytes_len"] = (int)bytes_len;
-        field["cpu_time_ms"] = cpu_ms;
-        field["verify_ok"] = verify_ok;
-        field["original_bytes"] = (int)(4 * series.size());
-
-        JsonObject agg = field.createNestedObject("agg");
-        agg["min"] = (long)minV;
-        agg["avg"] = avg;
-        agg["max"] = (long)maxV;
-
-        JsonArray payloadArr = field.createNestedArray("payload");
-        for (auto d : deltas)
-            payloadArr.add((long)d);
-        field["payload_varint_hex"] = Compression::hex_encode(varintBytes);
-
-        // Accumulate chunk-level totals only
-        chunkOriginalBytes += (4 * series.size());
-        chunkCompressedBytes += bytes_len;
-        chunkCpuMs += cpu_ms;
-        chunkVerifyAll = chunkVerifyAll && verify_ok;
-    };
-
-    // Try sequentially packing fields until threshold is reached, send chunk, then continue
-    size_t total = 0;
-    {
-        // compute total chunks by simulating packing
-        size_t countChunks = 0;
-        size_t idx = 0;
-        while (idx < fieldList.size())
+        if (code == HTTP_CODE_OK)
         {
-            DynamicJsonDocument docChunk(8192);
-            // copy session/window metadata
-            for (JsonPair kv : jsonDoc.as<JsonObject>())
+            // Only the status is kept, whatever else the reply carries
+            StaticJsonDocument<JSON_OBJECT_SIZE(1)> filter;
+            filter["status"] = true;
+            StaticJsonDocument<64> respDoc;
+            if (deserializeJson(respDoc, (const char *)body, length, DeserializationOption::Filter(filter)) ==
+                DeserializationError::Ok)
             {
-                if (String(kv.key().c_str()) == "fields")
-                    continue;
-                docChunk[kv.key().c_str()] = kv.value();
+                const char *status = respDoc["status"] | "";
+                return strcmp(status, "ok") == 0;
             }
-            JsonObject fieldsObjC = docChunk.createNestedObject("fields");
-            size_t startIdx = idx;
-            for (; idx < fieldList.size(); ++idx)
-            {
-                appendParamField(docChunk, fieldList[idx].param);
-                String probe;
-                serializeJson(docChunk, probe);
-                if (probe.length() > PAYLOAD_THRESHOLD)
-                {
-                    // remove the last addition by rebuilding chunk without it
-                    docChunk.remove("fields");
-                    fieldsObjC = docChunk.createNestedObject("fields");
-                    for (size_t j = startIdx; j < idx; ++j)
-                        appendParamField(docChunk, fieldList[j].param);
-                    break;
-                }
-            }
-            countChunks++;
         }
-        total = countChunks;
     }
+    else
+    {
+        LOG_E("HTTP", "Error: %s", HTTPClient::errorToString(code).c_str());
+    }
+    return false;
+}
 
-    size_t seq = 1;
-    size_t idx = 0;
-    while (idx < fieldList.size())
+// Split one attempt's time into build-side and network-side stages
+static void recordUploadTiming(int code)
+{
+    const HttpTiming &t = uploadHttp.timing();
+    if (t.connect_us > 0)
+        metrics.record(MetricStage::UPLOAD_CONNECT, t.connect_us);
+    if (t.send_us > 0)
     {
-        DynamicJsonDocument docChunk(8192);
-        for (JsonPair kv : jsonDoc.as<JsonObject>())
+        metrics.record(MetricStage::UPLOAD_SEND, t.send_us);
+        metrics.record(MetricStage::UPLOAD_SECURE_WRAP, uploadWrapUs);
+        metrics.record(MetricStage::UPLOAD_SERIALIZE, t.body_us > uploadWrapUs ? t.body_us - uploadWrapUs : 0);
+    }
+    if (code > 0)
+        metrics.record(MetricStage::UPLOAD_WAIT, t.wait_us);
+}
+
+// Start one POST of the prepared upload on the upload channel
+static bool startUploadAttempt(UploadContext &ctx)
+{
+    const APIConfig &apiConfig = configManager.getAPIConfig();
+
+    // Use upload_url for cloud ingestion
+    const char *uploadUrl = apiConfig.upload_url[0] != '\0' ? apiConfig.upload_url : "http://10.63.73.102:5000/upload";
+    LOG_D("HTTP", "POST to: %s", uploadUrl);
+
+    bool binary = apiConfig.upload_format == UPLOAD_FORMAT_BINARY;
+    const char *contentType = binary ? ENVELOPE_CONTENT_TYPE : "application/json";
+    const char *psk = configManager.getSecurityConfig().psk;
+    const BodyWriter body = [&ctx, psk, binary](Print &out)
+    {
+        uploadWrapUs = binary ? ESP8266UploadBuilder::writeEnvelope(out, ctx, psk)
+                              : ESP8266UploadBuilder::writeJson(out, ctx, psk);
+    };
+
+    ctx.acked = false;
+    uploadWrapUs = 0;
+    uploadHttp.setResponseBuffer(uploadResponse, sizeof(uploadResponse));
+    return uploadHttp.start(uploadUrl, contentType, body, apiConfig.timeout_ms, nullptr,
+                            [&ctx](int code)
+                            {
+                                recordUploadTiming(code);
+                                ctx.acked = handleUploadResponse(code, uploadHttp.responseData(),
+                                                                 uploadHttp.responseLength());
+                            });
+}
+
+static void finishUpload(UploadContext &ctx, bool ok)
+{
+    if (ok)
+    {
+        LOG_I("UPLOAD", "Upload successful");
+        if (ctx.rollupMode)
+        {
+            size_t dropped = dropCoveredSpill(ctx.window_start, ctx.window_end);
+            LOG_I("UPLOAD", "Rollups replaced %u spilled samples", (unsigned)dropped);
+        }
+        else
+            sampleStore.consumeWindow(ctx.fromSpill);
+        // Everything up to the window end is now on the server
+        aggregator.dropThrough(ctx.window_end);
+        lastUploadOk = true;
+        uploadFailures = 0;
+
+        // Clear the reported command results after successful upload
+        if (commandResultsSent > 0)
         {
-            if (String(kv.key().c_str()) == "fields")
-                continue;
-            docChunk[kv.key().c_str()] = kv.value();
+            LOG_I("COMMAND", "%u command result(s) successfully reported to cloud", (unsigned)commandResultsSent);
+            commandResults.erase(commandResults.begin(), commandResults.begin() + commandResultsSent);
         }
-        docChunk["chunk_seq"] = (int)seq;
-        docChunk["chunk_total"] = (int)total;
-        JsonObject fieldsObjC = docChunk.createNestedObject("fields");
 
-        // Chunk accumulators
-        size_t chunkOriginalBytes = 0;
-        size_t chunkCompressedBytes = 0;
-        float chunkCpuMs = 0.0f;
-        bool chunkVerifyAll = true;
+        // Clear config acknowledgment after successful upload
+        if (lastConfigAck.has_ack)
+        {
+            LOG_I("CONFIG", "Configuration acknowledgment successfully reported to cloud");
+            lastConfigAck.has_ack = false;
+            lastConfigAck.accepted.clear();
+            lastConfigAck.rejected.clear();
+            lastConfigAck.unchanged.clear();
+        }
 
-        size_t startIdx = idx;
-        for (; idx < fieldList.size(); ++idx)
+        // Apply pending configuration changes after successful upload
+        if (pendingConfigurationUpdate)
         {
-            appendParamFieldChunk(docChunk, fieldList[idx].param, chunkOriginalBytes, chunkCompressedBytes, chunkCpuMs, chunkVerifyAll);
-            String probe;
-            serializeJson(docChunk, probe);
-            if (probe.length() > PAYLOAD_THRESHOLD)
-            {
-                // rebuild without last
-                docChunk.remove("fields");
-                fieldsObjC = docChunk.createNestedObject("fields");
-                for (size_t j = startIdx; j < idx; ++j)
-                    appendParamFieldChunk(docChunk, fieldList[j].param, chunkOriginalBytes, chunkCompressedBytes, chunkCpuMs, chunkVerifyAll);
-                break;
-            }
+            LOG_I("CONFIG", "Applying pending configuration changes...");
+            applyNewConfiguration();
+            pendingConfigurationUpdate = false;
+            LOG_I("CONFIG", "New configuration applied successfully");
         }
+    }
+    else
+    {
+        metrics.count(MetricCounter::UPLOAD_FAILURES);
+        if (!ctx.rollupMode)
+            sampleStore.keepWindow(ctx.fromSpill);
+        lastUploadOk = false;
+
+        // Exponential backoff across upload ticks; polling continues and
+        // the buffer, then the spill queue, absorb the samples meanwhile
+        if (uploadFailures < 16)
+            uploadFailures++;
+        uint32_t backoffMs = UPLOAD_BACKOFF_BASE_MS << (uploadFailures - 1);
+        if (backoffMs > UPLOAD_BACKOFF_MAX_MS || backoffMs < UPLOAD_BACKOFF_BASE_MS)
+            backoffMs = UPLOAD_BACKOFF_MAX_MS;
+        backoffMs = withJitter(backoffMs);
+        uploadBackoffUntil = millis() + backoffMs;
+        LOG_E("UPLOAD", "Upload failed (%u in a row), next upload in %u ms", uploadFailures, (unsigned)backoffMs);
+    }
 
-        // Add window totals and chunk subtotals
-        docChunk["original_payload_size_bytes_total"] = (int)totalOriginalBytes;
-        docChunk["compressed_payload_size_bytes_total"] = (int)totalCompressedBytes;
-        docChunk["cpu_time_ms_total_window"] = totalCpuMs;
-        docChunk["verify_ok_all_window"] = verifyAll;
+    commandResultsSent = 0; // Unsent results may be evicted again
+    ctx.attempt = 0;
+    ctx.samples = SampleWindow();
+    std::vector<FieldEncoding>().swap(ctx.fields);
+    std::vector<Rollup>().swap(ctx.rollups);
+    std::vector<uint8_t>().swap(ctx.sampleOffsets);
+    std::vector<uint8_t>().swap(ctx.sampleMasks);
+    std::vector<uint8_t>().swap(ctx.sampleSlaves);
+}
 
-        docChunk["original_payload_size_bytes_chunk"] = (int)chunkOriginalBytes;
-        docChunk["compressed_payload_size_bytes_chunk"] = (int)chunkCompressedBytes;
-        docChunk["cpu_time_ms_chunk"] = chunkCpuMs;
-        docChunk["verify_ok_all_chunk"] = chunkVerifyAll;
+// Upload job: prepare once, then start a POST and poll the upload channel
+// until its completion callback has run. The retry backoff is a resume delay,
+// so polls keep running while the upload waits on the cloud or on a retry.
+uint32_t uploadStep()
+{
+    if (!uploadHttp.busy())
+    {
+        if (powerManager.linkPending())
+            return POWER_CHECK_INTERVAL_MS;
+        if (uploadCtx.attempt == 0 && !beginUpload(uploadCtx))
+            return JOB_DONE;
+        startUploadAttempt(uploadCtx);
+    }
 
-        bool ok = sendWithRetry(docChunk);
-        if (!ok)
-        {
-            httpClient.end();
-            return false;
-        }
-        ++seq;
+    if (uploadHttp.poll())
+        return ASYNC_HTTP_POLL_MS;
+
+    ++uploadCtx.attempt;
+    if (uploadCtx.acked || uploadCtx.attempt >= UPLOAD_MAX_ATTEMPTS)
+    {
+        finishUpload(uploadCtx, uploadCtx.acked);
+        return JOB_DONE;
     }
 
-    httpClient.end();
-    return true;
+    metrics.count(MetricCounter::UPLOAD_RETRIES);
+    uint32_t backoffMs = (1u << (uploadCtx.attempt - 1)) * 1000u;
+    if (backoffMs > 4000u)
+        backoffMs = 4000u;
+    backoffMs = withJitter(backoffMs);
+    LOG_W("HTTP", "Retry attempt %d in %u ms", uploadCtx.attempt + 1, (unsigned)backoffMs);
+    return backoffMs;
+}
+
+// Primary inverter's enabled parameters, served from the register cache
+// between polls; a cold cache costs one block read per register block
+static void printInverterValues()
+{
+    Serial.print("Inverter Values:");
+    for (ParameterType param : pollingConfig.getEnabledParameters())
+    {
+        float value;
+        Serial.print(" ");
+        Serial.print(FPSTR(param_key(param)));
+        Serial.print("=");
+        if (inverter.read(param, value))
+            Serial.print(value, 2);
+        else
+            Serial.print("?");
+    }
+    Serial.println();
 }
 
 void printSystemStatus()
@@ -1581,12 +2074,56 @@ void printSystemStatus()
     Serial.print(ESP.getFreeHeap());
     Serial.println(" bytes");
 
+    Serial.print("Max Free Block: ");
+    Serial.print(ESP.getMaxFreeBlockSize());
+    Serial.print(" bytes (lowest after poll: ");
+    Serial.print(heapPollStats.cycles ? heapPollStats.min_max_free_block : 0);
+    Serial.println(" bytes)");
+
+    Serial.print("Heap Fragmentation: ");
+    Serial.print(ESP.getHeapFragmentation());
+    Serial.print("% (peak after poll: ");
+    Serial.print(heapPollStats.peak_fragmentation);
+    Serial.println("%)");
+
+    Serial.print("Log Ring: ");
+    Serial.print(logRing.pending());
+    Serial.print(" bytes pending, high-water ");
+    Serial.print(logRing.highWater());
+    Serial.print("/");
+    Serial.print(LOG_RING_SIZE);
+    Serial.print(", dropped ");
+    Serial.println(logRing.dropped());
+
     // Buffer status
     Serial.print("Buffer Size: ");
     Serial.print(dataBuffer.size());
     Serial.print("/");
     Serial.println(configManager.getDeviceConfig().buffer_size);
 
+    if (uploadFailures > 0)
+    {
+        long left = (long)(uploadBackoffUntil - millis());
+        Serial.print("Upload Backoff: ");
+        Serial.print(uploadFailures);
+        Serial.print(" failure(s) in a row, next upload in ");
+        Serial.print(left > 0 ? left / 1000 : 0);
+        Serial.println(" s");
+    }
+
+    // Flash spill queue
+    spillQueue.printStatus();
+    aggregator.printStatus();
+    reportFilter.printStatus();
+    slavePoller.printStatus();
+    registerCache.printStatus();
+    printInverterValues();
+    pollRate.printStatus();
+    powerManager.printStatus();
+
+    // Scheduler jobs
+    scheduler.printStats();
+
     // Configuration
     Serial.print("Poll Interval: ");
     Serial.print(configManager.getDeviceConfig().poll_interval_ms);
@@ -1596,7 +2133,30 @@ void printSystemStatus()
     Serial.print(configManager.getDeviceConfig().upload_interval_ms);
     Serial.println(" ms");
 
-    Serial.println("Config Request Interval: 5000 ms (5 seconds)");
+    // Config channel: the ticker's current setting and the kind of request
+    Serial.print("Config Requests: ");
+    if (currentConfigPollingInterval == 0)
+    {
+        Serial.print("batched with uploads (power save)");
+    }
+    else
+    {
+        Serial.print("every ");
+        Serial.print(currentConfigPollingInterval);
+        Serial.print(" ms");
+    }
+    bool conditional = configCheckAllowed();
+    bool held = conditional && configManager.getAPIConfig().config_long_poll_s > 0 && !powerManager.saving();
+    Serial.print(conditional ? (held ? ", long-poll conditional checks" : ", conditional checks")
+                             : ", full requests");
+    if (fota.needsFastPolling())
+        Serial.print(" (FOTA fast polling)");
+    Serial.println();
+    Serial.print("Config ETag: ");
+    Serial.print(configEtag.length() > 0 ? configEtag.c_str() : "(none, full requests)");
+    Serial.print(", long-poll ");
+    Serial.print(configManager.getAPIConfig().config_long_poll_s);
+    Serial.println(" s");
 
     // Pending configuration status
     if (pendingConfigurationUpdate)
@@ -1609,37 +2169,51 @@ void printSystemStatus()
     }
 
     // Command execution status
-    if (pendingCommand.valid)
+    if (!commandQueue.empty())
     {
-        Serial.print("Pending Command: ");
-        Serial.print(pendingCommand.action);
-        Serial.print(" ");
-        Serial.print(pendingCommand.target_register);
-        Serial.print(" = ");
-        Serial.println(pendingCommand.value);
+        Serial.print("Pending Commands: ");
+        Serial.print(commandQueue.size());
+        Serial.print("/");
+        Serial.println(COMMAND_QUEUE_SIZE);
+        for (size_t i = 0; i < commandQueue.size(); i++)
+        {
+            const PendingCommand &command = commandQueue.at(i);
+            Serial.print("  ");
+            Serial.print(command.action);
+            Serial.print(" ");
+            Serial.print(command.target_register);
+            Serial.print(" = ");
+            Serial.println(command.value);
+        }
     }
     else
     {
         Serial.println("Pending Command: NO");
     }
 
-    if (lastCommandResult.has_result)
+    if (!commandResults.empty())
     {
+        const CommandResult &latest = commandResults.back();
         Serial.print("Last Command Result: ");
-        Serial.print(lastCommandResult.status);
-        if (lastCommandResult.error_message.length() > 0)
+        Serial.print(latest.status);
+        if (latest.error_message.length() > 0)
         {
             Serial.print(" (");
-            Serial.print(lastCommandResult.error_message);
+            Serial.print(latest.error_message);
             Serial.print(")");
         }
-        Serial.println(" (will be reported on next upload)");
+        Serial.print(" (");
+        Serial.print(commandResults.size());
+        Serial.println(" result(s) will be reported on next upload)");
     }
     else
     {
         Serial.println("Last Command Result: NO");
     }
 
+    // Keep-alive connection statistics
+    ESP8266AsyncHttp::printAllStats();
+
     // FOTA status
     fota.printStatus();
 
@@ -1653,6 +2227,9 @@ void handleSerialCommands()
         String command = Serial.readStringUntil('\n');
         command.trim();
 
+        // Console replies go straight to Serial; let queued log lines out first
+        logRing.flush();
+
         if (command == "status")
         {
             printSystemStatus();
@@ -1670,12 +2247,13 @@ void handleSerialCommands()
         else if (command == "upload")
         {
             Serial.println("[CMD] Triggering upload...");
-            uploadData();
+            scheduler.request(uploadJob);
         }
         else if (command == "config")
         {
             Serial.println("[CMD] Requesting configuration update...");
-            requestConfigUpdate();
+            configChangePending = true; // Full request, not a conditional check
+            scheduler.request(configJob);
         }
         else if (command == "test-config")
         {
@@ -1726,13 +2304,16 @@ void handleSerialCommands()
                 Serial.println(value);
 
                 // Simulate a queued command
-                pendingCommand.action = "write_register";
-                pendingCommand.target_register = registerName;
-                pendingCommand.value = value;
-                pendingCommand.received_at = millis();
-                pendingCommand.valid = true;
-
-                Serial.println("[CMD] Command queued for execution");
+                PendingCommand pending = {"write_register", registerName, value, millis(), true};
+                if (commandQueue.push(pending))
+                {
+                    scheduler.request(commandJob);
+                    Serial.println("[CMD] Command queued for execution");
+                }
+                else
+                {
+                    Serial.println("[CMD] Command queue full");
+                }
             }
             else
             {
@@ -1782,6 +2363,164 @@ void handleSerialCommands()
                 Serial.println("[CMD] Example: version 1.1.0");
             }
         }
+        else if (command == "transport")
+        {
+            Serial.print("[CMD] Modbus transport: ");
+            Serial.println(configManager.getAPIConfig().modbus_transport == MODBUS_TRANSPORT_BINARY ? "binary" : "json");
+        }
+        else if (command.startsWith("transport "))
+        {
+            // Parse command: "transport <json|binary>"
+            String mode = command.substring(10);
+            mode.trim();
+
+            if (mode == "json" || mode == "binary")
+            {
+                configManager.setModbusTransport(mode == "binary" ? MODBUS_TRANSPORT_BINARY : MODBUS_TRANSPORT_JSON_HEX);
+                if (configManager.saveConfig())
+                {
+                    Serial.print("[CMD] Modbus transport set to: ");
+                    Serial.println(mode);
+                }
+                else
+                {
+                    Serial.println("[CMD] Failed to save Modbus transport");
+                }
+            }
+            else
+            {
+                Serial.println("[CMD] Usage: transport <json|binary>");
+            }
+        }
+        else if (command == "bench")
+        {
+            // Codec micro-benchmark over synthetic traces plus the samples in RAM
+            std::vector<BenchTrace> traces;
+            ESP8266CodecBench::buildSyntheticTraces(traces);
+
+            // A view, not a reservation: an upload may hold a window right now
+            SampleWindow recorded = dataBuffer.peekWindow(dataBuffer.size());
+            for (ParameterType param : pollingConfig.getEnabledParameters())
+            {
+                BenchTrace trace;
+                trace.name = String("recorded_") + FPSTR(param_key(param));
+                ESP8266UploadBuilder::collectSeries(recorded, param, trace.samples);
+                if (!trace.samples.empty())
+                    traces.push_back(trace);
+            }
+
+            ESP8266CodecBench::run(Serial, traces);
+        }
+        else if (command == "cache-check")
+        {
+            // Two passes over the primary's enabled registers: the first may
+            // miss, the second must be all hits with no gateway read
+            uint32_t pass[2][2];
+            bool readOk = true;
+            for (int p = 0; p < 2; p++)
+            {
+                uint32_t hits = registerCache.hits();
+                uint32_t misses = registerCache.misses();
+                for (ParameterType param : pollingConfig.getEnabledParameters())
+                {
+                    uint16_t raw;
+                    readOk = inverter.readCached(param_reg(param), 1, &raw) && readOk;
+                }
+                pass[p][0] = registerCache.hits() - hits;
+                pass[p][1] = registerCache.misses() - misses;
+            }
+            bool ok = readOk && pass[1][1] == 0 && pass[1][0] == pollingConfig.getEnabledParameters().size();
+            Serial.printf("[CMD] Cache check: first pass %u hit(s) %u miss(es), ", pass[0][0], pass[0][1]);
+            Serial.printf("second pass %u hit(s) %u miss(es): %s\n", pass[1][0], pass[1][1], ok ? "OK" : "FAILED");
+        }
+        else if (command == "soak" || command.startsWith("soak "))
+        {
+            // Parse command: "soak [days] [loss %] [outage %] [latency ms]"
+            SoakOptions options = ESP8266SoakBench::defaults();
+            int days = options.days, loss = options.lossPercent, outage = options.outagePercent,
+                latency = options.latencyMs;
+            sscanf(command.c_str() + 4, "%d %d %d %d", &days, &loss, &outage, &latency);
+            if (days >= 1 && days <= SOAK_MAX_DAYS && loss >= 0 && loss <= 100 && outage >= 0 && outage <= 100 &&
+                latency >= 0 && latency <= 60000)
+            {
+                options.days = days;
+                options.lossPercent = loss;
+                options.outagePercent = outage;
+                options.latencyMs = latency;
+                if (soakBench.running())
+                {
+                    Serial.println("[CMD] A soak is already running");
+                }
+                else if (soakBench.begin(Serial, options, pollingConfig))
+                {
+                    Serial.printf("[CMD] Soak: %d day(s), %d%% read loss, %d%% daily outage, %d ms gateway latency\n",
+                                  days, loss, outage, latency);
+                    scheduler.start(soakJob);
+                }
+            }
+            else
+            {
+                Serial.println("[CMD] Usage: soak [1-30 days] [0-100 loss %] [0-100 outage %] [0-60000 latency ms]");
+            }
+        }
+        else if (command == "format")
+        {
+            Serial.print("[CMD] Upload format: ");
+            Serial.println(configManager.getAPIConfig().upload_format == UPLOAD_FORMAT_BINARY ? "binary" : "json");
+        }
+        else if (command.startsWith("format "))
+        {
+            // Parse command: "format <json|binary>"
+            String mode = command.substring(7);
+            mode.trim();
+
+            if (mode == "json" || mode == "binary")
+            {
+                configManager.setUploadFormat(mode == "binary" ? UPLOAD_FORMAT_BINARY : UPLOAD_FORMAT_JSON);
+                if (configManager.saveConfig())
+                {
+                    Serial.print("[CMD] Upload format set to: ");
+                    Serial.println(mode);
+                }
+                else
+                {
+                    Serial.println("[CMD] Failed to save upload format");
+                }
+            }
+            else
+            {
+                Serial.println("[CMD] Usage: format <json|binary>");
+            }
+        }
+        else if (command == "longpoll")
+        {
+            Serial.print("[CMD] Config long-poll: ");
+            Serial.print(configManager.getAPIConfig().config_long_poll_s);
+            Serial.println(" s");
+        }
+        else if (command.startsWith("longpoll "))
+        {
+            // Parse command: "longpoll <seconds>", 0 = short conditional polls
+            int seconds = command.substring(9).toInt();
+            if (seconds >= 0 && seconds <= CONFIG_LONG_POLL_MAX_S)
+            {
+                configManager.setConfigLongPoll((uint8_t)seconds);
+                if (configManager.saveConfig())
+                {
+                    Serial.print("[CMD] Config long-poll set to: ");
+                    Serial.print(seconds);
+                    Serial.println(" s");
+                }
+                else
+                {
+                    Serial.println("[CMD] Failed to save long-poll setting");
+                }
+            }
+            else
+            {
+                Serial.println("[CMD] Usage: longpoll <0-55>");
+            }
+        }
         else if (command == "fota-status")
         {
             fota.printDetailedStatus();
@@ -1846,6 +2585,20 @@ void handleSerialCommands()
                 Serial.println("[CMD] Assembled firmware file exists");
             }
         }
+        else if (command == "metrics")
+        {
+            metrics.print();
+        }
+        else if (command == "metrics-reset")
+        {
+            metrics.reset();
+            Serial.println("[CMD] Latency histograms and counters reset");
+        }
+        else if (command == "jobs-reset")
+        {
+            scheduler.resetStats();
+            Serial.println("[CMD] Scheduler statistics reset");
+        }
         else if (command == "help")
         {
             Serial.println("[CMD] Available commands:");
@@ -1860,6 +2613,15 @@ void handleSerialCommands()
             Serial.println("  wifi    - Show WiFi status");
             Serial.println("  version - Show current firmware version");
             Serial.println("  version <new_version> - Set firmware version");
+            Serial.println("  transport [json|binary] - Show or set Modbus gateway transport");
+            Serial.println("  format [json|binary] - Show or set upload body format");
+            Serial.println("  longpoll [seconds] - Show or set how long the server may hold a config check");
+            Serial.println("  bench - Run codec micro-benchmark (CSV output)");
+            Serial.println("  soak [days] [loss] [outage] [latency] - Simulated end-to-end soak (CSV output)");
+            Serial.println("  cache-check - Check that repeated register reads are served by the cache");
+            Serial.println("  jobs-reset - Reset scheduler lateness statistics");
+            Serial.println("  metrics - Dump per-stage latency histograms and counters");
+            Serial.println("  metrics-reset - Reset latency histograms and counters");
             Serial.println("  fota-status - Show FOTA update status");
             Serial.println("  fota-reset - Reset FOTA update state");
             Serial.println("  fota-assemble - Manually trigger firmware assembly");